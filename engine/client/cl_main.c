@@ -2662,6 +2662,19 @@ qboolean CL_PrecacheResources( void )
 {
 	resource_t	*pRes;
 
+	// read models and sounds in background while world is loading,
+	// loaders below will take already read files
+	for( pRes = cl.resourcesonhand.pNext; pRes && pRes != &cl.resourcesonhand; pRes = pRes->pNext )
+	{
+		if( FBitSet( pRes->ucFlags, RES_PRECACHED|RES_WASMISSING ))
+			continue;
+
+		if( pRes->type == t_model && pRes->nIndex != WORLD_INDEX )
+			Mod_PrefetchModel( pRes->szFileName );
+		else if( pRes->type == t_sound )
+			S_PrefetchSound( pRes->szFileName );
+	}
+
 	// NOTE: world need to be loaded as first model
 	for( pRes = cl.resourcesonhand.pNext; pRes && pRes != &cl.resourcesonhand; pRes = pRes->pNext )
 	{
@@ -2695,6 +2708,7 @@ qboolean CL_PrecacheResources( void )
 
 				if( FBitSet( pRes->ucFlags, RES_FATALIFMISSING ))
 				{
+					FS_CancelPrefetch();
 					CL_Disconnect_f();
 					return false;
 				}
@@ -2732,6 +2746,7 @@ qboolean CL_PrecacheResources( void )
 						if( FBitSet( pRes->ucFlags, RES_FATALIFMISSING ))
 						{
 							S_EndRegistration();
+							FS_CancelPrefetch();
 							CL_Disconnect_f();
 							return false;
 						}
@@ -2759,6 +2774,7 @@ qboolean CL_PrecacheResources( void )
 						if( FBitSet( pRes->ucFlags, RES_FATALIFMISSING ))
 						{
 							S_EndRegistration();
+							FS_CancelPrefetch();
 							CL_Disconnect_f();
 							return false;
 						}
@@ -2796,6 +2812,9 @@ qboolean CL_PrecacheResources( void )
 	if( cls.state != ca_active )
 		S_EndRegistration();
 
+	// drop files nobody asked for
+	FS_CancelPrefetch();
+
 	return true;
 }
 
@@ -354,6 +354,33 @@ sound_t S_RegisterSound( const char *name )
 	return sfx - s_knownSfx;
 }
 
+/*
+==================
+S_PrefetchSound
+
+start reading sound file in background if it's not in cache
+==================
+*/
+void S_PrefetchSound( const char *name )
+{
+	sfx_t	*sfx;
+	int	incache;
+
+	if( !COM_CheckString( name ) || !dma.initialized )
+		return;
+
+	if( S_TestSoundChar( name, '!' ) || name[0] == '*' )
+		return;
+
+	if( name[0] == '/' || name[0] == '\\' ) name++;
+	if( name[0] == '/' || name[0] == '\\' ) name++;
+
+	sfx = S_FindName( name, &incache );
+	if( !sfx || incache ) return;
+
+	FS_Prefetch( va( DEFAULT_SOUNDPATH "%s", sfx->name ), false );
+}
+
 sfx_t *S_GetSfxByHandle( sound_t handle )
 {
 	if( !dma.initialized )
@@ -421,10 +421,14 @@ void Cmd_Escape( char *newCommand, const char *oldCommand, int len );
 //
 // zone.c
 //
+#define POOL_SLAB	BIT( 0 )	// carve small allocations out of size class slabs
+#define POOL_ARENA	BIT( 1 )	// bump allocate from big chunks, Mem_Free doesn't reclaim memory
+
 void Memory_Init( void );
 void *_Mem_Realloc( poolhandle_t poolptr, void *memptr, size_t size, qboolean clear, const char *filename, int fileline );
 void *_Mem_Alloc( poolhandle_t poolptr, size_t size, qboolean clear, const char *filename, int fileline );
 poolhandle_t _Mem_AllocPool( const char *name, const char *filename, int fileline );
+poolhandle_t _Mem_AllocPoolFlags( const char *name, uint flags, const char *filename, int fileline );
 void _Mem_FreePool( poolhandle_t *poolptr, const char *filename, int fileline );
 void _Mem_EmptyPool( poolhandle_t poolptr, const char *filename, int fileline );
 void _Mem_Free( void *data, const char *filename, int fileline );
@@ -432,12 +436,19 @@ void _Mem_Check( const char *filename, int fileline );
 qboolean Mem_IsAllocatedExt( poolhandle_t poolptr, void *data );
 void Mem_PrintList( size_t minallocationsize );
 void Mem_PrintStats( void );
+void Mem_ProfileStart( void );
+void Mem_ProfileStop( void );
+qboolean Mem_ProfileActive( void );
+void Mem_ProfilePrint( int maxsites );
+qboolean Mem_ProfileDump( const char *filename );
 
 #define Mem_Malloc( pool, size ) _Mem_Alloc( pool, size, false, __FILE__, __LINE__ )
 #define Mem_Calloc( pool, size ) _Mem_Alloc( pool, size, true, __FILE__, __LINE__ )
 #define Mem_Realloc( pool, ptr, size ) _Mem_Realloc( pool, ptr, size, true, __FILE__, __LINE__ )
 #define Mem_Free( mem ) _Mem_Free( mem, __FILE__, __LINE__ )
 #define Mem_AllocPool( name ) _Mem_AllocPool( name, __FILE__, __LINE__ )
+#define Mem_AllocPoolFlags( name, flags ) _Mem_AllocPoolFlags( name, flags, __FILE__, __LINE__ )
+#define Mem_AllocArenaPool( name ) _Mem_AllocPoolFlags( name, POOL_ARENA, __FILE__, __LINE__ )
 #define Mem_FreePool( pool ) _Mem_FreePool( pool, __FILE__, __LINE__ )
 #define Mem_EmptyPool( pool ) _Mem_EmptyPool( pool, __FILE__, __LINE__ )
 #define Mem_IsAllocated( mem ) Mem_IsAllocatedExt( NULL, mem )
@@ -135,6 +135,9 @@ void FS_Init( void )
 	if( !Sys_GetParmFromCmdLine( "-game", gamedir ))
 		Q_strncpy( gamedir, SI.basedirName, sizeof( gamedir )); // gamedir == basedir
 
+	if( Sys_CheckParm( "-fsindex" ))
+		FS_SetIndexCache( va( "%s/fsindex.bin", host.rootdir ));
+
 	if( !FS_InitStdio( true, host.rootdir, SI.basedirName, gamedir, host.rodir ))
 	{
 		Host_Error( "Can't init filesystem_stdio!\n" );
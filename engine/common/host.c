@@ -54,6 +54,7 @@ struct tests_stats_s tests_stats;
 CVAR_DEFINE( host_developer, "developer", "0", FCVAR_FILTERABLE, "engine is in development-mode" );
 CVAR_DEFINE_AUTO( sys_timescale, "1.0", FCVAR_CHEAT|FCVAR_FILTERABLE, "scale frame time" );
 CVAR_DEFINE_AUTO( sys_ticrate, "100", 0, "framerate in dedicated mode" );
+static CVAR_DEFINE_AUTO( sys_eventloop, "1", 0, "dedicated server waits for exact frame time and packets instead of sleeping in milliseconds" );
 
 static CVAR_DEFINE_AUTO( host_serverstate, "0", FCVAR_READ_ONLY, "displays current server state" );
 static CVAR_DEFINE_AUTO( host_gameloaded, "0", FCVAR_READ_ONLY, "inidcates a loaded game.dll" );
@@ -64,6 +65,20 @@ static CVAR_DEFINE_AUTO( host_framerate, "0", FCVAR_FILTERABLE, "locks frame tim
 static CVAR_DEFINE( host_sleeptime, "sleeptime", "1", FCVAR_ARCHIVE|FCVAR_FILTERABLE, "milliseconds to sleep for each frame. higher values reduce fps accuracy" );
 CVAR_DEFINE( con_gamemaps, "con_mapfilter", "1", FCVAR_ARCHIVE, "when true show only maps in game folder" );
 
+#define HOST_TICK_HISTORY	1024
+#define HOST_TICK_LATE	0.1	// fraction of frame time
+
+// frames limited by Host_FilterTime, for host_tickstats
+static struct
+{
+	double	intervals[HOST_TICK_HISTORY];	// real time since previous frame
+	double	target;
+	double	lasttime;		// host.realtime of previous frame, 0 after reset
+	uint	numticks;
+	uint	numlate;
+	uint	numpacketframes;
+} host_ticks;
+
 void Sys_PrintUsage( void )
 {
 	string version_str;
@@ -93,6 +108,9 @@ void Sys_PrintUsage( void )
 	O("-rodir <path>    ", "set read-only base directory")
 	O("-bugcomp         ", "enable precise bug compatibility. Will break games that don't require it")
 	O("                 ", "Refer to engine documentation for more info")
+	O("-memslab         ", "use size class slabs for small allocations in all memory pools")
+	O("-memprofile      ", "start memory profiler on engine startup")
+	O("-fsindex         ", "cache parsed archive directories in fsindex.bin to speed up mounting")
 	O("-disablehelp     ", "disable this message")
 #if !XASH_DEDICATED
 	O("-dedicated       ", "run engine in dedicated mode")
@@ -464,6 +482,42 @@ void Host_MemStats_f( void )
 	}
 }
 
+/*
+===============
+Host_MemProfile_f
+===============
+*/
+static void Host_MemProfile_f( void )
+{
+	const char *cmd = Cmd_Argv( 1 );
+
+	if( Cmd_Argc() < 2 || !Q_stricmp( cmd, "print" ))
+	{
+		Mem_ProfilePrint( Cmd_Argc() > 2 ? Q_atoi( Cmd_Argv( 2 )) : 32 );
+	}
+	else if( !Q_stricmp( cmd, "start" ))
+	{
+		Mem_ProfileStart();
+		Con_Printf( "memory profiler started\n" );
+	}
+	else if( !Q_stricmp( cmd, "stop" ))
+	{
+		Mem_ProfileStop();
+		Con_Printf( "memory profiler stopped\n" );
+	}
+	else if( !Q_stricmp( cmd, "dump" ))
+	{
+		const char *filename = Cmd_Argc() > 2 ? Cmd_Argv( 2 ) : "memprofile.txt";
+
+		if( Mem_ProfileDump( filename ))
+			Con_Printf( "memory profile written to %s\n", filename );
+	}
+	else
+	{
+		Con_Printf( S_USAGE "memprofile <start|stop|print [count]|dump [filename]>\n" );
+	}
+}
+
 void Host_Minimize_f( void )
 {
 #ifdef XASH_SDL
@@ -618,6 +672,85 @@ double Host_CalcFPS( void )
 	return fps;
 }
 
+static int Host_CompareDoubles( const void *a, const void *b )
+{
+	double da = *(const double *)a, db = *(const double *)b;
+
+	return ( da > db ) - ( da < db );
+}
+
+/*
+===================
+Host_RecordTick
+
+frames woken up by packets only move the start of the next interval,
+otherwise the frame after them looks early or late
+===================
+*/
+static void Host_RecordTick( double scale, double target, qboolean packetframe )
+{
+	double	interval = ( host.realtime - host_ticks.lasttime ) / scale;
+	qboolean	first = host_ticks.lasttime == 0.0;
+
+	host_ticks.lasttime = host.realtime;
+
+	if( packetframe )
+	{
+		host_ticks.numpacketframes++;
+		return;
+	}
+
+	if( first )
+		return;
+
+	host_ticks.intervals[host_ticks.numticks % HOST_TICK_HISTORY] = interval;
+	host_ticks.target = target;
+	host_ticks.numticks++;
+
+	if( interval > target * ( 1.0 + HOST_TICK_LATE ))
+		host_ticks.numlate++;
+}
+
+/*
+===================
+Host_TickStats_f
+
+===================
+*/
+static void Host_TickStats_f( void )
+{
+	double jitter[HOST_TICK_HISTORY], total = 0.0;
+	int i, num;
+
+	if( !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		memset( &host_ticks, 0, sizeof( host_ticks ));
+		return;
+	}
+
+	num = Q_min( host_ticks.numticks, HOST_TICK_HISTORY );
+
+	if( !num )
+	{
+		Con_Printf( "no frames were limited yet\n" );
+		return;
+	}
+
+	for( i = 0; i < num; i++ )
+	{
+		jitter[i] = fabs( host_ticks.intervals[i] - host_ticks.target ) * 1000000.0;
+		total += host_ticks.intervals[i];
+	}
+
+	qsort( jitter, num, sizeof( jitter[0] ), Host_CompareDoubles );
+
+	Con_Printf( "frame rate: %.2f of %.2f over last %i frames\n", num / total, 1.0 / host_ticks.target, num );
+	Con_Printf( "jitter: p50 %.0f us, p90 %.0f us, p99 %.0f us, max %.0f us\n",
+		jitter[num * 50 / 100], jitter[num * 90 / 100], jitter[num * 99 / 100], jitter[num - 1] );
+	Con_Printf( "late frames: %u of %u\n", host_ticks.numlate, host_ticks.numticks );
+	Con_Printf( "frames run on packet arrival: %u\n", host_ticks.numpacketframes );
+}
+
 /*
 ===================
 Host_FilterTime
@@ -639,6 +772,7 @@ qboolean Host_FilterTime( float time )
 		static int sleeps;
 		double targetframetime;
 		int sleeptime = Host_CalcSleep();
+		qboolean packetframe = false;
 
 		// limit fps to withing tolerable range
 		fps = bound( MIN_FPS, fps, MAX_FPS );
@@ -649,13 +783,23 @@ qboolean Host_FilterTime( float time )
 
 		if(( host.realtime - oldtime ) < targetframetime * scale )
 		{
-			if( sleeptime > 0 && sleeps > 0 )
+			int wait = -1;
+
+			// wait exactly until the frame time, packets cut it short only when
+			// game runs at sv_fps rate, so extra frames just read them
+			if( Host_IsDedicated( ) && sys_eventloop.value )
+				wait = NET_WaitForEvents(( oldtime + targetframetime * scale - host.realtime ) / scale, sv_fps.value != 0.0f );
+
+			if( wait < 0 && sleeptime > 0 && sleeps > 0 )
 			{
 				Sys_Sleep( sleeptime );
 				sleeps--;
 			}
 
-			return false;
+			if( wait <= 0 )
+				return false;
+
+			packetframe = true;
 		}
 
 		if( sleeptime > 0 && sleeps <= 0 )
@@ -676,6 +820,8 @@ qboolean Host_FilterTime( float time )
 				sleeps = 1;
 			}
 		}
+
+		Host_RecordTick( scale, targetframetime, packetframe );
 	}
 
 	host.frametime = host.realtime - oldtime;
@@ -993,6 +1139,7 @@ void Host_InitCommon( int argc, char **argv, const char *progname, qboolean bCha
 	Q_snprintf( dev_level, sizeof( dev_level ), "%i", developer );
 	Cvar_DirectSet( &host_developer, dev_level );
 	Cvar_RegisterVariable( &sys_ticrate );
+	Cvar_RegisterVariable( &sys_eventloop );
 
 	if( Sys_GetParmFromCmdLine( "-sys_ticrate", ticrate ))
 	{
@@ -1105,6 +1252,8 @@ void Host_InitCommon( int argc, char **argv, const char *progname, qboolean bCha
 
 	Cmd_AddCommand( "exec", Host_Exec_f, "execute a script file" );
 	Cmd_AddCommand( "memlist", Host_MemStats_f, "prints memory pool information" );
+	Cmd_AddCommand( "memprofile", Host_MemProfile_f, "per call site memory profiler" );
+	Cmd_AddCommand( "host_tickstats", Host_TickStats_f, "prints achieved frame rate and jitter, 'reset' clears them" );
 	Cmd_AddRestrictedCommand( "userconfigd", Host_Userconfigd_f, "execute all scripts from userconfig.d" );
 
 	Image_Init();
@@ -1312,6 +1461,7 @@ void EXPORT Host_Shutdown( void )
 	SV_UnloadProgs();
 	SV_ShutdownFilter();
 	CL_Shutdown();
+	Sys_ShutdownWorkers();
 
 	Mod_Shutdown();
 	NET_Shutdown();
@@ -1379,6 +1379,109 @@ static int RemapClipNodes_r( dclipnode32_t *srcnodes, hull_t *hull, int nodenum
 	return c;
 }
 
+/*
+===============================================================================
+
+			PACKED COLLISION HULLS
+
+Clipnodes are copied into a single array in breadth-first order, each node
+carries its own plane, so hull walks don't jump between clipnodes and planes.
+hull_t is a part of the game API, so packed hulls are kept in a table
+next to the models list, hulls that aren't there use clipnodes directly.
+
+===============================================================================
+*/
+/*
+=================
+Mod_PackHull
+
+returns NULL for broken hulls
+=================
+*/
+mpackedhull_t *Mod_PackHull( const hull_t *hull, int numclipnodes, int numplanes, poolhandle_t mempool )
+{
+	mpackedhull_t	*packed;
+	int		*queue, *remap;
+	int		i, j, head, tail, count = 0;
+	qboolean		broken = false;
+
+	if( numclipnodes <= 0 || !hull->clipnodes || !hull->planes )
+		return NULL;
+
+	remap = Mem_Malloc( mempool, sizeof( *remap ) * numclipnodes );
+	queue = Mem_Malloc( host.mempool, sizeof( *queue ) * numclipnodes );
+	memset( remap, 0xff, sizeof( *remap ) * numclipnodes );
+
+	for( i = 0; i < numclipnodes && !broken; i++ )
+	{
+		if( remap[i] != -1 )
+			continue;
+
+		// breadth-first walk from each unvisited node, usually it's a submodel headnode
+		head = tail = 0;
+		queue[tail++] = i;
+		remap[i] = count++;
+
+		while( head < tail && !broken )
+		{
+			const mclipnode_t *node = &hull->clipnodes[queue[head++]];
+
+			// let the unpacked path report them
+			if( node->planenum < 0 || node->planenum >= numplanes )
+				broken = true;
+
+			for( j = 0; j < 2; j++ )
+			{
+				int child = node->children[j];
+
+				if( child >= numclipnodes )
+					broken = true;
+
+				if( child < 0 || child >= numclipnodes || remap[child] != -1 )
+					continue;
+
+				remap[child] = count++;
+				queue[tail++] = child;
+			}
+		}
+	}
+
+	if( broken )
+	{
+		Con_Reportf( S_WARN "%s: broken clipnodes, hull isn't packed\n", __func__ );
+		Mem_Free( remap );
+		Mem_Free( queue );
+		return NULL;
+	}
+
+	Mem_Free( queue );
+
+	packed = Mem_Calloc( mempool, sizeof( *packed ));
+	packed->clipnodes = hull->clipnodes;
+	packed->mempool = mempool;
+	packed->remap = remap;
+	packed->numclipnodes = numclipnodes;
+	packed->nodes = Mem_Malloc( mempool, sizeof( *packed->nodes ) * numclipnodes );
+
+	for( i = 0; i < numclipnodes; i++ )
+	{
+		const mclipnode_t	*in = &hull->clipnodes[i];
+		mpackednode_t	*out = &packed->nodes[remap[i]];
+
+		out->plane = hull->planes[in->planenum];
+		out->clipnode = i;
+
+		for( j = 0; j < 2; j++ )
+		{
+			if( in->children[j] < 0 )
+				out->children[j] = in->children[j];
+			else out->children[j] = remap[in->children[j]];
+		}
+	}
+
+	return packed;
+}
+
 /*
 =================
 Mod_MakeHull0
@@ -1414,6 +1517,8 @@ static void Mod_MakeHull0( model_t *mod )
 			else out->children[j] = child - mod->nodes;
 		}
 	}
+
+	Mod_SetPackedHull( mod, 0, Mod_PackHull( hull, mod->numnodes, mod->numplanes, mod->mempool ));
 }
 
 /*
@@ -1429,6 +1534,7 @@ static void Mod_SetupHull( dbspmodel_t *bmod, model_t *mod, poolhandle_t mempool
 	// assume no hull
 	hull->firstclipnode = hull->lastclipnode = 0;
 	hull->planes = NULL; // hull is missed
+	Mod_SetPackedHull( mod, hullnum, NULL );
 
 	if(( headnode == -1 ) || ( hullnum != 1 && headnode == 0 ))
 		return; // hull missed
@@ -1468,6 +1574,8 @@ static void Mod_SetupHull( dbspmodel_t *bmod, model_t *mod, poolhandle_t mempool
 
 	// remap clipnodes to 16-bit indexes
 	RemapClipNodes_r( bmod->clipnodes_out, hull, headnode );
+
+	Mod_SetPackedHull( mod, hullnum, Mod_PackHull( hull, count, mod->numplanes, mempool ));
 }
 
 /*
@@ -1668,6 +1776,7 @@ static void Mod_SetupSubmodels( model_t *mod, dbspmodel_t *bmod )
 			Q_snprintf( name, sizeof( name ), "*%i", i + 1 );
 			submod = Mod_FindName( name, true );
 			*submod = *mod;
+			Mod_SetPackedHull( submod, 0, Mod_FindPackedHull( &mod->hulls[0] ));
 			Q_strncpy( submod->name, name, sizeof( submod->name ));
 			submod->mempool = 0;
 			mod = submod;
@@ -2719,7 +2828,8 @@ static void Mod_LoadClipnodes( model_t *mod, dbspmodel_t *bmod )
 	dclipnode32_t	*out;
 	int		i;
 
-	bmod->clipnodes_out = out = (dclipnode32_t *)Mem_Malloc( mod->mempool, bmod->numclipnodes * sizeof( *out ));
+	// temporary, so keep it out of the model arena
+	bmod->clipnodes_out = out = (dclipnode32_t *)Mem_Malloc( host.mempool, bmod->numclipnodes * sizeof( *out ));
 
 	if(( bmod->version == QBSP2_VERSION ) || ( bmod->version == HLBSP_VERSION && bmod->isbsp30ext && bmod->numclipnodes >= MAX_MAP_CLIPNODES_HLBSP ))
 	{
@@ -3165,7 +3275,7 @@ void Mod_LoadBrushModel( model_t *mod, const void *buffer, qboolean *loaded )
 
 	if( loaded ) *loaded = false;
 
-	mod->mempool = Mem_AllocPool( poolname );
+	mod->mempool = Mem_AllocArenaPool( poolname );
 	mod->type = mod_brush;
 
 	// loading all the lumps into heap
@@ -62,6 +62,23 @@ typedef struct
 #define NL_NEEDS_LOADED	1
 #define NL_PRESENT		2
 
+// collision hull node with the plane inlined, see Mod_PackHull
+typedef struct mpackednode_s
+{
+	mplane_t		plane;		// copy of the splitting plane
+	int		children[2];	// indexes in the packed array, negative numbers are contents
+	int		clipnode;		// original index, for validation
+} mpackednode_t;
+
+typedef struct mpackedhull_s
+{
+	const mclipnode_t	*clipnodes;	// hull this was built for
+	poolhandle_t	mempool;		// owner
+	mpackednode_t	*nodes;		// in breadth-first order
+	int		*remap;		// clipnode index to packed index
+	int		numclipnodes;
+} mpackedhull_t;
+
 typedef struct hullnode_s
 {
 	struct hullnode_s	*next;
@@ -139,9 +156,13 @@ void *Mod_StudioExtradata( model_t *mod );
 model_t *Mod_FindName( const char *name, qboolean trackCRC );
 model_t *Mod_LoadModel( model_t *mod, qboolean crash );
 model_t *Mod_ForName( const char *name, qboolean crash, qboolean trackCRC );
+void Mod_PrefetchModel( const char *name );
 qboolean Mod_ValidateCRC( const char *name, CRC32_t crc );
 void Mod_NeedCRC( const char *name, qboolean needCRC );
 void Mod_FreeUnused( void );
+void Mod_SetPackedHull( model_t *mod, int hullnum, const mpackedhull_t *packed );
+const mpackedhull_t *Mod_FindPackedHull( const hull_t *hull );
+void Mod_DropPackedHulls( poolhandle_t mempool );
 
 //
 // mod_bmodel.c
@@ -158,6 +179,7 @@ mleaf_t *Mod_PointInLeaf( const vec3_t p, mnode_t *node );
 int Mod_SampleSizeForFace( msurface_t *surf );
 byte *Mod_GetPVSForPoint( const vec3_t p );
 void Mod_UnloadBrushModel( model_t *mod );
+mpackedhull_t *Mod_PackHull( const hull_t *hull, int numclipnodes, int numplanes, poolhandle_t mempool );
 void Mod_PrintWorldStats_f( void );
 
 //
@@ -854,7 +854,7 @@ void Mod_LoadStudioModel( model_t *mod, const void *buffer, qboolean *loaded )
 	Q_snprintf( poolname, sizeof( poolname ), "^2%s^7", mod->name );
 
 	if( loaded ) *loaded = false;
-	mod->mempool = Mem_AllocPool( poolname );
+	mod->mempool = Mem_AllocArenaPool( poolname );
 	mod->type = mod_studio;
 
 	phdr = R_StudioLoadHeader( mod, buffer );
@@ -904,16 +904,21 @@ void Mod_LoadStudioModel( model_t *mod, const void *buffer, qboolean *loaded )
 		}
 		else
 		{
+			byte	*temp;
+
 			// NOTE: don't modify source buffer because it's used for CRC computing
-			mod->cache.data = Mem_Calloc( mod->mempool, phdr->length );
-			memcpy( mod->cache.data, buffer, phdr->length );
-			phdr = (studiohdr_t *)mod->cache.data; // get the new pointer on studiohdr
+			temp = Mem_Malloc( host.mempool, phdr->length );
+			memcpy( temp, buffer, phdr->length );
+			phdr = (studiohdr_t *)temp;
 #if !XASH_DEDICATED
 			ref.dllFuncs.Mod_StudioLoadTextures( mod, phdr );
 #endif
 
 			// NOTE: we wan't keep raw textures in memory. just cutoff model pointer above texture base
-			mod->cache.data = Mem_Realloc( mod->mempool, mod->cache.data, phdr->texturedataindex );
+			// model pool is an arena, so don't shrink the block in place, copy it instead
+			mod->cache.data = Mem_Malloc( mod->mempool, phdr->texturedataindex );
+			memcpy( mod->cache.data, temp, phdr->texturedataindex );
+			Mem_Free( temp );
 			phdr = (studiohdr_t *)mod->cache.data; // get the new pointer on studiohdr
 			phdr->length = phdr->texturedataindex;	// update model size
 		}
@@ -26,6 +26,7 @@ GNU General Public License for more details.
 
 static model_info_t	mod_crcinfo[MAX_MODELS];
 static model_t	mod_known[MAX_MODELS];
+static const mpackedhull_t *mod_packedhulls[MAX_MODELS][MAX_MAP_HULLS]; // see Mod_PackHull
 static int	mod_numknown = 0;
 poolhandle_t      com_studiocache;		// cache for submodels
 CVAR_DEFINE( mod_studiocache, "r_studiocache", "1", FCVAR_ARCHIVE, "enables studio cache for speedup tracing hitboxes" );
@@ -99,6 +100,8 @@ Mod_FreeModel
 */
 void Mod_FreeModel( model_t *mod )
 {
+	int	i;
+
 	// already freed?
 	if( !mod || !COM_CheckStringEmpty( mod->name ) )
 		return;
@@ -106,9 +109,17 @@ void Mod_FreeModel( model_t *mod )
 	if( mod->type != mod_brush || mod->name[0] != '*' )
 	{
 		Mod_FreeUserData( mod );
+
+		// submodels share the pool of the world
+		if( mod->type == mod_brush )
+			Mod_DropPackedHulls( mod->mempool );
+
 		Mem_FreePool( &mod->mempool );
 	}
 
+	for( i = 0; i < MAX_MAP_HULLS; i++ )
+		Mod_SetPackedHull( mod, i, NULL );
+
 	if( mod->type == mod_brush && FBitSet( mod->flags, MODEL_WORLD ) )
 	{
 		world.shadowdata = NULL;
@@ -241,6 +252,24 @@ model_t *Mod_FindName( const char *filename, qboolean trackCRC )
 	return mod;
 }
 
+/*
+==================
+Mod_UserDataBuffer
+
+game callbacks always got a writable zero terminated
+buffer from FS_LoadFile, don't hand them the mapping
+==================
+*/
+static byte *Mod_UserDataBuffer( const byte *buf, fs_offset_t length )
+{
+	byte	*copy = Mem_Malloc( host.mempool, length + 1 );
+
+	memcpy( copy, buf, length );
+	copy[length] = '\0';
+
+	return copy;
+}
+
 /*
 ==================
 Mod_LoadModel
@@ -271,7 +300,8 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 	Q_strncpy( tempname, mod->name, sizeof( tempname ));
 	COM_FixSlashes( tempname );
 
-	buf = FS_LoadFile( tempname, &length, false );
+	// loaders copy everything they need, so map the file instead of reading it
+	buf = FS_MapFile( tempname, &length, false );
 
 	if( !buf )
 	{
@@ -307,7 +337,7 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 		// ref.dllFuncs.Mod_LoadModel( mod_brush, mod, buf, &loaded, 0 );
 		break;
 	default:
-		Mem_Free( buf );
+		FS_UnmapFile( buf );
 		if( crash ) Host_Error( "%s has unknown format\n", tempname );
 		else Con_Printf( S_ERROR "%s has unknown format\n", tempname );
 		return NULL;
@@ -321,11 +351,25 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 		{
 			if( svgame.physFuncs.Mod_ProcessUserData != NULL )
 			{
+				byte	*userbuf = Mod_UserDataBuffer( buf, length );
+
 				// let the server.dll load custom data
-				svgame.physFuncs.Mod_ProcessUserData( mod, true, buf );
+				svgame.physFuncs.Mod_ProcessUserData( mod, true, userbuf );
+				Mem_Free( userbuf );
+
+				// it may have changed the clipnodes
+				Mod_DropPackedHulls( mod->mempool );
 			}
 		}
 #if !XASH_DEDICATED
+		else if( clgame.drawFuncs.Mod_ProcessUserData != NULL )
+		{
+			byte	*userbuf = Mod_UserDataBuffer( buf, length );
+
+			// renderer passes it to the client.dll
+			loaded = ref.dllFuncs.Mod_ProcessRenderData( mod, true, userbuf );
+			Mem_Free( userbuf );
+		}
 		else
 		{
 			loaded = ref.dllFuncs.Mod_ProcessRenderData( mod, true, buf );
@@ -336,7 +380,7 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 	if( !loaded )
 	{
 		Mod_FreeModel( mod );
-		Mem_Free( buf );
+		FS_UnmapFile( buf );
 
 		if( crash ) Host_Error( "Could not load model %s\n", tempname );
 		else Con_Printf( S_ERROR "Could not load model %s\n", tempname );
@@ -366,7 +410,7 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 			p->initialCRC = currentCRC;
 		}
 	}
-	Mem_Free( buf );
+	FS_UnmapFile( buf );
 
 	return mod;
 }
@@ -389,6 +433,34 @@ model_t *Mod_ForName( const char *name, qboolean crash, qboolean trackCRC )
 	return Mod_LoadModel( mod, crash );
 }
 
+/*
+==================
+Mod_PrefetchModel
+
+start reading model file in background if it's not loaded yet
+==================
+*/
+void Mod_PrefetchModel( const char *name )
+{
+	char	tempname[MAX_QPATH];
+	model_t	*mod;
+	int	i;
+
+	if( !COM_CheckString( name ) || name[0] == '*' )
+		return;
+
+	for( i = 0, mod = mod_known; i < mod_numknown; i++, mod++ )
+	{
+		if( mod->mempool && !Q_stricmp( mod->name, name ))
+			return;
+	}
+
+	// same name as Mod_LoadModel will ask for
+	Q_strncpy( tempname, name, sizeof( tempname ));
+	COM_FixSlashes( tempname );
+	FS_Prefetch( tempname, false );
+}
+
 /*
 ==================
 Mod_PurgeStudioCache
@@ -472,6 +544,90 @@ void Mod_FreeUnused( void )
 	}
 }
 
+/*
+==================
+Mod_SetPackedHull
+
+models outside of the list are ignored
+==================
+*/
+void Mod_SetPackedHull( model_t *mod, int hullnum, const mpackedhull_t *packed )
+{
+	if( (uintptr_t)mod < (uintptr_t)mod_known || (uintptr_t)mod >= (uintptr_t)&mod_known[MAX_MODELS] )
+		return;
+
+	if( hullnum < 0 || hullnum >= MAX_MAP_HULLS )
+		return;
+
+	mod_packedhulls[mod - mod_known][hullnum] = packed;
+}
+
+/*
+==================
+Mod_FindPackedHull
+
+returns NULL for hulls that weren't packed
+==================
+*/
+const mpackedhull_t *Mod_FindPackedHull( const hull_t *hull )
+{
+	const mpackedhull_t	*packed;
+	size_t		offset;
+	int		i;
+
+	// box hulls and such
+	if( (uintptr_t)hull < (uintptr_t)mod_known || (uintptr_t)hull >= (uintptr_t)&mod_known[mod_numknown] )
+		return NULL;
+
+	offset = (uintptr_t)hull - (uintptr_t)mod_known;
+	i = offset / sizeof( model_t );
+	offset -= i * sizeof( model_t );
+
+	if( offset < offsetof( model_t, hulls ))
+		return NULL;
+
+	offset -= offsetof( model_t, hulls );
+
+	if( offset % sizeof( hull_t ) || offset / sizeof( hull_t ) >= MAX_MAP_HULLS )
+		return NULL;
+
+	packed = mod_packedhulls[i][offset / sizeof( hull_t )];
+
+	if( !packed || packed->clipnodes != hull->clipnodes )
+		return NULL;
+
+	// let the unpacked path deal with broken hulls
+	if( hull->firstclipnode < 0 || hull->firstclipnode >= packed->numclipnodes )
+		return NULL;
+
+	return packed;
+}
+
+/*
+==================
+Mod_DropPackedHulls
+
+forget hulls allocated from the given pool,
+the memory itself goes away with the pool
+==================
+*/
+void Mod_DropPackedHulls( poolhandle_t mempool )
+{
+	int	i, j;
+
+	if( !mempool )
+		return;
+
+	for( i = 0; i < mod_numknown; i++ )
+	{
+		for( j = 0; j < MAX_MAP_HULLS; j++ )
+		{
+			if( mod_packedhulls[i][j] && mod_packedhulls[i][j]->mempool == mempool )
+				mod_packedhulls[i][j] = NULL;
+		}
+	}
+}
+
 /*
 ===============================================================================
 
@@ -20,11 +20,10 @@ GNU General Public License for more details.
 //#define DEBUG_NET_MESSAGES_SEND
 //#define DEBUG_NET_MESSAGES_READ
 
-// precalculated bit masks for WriteUBitLong.
-// Using these tables instead of doing the calculations
-// gives a 33% speedup in WriteUBitLong.
-static uint32_t	BitWriteMasks[32][33];
-static uint32_t	ExtraMasks[32];
+// bit fields are accessed through 64-bit little-endian window that starts
+// at the byte of the first bit, so at most 39 bits never span two words
+#define MSG_WINDOW_BYTES	8
+
 const char *svc_strings[svc_lastmsg+1] =
 {
 	"svc_bad",
@@ -89,24 +88,88 @@ const char *svc_strings[svc_lastmsg+1] =
 	"svc_exec",
 };
 
-void MSG_InitMasks( void )
+/*
+=======================
+MSG_LoadWindow
+
+=======================
+*/
+static inline uint64_t MSG_LoadWindow( const byte *p )
 {
-	uint	startbit, endbit;
-	uint	maskBit, nBitsLeft;
+#if XASH_BIG_ENDIAN
+	return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24
+		| (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+#else
+	uint64_t w;
+	memcpy( &w, p, sizeof( w ));
+	return w;
+#endif
+}
 
-	for( startbit = 0; startbit < 32; startbit++ )
-	{
-		for( nBitsLeft = 0; nBitsLeft < 33; nBitsLeft++ )
-		{
-			endbit = startbit + nBitsLeft;
+/*
+=======================
+MSG_StoreWindow
 
-			BitWriteMasks[startbit][nBitsLeft] = (uint)BIT( startbit ) - 1;
-			if( endbit < 32 ) BitWriteMasks[startbit][nBitsLeft] |= ~((uint)BIT( endbit ) - 1 );
-		}
-	}
+=======================
+*/
+static inline void MSG_StoreWindow( byte *p, uint64_t w )
+{
+#if XASH_BIG_ENDIAN
+	int i;
+
+	for( i = 0; i < MSG_WINDOW_BYTES; i++, w >>= 8 )
+		p[i] = (byte)w;
+#else
+	memcpy( p, &w, sizeof( w ));
+#endif
+}
+
+/*
+=======================
+MSG_LoadDword
+
+bytes of a blob in stream order, whatever the host is
+=======================
+*/
+static inline uint32_t MSG_LoadDword( const byte *p )
+{
+#if XASH_BIG_ENDIAN
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+#else
+	uint32_t w;
+	memcpy( &w, p, sizeof( w ));
+	return w;
+#endif
+}
+
+/*
+=======================
+MSG_StoreDword
 
-	for( maskBit = 0; maskBit < 32; maskBit++ )
-		ExtraMasks[maskBit] = (uint)BIT( maskBit ) - 1;
+=======================
+*/
+static inline void MSG_StoreDword( byte *p, uint32_t w )
+{
+#if XASH_BIG_ENDIAN
+	p[0] = (byte)w;
+	p[1] = (byte)( w >> 8 );
+	p[2] = (byte)( w >> 16 );
+	p[3] = (byte)( w >> 24 );
+#else
+	memcpy( p, &w, sizeof( w ));
+#endif
+}
+
+/*
+=======================
+MSG_HasWindow
+
+whole window at this bit is inside of the buffer
+=======================
+*/
+static inline qboolean MSG_HasWindow( const sizebuf_t *sb, int bit )
+{
+	return ( bit >> 3 ) + MSG_WINDOW_BYTES <= ( sb->nDataBits + 7 ) >> 3;
 }
 
 void MSG_InitExt( sizebuf_t *sb, const char *pDebugName, void *pData, int nBytes, int nMaxBits )
@@ -206,6 +269,9 @@ void MSG_WriteOneBit( sizebuf_t *sb, int nValue )
 
 void MSG_WriteUBitLong( sizebuf_t *sb, uint curData, int numbits )
 {
+	uint64_t	mask, data;
+	int	shift;
+
 	Assert( numbits >= 0 && numbits <= 32 );
 
 	// bounds checking..
@@ -213,36 +279,29 @@ void MSG_WriteUBitLong( sizebuf_t *sb, uint curData, int numbits )
 	{
 		sb->bOverflow = true;
 		sb->iCurBit = sb->nDataBits;
+		return;
 	}
-	else
-	{
-		int	nBitsLeft = numbits;
-		int	iCurBit = sb->iCurBit;
-		uint	iDWord = iCurBit >> 5;	// Mask in a dword.
-		uint32_t	iCurBitMasked;
-		int	nBitsWritten;
-
-		Assert(( iDWord * 4 + sizeof( int )) <= (uint)MSG_GetMaxBytes( sb ));
 
-		iCurBitMasked = iCurBit & 31;
-		((uint32_t *)sb->pData)[iDWord] &= BitWriteMasks[iCurBitMasked][nBitsLeft];
-		((uint32_t *)sb->pData)[iDWord] |= curData << iCurBitMasked;
-
-		// did it span a dword?
-		nBitsWritten = 32 - iCurBitMasked;
+	shift = sb->iCurBit & 7;
+	mask = ((((uint64_t)1 ) << numbits ) - 1 ) << shift;
+	data = ((uint64_t)curData << shift ) & mask;
 
-		if( nBitsWritten < nBitsLeft )
-		{
-			nBitsLeft -= nBitsWritten;
-			iCurBit += nBitsWritten;
-			curData >>= nBitsWritten;
+	if( MSG_HasWindow( sb, sb->iCurBit ))
+	{
+		byte *p = sb->pData + ( sb->iCurBit >> 3 );
+		MSG_StoreWindow( p, ( MSG_LoadWindow( p ) & ~mask ) | data );
+	}
+	else
+	{
+		// near the end of buffer, touch only bytes we need
+		byte	*p = sb->pData + ( sb->iCurBit >> 3 );
+		int	i, numbytes = ( shift + numbits + 7 ) >> 3;
 
-			iCurBitMasked = iCurBit & 31;
-			((uint32_t *)sb->pData)[iDWord+1] &= BitWriteMasks[iCurBitMasked][nBitsLeft];
-			((uint32_t *)sb->pData)[iDWord+1] |= curData << iCurBitMasked;
-		}
-		sb->iCurBit += numbits;
+		for( i = 0; i < numbytes; i++, mask >>= 8, data >>= 8 )
+			p[i] = ( p[i] & ~(byte)mask ) | (byte)data;
 	}
+
+	sb->iCurBit += numbits;
 }
 
 /*
@@ -283,6 +342,19 @@ qboolean MSG_WriteBits( sizebuf_t *sb, const void *pData, int nBits )
 	byte	*pOut = (byte *)pData;
 	int	nBitsLeft = nBits;
 
+	// whole bytes to byte boundary are just copied
+	if(( sb->iCurBit & 7 ) == 0 && sb->iCurBit + nBits <= sb->nDataBits )
+	{
+		memcpy( sb->pData + ( sb->iCurBit >> 3 ), pOut, nBits >> 3 );
+		sb->iCurBit += nBits & ~7;
+		pOut += nBits >> 3;
+
+		if( nBits & 7 )
+			MSG_WriteUBitLong( sb, *pOut, nBits & 7 );
+
+		return !sb->bOverflow;
+	}
+
 	// get output dword-aligned.
 	while((( uint32_t )pOut & 3 ) != 0 && nBitsLeft >= 8 )
 	{
@@ -295,7 +367,7 @@ qboolean MSG_WriteBits( sizebuf_t *sb, const void *pData, int nBits )
 	// read dwords.
 	while( nBitsLeft >= 32 )
 	{
-		MSG_WriteUBitLong( sb, *(( uint32_t *)pOut ), 32 );
+		MSG_WriteUBitLong( sb, MSG_LoadDword( pOut ), 32 );
 
 		pOut += sizeof( uint32_t );
 		nBitsLeft -= 32;
@@ -466,8 +538,8 @@ int MSG_ReadOneBit( sizebuf_t *sb )
 
 uint MSG_ReadUBitLong( sizebuf_t *sb, int numbits )
 {
-	int	idword1;
-	uint	dword1, ret;
+	uint64_t	data;
+	int	shift;
 
 	if( numbits == 8 )
 	{
@@ -486,30 +558,25 @@ uint MSG_ReadUBitLong( sizebuf_t *sb, int numbits )
 
 	Assert( numbits > 0 && numbits <= 32 );
 
-	// Read the current dword.
-	idword1 = sb->iCurBit >> 5;
-	dword1 = ((uint *)sb->pData)[idword1];
-	dword1 >>= ( sb->iCurBit & 31 );	// get the bits we're interested in.
-
-	sb->iCurBit += numbits;
-	ret = dword1;
+	shift = sb->iCurBit & 7;
 
-	// Does it span this dword?
-	if(( sb->iCurBit - 1 ) >> 5 == idword1 )
+	if( MSG_HasWindow( sb, sb->iCurBit ))
 	{
-		if( numbits != 32 )
-			ret &= ExtraMasks[numbits];
+		data = MSG_LoadWindow( sb->pData + ( sb->iCurBit >> 3 ));
 	}
 	else
 	{
-		int	nExtraBits = sb->iCurBit & 31;
-		uint	dword2 = ((uint *)sb->pData)[idword1+1] & ExtraMasks[nExtraBits];
+		// near the end of buffer, touch only bytes we need
+		const byte	*p = sb->pData + ( sb->iCurBit >> 3 );
+		int		i, numbytes = ( shift + numbits + 7 ) >> 3;
 
-		// no need to mask since we hit the end of the dword.
-		// shift the second dword's part into the high bits.
-		ret |= (dword2 << ( numbits - nExtraBits ));
+		for( i = 0, data = 0; i < numbytes; i++ )
+			data |= (uint64_t)p[i] << ( i * 8 );
 	}
-	return ret;
+
+	sb->iCurBit += numbits;
+
+	return (uint)(( data >> shift ) & ((((uint64_t)1 ) << numbits ) - 1 ));
 }
 
 qboolean MSG_ReadBits( sizebuf_t *sb, void *pOutData, int nBits )
@@ -517,6 +584,19 @@ qboolean MSG_ReadBits( sizebuf_t *sb, void *pOutData, int nBits )
 	byte	*pOut = (byte *)pOutData;
 	int	nBitsLeft = nBits;
 
+	// whole bytes from byte boundary are just copied
+	if(( sb->iCurBit & 7 ) == 0 && sb->iCurBit + nBits <= sb->nDataBits )
+	{
+		memcpy( pOut, sb->pData + ( sb->iCurBit >> 3 ), nBits >> 3 );
+		sb->iCurBit += nBits & ~7;
+		pOut += nBits >> 3;
+
+		if( nBits & 7 )
+			*pOut = MSG_ReadUBitLong( sb, nBits & 7 );
+
+		return !sb->bOverflow;
+	}
+
 	// get output dword-aligned.
 	while((( uint32_t )pOut & 3) != 0 && nBitsLeft >= 8 )
 	{
@@ -528,7 +608,7 @@ qboolean MSG_ReadBits( sizebuf_t *sb, void *pOutData, int nBits )
 	// read dwords.
 	while( nBitsLeft >= 32 )
 	{
-		*((uint32_t *)pOut) = MSG_ReadUBitLong( sb, 32 );
+		MSG_StoreDword( pOut, MSG_ReadUBitLong( sb, 32 ));
 		pOut += sizeof( uint32_t );
 		nBitsLeft -= 32;
 	}
@@ -717,3 +797,407 @@ void MSG_ExciseBits( sizebuf_t *sb, int startbit, int bitstoremove )
 	MSG_SeekToBit( sb, startbit, SEEK_SET );
 	sb->nDataBits -= bitstoremove;
 }
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+/*
+=======================
+MSG_RefWriteUBitLong
+
+dword based writer that was used before, kept to check the new one against it
+=======================
+*/
+static void MSG_RefWriteUBitLong( sizebuf_t *sb, uint curData, int numbits )
+{
+	int	iCurBit = sb->iCurBit, nBitsLeft = numbits;
+	uint	iDWord = iCurBit >> 5, iCurBitMasked = iCurBit & 31;
+	uint32_t	*pData = (uint32_t *)sb->pData;
+	int	nBitsWritten;
+
+	if(( sb->iCurBit + numbits ) > sb->nDataBits )
+	{
+		sb->bOverflow = true;
+		sb->iCurBit = sb->nDataBits;
+		return;
+	}
+
+#define REF_WRITE_MASK( start, left ) \
+	(((uint)BIT( start ) - 1 ) | (( start ) + ( left ) < 32 ? ~((uint)BIT(( start ) + ( left )) - 1 ) : 0 ))
+
+	pData[iDWord] &= REF_WRITE_MASK( iCurBitMasked, nBitsLeft );
+	pData[iDWord] |= curData << iCurBitMasked;
+	nBitsWritten = 32 - iCurBitMasked;
+
+	if( nBitsWritten < nBitsLeft )
+	{
+		nBitsLeft -= nBitsWritten;
+		iCurBit += nBitsWritten;
+		curData >>= nBitsWritten;
+
+		iCurBitMasked = iCurBit & 31;
+		pData[iDWord+1] &= REF_WRITE_MASK( iCurBitMasked, nBitsLeft );
+		pData[iDWord+1] |= curData << iCurBitMasked;
+	}
+#undef REF_WRITE_MASK
+
+	sb->iCurBit += numbits;
+}
+
+/*
+=======================
+MSG_RefReadUBitLong
+
+=======================
+*/
+static uint MSG_RefReadUBitLong( sizebuf_t *sb, int numbits )
+{
+	const uint32_t	*pData = (const uint32_t *)sb->pData;
+	int	idword1;
+	uint	ret;
+
+	if( numbits == 8 )
+	{
+		int leftBits = MSG_GetNumBitsLeft( sb );
+
+		if( leftBits >= 0 && leftBits < 8 )
+			return 0;
+	}
+
+	if(( sb->iCurBit + numbits ) > sb->nDataBits )
+	{
+		sb->bOverflow = true;
+		sb->iCurBit = sb->nDataBits;
+		return 0;
+	}
+
+	idword1 = sb->iCurBit >> 5;
+	ret = pData[idword1] >> ( sb->iCurBit & 31 );
+	sb->iCurBit += numbits;
+
+	if(( sb->iCurBit - 1 ) >> 5 == idword1 )
+	{
+		if( numbits != 32 )
+			ret &= (uint)BIT( numbits ) - 1;
+	}
+	else
+	{
+		int nExtraBits = sb->iCurBit & 31;
+		ret |= ( pData[idword1+1] & ((uint)BIT( nExtraBits ) - 1 )) << ( numbits - nExtraBits );
+	}
+
+	return ret;
+}
+
+/*
+=======================
+MSG_RefWriteBits
+
+=======================
+*/
+static void MSG_RefWriteBits( sizebuf_t *sb, const byte *pOut, int nBitsLeft )
+{
+	while((( uintptr_t )pOut & 3 ) != 0 && nBitsLeft >= 8 )
+	{
+		MSG_RefWriteUBitLong( sb, *pOut, 8 );
+		nBitsLeft -= 8;
+		++pOut;
+	}
+
+	while( nBitsLeft >= 32 )
+	{
+		MSG_RefWriteUBitLong( sb, MSG_LoadDword( pOut ), 32 );
+		pOut += sizeof( uint32_t );
+		nBitsLeft -= 32;
+	}
+
+	while( nBitsLeft >= 8 )
+	{
+		MSG_RefWriteUBitLong( sb, *pOut, 8 );
+		nBitsLeft -= 8;
+		++pOut;
+	}
+
+	if( nBitsLeft )
+		MSG_RefWriteUBitLong( sb, *pOut, nBitsLeft );
+}
+
+/*
+=======================
+MSG_RefReadBits
+
+=======================
+*/
+static void MSG_RefReadBits( sizebuf_t *sb, byte *pOut, int nBitsLeft )
+{
+	while((( uintptr_t )pOut & 3 ) != 0 && nBitsLeft >= 8 )
+	{
+		*pOut = MSG_RefReadUBitLong( sb, 8 );
+		++pOut;
+		nBitsLeft -= 8;
+	}
+
+	while( nBitsLeft >= 32 )
+	{
+		MSG_StoreDword( pOut, MSG_RefReadUBitLong( sb, 32 ));
+		pOut += sizeof( uint32_t );
+		nBitsLeft -= 32;
+	}
+
+	while( nBitsLeft >= 8 )
+	{
+		*pOut = MSG_RefReadUBitLong( sb, 8 );
+		++pOut;
+		nBitsLeft -= 8;
+	}
+
+	if( nBitsLeft )
+		*pOut = MSG_RefReadUBitLong( sb, nBitsLeft );
+}
+
+/*
+=======================
+MSG_CompareBitStream
+
+runs operations encoded in input on both implementations,
+returns false if they produced different bits or state
+=======================
+*/
+#define MSG_TEST_WORDS	16
+
+static qboolean MSG_CompareBitStream( const byte *ops, size_t size )
+{
+	uint32_t	data[MSG_TEST_WORDS], ref[MSG_TEST_WORDS];
+	uint32_t	bits[MSG_TEST_WORDS];
+	sizebuf_t	sb, rb;
+	size_t	i = 0, k;
+	int	j, nMaxBits, valid = 0;
+
+	if( size < 1 )
+		return true;
+
+	// odd sizes make sure overflows and buffer tail are hit
+	nMaxBits = sizeof( data ) * 8 - ( ops[i++] & 63 );
+	memset( data, 0xAA, sizeof( data ));
+	memset( ref, 0x55, sizeof( ref ));
+	MSG_InitExt( &sb, "Test", data, sizeof( data ), nMaxBits );
+	MSG_InitExt( &rb, "Ref", ref, sizeof( ref ), nMaxBits );
+
+	while( i + 5 <= size )
+	{
+		int	op = ops[i] >> 6, numbits = ( ops[i] & 31 ) + 1;
+		uint	value = ops[i+1] | ops[i+2] << 8 | ops[i+3] << 16 | (uint)ops[i+4] << 24;
+		int	start = sb.iCurBit;
+
+		// overflow is tracked per operation
+		sb.bOverflow = rb.bOverflow = false;
+		i += 5;
+
+		switch( op )
+		{
+		case 0:
+			MSG_WriteUBitLong( &sb, value, numbits );
+			MSG_RefWriteUBitLong( &rb, value, numbits );
+			break;
+		case 1:
+			numbits = Q_max( numbits, 2 );
+			MSG_WriteSBitLong( &sb, (int)value, numbits );
+
+			// same as MSG_WriteSBitLong
+			if((int)value < 0 )
+			{
+				MSG_RefWriteUBitLong( &rb, (uint)( 0x80000000 + (int)value ), numbits - 1 );
+				MSG_WriteOneBit( &rb, 1 );
+			}
+			else
+			{
+				MSG_RefWriteUBitLong( &rb, value, numbits - 1 );
+				MSG_WriteOneBit( &rb, 0 );
+			}
+			break;
+		case 2:
+			numbits = value & 255;
+			j = Q_min( value >> 8 & 3, numbits >> 3 );
+
+			for( k = 0; k < sizeof( bits ); k++ )
+				((byte *)bits)[k] = ops[( i + k ) % size];
+
+			// unaligned source goes through dword loop too
+			MSG_WriteBits( &sb, (byte *)bits + j, numbits - j * 8 );
+			MSG_RefWriteBits( &rb, (byte *)bits + j, numbits - j * 8 );
+			break;
+		case 3:
+			j = value % ( sb.iCurBit + 1 );
+			MSG_SeekToBit( &sb, j, SEEK_SET );
+			MSG_SeekToBit( &rb, j, SEEK_SET );
+			break;
+		}
+
+		if( sb.iCurBit != rb.iCurBit || sb.bOverflow != rb.bOverflow )
+			return false;
+
+		// bits past the cursor are undefined and overflow moves it to the end,
+		// so only check bits that were written in one go from the start
+		if( sb.bOverflow )
+			valid = Q_min( valid, start );
+		else if( op != 3 && start <= valid )
+			valid = sb.iCurBit;
+
+		for( j = 0; j < valid; j++ )
+		{
+			if((((byte *)data)[j >> 3] ^ ((byte *)ref)[j >> 3] ) & BIT( j & 7 ))
+				return false;
+		}
+	}
+
+	// read it back in random chunks
+	MSG_StartReading( &sb, data, sizeof( data ), 0, nMaxBits );
+	MSG_StartReading( &rb, data, sizeof( data ), 0, nMaxBits );
+
+	// reads of 8 bits at the very end don't overflow, so limit them
+	for( i = 0; i < sizeof( data ) * 8 && !sb.bOverflow; i++ )
+	{
+		int		numbits = ( ops[i % size] & 63 ) + 1;
+		uint32_t	got[2], want[2];
+
+		if( i & 1 )
+		{
+			numbits = Q_min( numbits, 32 );
+
+			if( MSG_ReadUBitLong( &sb, numbits ) != MSG_RefReadUBitLong( &rb, numbits ))
+				return false;
+		}
+		else
+		{
+			memset( got, 0, sizeof( got ));
+			memset( want, 0, sizeof( want ));
+			MSG_ReadBits( &sb, got, numbits );
+			MSG_RefReadBits( &rb, (byte *)want, numbits );
+
+			// output is undefined after overflow
+			if( !sb.bOverflow && memcmp( got, want, sizeof( got )))
+				return false;
+		}
+
+		if( sb.iCurBit != rb.iCurBit || sb.bOverflow != rb.bOverflow )
+			return false;
+	}
+
+	return true;
+}
+
+int EXPORT Fuzz_MSG_BitStream( const uint8_t *Data, size_t Size )
+{
+	if( !MSG_CompareBitStream( Data, Size ))
+		abort();
+
+	return 0;
+}
+
+static void Test_MsgBitStream( void )
+{
+	byte	ops[4096];
+	uint	seed = 0x1234567;
+	int	i, j, wrong = 0;
+
+	for( i = 0; i < 256; i++ )
+	{
+		int size = 1 + i * ( sizeof( ops ) - 1 ) / 255;
+
+		for( j = 0; j < size; j++ )
+		{
+			seed = seed * 1103515245 + 12345;
+			ops[j] = seed >> 16;
+		}
+
+		if( !MSG_CompareBitStream( ops, size ))
+			wrong++;
+	}
+
+	TASSERT_EQi( wrong, 0 );
+}
+
+static void Test_MsgWireLayout( void )
+{
+	byte	data[16];
+	sizebuf_t	sb;
+
+	// fields are packed starting from the lowest bit of each byte
+	memset( data, 0, sizeof( data ));
+	MSG_Init( &sb, "Test", data, sizeof( data ));
+	MSG_WriteUBitLong( &sb, 5, 3 );
+	MSG_WriteUBitLong( &sb, 0xFFFFFFFF, 32 );
+	MSG_WriteUBitLong( &sb, 0, 5 );
+	TASSERT_EQi( data[0], 0xFD );
+	TASSERT_EQi( data[3], 0xFF );
+	TASSERT_EQi( data[4], 0x07 );
+	TASSERT_EQi( sb.iCurBit, 40 );
+
+	MSG_StartReading( &sb, data, sizeof( data ), 0, -1 );
+	TASSERT_EQi( MSG_ReadUBitLong( &sb, 3 ), 5 );
+	TASSERT_EQi( MSG_ReadUBitLong( &sb, 32 ), 0xFFFFFFFF );
+	TASSERT_EQi( MSG_ReadUBitLong( &sb, 5 ), 0 );
+
+	// last bits of buffer go through slow path
+	MSG_StartWriting( &sb, data, sizeof( data ), 0, 125 );
+	MSG_SeekToBit( &sb, 100, SEEK_SET );
+	MSG_WriteUBitLong( &sb, 0x1ABCDEF, 25 );
+	TASSERT( !sb.bOverflow );
+	MSG_WriteOneBit( &sb, 1 );
+	TASSERT( sb.bOverflow );
+
+	MSG_StartReading( &sb, data, sizeof( data ), 0, 125 );
+	MSG_SeekToBit( &sb, 100, SEEK_SET );
+	TASSERT_EQi( MSG_ReadUBitLong( &sb, 25 ), 0x1ABCDEF );
+}
+
+static void Test_MsgBlobLayout( void )
+{
+	uint32_t	blob[4], got[4];
+	byte	data[24], *b = (byte *)blob;
+	sizebuf_t	sb;
+	int	i, wrong = 0;
+
+	// aligned source, so the dword loops run
+	for( i = 0; i < sizeof( blob ); i++ )
+		b[i] = 0x11 * ( i + 1 ) ^ 0x80;
+
+	// a blob is a byte stream on the wire, no matter what the host byte order is
+	memset( data, 0, sizeof( data ));
+	MSG_Init( &sb, "Test", data, sizeof( data ));
+	MSG_WriteUBitLong( &sb, 5, 3 );
+	MSG_WriteBits( &sb, blob, sizeof( blob ) * 8 );
+	TASSERT( !sb.bOverflow );
+	TASSERT_EQi( data[0], ( b[0] << 3 | 5 ) & 0xFF );
+
+	for( i = 1; i < sizeof( blob ); i++ )
+	{
+		if( data[i] != (( b[i] << 3 | b[i-1] >> 5 ) & 0xFF ))
+			wrong++;
+	}
+
+	TASSERT_EQi( wrong, 0 );
+	TASSERT_EQi( data[sizeof( blob )], b[sizeof( blob ) - 1] >> 5 );
+
+	MSG_StartReading( &sb, data, sizeof( data ), 0, -1 );
+	TASSERT_EQi( MSG_ReadUBitLong( &sb, 3 ), 5 );
+	memset( got, 0, sizeof( got ));
+	MSG_ReadBits( &sb, got, sizeof( got ) * 8 );
+	TASSERT( !memcmp( got, blob, sizeof( blob )));
+
+	// byte aligned copy
+	memset( data, 0, sizeof( data ));
+	MSG_Init( &sb, "Test", data, sizeof( data ));
+	MSG_WriteByte( &sb, 0x42 );
+	MSG_WriteBits( &sb, blob, sizeof( blob ) * 8 );
+	TASSERT_EQi( data[0], 0x42 );
+	TASSERT( !memcmp( data + 1, blob, sizeof( blob )));
+}
+
+void Test_RunMsgBits( void )
+{
+	TRUN( Test_MsgWireLayout( ));
+	TRUN( Test_MsgBlobLayout( ));
+	TRUN( Test_MsgBitStream( ));
+}
+#endif // XASH_ENGINE_TESTS
@@ -57,7 +57,6 @@ struct sizebuf_s
 
 // common functions
 void MSG_InitExt( sizebuf_t *sb, const char *pDebugName, void *pData, int nBytes, int nMaxBits );
-void MSG_InitMasks( void );	// called once at startup engine
 int MSG_SeekToBit( sizebuf_t *sb, int bitPos, int whence );
 void MSG_ExciseBits( sizebuf_t *sb, int startbit, int bitstoremove );
 _inline int MSG_TellBit( sizebuf_t *sb ) { return sb->iCurBit; }
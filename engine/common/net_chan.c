@@ -95,6 +95,20 @@ sizebuf_t	net_message;
 static poolhandle_t net_mempool;
 byte	net_message_buffer[NET_MAX_MESSAGE];
 
+typedef struct netcompress_s
+{
+	struct netcompress_s *next;
+	sys_job_t	job;
+	qboolean	started;
+	byte	*uncompressed;	// loaded on main thread
+	uint	size;
+	byte	*compressed;	// from LZSS_Compress, NULL if it failed
+	uint	compressedsize;
+	char	filename[MAX_OSPATH];
+} netcompress_t;
+
+static netcompress_t *net_compress;	// head is in work, the rest waits
+
 const char *ns_strings[NS_COUNT] =
 {
 	"Client",
@@ -256,13 +270,14 @@ void Netchan_Init( void )
 	Cvar_RegisterVariable( &net_qport );
 	Cvar_FullSet( net_qport.name, buf, net_qport.flags );
 
-	net_mempool = Mem_AllocPool( "Network Pool" );
-
-	MSG_InitMasks();	// initialize bit-masks
+	net_mempool = Mem_AllocPoolFlags( "Network Pool", POOL_SLAB );
 }
 
+static void Netchan_ClearCompression( void );
+
 void Netchan_Shutdown( void )
 {
+	Netchan_ClearCompression();
 	Mem_FreePool( &net_mempool );
 }
 
@@ -367,6 +382,19 @@ Netchan_UnlinkFragment
 
 ==============================
 */
+static void Netchan_FreeFragbuf( fragbuf_t *buf )
+{
+	if( buf->file )
+		FS_Close( buf->file );
+
+	if( buf->blob )
+		Netchan_ReleaseFragBlob( &buf->blob );
+	else if( buf->frag_message_buf )
+		Mem_Free( buf->frag_message_buf );
+
+	Mem_Free( buf );
+}
+
 void Netchan_UnlinkFragment( fragbuf_t *buf, fragbuf_t **list )
 {
 	fragbuf_t	*search;
@@ -380,7 +408,7 @@ void Netchan_UnlinkFragment( fragbuf_t *buf, fragbuf_t **list )
 		*list = buf->next;
 
 		// destroy remnant
-		Mem_Free( buf );
+		Netchan_FreeFragbuf( buf );
 		return;
 	}
 
@@ -392,7 +420,7 @@ void Netchan_UnlinkFragment( fragbuf_t *buf, fragbuf_t **list )
 			search->next = buf->next;
 
 			// destroy remnant
-			Mem_Free( buf );
+			Netchan_FreeFragbuf( buf );
 			return;
 		}
 		search = search->next;
@@ -417,8 +445,7 @@ void Netchan_ClearFragbufs( fragbuf_t **ppbuf )
 	while( buf )
 	{
 		n = buf->next;
-		Mem_Free( buf->frag_message_buf );
-		Mem_Free( buf );
+		Netchan_FreeFragbuf( buf );
 		buf = n;
 	}
 
@@ -694,6 +721,73 @@ void Netchan_AddBufferToList( fragbuf_t **pplist, fragbuf_t *pbuf )
 	pprev->next = pbuf;
 }
 
+/*
+==============================
+Netchan_FragmentSize
+
+==============================
+*/
+static int Netchan_FragmentSize( netchan_t *chan )
+{
+	if( chan->pfnBlockSize != NULL )
+		return chan->pfnBlockSize( chan->client, FRAGSIZE_FRAG );
+	return FRAGMENT_MAX_SIZE; // fallback
+}
+
+/*
+==============================
+Netchan_CompressFragments
+
+returns compressed copy of data allocated with malloc
+or NULL if compression doesn't make it smaller
+==============================
+*/
+static byte *Netchan_CompressFragments( const byte *data, uint size, uint *compressedsize )
+{
+	uint	uCompressedSize = 0;
+	byte	*pbOut;
+
+	if( LZSS_IsCompressed( data ))
+		return NULL;
+
+	pbOut = LZSS_Compress( (byte *)data, size, &uCompressedSize );
+
+	if( pbOut && uCompressedSize > 0 && uCompressedSize < size )
+	{
+		Con_Reportf( "Compressing split packet (%d -> %d bytes)\n", size, uCompressedSize );
+		*compressedsize = uCompressedSize;
+		return pbOut;
+	}
+
+	if( pbOut ) free( pbOut );
+	return NULL;
+}
+
+/*
+==============================
+Netchan_AddToWaitlist
+
+==============================
+*/
+static void Netchan_AddToWaitlist( netchan_t *chan, int stream, fragbufwaiting_t *wait )
+{
+	fragbufwaiting_t	*p;
+
+	// now add waiting list item to end of buffer queue
+	if( !chan->waitlist[stream] )
+	{
+		chan->waitlist[stream] = wait;
+	}
+	else
+	{
+		p = chan->waitlist[stream];
+
+		while( p->next )
+			p = p->next;
+		p->next = wait;
+	}
+}
+
 /*
 ==============================
 Netchan_CreateFragments_
@@ -707,30 +801,23 @@ static void Netchan_CreateFragments_( netchan_t *chan, sizebuf_t *msg )
 	int		remaining;
 	int		bytes, pos;
 	int		bufferid = 1;
-	fragbufwaiting_t	*wait, *p;
+	fragbufwaiting_t	*wait;
+	uint		uCompressedSize;
+	byte		*pbOut;
 
 	if( MSG_GetNumBytesWritten( msg ) == 0 )
 		return;
 
-	if( chan->pfnBlockSize != NULL )
-		chunksize = chan->pfnBlockSize( chan->client, FRAGSIZE_FRAG );
-	else chunksize = FRAGMENT_MAX_SIZE; // fallback
+	chunksize = Netchan_FragmentSize( chan );
 
 	wait = (fragbufwaiting_t *)Mem_Calloc( net_mempool, sizeof( fragbufwaiting_t ));
 
-	if( !LZSS_IsCompressed( MSG_GetData( msg )))
+	pbOut = Netchan_CompressFragments( msg->pData, MSG_GetNumBytesWritten( msg ), &uCompressedSize );
+	if( pbOut )
 	{
-		uint	uCompressedSize = 0;
-		uint	uSourceSize = MSG_GetNumBytesWritten( msg );
-		byte	*pbOut = LZSS_Compress( msg->pData, uSourceSize, &uCompressedSize );
-
-		if( pbOut && uCompressedSize > 0 && uCompressedSize < uSourceSize )
-		{
-			Con_Reportf( "Compressing split packet (%d -> %d bytes)\n", uSourceSize, uCompressedSize );
-			memcpy( msg->pData, pbOut, uCompressedSize );
-			MSG_SeekToBit( msg, uCompressedSize << 3, SEEK_SET );
-		}
-		if( pbOut ) free( pbOut );
+		memcpy( msg->pData, pbOut, uCompressedSize );
+		MSG_SeekToBit( msg, uCompressedSize << 3, SEEK_SET );
+		free( pbOut );
 	}
 
 	remaining = MSG_GetNumBytesWritten( msg );
@@ -752,19 +839,7 @@ static void Netchan_CreateFragments_( netchan_t *chan, sizebuf_t *msg )
 		pos += bytes;
 	}
 
-	// now add waiting list item to end of buffer queue
-	if( !chan->waitlist[FRAG_NORMAL_STREAM] )
-	{
-		chan->waitlist[FRAG_NORMAL_STREAM] = wait;
-	}
-	else
-	{
-		p = chan->waitlist[FRAG_NORMAL_STREAM];
-
-		while( p->next )
-			p = p->next;
-		p->next = wait;
-	}
+	Netchan_AddToWaitlist( chan, FRAG_NORMAL_STREAM, wait );
 }
 
 /*
@@ -785,6 +860,103 @@ void Netchan_CreateFragments( netchan_t *chan, sizebuf_t *msg )
 	Netchan_CreateFragments_( chan, msg );
 }
 
+/*
+==============================
+Netchan_CreateFragBlob
+
+compresses message once, so it can be queued to many
+channels without building and copying it again
+==============================
+*/
+fragblob_t *Netchan_CreateFragBlob( sizebuf_t *msg )
+{
+	uint	size = MSG_GetNumBytesWritten( msg );
+	uint	uCompressedSize;
+	fragblob_t	*blob;
+	byte	*pbOut;
+
+	if( !size )
+		return NULL;
+
+	pbOut = Netchan_CompressFragments( MSG_GetData( msg ), size, &uCompressedSize );
+	if( pbOut )
+		size = uCompressedSize;
+
+	blob = (fragblob_t *)Mem_Malloc( net_mempool, sizeof( *blob ) + size );
+	blob->refcount = 1;
+	blob->size = size;
+	memcpy( blob->data, pbOut ? pbOut : MSG_GetData( msg ), size );
+
+	if( pbOut ) free( pbOut );
+
+	return blob;
+}
+
+/*
+==============================
+Netchan_ReleaseFragBlob
+
+blob is freed when it isn't used by owner and any fragment
+==============================
+*/
+void Netchan_ReleaseFragBlob( fragblob_t **blob )
+{
+	if( !*blob )
+		return;
+
+	if( --( *blob )->refcount <= 0 )
+		Mem_Free( *blob );
+
+	*blob = NULL;
+}
+
+/*
+==============================
+Netchan_CreateBlobFragments
+
+same as Netchan_CreateFragments, but fragments point into blob
+==============================
+*/
+void Netchan_CreateBlobFragments( netchan_t *chan, fragblob_t *blob )
+{
+	fragbuf_t		*buf;
+	fragbufwaiting_t	*wait;
+	int		chunksize;
+	int		bytes, pos;
+	int		bufferid = 1;
+
+	// always queue any pending reliable data ahead of the fragmentation buffer
+	if( MSG_GetNumBytesWritten( &chan->message ) > 0 )
+	{
+		Netchan_CreateFragments_( chan, &chan->message );
+		MSG_Clear( &chan->message );
+	}
+
+	if( !blob || !blob->size )
+		return;
+
+	chunksize = Netchan_FragmentSize( chan );
+	wait = (fragbufwaiting_t *)Mem_Calloc( net_mempool, sizeof( fragbufwaiting_t ));
+
+	for( pos = 0; pos < blob->size; pos += bytes )
+	{
+		bytes = Q_min( blob->size - pos, chunksize );
+
+		buf = (fragbuf_t *)Mem_Calloc( net_mempool, sizeof( fragbuf_t ));
+		buf->bufferid = bufferid++;
+		buf->blob = blob;
+		blob->refcount++;
+
+		// it's only read from
+		MSG_Init( &buf->frag_message, "Frag Message", blob->data + pos, bytes );
+		MSG_SeekToBit( &buf->frag_message, bytes << 3, SEEK_SET );
+
+		Netchan_AddFragbufToTail( wait, buf );
+	}
+
+	Netchan_AddToWaitlist( chan, FRAG_NORMAL_STREAM, wait );
+}
+
 /*
 ==============================
 Netchan_FindBufferById
@@ -944,123 +1116,296 @@ void Netchan_CreateFileFragmentsFromBuffer( netchan_t *chan, const char *filenam
 	}
 }
 
+/*
+=============================================================================
+
+FILE COMPRESSION
+
+Downloaded files are sent from .ztmp copy compressed with LZSS. Files are
+compressed on background thread one at a time, so big ones don't stall
+the server. Loading file and writing .ztmp stays on main thread, because
+filesystem and memory pools aren't thread safe. Until .ztmp is written,
+downloads of the file are sent uncompressed.
+
+=============================================================================
+*/
+
+/*
+==============================
+Netchan_CompressedFileReady
+
+returns true if .ztmp is there and isn't older than the file
+==============================
+*/
+static qboolean Netchan_CompressedFileReady( const char *filename, char *compressedfilename, size_t size )
+{
+	Q_strncpy( compressedfilename, filename, size );
+	COM_ReplaceExtension( compressedfilename, ".ztmp", size );
+
+	if( FS_FileTime( compressedfilename, false ) < FS_FileTime( filename, false ))
+		return false;
+
+	return FS_FileSize( compressedfilename, false ) != -1;
+}
+
+/*
+==============================
+Netchan_CompressJob
+
+runs on background thread
+==============================
+*/
+static void Netchan_CompressJob( void *data )
+{
+	netcompress_t *c = data;
+
+	c->compressed = LZSS_Compress( c->uncompressed, c->size, &c->compressedsize );
+}
+
+/*
+==============================
+Netchan_FreeCompression
+
+job must be finished
+==============================
+*/
+static void Netchan_FreeCompression( netcompress_t *c )
+{
+	if( c->compressed )
+		free( c->compressed );
+
+	if( c->uncompressed )
+		Mem_Free( c->uncompressed );
+
+	net_compress = c->next;
+	Mem_Free( c );
+}
+
+/*
+==============================
+Netchan_ClearCompression
+
+drops files that wait for compression
+==============================
+*/
+static void Netchan_ClearCompression( void )
+{
+	while( net_compress )
+	{
+		// let it finish, job writes into it
+		if( net_compress->started )
+			Sys_WaitForJob( &net_compress->job );
+
+		Netchan_FreeCompression( net_compress );
+	}
+}
+
+/*
+==============================
+Netchan_QueueCompression
+
+==============================
+*/
+void Netchan_QueueCompression( const char *filename )
+{
+	char		compressedfilename[MAX_OSPATH];
+	netcompress_t	*c, **prev;
+
+	if( Netchan_CompressedFileReady( filename, compressedfilename, sizeof( compressedfilename )))
+		return;
+
+	for( prev = &net_compress; *prev; prev = &( *prev )->next )
+	{
+		if( !Q_strcmp( ( *prev )->filename, filename ))
+			return; // already queued
+	}
+
+	c = (netcompress_t *)Mem_Calloc( net_mempool, sizeof( *c ));
+	Q_strncpy( c->filename, filename, sizeof( c->filename ));
+	*prev = c;
+
+	Netchan_UpdateCompression( false );
+}
+
+/*
+==============================
+Netchan_UpdateCompression
+
+writes out compressed files and starts next one,
+wait makes it compress everything in the queue
+==============================
+*/
+void Netchan_UpdateCompression( qboolean wait )
+{
+	netcompress_t	*c;
+
+	while(( c = net_compress ) != NULL )
+	{
+		if( !c->started )
+		{
+			fs_offset_t	size = 0;
+
+			c->uncompressed = FS_LoadFile( c->filename, &size, false );
+
+			if( !c->uncompressed || size <= 0 )
+			{
+				Netchan_FreeCompression( c );
+				continue;
+			}
+
+			c->size = size;
+			c->started = true;
+			Sys_QueueJob( &c->job, Netchan_CompressJob, c );
+		}
+
+		if( wait )
+			Sys_WaitForJob( &c->job );
+		else if( !Sys_JobFinished( &c->job ))
+			return;
+
+		if( c->compressed )
+		{
+			char	compressedfilename[MAX_OSPATH];
+
+			Q_strncpy( compressedfilename, c->filename, sizeof( compressedfilename ));
+			COM_ReplaceExtension( compressedfilename, ".ztmp", sizeof( compressedfilename ));
+
+			Con_DPrintf( "compressed file %s (%s -> %s)\n", c->filename, Q_memprint( c->size ), Q_memprint( c->compressedsize ));
+			FS_WriteFile( compressedfilename, c->compressed, c->compressedsize );
+		}
+
+		Netchan_FreeCompression( c );
+	}
+}
+
 /*
 ==============================
 Netchan_CreateFileFragments
 
+file is read piece by piece as it's being sent,
+so whole transfer needs a single fragbuf. It's only
+opened once the transfer starts, see Netchan_ReadFileFragment
 ==============================
 */
 int Netchan_CreateFileFragments( netchan_t *chan, const char *filename )
 {
-	int		chunksize;
-	int		send, pos;
-	int		remaining;
-	int		bufferid = 1;
-	fs_offset_t	filesize = 0;
 	char		compressedfilename[MAX_OSPATH];
-	int		compressedFileTime;
-	int		fileTime;
-	qboolean		firstfragment = true;
+	fs_offset_t	filesize;
+	int		chunksize;
 	qboolean		bCompressed = false;
-	fragbufwaiting_t	*wait, *p;
+	fragbufwaiting_t	*wait;
 	fragbuf_t		*buf;
-	
-	if(( filesize = FS_FileSize( filename, false )) <= 0 )
+
+	if( FS_FileSize( filename, false ) <= 0 )
 	{
 		Con_Printf( S_WARN "Unable to open %s for transfer\n", filename );
 		return 0;
 	}
 
-	if( chan->pfnBlockSize != NULL )
-		chunksize = chan->pfnBlockSize( chan->client, FRAGSIZE_FRAG );
-	else chunksize = FRAGMENT_MAX_SIZE; // fallback
-
-	Q_strncpy( compressedfilename, filename, sizeof( compressedfilename ));
-	COM_ReplaceExtension( compressedfilename, ".ztmp", sizeof( compressedfilename ));
-	compressedFileTime = FS_FileTime( compressedfilename, false );
-	fileTime = FS_FileTime( filename, false );
-
-	if( compressedFileTime >= fileTime )
+	if( Netchan_CompressedFileReady( filename, compressedfilename, sizeof( compressedfilename )))
 	{
-		// if compressed file already created and newer than source
-		fs_offset_t compressedSize = FS_FileSize( compressedfilename, false );
-		if( compressedSize != -1 )
-		{
-			bCompressed = true;
-			filesize = compressedSize;
-		}
+		filesize = FS_FileSize( compressedfilename, false );
+		bCompressed = true;
 	}
 	else
 	{
-		uint	uCompressedSize;
-		byte	*uncompressed;
-		byte	*compressed;
-
-		uncompressed = FS_LoadFile( filename, &filesize, false );
-		compressed = LZSS_Compress( uncompressed, filesize, &uCompressedSize );
+		// don't keep client waiting, next one will get it compressed
+		Netchan_QueueCompression( filename );
+		filesize = FS_FileSize( filename, false );
+	}
 
-		if( compressed )
-		{
-			Con_DPrintf( "compressed file %s (%s -> %s)\n", filename, Q_memprint( filesize ), Q_memprint( uCompressedSize ));
-			FS_WriteFile( compressedfilename, compressed, uCompressedSize );
-			filesize = uCompressedSize;
-			bCompressed = true;
-			free( compressed );
-		}
-		Mem_Free( uncompressed );
+	if( filesize <= 0 )
+	{
+		Con_Printf( S_WARN "Unable to open %s for transfer\n", filename );
+		return 0;
 	}
 
-	wait = (fragbufwaiting_t *)Mem_Calloc( net_mempool, sizeof( fragbufwaiting_t ));
-	remaining = filesize;
-	pos = 0;
+	chunksize = Netchan_FragmentSize( chan );
+	buf = Netchan_AllocFragbuf( chunksize );
+	buf->bufferid = 1;
 
-	while( remaining > 0 )
-	{
-		send = Q_min( remaining, chunksize );
+	// first piece carries the filename
+	MSG_Clear( &buf->frag_message );
+	MSG_WriteString( &buf->frag_message, filename );
 
-		buf = Netchan_AllocFragbuf( send );
-		buf->bufferid = bufferid++;
+	buf->isfile = true;
+	buf->iscompressed = bCompressed;
+	buf->foffset = 0;
+	buf->size = Q_min( filesize, chunksize - MSG_GetNumBytesWritten( &buf->frag_message ));
+	buf->remaining = filesize - buf->size;
+	buf->chunksize = chunksize;
+	Q_strncpy( buf->filename, filename, sizeof( buf->filename ));
 
-		// copy in data
-		MSG_Clear( &buf->frag_message );
+	wait = (fragbufwaiting_t *)Mem_Calloc( net_mempool, sizeof( fragbufwaiting_t ));
+	Netchan_AddFragbufToTail( wait, buf );
 
-		if( firstfragment )
-		{
-			// Write filename
-			MSG_WriteString( &buf->frag_message, filename );
+	// receiver needs to know total number of pieces
+	wait->fragbufcount = 1 + ( buf->remaining + chunksize - 1 ) / chunksize;
 
-			// Send a bit less on first package
-			send -= MSG_GetNumBytesWritten( &buf->frag_message );
+	Netchan_AddToWaitlist( chan, FRAG_FILE_STREAM, wait );
 
-			firstfragment = false;
-		}
+	return 1;
+}
 
-		buf->isfile = true;
-		buf->size = send;
-		buf->foffset = pos;
-		buf->iscompressed = bCompressed;
-		Q_strncpy( buf->filename, filename, sizeof( buf->filename ));
+/*
+==============================
+Netchan_ReadFileFragment
 
-		pos += send;
-		remaining -= send;
+==============================
+*/
+static void Netchan_ReadFileFragment( fragbuf_t *buf )
+{
+	byte	filebuffer[NET_MAX_FRAGMENT];
+	char	compressedfilename[MAX_OSPATH];
 
-		Netchan_AddFragbufToTail( wait, buf );
+	// queued downloads don't hold descriptors, open it when it goes out
+	if( !buf->file && buf->foffset == 0 )
+	{
+		if( buf->iscompressed )
+		{
+			Q_strncpy( compressedfilename, buf->filename, sizeof( compressedfilename ));
+			COM_ReplaceExtension( compressedfilename, ".ztmp", sizeof( compressedfilename ));
+			buf->file = FS_Open( compressedfilename, "rb", false );
+		}
+		else buf->file = FS_Open( buf->filename, "rb", false );
 	}
 
-	// now add waiting list item to end of buffer queue
-	if( !chan->waitlist[FRAG_FILE_STREAM] )
+	if( !buf->file || FS_Read( buf->file, filebuffer, buf->size ) != buf->size )
 	{
-		chan->waitlist[FRAG_FILE_STREAM] = wait;
+		Con_Printf( S_ERROR "%s: can't read %s\n", __func__, buf->filename );
+		memset( filebuffer, 0, buf->size );
 	}
-	else
+
+	// release it as soon as the last piece is read
+	if( buf->file && buf->remaining <= 0 )
 	{
-		p = chan->waitlist[FRAG_FILE_STREAM];
-		while( p->next )
-			p = p->next;
-		p->next = wait;
+		FS_Close( buf->file );
+		buf->file = NULL;
 	}
 
-	return 1;
+	MSG_WriteBits( &buf->frag_message, filebuffer, buf->size << 3 );
+}
+
+/*
+==============================
+Netchan_NextFileFragment
+
+moves streamed file buffer to the next piece,
+returns false if the file is done
+==============================
+*/
+static qboolean Netchan_NextFileFragment( fragbuf_t *buf )
+{
+	if( buf->remaining <= 0 )
+		return false;
+
+	MSG_Clear( &buf->frag_message );
+	buf->bufferid++;
+	buf->foffset += buf->size;
+	buf->size = Q_min( buf->remaining, buf->chunksize );
+	buf->remaining -= buf->size;
+
+	return true;
 }
 
 /*
@@ -1080,7 +1425,7 @@ void Netchan_FlushIncoming( netchan_t *chan, int stream )
 	while( p )
 	{
 		n = p->next;
-		Mem_Free( p );
+		Netchan_FreeFragbuf( p );
 		p = n;
 	}
 	chan->incomingbufs[stream] = NULL;
@@ -1119,7 +1464,7 @@ qboolean Netchan_CopyNormalFragments( netchan_t *chan, sizebuf_t *msg, size_t *l
 		MSG_WriteBytes( msg, MSG_GetData( &p->frag_message ), MSG_GetNumBytesWritten( &p->frag_message ));
 		size += MSG_GetNumBytesWritten( &p->frag_message );
 
-		Mem_Free( p );
+		Netchan_FreeFragbuf( p );
 		p = n;
 	}
 
@@ -1249,7 +1594,7 @@ qboolean Netchan_CopyFileFragments( netchan_t *chan, sizebuf_t *msg )
 		}
 
 		pos += cursize;
-		Mem_Free( p );
+		Netchan_FreeFragbuf( p );
 		p = n;
 	}
 
@@ -1537,7 +1882,7 @@ void Netchan_TransmitBits( netchan_t *chan, int length, byte *data )
 				// files set size a bit differently.
 				if( pbuf->isfile && !pbuf->isbuffer )
 				{
-					fragment_size = pbuf->size;
+					fragment_size += pbuf->size;
 				}
 			}
 
@@ -1553,26 +1898,7 @@ void Netchan_TransmitBits( netchan_t *chan, int length, byte *data )
 
 				// if it's not in-memory, then we'll need to copy it in frame the file handle.
 				if( pbuf->isfile && !pbuf->isbuffer )
-				{
-					byte	filebuffer[NET_MAX_FRAGMENT];
-					file_t	*file;
-
-					if( pbuf->iscompressed )
-					{
-						char	compressedfilename[MAX_OSPATH];
-
-						Q_strncpy( compressedfilename, pbuf->filename, sizeof( compressedfilename ));
-						COM_ReplaceExtension( compressedfilename, ".ztmp", sizeof( compressedfilename ));
-						file = FS_Open( compressedfilename, "rb", false );
-					}
-					else file = FS_Open( pbuf->filename, "rb", false );
-
-					FS_Seek( file, pbuf->foffset, SEEK_SET );
-					FS_Read( file, filebuffer, pbuf->size );
-
-					MSG_WriteBits( &pbuf->frag_message, filebuffer, pbuf->size << 3 );
-					FS_Close( file );
-				}
+					Netchan_ReadFileFragment( pbuf );
 
 				// copy frag stuff on top of current buffer
 				MSG_StartWriting( &temp, chan->reliable_buf, sizeof( chan->reliable_buf ), chan->reliable_length, -1 );
@@ -1580,8 +1906,9 @@ void Netchan_TransmitBits( netchan_t *chan, int length, byte *data )
 				chan->reliable_length += MSG_GetNumBitsWritten( &pbuf->frag_message );
 				chan->frag_length[i] = MSG_GetNumBitsWritten( &pbuf->frag_message );
 
-				// unlink pbuf
-				Netchan_UnlinkFragment( pbuf, &chan->fragbufs[i] );
+				// unlink pbuf, unless there is more to read from file
+				if( !Netchan_NextFileFragment( pbuf ))
+					Netchan_UnlinkFragment( pbuf, &chan->fragbufs[i] );
 
 				chan->reliable_fragment[i] = 1;
 
@@ -1897,3 +2224,240 @@ qboolean Netchan_Process( netchan_t *chan, sizebuf_t *msg )
 
 	return true;
 }
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+static int Test_NetchanBlockSize( void *cl, fragsize_t mode )
+{
+	return FRAGMENT_DEFAULT_SIZE;
+}
+
+static void Test_NetchanBlob( void )
+{
+	poolhandle_t oldpool = net_mempool;
+	netchan_t *chans;
+	fragblob_t *blob;
+	sizebuf_t msg;
+	byte *data, *out;
+	int i, j, numfrags = 0;
+	netadr_t adr;
+
+	if( !net_mempool )
+		net_mempool = Mem_AllocPool( "Netchan Test Pool" );
+
+	data = Mem_Malloc( host.mempool, MAX_INIT_MSG );
+	out = Mem_Malloc( host.mempool, MAX_INIT_MSG );
+	chans = Mem_Calloc( host.mempool, sizeof( *chans ) * 2 );
+
+	// compressible, like real signon, but doesn't fit in one fragment
+	MSG_Init( &msg, "TestBlob", data, MAX_INIT_MSG );
+	for( i = 0; i < 2000; i++ )
+	{
+		MSG_WriteString( &msg, "models/player.mdl" );
+		MSG_WriteLong( &msg, COM_RandomLong( 0, 0x7fffffff ));
+	}
+
+	blob = Netchan_CreateFragBlob( &msg );
+	TASSERT( blob != NULL );
+	if( !blob )
+		return;
+
+	TASSERT( blob->size < MSG_GetNumBytesWritten( &msg ));
+	TASSERT( LZSS_IsCompressed( blob->data ));
+
+	memset( &adr, 0, sizeof( adr ));
+	adr.type = NA_LOOPBACK;
+
+	for( i = 0; i < 2; i++ )
+	{
+		fragbufwaiting_t *wait;
+		fragbuf_t *p;
+		int size = 0;
+
+		Netchan_Setup( NS_SERVER, &chans[i], adr, 0, NULL, Test_NetchanBlockSize );
+
+		// pending reliable data goes first
+		MSG_WriteString( &chans[i].message, "pending" );
+		Netchan_CreateBlobFragments( &chans[i], blob );
+		TASSERT_EQi( MSG_GetNumBytesWritten( &chans[i].message ), 0 );
+
+		wait = chans[i].waitlist[FRAG_NORMAL_STREAM];
+		TASSERT( wait != NULL && wait->next != NULL );
+		if( !wait || !wait->next )
+			continue;
+
+		TASSERT( !Q_strcmp( (char *)MSG_GetData( &wait->fragbufs->frag_message ), "pending" ));
+
+		// fragments point into blob, nothing is copied
+		for( p = wait->next->fragbufs, j = 0; p; p = p->next, j++ )
+		{
+			TASSERT( p->blob == blob && MSG_GetData( &p->frag_message ) == blob->data + size );
+			TASSERT_EQi( p->bufferid, j + 1 );
+			memcpy( out + size, MSG_GetData( &p->frag_message ), MSG_GetNumBytesWritten( &p->frag_message ));
+			size += MSG_GetNumBytesWritten( &p->frag_message );
+		}
+
+		TASSERT_EQi( size, blob->size );
+		TASSERT_EQi( wait->next->fragbufcount, j );
+		numfrags = j;
+	}
+
+	TASSERT( numfrags > 1 );
+	TASSERT_EQi( blob->refcount, 1 + numfrags * 2 );
+
+	// fragments of every channel give same message back
+	TASSERT_EQi( LZSS_GetActualSize( out ), MSG_GetNumBytesWritten( &msg ));
+	if( LZSS_GetActualSize( out ) == MSG_GetNumBytesWritten( &msg ))
+	{
+		byte *decompressed = Mem_Malloc( host.mempool, MSG_GetNumBytesWritten( &msg ) + 1 );
+
+		TASSERT_EQi( LZSS_Decompress( out, decompressed ), MSG_GetNumBytesWritten( &msg ));
+		TASSERT( !memcmp( decompressed, data, MSG_GetNumBytesWritten( &msg )));
+		Mem_Free( decompressed );
+	}
+
+	// owner can let it go before channels are done with it
+	Netchan_ReleaseFragBlob( &blob );
+	TASSERT( blob == NULL );
+	blob = chans[1].waitlist[FRAG_NORMAL_STREAM]->next->fragbufs->blob;
+	TASSERT_EQi( blob->refcount, numfrags * 2 );
+
+	Netchan_Clear( &chans[0] );
+	TASSERT_EQi( blob->refcount, numfrags );
+	Netchan_Clear( &chans[1] );
+
+	Mem_Free( chans );
+	Mem_Free( out );
+	Mem_Free( data );
+
+	if( !oldpool )
+		Mem_FreePool( &net_mempool );
+	net_mempool = oldpool;
+}
+
+/*
+sends file from first channel to second one over loopback,
+and checks that downloaded copy matches
+*/
+static void Test_NetchanDownload( netchan_t *chans, const char *filename, const byte *data, int size, qboolean compressed )
+{
+	static byte packet[NET_MAX_MESSAGE];
+	fragbufwaiting_t *wait;
+	fs_offset_t outsize = 0;
+	string downloaded;
+	sizebuf_t msg;
+	size_t length;
+	byte *out;
+	int i, frames;
+
+	Q_snprintf( downloaded, sizeof( downloaded ), "downloaded/%s", filename );
+	FS_Delete( downloaded );
+
+	TASSERT_EQi( Netchan_CreateFileFragments( &chans[0], filename ), 1 );
+
+	// single buffer, file is read as it's being sent
+	wait = chans[0].waitlist[FRAG_FILE_STREAM];
+	TASSERT( wait != NULL && wait->fragbufs != NULL );
+	if( !wait || !wait->fragbufs )
+		return;
+
+	TASSERT( wait->fragbufs->next == NULL );
+	TASSERT( wait->fragbufcount > 1 );
+	TASSERT( wait->fragbufs->iscompressed == compressed );
+	TASSERT( wait->fragbufs->file == NULL );
+
+	for( frames = 0; frames < 10000 && !chans[1].incomingready[FRAG_FILE_STREAM]; frames++ )
+	{
+		for( i = 0; i < 2; i++ )
+		{
+			Netchan_TransmitBits( &chans[i], 0, NULL );
+
+			length = sizeof( packet );
+			if( !NET_GetPacket( chans[i ^ 1].sock, &net_from, packet, &length ))
+				break;
+
+			MSG_Init( &msg, "TestPacket", packet, length );
+			Netchan_Process( &chans[i ^ 1], &msg );
+		}
+	}
+
+	TASSERT( chans[1].incomingready[FRAG_FILE_STREAM] );
+	TASSERT( chans[0].fragbufs[FRAG_FILE_STREAM] == NULL );
+	TASSERT( Netchan_CopyFileFragments( &chans[1], &net_message ));
+
+	out = FS_LoadFile( downloaded, &outsize, false );
+	TASSERT( out != NULL );
+	TASSERT_EQi( outsize, size );
+
+	if( out )
+	{
+		TASSERT( outsize == size && !memcmp( out, data, size ));
+		Mem_Free( out );
+	}
+
+	FS_Delete( downloaded );
+}
+
+static void Test_NetchanFiles( void )
+{
+	static const char *words[] = { "models/", "player", ".mdl", "sound/", "weapons/", ".wav", "sprites/", "\n" };
+	const char *filename = "nettest.dat";
+	const char *compressedfilename = "nettest.ztmp";
+	poolhandle_t oldpool = net_mempool;
+	netchan_t *chans;
+	netadr_t adr;
+	byte *data;
+	int i, size;
+
+	if( !net_mempool )
+		net_mempool = Mem_AllocPool( "Netchan Test Pool" );
+
+	// compressible, but takes a lot of fragments
+	data = Mem_Malloc( host.mempool, 65536 );
+	for( size = 0; size < 60000; size += Q_strlen( words[i] ))
+	{
+		i = COM_RandomLong( 0, ARRAYSIZE( words ) - 1 );
+		memcpy( data + size, words[i], Q_strlen( words[i] ));
+	}
+
+	FS_Delete( compressedfilename );
+	TASSERT( FS_WriteFile( filename, data, size ));
+
+	chans = Mem_Calloc( host.mempool, sizeof( *chans ) * 2 );
+	memset( &adr, 0, sizeof( adr ));
+	adr.type = NA_LOOPBACK;
+	Netchan_Setup( NS_SERVER, &chans[0], adr, 0, NULL, Test_NetchanBlockSize );
+	Netchan_Setup( NS_CLIENT, &chans[1], adr, 0, NULL, Test_NetchanBlockSize );
+
+	// no .ztmp yet, file is sent as is and gets queued for compression
+	Test_NetchanDownload( chans, filename, data, size, false );
+	TASSERT( net_compress != NULL );
+
+	Netchan_UpdateCompression( true );
+	TASSERT( net_compress == NULL );
+	TASSERT( FS_FileSize( compressedfilename, false ) > 0 );
+	TASSERT( FS_FileSize( compressedfilename, false ) < size );
+
+	// then it goes compressed
+	Test_NetchanDownload( chans, filename, data, size, true );
+
+	Netchan_Clear( &chans[0] );
+	Netchan_Clear( &chans[1] );
+	FS_Delete( compressedfilename );
+	FS_Delete( filename );
+
+	Mem_Free( chans );
+	Mem_Free( data );
+
+	if( !oldpool )
+		Mem_FreePool( &net_mempool );
+	net_mempool = oldpool;
+}
+
+void Test_RunNetchan( void )
+{
+	TRUN( Test_NetchanBlob( ));
+	TRUN( Test_NetchanFiles( ));
+}
+#endif // XASH_ENGINE_TESTS
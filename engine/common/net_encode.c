@@ -25,6 +25,7 @@ GNU General Public License for more details.
 #include "event_args.h"
 #include "protocol.h"
 #include "client.h"
+#include "crclib.h"
 
 #define DELTA_PATH		"delta.lst"
 
@@ -39,6 +40,8 @@ GNU General Public License for more details.
 #define DT_SIGNED		BIT( 8 )	// sign modificator
 
 #define NUM_FIELDS( x )	((sizeof( x ) / sizeof( x[0] )) - 1)
+#define DELTA_MAX_FIELDS	128	// entity_state_t is the largest
+#define DELTA_MAX_WORDS	256	// biggest struct for change masks, in 32-bit words
 
 // helper macroses
 #define ENTS_DEF( x )	#x, offsetof( entity_state_t, x ), sizeof( ((entity_state_t *)0)->x )
@@ -50,6 +53,8 @@ GNU General Public License for more details.
 
 static qboolean		delta_init = false;
 
+static void Delta_CompileAll( void );
+
 // list of all the struct names
 static const delta_field_t cmd_fields[] =
 {
@@ -315,6 +320,9 @@ static const delta_field_t ent_fields[] =
 { NULL },
 };
 
+STATIC_ASSERT( NUM_FIELDS( ent_fields ) <= DELTA_MAX_FIELDS,
+	"increase DELTA_MAX_FIELDS" );
+
 enum
 {
 	DT_EVENT_T = 0,
@@ -400,20 +408,38 @@ static delta_info_t *Delta_FindStructByDelta( const delta_t *pFields )
 	return NULL;
 }
 
-static void Delta_CustomEncode( delta_info_t *dt, const void *from, const void *to )
+/*
+=====================
+Delta_CustomEncode
+
+game encoders mark fields in shared table, so copy the result
+out to let snapshots for different clients be encoded in parallel
+=====================
+*/
+static void Delta_CustomEncode( delta_info_t *dt, const void *from, const void *to, qboolean *inactive )
 {
 	int	i;
 
 	Assert( dt != NULL );
 
-	// set all fields is active by default
+	if( !dt->userCallback )
+	{
+		// set all fields is active by default
+		memset( inactive, 0, dt->numFields * sizeof( *inactive ));
+		return;
+	}
+
+	Sys_EnterSerial();
+
 	for( i = 0; i < dt->numFields; i++ )
 		dt->pFields[i].bInactive = false;
 
-	if( dt->userCallback )
-	{
-		dt->userCallback( dt->pFields, from, to );
-	}
+	dt->userCallback( dt->pFields, from, to );
+
+	for( i = 0; i < dt->numFields; i++ )
+		inactive[i] = dt->pFields[i].bInactive;
+
+	Sys_LeaveSerial();
 }
 
 static delta_field_t *Delta_FindFieldInfo( const delta_field_t *pInfo, const char *fieldName )
@@ -827,7 +853,12 @@ void Delta_Init( void )
 	dt = Delta_FindStructByIndex( DT_MOVEVARS_T );
 
 	Assert( dt != NULL );
-	if( dt->bInitialized ) return;	// "movevars_t" already specified by user
+	if( dt->bInitialized )
+	{
+		// "movevars_t" already specified by user
+		Delta_CompileAll();
+		return;
+	}
 
 	// create movevars_t delta internal
 	Delta_AddField( dt, "gravity", DT_FLOAT|DT_SIGNED, 16, 8.0f, 1.0f );
@@ -865,6 +896,8 @@ void Delta_Init( void )
 
 	// now done
 	dt->bInitialized = true;
+
+	Delta_CompileAll();
 }
 
 void Delta_InitClient( void )
@@ -884,6 +917,8 @@ void Delta_InitClient( void )
 	}
 
 	if( numActive ) delta_init = true;
+
+	Delta_CompileAll();
 }
 
 void Delta_Shutdown( void )
@@ -905,6 +940,15 @@ void Delta_Shutdown( void )
 			dt_info[i].pFields = NULL;
 		}
 
+		if( dt_info[i].pOps )
+		{
+			Z_Free( dt_info[i].pOps );
+			dt_info[i].pOps = NULL;
+		}
+
+		dt_info[i].numOps = 0;
+		dt_info[i].numWords = 0;
+
 		dt_info[i].bInitialized = false;
 	}
 
@@ -956,9 +1000,6 @@ static qboolean Delta_CompareField( delta_t *pField, void *from, void *to, doubl
 	Assert( from != NULL );
 	Assert( to != NULL );
 
-	if( pField->bInactive )
-		return true;
-
 	fromF = toF = 0;
 
 	if( pField->flags & DT_BYTE )
@@ -1075,6 +1116,345 @@ static qboolean Delta_CompareField( delta_t *pField, void *from, void *to, doubl
 	return fromF == toF;
 }
 
+/*
+=============================================================================
+
+COMPILED ENCODERS
+
+Each table is turned into an array of ops with field type resolved
+once, so the writer doesn't go through the flags for every field.
+Before looking at the fields, from and to are compared by 32-bit words:
+a field that has all its words unchanged can't be sent. Other fields
+are compared exactly like in Delta_CompareField, so output is the same.
+
+=============================================================================
+*/
+enum
+{
+	DELTA_OP_NONE = 0,	// never sent
+	DELTA_OP_INT8,
+	DELTA_OP_UINT8,
+	DELTA_OP_INT16,
+	DELTA_OP_UINT16,
+	DELTA_OP_INT32,
+	DELTA_OP_UINT32,
+	DELTA_OP_FLOAT,
+	DELTA_OP_ANGLE,
+	DELTA_OP_TIMEWINDOW_8,
+	DELTA_OP_TIMEWINDOW_BIG,
+	DELTA_OP_STRING,
+};
+
+typedef struct delta_op_s
+{
+	byte		type;		// DELTA_OP_*
+	byte		signbit;
+	byte		scale;		// multiplier isn't 1.0
+	byte		bits;
+	int		offset;
+	int		firstword;	// in change mask
+	int		lastword;
+} delta_op_t;
+
+static qboolean delta_interpret = false;	// for Delta_BenchEntities
+
+/*
+=====================
+Delta_OpType
+
+same order as checks in Delta_WriteField
+=====================
+*/
+static int Delta_OpType( const delta_t *pField )
+{
+	qboolean signbit = FBitSet( pField->flags, DT_SIGNED ) ? true : false;
+
+	if( FBitSet( pField->flags, DT_BYTE ))
+		return signbit ? DELTA_OP_INT8 : DELTA_OP_UINT8;
+	if( FBitSet( pField->flags, DT_SHORT ))
+		return signbit ? DELTA_OP_INT16 : DELTA_OP_UINT16;
+	if( FBitSet( pField->flags, DT_INTEGER ))
+		return signbit ? DELTA_OP_INT32 : DELTA_OP_UINT32;
+	if( FBitSet( pField->flags, DT_FLOAT ))
+		return DELTA_OP_FLOAT;
+	if( FBitSet( pField->flags, DT_ANGLE ))
+		return DELTA_OP_ANGLE;
+	if( FBitSet( pField->flags, DT_TIMEWINDOW_8 ))
+		return DELTA_OP_TIMEWINDOW_8;
+	if( FBitSet( pField->flags, DT_TIMEWINDOW_BIG ))
+		return DELTA_OP_TIMEWINDOW_BIG;
+	if( FBitSet( pField->flags, DT_STRING ))
+		return DELTA_OP_STRING;
+
+	return DELTA_OP_NONE;
+}
+
+/*
+=====================
+Delta_Compile
+
+=====================
+*/
+static void Delta_Compile( delta_info_t *dt )
+{
+	int	i, structsize = 0;
+
+	if( dt->pOps )
+	{
+		Z_Free( dt->pOps );
+		dt->pOps = NULL;
+	}
+
+	dt->numOps = dt->numWords = 0;
+
+	if( !dt->bInitialized || dt->numFields <= 0 || dt->numFields > DELTA_MAX_FIELDS )
+		return;
+
+	dt->pOps = Z_Calloc( dt->numFields * sizeof( delta_op_t ));
+
+	for( i = 0; i < dt->numFields; i++ )
+	{
+		const delta_t	*pField = &dt->pFields[i];
+		delta_op_t	*op = &dt->pOps[i];
+
+		op->type = Delta_OpType( pField );
+		op->signbit = FBitSet( pField->flags, DT_SIGNED ) ? 1 : 0;
+		op->scale = !Q_equal( pField->multiplier, 1.0f );
+		op->bits = pField->bits;
+		op->offset = pField->offset;
+		op->firstword = pField->offset / 4;
+		op->lastword = ( pField->offset + Q_max( pField->size, 1 ) - 1 ) / 4;
+
+		structsize = Q_max( structsize, pField->offset + pField->size );
+	}
+
+	// structs are aligned to 4 bytes, so rounding up doesn't read past them
+	dt->numWords = ( structsize + 3 ) / 4;
+	if( dt->numWords > DELTA_MAX_WORDS )
+		dt->numWords = 0;
+
+	dt->numOps = dt->numFields;
+}
+
+/*
+=====================
+Delta_CompileAll
+
+=====================
+*/
+static void Delta_CompileAll( void )
+{
+	int	i;
+
+	for( i = 0; i < NUM_FIELDS( dt_info ); i++ )
+		Delta_Compile( &dt_info[i] );
+}
+
+/*
+=====================
+Delta_ChangedWords
+
+sets bit for every 32-bit word that differs, written
+without branches so compiler can vectorize it
+=====================
+*/
+static void Delta_ChangedWords( const delta_info_t *dt, const void *from, const void *to, uint32_t *changed )
+{
+	const uint32_t	*a = from, *b = to;
+	int		i;
+
+	memset( changed, 0, (( dt->numWords + 31 ) / 32 ) * sizeof( *changed ));
+
+	for( i = 0; i < dt->numWords; i++ )
+		changed[i >> 5] |= (uint32_t)( a[i] != b[i] ) << ( i & 31 );
+}
+
+/*
+=====================
+Delta_DirtyFields
+
+sets bit for every field that may have changed, fields
+that are clear can be skipped without comparing
+=====================
+*/
+static void Delta_DirtyFields( const delta_info_t *dt, const qboolean *inactive, const void *from, const void *to, uint32_t *dirty )
+{
+	uint32_t	changed[DELTA_MAX_WORDS / 32];
+	int	i, j;
+
+	memset( dirty, 0, (( dt->numOps + 31 ) / 32 ) * sizeof( *dirty ));
+
+	if( dt->numWords )
+	{
+		// mostly static entities end here
+		if( !memcmp( from, to, dt->numWords * sizeof( uint32_t )))
+			return;
+
+		Delta_ChangedWords( dt, from, to, changed );
+	}
+
+	for( i = 0; i < dt->numOps; i++ )
+	{
+		const delta_op_t *op = &dt->pOps[i];
+
+		if( inactive[i] || op->type == DELTA_OP_NONE )
+			continue;
+
+		if( dt->numWords )
+		{
+			for( j = op->firstword; j <= op->lastword; j++ )
+			{
+				if( FBitSet( changed[j >> 5], BIT( j & 31 )))
+					break;
+			}
+
+			if( j > op->lastword )
+				continue; // same bytes
+		}
+
+		SetBits( dirty[i >> 5], BIT( i & 31 ));
+	}
+}
+
+/*
+=====================
+Delta_LoadInteger
+
+=====================
+*/
+static int Delta_LoadInteger( const delta_op_t *op, const byte *base )
+{
+	const byte *p = base + op->offset;
+
+	switch( op->type )
+	{
+	case DELTA_OP_INT8: return *(int8_t *)p;
+	case DELTA_OP_UINT8: return *(uint8_t *)p;
+	case DELTA_OP_INT16: return *(int16_t *)p;
+	case DELTA_OP_UINT16: return *(uint16_t *)p;
+	case DELTA_OP_INT32: return *(int32_t *)p;
+	default: return *(uint32_t *)p;
+	}
+}
+
+/*
+=====================
+Delta_CompareOp
+
+Delta_CompareField for compiled field
+=====================
+*/
+static qboolean Delta_CompareOp( const delta_op_t *op, delta_t *pField, const byte *from, const byte *to, double timebase )
+{
+	float	val_a, val_b;
+	int	fromF, toF;
+
+	switch( op->type )
+	{
+	case DELTA_OP_INT8:
+	case DELTA_OP_UINT8:
+	case DELTA_OP_INT16:
+	case DELTA_OP_UINT16:
+	case DELTA_OP_INT32:
+	case DELTA_OP_UINT32:
+		fromF = Delta_ClampIntegerField( pField, Delta_LoadInteger( op, from ), op->signbit, op->bits );
+		toF = Delta_ClampIntegerField( pField, Delta_LoadInteger( op, to ), op->signbit, op->bits );
+
+		if( op->scale )
+		{
+			fromF *= pField->multiplier;
+			toF *= pField->multiplier;
+		}
+		return fromF == toF;
+	case DELTA_OP_FLOAT:
+	case DELTA_OP_ANGLE:
+		// don't convert floats to integers
+		return *(int *)( from + op->offset ) == *(int *)( to + op->offset );
+	case DELTA_OP_TIMEWINDOW_8:
+		val_a = Q_rint((*(float *)( from + op->offset )) * 100.0f );
+		val_b = Q_rint((*(float *)( to + op->offset )) * 100.0f );
+		val_a -= Q_rint(timebase * 100.0);
+		val_b -= Q_rint(timebase * 100.0);
+		return FloatAsInt( val_a ) == FloatAsInt( val_b );
+	case DELTA_OP_TIMEWINDOW_BIG:
+		val_a = (*(float *)( from + op->offset ));
+		val_b = (*(float *)( to + op->offset ));
+
+		if( op->scale )
+		{
+			val_a *= pField->multiplier;
+			val_b *= pField->multiplier;
+			val_a = (timebase * pField->multiplier) - val_a;
+			val_b = (timebase * pField->multiplier) - val_b;
+		}
+		else
+		{
+			val_a = timebase - val_a;
+			val_b = timebase - val_b;
+		}
+		return FloatAsInt( val_a ) == FloatAsInt( val_b );
+	case DELTA_OP_STRING:
+		return !Q_strcmp((char *)( from + op->offset ), (char *)( to + op->offset ));
+	}
+
+	return true;
+}
+
+/*
+=====================
+Delta_WriteOp
+
+Delta_WriteField for compiled field, after it's known to be changed
+=====================
+*/
+static void Delta_WriteOp( sizebuf_t *msg, const delta_op_t *op, delta_t *pField, const byte *to, double timebase )
+{
+	float	flValue;
+	uint	iValue;
+
+	switch( op->type )
+	{
+	case DELTA_OP_INT8:
+	case DELTA_OP_UINT8:
+	case DELTA_OP_INT16:
+	case DELTA_OP_UINT16:
+	case DELTA_OP_INT32:
+	case DELTA_OP_UINT32:
+		iValue = Delta_LoadInteger( op, to );
+		iValue = Delta_ClampIntegerField( pField, iValue, op->signbit, op->bits );
+
+		if( op->scale )
+			iValue *= pField->multiplier;
+
+		MSG_WriteBitLong( msg, iValue, op->bits, op->signbit );
+		break;
+	case DELTA_OP_FLOAT:
+		flValue = *(float *)( to + op->offset );
+		iValue = (int)((double)flValue * pField->multiplier);
+		iValue = Delta_ClampIntegerField( pField, iValue, op->signbit, op->bits );
+		MSG_WriteBitLong( msg, iValue, op->bits, op->signbit );
+		break;
+	case DELTA_OP_ANGLE:
+		MSG_WriteBitAngle( msg, *(float *)( to + op->offset ), op->bits );
+		break;
+	case DELTA_OP_TIMEWINDOW_8:
+		flValue = *(float *)( to + op->offset );
+		iValue = (int)Q_rint( timebase * 100.0 ) - (int)Q_rint( flValue * 100.0 );
+		iValue = Delta_ClampIntegerField( pField, iValue, 1, op->bits );
+		MSG_WriteBitLong( msg, iValue, op->bits, 1 );
+		break;
+	case DELTA_OP_TIMEWINDOW_BIG:
+		flValue = *(float *)( to + op->offset );
+		iValue = (int)Q_rint( timebase * pField->multiplier ) - (int)Q_rint( flValue * pField->multiplier );
+		iValue = Delta_ClampIntegerField( pField, iValue, 1, op->bits );
+		MSG_WriteBitLong( msg, iValue, op->bits, 1 );
+		break;
+	case DELTA_OP_STRING:
+		MSG_WriteString( msg, (char *)( to + op->offset ));
+		break;
+	}
+}
+
 /*
 =====================
 Delta_TestBaseline
@@ -1085,6 +1465,8 @@ compare baselines to find optimal
 int Delta_TestBaseline( entity_state_t *from, entity_state_t *to, qboolean player, double timebase )
 {
 	delta_info_t	*dt = NULL;
+	qboolean		inactive[DELTA_MAX_FIELDS];
+	uint32_t		dirty[DELTA_MAX_FIELDS / 32];
 	delta_t		*pField;
 	int		i, countBits;
 	int		numChanges = 0;
@@ -1111,15 +1493,24 @@ int Delta_TestBaseline( entity_state_t *from, entity_state_t *to, qboolean playe
 	Assert( pField != NULL );
 
 	// activate fields and call custom encode func
-	Delta_CustomEncode( dt, from, to );
+	Delta_CustomEncode( dt, from, to, inactive );
+
+	if( dt->numOps == dt->numFields && !delta_interpret )
+		Delta_DirtyFields( dt, inactive, from, to, dirty );
 
 	// process fields
 	for( i = 0; i < dt->numFields; i++, pField++ )
 	{
+		qboolean	fieldChanged;
+
 		// flag about field change (sets always)
 		countBits++;
 
-		if( !Delta_CompareField( pField, from, to, timebase ))
+		if( dt->numOps == dt->numFields && !delta_interpret )
+			fieldChanged = FBitSet( dirty[i >> 5], BIT( i & 31 )) && !Delta_CompareOp( &dt->pOps[i], pField, (byte *)from, (byte *)to, timebase );
+		else fieldChanged = !inactive[i] && !Delta_CompareField( pField, from, to, timebase );
+
+		if( fieldChanged )
 		{
 			// strings are handled difference
 			if( FBitSet( pField->flags, DT_STRING ))
@@ -1140,14 +1531,14 @@ write fields by offsets
 assume from and to is valid
 =====================
 */
-static qboolean Delta_WriteField( sizebuf_t *msg, delta_t *pField, void *from, void *to, double timebase )
+static qboolean Delta_WriteField( sizebuf_t *msg, delta_t *pField, qboolean inactive, void *from, void *to, double timebase )
 {
 	int		signbit = FBitSet( pField->flags, DT_SIGNED ) ? 1 : 0;
 	float		flValue, flAngle;
 	uint		iValue;
 	const char	*pStr;
 
-	if( Delta_CompareField( pField, from, to, timebase ))
+	if( inactive || Delta_CompareField( pField, from, to, timebase ))
 	{
 		MSG_WriteOneBit( msg, 0 );	// unchanged
 		return false;
@@ -1233,6 +1624,71 @@ static qboolean Delta_WriteField( sizebuf_t *msg, delta_t *pField, void *from, v
 	return true;
 }
 
+/*
+=====================
+Delta_WriteFields
+
+writes all fields of the table, returns number of changed ones
+=====================
+*/
+static int Delta_WriteFields( sizebuf_t *msg, delta_info_t *dt, const qboolean *inactive, void *from, void *to, double timebase, delta_stats_t *stats )
+{
+	uint32_t	dirty[DELTA_MAX_FIELDS / 32];
+	int	i, run, numChanges = 0;
+
+	if( delta_interpret || dt->numOps != dt->numFields )
+	{
+		for( i = 0; i < dt->numFields; i++ )
+		{
+			if( Delta_WriteField( msg, &dt->pFields[i], inactive[i], from, to, timebase ))
+				numChanges++;
+		}
+
+		if( stats )
+		{
+			stats->encoded += numChanges;
+			stats->compared += dt->numFields - numChanges;
+		}
+
+		return numChanges;
+	}
+
+	Delta_DirtyFields( dt, inactive, from, to, dirty );
+
+	for( i = 0; i < dt->numOps; i += run )
+	{
+		if( !FBitSet( dirty[i >> 5], BIT( i & 31 )))
+		{
+			// write run of unchanged flags at once
+			for( run = 1; run < 32 && i + run < dt->numOps; run++ )
+			{
+				if( FBitSet( dirty[( i + run ) >> 5], BIT(( i + run ) & 31 )))
+					break;
+			}
+
+			MSG_WriteUBitLong( msg, 0, run );
+			if( stats ) stats->skipped += run;
+			continue;
+		}
+
+		run = 1;
+
+		if( Delta_CompareOp( &dt->pOps[i], &dt->pFields[i], from, to, timebase ))
+		{
+			MSG_WriteOneBit( msg, 0 );	// unchanged
+			if( stats ) stats->compared++;
+			continue;
+		}
+
+		MSG_WriteOneBit( msg, 1 );	// changed
+		Delta_WriteOp( msg, &dt->pOps[i], &dt->pFields[i], to, timebase );
+		if( stats ) stats->encoded++;
+		numChanges++;
+	}
+
+	return numChanges;
+}
+
 /*
 ====================
 Delta_CopyField
@@ -1401,9 +1857,9 @@ MSG_WriteDeltaUsercmd
 */
 void MSG_WriteDeltaUsercmd( sizebuf_t *msg, usercmd_t *from, usercmd_t *to )
 {
+	qboolean		inactive[DELTA_MAX_FIELDS];
 	delta_t		*pField;
 	delta_info_t	*dt;
-	int		i;
 
 	dt = Delta_FindStructByIndex( DT_USERCMD_T );
 	Assert( dt && dt->bInitialized );
@@ -1412,13 +1868,10 @@ void MSG_WriteDeltaUsercmd( sizebuf_t *msg, usercmd_t *from, usercmd_t *to )
 	Assert( pField != NULL );
 
 	// activate fields and call custom encode func
-	Delta_CustomEncode( dt, from, to );
+	Delta_CustomEncode( dt, from, to, inactive );
 
 	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
-	{
-		Delta_WriteField( msg, pField, from, to, 0.0f );
-	}
+	Delta_WriteFields( msg, dt, inactive, from, to, 0.0f, NULL );
 }
 
 /*
@@ -1463,9 +1916,9 @@ MSG_WriteDeltaEvent
 */
 void MSG_WriteDeltaEvent( sizebuf_t *msg, event_args_t *from, event_args_t *to )
 {
+	qboolean		inactive[DELTA_MAX_FIELDS];
 	delta_t		*pField;
 	delta_info_t	*dt;
-	int		i;
 
 	dt = Delta_FindStructByIndex( DT_EVENT_T );
 	Assert( dt && dt->bInitialized );
@@ -1474,13 +1927,10 @@ void MSG_WriteDeltaEvent( sizebuf_t *msg, event_args_t *from, event_args_t *to )
 	Assert( pField != NULL );
 
 	// activate fields and call custom encode func
-	Delta_CustomEncode( dt, from, to );
+	Delta_CustomEncode( dt, from, to, inactive );
 
 	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
-	{
-		Delta_WriteField( msg, pField, from, to, 0.0f );
-	}
+	Delta_WriteFields( msg, dt, inactive, from, to, 0.0f, NULL );
 }
 
 /*
@@ -1518,9 +1968,10 @@ movevars_t communication
 */
 qboolean MSG_WriteDeltaMovevars( sizebuf_t *msg, movevars_t *from, movevars_t *to )
 {
+	qboolean		inactive[DELTA_MAX_FIELDS];
 	delta_t		*pField;
 	delta_info_t	*dt;
-	int		i, startBit;
+	int		startBit;
 	int		numChanges = 0;
 
 	dt = Delta_FindStructByIndex( DT_MOVEVARS_T );
@@ -1532,16 +1983,12 @@ qboolean MSG_WriteDeltaMovevars( sizebuf_t *msg, movevars_t *from, movevars_t *t
 	startBit = msg->iCurBit;
 
 	// activate fields and call custom encode func
-	Delta_CustomEncode( dt, from, to );
+	Delta_CustomEncode( dt, from, to, inactive );
 
 	MSG_BeginServerCmd( msg, svc_deltamovevars );
 
 	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
-	{
-		if( Delta_WriteField( msg, pField, from, to, 0.0f ))
-			numChanges++;
-	}
+	numChanges = Delta_WriteFields( msg, dt, inactive, from, to, 0.0f, NULL );
 
 	// if we have no changes - kill the message
 	if( !numChanges )
@@ -1588,11 +2035,12 @@ Writes current client data only for local client
 Other clients can grab the client state from entity_state_t
 ==================
 */
-void MSG_WriteClientData( sizebuf_t *msg, clientdata_t *from, clientdata_t *to, double timebase )
+void MSG_WriteClientData( sizebuf_t *msg, clientdata_t *from, clientdata_t *to, double timebase, delta_stats_t *stats )
 {
+	qboolean		inactive[DELTA_MAX_FIELDS];
 	delta_t		*pField;
 	delta_info_t	*dt;
-	int		i, startBit;
+	int		startBit;
 	int		numChanges = 0;
 
 	dt = Delta_FindStructByIndex( DT_CLIENTDATA_T );
@@ -1606,14 +2054,10 @@ void MSG_WriteClientData( sizebuf_t *msg, clientdata_t *from, clientdata_t *to,
 	MSG_WriteOneBit( msg, 1 ); // have clientdata
 
 	// activate fields and call custom encode func
-	Delta_CustomEncode( dt, from, to );
+	Delta_CustomEncode( dt, from, to, inactive );
 
 	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
-	{
-		if( Delta_WriteField( msg, pField, from, to, timebase ))
-			numChanges++;
-	}
+	numChanges = Delta_WriteFields( msg, dt, inactive, from, to, timebase, stats );
 
 	if( numChanges ) return; // we have updates
 
@@ -1669,11 +2113,12 @@ Writes current client data only for local client
 Other clients can grab the client state from entity_state_t
 ==================
 */
-void MSG_WriteWeaponData( sizebuf_t *msg, weapon_data_t *from, weapon_data_t *to, double timebase, int index )
+void MSG_WriteWeaponData( sizebuf_t *msg, weapon_data_t *from, weapon_data_t *to, double timebase, int index, delta_stats_t *stats )
 {
+	qboolean		inactive[DELTA_MAX_FIELDS];
 	delta_t		*pField;
 	delta_info_t	*dt;
-	int		i, startBit;
+	int		startBit;
 	int		numChanges = 0;
 
 	dt = Delta_FindStructByIndex( DT_WEAPONDATA_T );
@@ -1683,7 +2128,7 @@ void MSG_WriteWeaponData( sizebuf_t *msg, weapon_data_t *from, weapon_data_t *to
 	Assert( pField != NULL );
 
 	// activate fields and call custom encode func
-	Delta_CustomEncode( dt, from, to );
+	Delta_CustomEncode( dt, from, to, inactive );
 
 	startBit = msg->iCurBit;
 
@@ -1691,11 +2136,7 @@ void MSG_WriteWeaponData( sizebuf_t *msg, weapon_data_t *from, weapon_data_t *to
 	MSG_WriteUBitLong( msg, index, MAX_WEAPON_BITS );
 
 	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
-	{
-		if( Delta_WriteField( msg, pField, from, to, timebase ))
-			numChanges++;
-	}
+	numChanges = Delta_WriteFields( msg, dt, inactive, from, to, timebase, stats );
 
 	// if we have no changes - kill the message
 	if( !numChanges ) MSG_SeekToBit( msg, startBit, SEEK_SET );
@@ -1745,11 +2186,12 @@ If force is not set, then nothing at all will be generated if the entity is
 identical, under the assumption that the in-order delta code will catch it.
 ==================
 */
-void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, sizebuf_t *msg, qboolean force, int delta_type, double timebase, int baseline )
+void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, sizebuf_t *msg, qboolean force, int delta_type, double timebase, int baseline, delta_stats_t *stats )
 {
 	delta_info_t	*dt = NULL;
+	qboolean		inactive[DELTA_MAX_FIELDS];
 	delta_t		*pField;
-	int		i, startBit;
+	int		startBit;
 	int		numChanges = 0;
 
 	if( to == NULL )
@@ -1816,26 +2258,64 @@ void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, sizebuf_t *
 	if( delta_type == DELTA_STATIC )
 	{
 		// static entities won't to be custom encoded
-		for( i = 0; i < dt->numFields; i++ )
-			dt->pFields[i].bInactive = false;
+		memset( inactive, 0, sizeof( inactive ));
 	}
 	else
 	{
 		// activate fields and call custom encode func
-		Delta_CustomEncode( dt, from, to );
+		Delta_CustomEncode( dt, from, to, inactive );
 	}
 
 	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
-	{
-		if( Delta_WriteField( msg, pField, from, to, timebase ))
-			numChanges++;
-	}
+	numChanges += Delta_WriteFields( msg, dt, inactive, from, to, timebase, stats );
 
 	// if we have no changes - kill the message
 	if( !numChanges && !force ) MSG_SeekToBit( msg, startBit, SEEK_SET );
 }
 
+/*
+==================
+Delta_BenchEntities
+
+encodes pairs of entity states, returns time per pass
+and checksum of written data
+==================
+*/
+double Delta_BenchEntities( entity_state_t *from, entity_state_t *to, int count, int maxclients, int passes, qboolean compiled, uint32_t *crc )
+{
+	static byte	buf[NET_MAX_MESSAGE];
+	sizebuf_t		msg;
+	double		start;
+	int		i, pass;
+
+	MSG_Init( &msg, "DeltaBench", buf, sizeof( buf ));
+	CRC32_Init( crc );
+	delta_interpret = !compiled;
+	start = Sys_DoubleTime();
+
+	for( pass = 0; pass < passes; pass++ )
+	{
+		for( i = 0; i < count; i++ )
+		{
+			int type = ( to[i].number >= 1 && to[i].number <= maxclients ) ? DELTA_PLAYER : DELTA_ENTITY;
+
+			MSG_WriteDeltaEntity( &from[i], &to[i], &msg, false, type, 1.0, 0, NULL );
+
+			if( MSG_GetNumBytesLeft( &msg ) < 1024 || i == count - 1 )
+			{
+				if( pass == 0 )
+					CRC32_ProcessBuffer( crc, MSG_GetData( &msg ), MSG_GetNumBytesWritten( &msg ));
+				MSG_Clear( &msg );
+			}
+		}
+	}
+
+	delta_interpret = false;
+	*crc = CRC32_Final( *crc );
+
+	return ( Sys_DoubleTime() - start ) / Q_max( passes, 1 );
+}
+
 /*
 ==================
 MSG_ReadDeltaEntity
@@ -2070,3 +2550,101 @@ void GAME_EXPORT Delta_UnsetFieldByIndex( delta_t *pFields, int fieldNumber )
 
 	dt->pFields[fieldNumber].bInactive = true;
 }
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+static void Test_RandomizeState( entity_state_t *state )
+{
+	byte	*p = (byte *)state;
+	int	i, count = COM_RandomLong( 0, 8 );
+
+	// flip few random bytes, floats and integers get odd values too
+	for( i = 0; i < count; i++ )
+		p[COM_RandomLong( 0, sizeof( *state ) - 1 )] = COM_RandomLong( 0, 255 );
+
+	if( COM_RandomLong( 0, 1 ))
+		state->origin[0] = COM_RandomFloat( -8192.0f, 8192.0f );
+	if( COM_RandomLong( 0, 1 ))
+		state->animtime = COM_RandomFloat( 0.0f, 2.0f );
+}
+
+static void Test_DeltaCompile( void )
+{
+	delta_info_t	*dt = Delta_FindStructByIndex( DT_ENTITY_STATE_T );
+	qboolean		inactive[DELTA_MAX_FIELDS];
+	static byte	buf[2][4096];
+	entity_state_t	from, to;
+	sizebuf_t		msg[2];
+	delta_stats_t	stats = { 0 };
+	int		i, wrong = 0;
+
+	if( dt->bInitialized )
+		return; // don't break real tables
+
+	Delta_AddField( dt, "origin[0]", DT_SIGNED|DT_FLOAT, 21, 8.0f, 1.0f );
+	Delta_AddField( dt, "angles[0]", DT_ANGLE, 16, 1.0f, 1.0f );
+	Delta_AddField( dt, "modelindex", DT_INTEGER, 10, 1.0f, 1.0f );
+	Delta_AddField( dt, "sequence", DT_INTEGER, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "frame", DT_FLOAT, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "skin", DT_SHORT|DT_SIGNED, 9, 1.0f, 1.0f );
+	Delta_AddField( dt, "solid", DT_SHORT, 3, 1.0f, 1.0f );
+	Delta_AddField( dt, "scale", DT_FLOAT, 16, 256.0f, 1.0f );
+	Delta_AddField( dt, "renderamt", DT_INTEGER, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "rendercolor.r", DT_BYTE, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "rendercolor.g", DT_BYTE|DT_SIGNED, 4, 2.0f, 1.0f );
+	Delta_AddField( dt, "animtime", DT_TIMEWINDOW_8, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "framerate", DT_FLOAT|DT_SIGNED, 8, 16.0f, 1.0f );
+	Delta_AddField( dt, "controller[0]", DT_BYTE, 8, 1.0f, 1.0f );
+	Delta_AddField( dt, "health", DT_INTEGER|DT_SIGNED, 12, 3.0f, 1.0f );
+	Delta_AddField( dt, "impacttime", DT_TIMEWINDOW_BIG, 16, 100.0f, 1.0f );
+	Delta_AddField( dt, "starttime", DT_TIMEWINDOW_BIG, 16, 1.0f, 1.0f );
+	Delta_AddField( dt, "fuser1", DT_SIGNED|DT_FLOAT, 22, 128.0f, 1.0f );
+	Delta_AddField( dt, "vuser4[2]", DT_INTEGER, 32, 1.0f, 1.0f );
+	dt->bInitialized = true;
+	Delta_Compile( dt );
+
+	TASSERT( dt->numOps == dt->numFields && dt->numWords > 0 );
+	memset( inactive, 0, sizeof( inactive ));
+	memset( &from, 0, sizeof( from ));
+
+	for( i = 0; i < 10000; i++ )
+	{
+		int j, bits[2], numChanges[2];
+
+		to = from;
+		Test_RandomizeState( &to );
+		inactive[COM_RandomLong( 0, dt->numFields - 1 )] = COM_RandomLong( 0, 1 );
+
+		for( j = 0; j < 2; j++ )
+		{
+			memset( buf[j], 0, sizeof( buf[j] ));
+			MSG_Init( &msg[j], "DeltaTest", buf[j], sizeof( buf[j] ));
+			delta_interpret = j == 0;
+			numChanges[j] = Delta_WriteFields( &msg[j], dt, inactive, &from, &to, 1.5, j ? &stats : NULL );
+			bits[j] = Delta_TestBaseline( &from, &to, false, 1.5 );
+		}
+
+		delta_interpret = false;
+
+		if( numChanges[0] != numChanges[1] || bits[0] != bits[1]
+			|| MSG_GetNumBitsWritten( &msg[0] ) != MSG_GetNumBitsWritten( &msg[1] )
+			|| memcmp( buf[0], buf[1], MSG_GetNumBytesWritten( &msg[0] )))
+			wrong++;
+
+		from = to;
+	}
+
+	TASSERT_EQi( wrong, 0 );
+	TASSERT_EQi( stats.skipped + stats.compared + stats.encoded, dt->numFields * 10000 );
+	TASSERT( stats.skipped > stats.encoded );
+
+	delta_init = true; // let it free the test table
+	Delta_Shutdown();
+}
+
+void Test_RunDelta( void )
+{
+	TRUN( Test_DeltaCompile( ));
+}
+#endif // XASH_ENGINE_TESTS
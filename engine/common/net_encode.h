@@ -69,8 +69,21 @@ typedef struct
 	char		funcName[32];
 	pfnDeltaEncode	userCallback;
 	qboolean		bInitialized;
+
+	// filled by Delta_Compile
+	struct delta_op_s	*pOps;
+	int		numOps;
+	int		numWords;	// 0 if struct is too big for change masks
 } delta_info_t;
 
+// fields of snapshot, for net_showpackets
+typedef struct
+{
+	uint		skipped;	// same bytes
+	uint		compared;	// unchanged after compare
+	uint		encoded;
+} delta_stats_t;
+
 //
 // net_encode.c
 //
@@ -102,12 +115,13 @@ void MSG_WriteDeltaEvent( sizebuf_t *msg, struct event_args_s *from, struct even
 void MSG_ReadDeltaEvent( sizebuf_t *msg, struct event_args_s *from, struct event_args_s *to );
 qboolean MSG_WriteDeltaMovevars( sizebuf_t *msg, struct movevars_s *from, struct movevars_s *to );
 void MSG_ReadDeltaMovevars( sizebuf_t *msg, struct movevars_s *from, struct movevars_s *to );
-void MSG_WriteClientData( sizebuf_t *msg, struct clientdata_s *from, struct clientdata_s *to, double timebase );
+void MSG_WriteClientData( sizebuf_t *msg, struct clientdata_s *from, struct clientdata_s *to, double timebase, delta_stats_t *stats );
 void MSG_ReadClientData( sizebuf_t *msg, struct clientdata_s *from, struct clientdata_s *to, double timebase );
-void MSG_WriteWeaponData( sizebuf_t *msg, struct weapon_data_s *from, struct weapon_data_s *to, double timebase, int index );
+void MSG_WriteWeaponData( sizebuf_t *msg, struct weapon_data_s *from, struct weapon_data_s *to, double timebase, int index, delta_stats_t *stats );
 void MSG_ReadWeaponData( sizebuf_t *msg, struct weapon_data_s *from, struct weapon_data_s *to, double timebase );
-void MSG_WriteDeltaEntity( struct entity_state_s *from, struct entity_state_s *to, sizebuf_t *msg, qboolean force, int type, double timebase, int ofs );
+void MSG_WriteDeltaEntity( struct entity_state_s *from, struct entity_state_s *to, sizebuf_t *msg, qboolean force, int type, double timebase, int ofs, delta_stats_t *stats );
 qboolean MSG_ReadDeltaEntity( sizebuf_t *msg, struct entity_state_s *from, struct entity_state_s *to, int num, int type, double timebase );
 int Delta_TestBaseline( struct entity_state_s *from, struct entity_state_s *to, qboolean player, double timebase );
+double Delta_BenchEntities( struct entity_state_s *from, struct entity_state_s *to, int count, int maxclients, int passes, qboolean compiled, uint32_t *crc );
 
 #endif//NET_ENCODE_H
@@ -13,6 +13,10 @@ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
 GNU General Public License for more details.
 */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // recvmmsg, sendmmsg
+#endif
+
 #include "common.h"
 #include "client.h" // ConnectionProgress
 #include "netchan.h"
@@ -41,6 +45,20 @@ static const struct in6_addr in6addr_any;
 #define SPLITPACKET_MAX_SIZE			64000
 #define NET_MAX_FRAGMENTS		( NET_MAX_FRAGMENT / (SPLITPACKET_MIN_SIZE - sizeof( SPLITPACKET )))
 
+#if XASH_LINUX && !defined XASH_NO_NETWORK
+#define NET_USE_MMSG		1
+#define NET_RECV_BATCH		16	// datagrams per recvmmsg
+#define NET_SEND_BATCH		64	// datagrams per sendmmsg
+#define NET_SEND_BUFFER		( NET_SEND_BATCH * MAX_ROUTEABLE_PACKET )
+#define NET_USE_EPOLL		1
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/prctl.h>
+#else
+#define NET_USE_MMSG		0
+#define NET_USE_EPOLL		0
+#endif
+
 // ff02:1
 static const uint8_t k_ipv6Bytes_LinkLocalAllNodes[16] =
 { 0xff, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 };
@@ -108,6 +126,46 @@ typedef struct
 } net_state_t;
 
 static net_state_t		net;
+
+#if NET_USE_MMSG
+typedef struct
+{
+	byte		*data;	// NET_RECV_BATCH slots of NET_MAX_FRAGMENT bytes
+	struct mmsghdr	msgs[NET_RECV_BATCH];
+	struct iovec	iov[NET_RECV_BATCH];
+	struct sockaddr_storage	addr[NET_RECV_BATCH];
+	int		count;	// received by last recvmmsg
+	int		next;	// next one to be returned
+} net_recvbatch_t;
+
+typedef struct
+{
+	struct mmsghdr	msgs[NET_SEND_BATCH];
+	struct iovec	iov[NET_SEND_BATCH];
+	struct sockaddr_storage	addr[NET_SEND_BATCH];
+	netadr_t		to[NET_SEND_BATCH];	// for error messages
+	int		sockets[NET_SEND_BATCH];
+	byte		data[NET_SEND_BUFFER];
+	int		count;
+	size_t		used;
+	qboolean		active;	// between NET_BeginSendBatch and NET_FlushSendBatch
+} net_sendbatch_t;
+
+static net_recvbatch_t	net_recvbatch[2];	// server IPv4 and IPv6 sockets
+static net_sendbatch_t	net_sendbatch;
+
+static CVAR_DEFINE_AUTO( net_batch, "1", FCVAR_PRIVILEGED, "receive and send server packets in batches with recvmmsg and sendmmsg" );
+#endif
+
+#if NET_USE_EPOLL
+static struct
+{
+	int		epoll;	// -1 until first NET_WaitForEvents
+	int		timer;
+	int		sockets[2];	// server sockets added to epoll
+	qboolean		failed;	// don't try again
+} net_events = { -1, -1, { INVALID_SOCKET, INVALID_SOCKET }};
+#endif
 static CVAR_DEFINE_AUTO( net_address, "0", FCVAR_PRIVILEGED|FCVAR_READ_ONLY, "contain local address of current client" );
 static CVAR_DEFINE( net_ipname, "ip", "localhost", FCVAR_PRIVILEGED, "network ip address" );
 static CVAR_DEFINE( net_iphostport, "ip_hostport", "0", FCVAR_READ_ONLY, "network ip host port" );
@@ -953,6 +1011,7 @@ qboolean NET_CompareAdr( const netadr_t a, const netadr_t b )
 	{
 		if( a.port == b.port && !NET_NetadrIP6Compare( &a, &b ))
 		    return true;
+		return false;
 	}
 
 	Con_DPrintf( S_ERROR "NET_CompareAdr: bad address type\n" );
@@ -1441,6 +1500,280 @@ qboolean NET_GetLong( byte *pData, int size, size_t *outSize, int splitsize )
 	return false;
 }
 
+/*
+==================
+NET_NeedSplit
+
+==================
+*/
+static qboolean NET_NeedSplit( netsrc_t sock, size_t len, size_t splitsize )
+{
+#ifdef NET_USE_FRAGMENTS
+	return splitsize > sizeof( SPLITPACKET ) && sock == NS_SERVER && len > splitsize;
+#else
+	return false;
+#endif
+}
+
+/*
+==================
+NET_SendError
+
+reports error of last send call
+==================
+*/
+static void NET_SendError( netadr_t to )
+{
+	int err = WSAGetLastError();
+
+	// WSAEWOULDBLOCK is silent
+	if( err == WSAEWOULDBLOCK )
+		return;
+
+	// some PPP links don't allow broadcasts
+	if( err == WSAEADDRNOTAVAIL && ( to.type == NA_BROADCAST || to.type6 == NA_MULTICAST_IP6 ))
+		return;
+
+	if( Host_IsDedicated( ))
+	{
+		Con_DPrintf( S_ERROR "NET_SendPacket: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ));
+	}
+	else if( err == WSAEADDRNOTAVAIL || err == WSAENOBUFS )
+	{
+		Con_DPrintf( S_ERROR "NET_SendPacket: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ));
+	}
+	else
+	{
+		Con_Printf( S_ERROR "NET_SendPacket: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ));
+	}
+}
+
+/*
+=============================================================================
+
+BATCHED I/O
+
+Linux servers receive up to NET_RECV_BATCH datagrams per socket with one
+recvmmsg call and hand them out one by one. Packets sent between
+NET_BeginSendBatch and NET_FlushSendBatch are queued and sent with one
+sendmmsg call per socket. Other platforms use recvfrom and sendto.
+
+=============================================================================
+*/
+#if NET_USE_MMSG
+/*
+==================
+NET_ClearBatches
+
+drops everything that was received or queued on old sockets
+==================
+*/
+static void NET_ClearBatches( void )
+{
+	int i;
+
+	for( i = 0; i < ARRAYSIZE( net_recvbatch ); i++ )
+		net_recvbatch[i].count = net_recvbatch[i].next = 0;
+
+	net_sendbatch.count = 0;
+	net_sendbatch.used = 0;
+}
+
+/*
+==================
+NET_FreeBatches
+
+==================
+*/
+static void NET_FreeBatches( void )
+{
+	int i;
+
+	NET_ClearBatches();
+
+	for( i = 0; i < ARRAYSIZE( net_recvbatch ); i++ )
+	{
+		if( net_recvbatch[i].data )
+			Mem_Free( net_recvbatch[i].data );
+		net_recvbatch[i].data = NULL;
+	}
+}
+
+/*
+==================
+NET_RecvBatch
+
+returns same as recvfrom for next datagram in batch, receives new batch if needed
+==================
+*/
+static int NET_RecvBatch( net_recvbatch_t *batch, int net_socket, byte *buf, size_t size, struct sockaddr_storage *addr )
+{
+	struct mmsghdr *msg;
+	int i, ret;
+
+	if( batch->next >= batch->count )
+	{
+		batch->count = batch->next = 0;
+
+		if( !batch->data )
+			batch->data = Mem_Malloc( host.mempool, NET_RECV_BATCH * NET_MAX_FRAGMENT );
+
+		for( i = 0; i < NET_RECV_BATCH; i++ )
+		{
+			batch->iov[i].iov_base = batch->data + i * NET_MAX_FRAGMENT;
+			batch->iov[i].iov_len = NET_MAX_FRAGMENT;
+			memset( &batch->msgs[i], 0, sizeof( batch->msgs[i] ));
+			batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+			batch->msgs[i].msg_hdr.msg_iovlen = 1;
+			batch->msgs[i].msg_hdr.msg_name = &batch->addr[i];
+			batch->msgs[i].msg_hdr.msg_namelen = sizeof( batch->addr[i] );
+		}
+
+		ret = recvmmsg( net_socket, batch->msgs, NET_RECV_BATCH, MSG_DONTWAIT, NULL );
+
+		if( ret <= 0 )
+		{
+			if( ret == 0 )
+				errno = EWOULDBLOCK;
+			return SOCKET_ERROR;
+		}
+
+		batch->count = ret;
+	}
+
+	msg = &batch->msgs[batch->next];
+
+	// truncated datagram fills the buffer, like recvfrom does
+	ret = Q_min( msg->msg_len, size );
+	memcpy( buf, batch->iov[batch->next].iov_base, ret );
+	memcpy( addr, &batch->addr[batch->next], sizeof( *addr ));
+	batch->next++;
+
+	return ret;
+}
+
+/*
+==================
+NET_SendBatch
+
+==================
+*/
+static void NET_SendBatch( void )
+{
+	net_sendbatch_t *batch = &net_sendbatch;
+	int i, num, ret;
+
+	for( i = 0; i < batch->count; i += num )
+	{
+		// one call per run of packets to the same socket
+		for( num = 1; i + num < batch->count; num++ )
+		{
+			if( batch->sockets[i + num] != batch->sockets[i] )
+				break;
+		}
+
+		ret = sendmmsg( batch->sockets[i], &batch->msgs[i], num, 0 );
+
+		// skip the one that failed and try the rest
+		if( ret <= 0 )
+		{
+			NET_SendError( batch->to[i] );
+			num = 1;
+		}
+		else if( ret < num )
+		{
+			num = ret;
+		}
+	}
+
+	batch->count = 0;
+	batch->used = 0;
+}
+
+/*
+==================
+NET_QueueSend
+
+returns false if datagram must be sent directly
+==================
+*/
+static qboolean NET_QueueSend( int net_socket, const void *data, size_t length, const struct sockaddr_storage *addr, netadr_t to )
+{
+	net_sendbatch_t *batch = &net_sendbatch;
+	int i;
+
+	if( !batch->active || length > sizeof( batch->data ))
+		return false;
+
+	if( batch->count >= NET_SEND_BATCH || batch->used + length > sizeof( batch->data ))
+		NET_SendBatch();
+
+	i = batch->count++;
+	memcpy( batch->data + batch->used, data, length );
+	memcpy( &batch->addr[i], addr, sizeof( *addr ));
+	batch->iov[i].iov_base = batch->data + batch->used;
+	batch->iov[i].iov_len = length;
+	memset( &batch->msgs[i], 0, sizeof( batch->msgs[i] ));
+	batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+	batch->msgs[i].msg_hdr.msg_iovlen = 1;
+	batch->msgs[i].msg_hdr.msg_name = &batch->addr[i];
+	batch->msgs[i].msg_hdr.msg_namelen = NET_SockAddrLen( addr );
+	batch->sockets[i] = net_socket;
+	batch->to[i] = to;
+	batch->used += length;
+
+	return true;
+}
+#endif // NET_USE_MMSG
+
+/*
+==================
+NET_RecvFrom
+
+==================
+*/
+static int NET_RecvFrom( netsrc_t sock, int protocol, int net_socket, byte *buf, size_t size, struct sockaddr_storage *addr )
+{
+	WSAsize_t addr_len = sizeof( *addr );
+
+#if NET_USE_MMSG
+	// finish batch even if batching was just disabled
+	if( sock == NS_SERVER && ( net_batch.value || net_recvbatch[protocol].next < net_recvbatch[protocol].count ))
+		return NET_RecvBatch( &net_recvbatch[protocol], net_socket, buf, size, addr );
+#endif
+
+	return recvfrom( net_socket, buf, size, 0, (struct sockaddr *)addr, &addr_len );
+}
+
+/*
+==================
+NET_BeginSendBatch
+
+server packets are queued from now on until NET_FlushSendBatch
+==================
+*/
+void NET_BeginSendBatch( void )
+{
+#if NET_USE_MMSG
+	net_sendbatch.active = net.initialized && net_batch.value;
+#endif
+}
+
+/*
+==================
+NET_FlushSendBatch
+
+sends queued packets and stops queueing
+==================
+*/
+void NET_FlushSendBatch( void )
+{
+#if NET_USE_MMSG
+	NET_SendBatch();
+	net_sendbatch.active = false;
+#endif
+}
+
 /*
 ==================
 NET_QueuePacket
@@ -1453,7 +1786,6 @@ static qboolean NET_QueuePacket( netsrc_t sock, netadr_t *from, byte *data, size
 	byte		buf[NET_MAX_FRAGMENT];
 	int		ret, protocol;
 	int		net_socket;
-	WSAsize_t	addr_len;
 	struct sockaddr_storage	addr = { 0 };
 
 	*length = 0;
@@ -1469,8 +1801,7 @@ static qboolean NET_QueuePacket( netsrc_t sock, netadr_t *from, byte *data, size
 		if( !NET_IsSocketValid( net_socket ))
 			continue;
 
-		addr_len = sizeof( addr );
-		ret = recvfrom( net_socket, buf, sizeof( buf ), 0, (struct sockaddr *)&addr, &addr_len );
+		ret = NET_RecvFrom( sock, protocol, net_socket, buf, sizeof( buf ), &addr );
 
 		NET_SockadrToNetadr( &addr, from );
 
@@ -1556,7 +1887,7 @@ int NET_SendLong( netsrc_t sock, int net_socket, const char *buf, size_t len, in
 {
 #ifdef NET_USE_FRAGMENTS
 	// do we need to break this packet up?
-	if( splitsize > sizeof( SPLITPACKET ) && sock == NS_SERVER && len > splitsize )
+	if( NET_NeedSplit( sock, len, splitsize ))
 	{
 		char		packet[SPLITPACKET_MAX_SIZE];
 		int		total_sent, size, packet_count;
@@ -1647,34 +1978,21 @@ void NET_SendPacketEx( netsrc_t sock, size_t length, const void *data, netadr_t
 
 	NET_NetadrToSockadr( &to, &addr );
 
-	ret = NET_SendLong( sock, net_socket, data, length, 0, &addr, NET_SockAddrLen( &addr ), splitsize );
-
-	if( NET_IsSocketError( ret ))
+#if NET_USE_MMSG
+	if( sock == NS_SERVER && net_sendbatch.active )
 	{
-		int err = WSAGetLastError();
-
-		// WSAEWOULDBLOCK is silent
-		if( err == WSAEWOULDBLOCK )
-			return;
-
-		// some PPP links don't allow broadcasts
-		if( err == WSAEADDRNOTAVAIL && ( to.type == NA_BROADCAST || to.type6 == NA_MULTICAST_IP6 ))
+		// split packets are sent directly, after ones queued before them
+		if( !NET_NeedSplit( sock, length, splitsize ) && NET_QueueSend( net_socket, data, length, &addr, to ))
 			return;
 
-		if( Host_IsDedicated( ))
-		{
-			Con_DPrintf( S_ERROR "NET_SendPacket: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ));
-		}
-		else if( err == WSAEADDRNOTAVAIL || err == WSAENOBUFS )
-		{
-			Con_DPrintf( S_ERROR "NET_SendPacket: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ));
-		}
-		else
-		{
-			Con_Printf( S_ERROR "NET_SendPacket: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ));
-		}
+		NET_SendBatch();
 	}
+#endif
+
+	ret = NET_SendLong( sock, net_socket, data, length, 0, &addr, NET_SockAddrLen( &addr ), splitsize );
 
+	if( NET_IsSocketError( ret ))
+		NET_SendError( to );
 }
 
 /*
@@ -2022,6 +2340,9 @@ void NET_Config( qboolean multiplayer, qboolean changeport )
 	}
 
 	NET_ClearLoopback ();
+#if NET_USE_MMSG
+	NET_ClearBatches();
+#endif
 
 	net.configured = multiplayer ? true : false;
 }
@@ -2065,6 +2386,11 @@ void NET_Sleep( int msec )
 	if( !net.initialized || host.type == HOST_NORMAL )
 		return; // we're not a dedicated server, just run full speed
 
+#if NET_USE_MMSG
+	if( net_recvbatch[0].next < net_recvbatch[0].count || net_recvbatch[1].next < net_recvbatch[1].count )
+		return; // already received
+#endif
+
 	FD_ZERO( &fdset );
 
 	if( net.ip_sockets[NS_SERVER] != INVALID_SOCKET )
@@ -2073,12 +2399,180 @@ void NET_Sleep( int msec )
 		i = net.ip_sockets[NS_SERVER];
 	}
 
+	if( net.ip6_sockets[NS_SERVER] != INVALID_SOCKET )
+	{
+		FD_SET( net.ip6_sockets[NS_SERVER], &fdset );
+		i = Q_max( i, net.ip6_sockets[NS_SERVER] );
+	}
+
 	timeout.tv_sec = msec / 1000;
 	timeout.tv_usec = (msec % 1000) * 1000;
 	select( i+1, &fdset, NULL, NULL, &timeout );
 #endif
 }
 
+#if NET_USE_EPOLL
+/*
+====================
+NET_ShutdownEvents
+
+====================
+*/
+static void NET_ShutdownEvents( void )
+{
+	if( net_events.timer >= 0 )
+		close( net_events.timer );
+
+	if( net_events.epoll >= 0 )
+		close( net_events.epoll );
+
+	net_events.epoll = net_events.timer = -1;
+	net_events.sockets[0] = net_events.sockets[1] = INVALID_SOCKET;
+}
+
+/*
+====================
+NET_InitEvents
+
+====================
+*/
+static qboolean NET_InitEvents( void )
+{
+	struct epoll_event ev = { 0 };
+
+	if( net_events.epoll >= 0 )
+		return true;
+
+	if( net_events.failed )
+		return false;
+
+	net_events.epoll = epoll_create1( EPOLL_CLOEXEC );
+	net_events.timer = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC );
+	ev.events = EPOLLIN;
+	ev.data.fd = net_events.timer;
+
+	if( net_events.epoll < 0 || net_events.timer < 0 || epoll_ctl( net_events.epoll, EPOLL_CTL_ADD, net_events.timer, &ev ) < 0 )
+	{
+		Con_Printf( S_ERROR "%s: %s, falling back to sleep\n", __func__, NET_ErrorString( ));
+		NET_ShutdownEvents();
+		net_events.failed = true;
+		return false;
+	}
+
+	// default slack of 50 microseconds is too much for tick deadlines
+	prctl( PR_SET_TIMERSLACK, 1, 0, 0, 0 );
+
+	return true;
+}
+
+/*
+====================
+NET_WatchSocket
+
+keeps epoll in sync with reopened sockets
+====================
+*/
+static void NET_WatchSocket( int slot, int net_socket )
+{
+	struct epoll_event ev = { 0 };
+
+	if( net_events.sockets[slot] == net_socket )
+		return;
+
+	// closed sockets are removed from epoll by kernel
+	if( NET_IsSocketValid( net_events.sockets[slot] ))
+		epoll_ctl( net_events.epoll, EPOLL_CTL_DEL, net_events.sockets[slot], &ev );
+
+	net_events.sockets[slot] = INVALID_SOCKET;
+
+	if( !NET_IsSocketValid( net_socket ))
+		return;
+
+	// edge triggered, so unread packets don't wake us again
+	ev.events = EPOLLIN|EPOLLET;
+	ev.data.fd = net_socket;
+
+	if( !epoll_ctl( net_events.epoll, EPOLL_CTL_ADD, net_socket, &ev ))
+		net_events.sockets[slot] = net_socket;
+}
+#endif // NET_USE_EPOLL
+
+/*
+====================
+NET_WaitForEvents
+
+waits with precise timeout in seconds, returns 1 if it was cut short by
+a packet for server, 0 on timeout and -1 if this isn't supported
+====================
+*/
+int NET_WaitForEvents( double timeout, qboolean packets )
+{
+#if NET_USE_EPOLL
+	struct epoll_event events[4];
+	struct itimerspec its = { 0 };
+	struct timespec now;
+	int64_t deadline;
+	int i, num;
+
+	if( !NET_InitEvents( ))
+		return -1;
+
+#if NET_USE_MMSG
+	if( packets && ( net_recvbatch[0].next < net_recvbatch[0].count || net_recvbatch[1].next < net_recvbatch[1].count ))
+		return 1; // already received
+#endif
+
+	if( timeout <= 0.0 )
+		return 0;
+
+	NET_WatchSocket( 0, net.ip_sockets[NS_SERVER] );
+	NET_WatchSocket( 1, net.ip6_sockets[NS_SERVER] );
+
+	// absolute deadline doesn't drift if we are woken up early
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	deadline = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec + (int64_t)( timeout * 1e9 );
+	its.it_value.tv_sec = deadline / 1000000000;
+	its.it_value.tv_nsec = deadline % 1000000000;
+
+	if( timerfd_settime( net_events.timer, TFD_TIMER_ABSTIME, &its, NULL ) < 0 )
+		return -1;
+
+	while( true )
+	{
+		qboolean timedout = false, received = false;
+
+		num = epoll_wait( net_events.epoll, events, ARRAYSIZE( events ), -1 );
+
+		if( num < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+			return -1;
+		}
+
+		for( i = 0; i < num; i++ )
+		{
+			if( events[i].data.fd == net_events.timer )
+			{
+				uint64_t expirations;
+
+				if( read( net_events.timer, &expirations, sizeof( expirations )) > 0 )
+					timedout = true;
+			}
+			else received = true;
+		}
+
+		if( received && packets )
+			return 1;
+
+		if( timedout )
+			return 0;
+	}
+#else
+	return -1;
+#endif
+}
+
 /*
 ====================
 NET_ClearLagData
@@ -2112,6 +2606,9 @@ void NET_Init( void )
 	Cvar_RegisterVariable( &net_clientport );
 	Cvar_RegisterVariable( &net_fakelag );
 	Cvar_RegisterVariable( &net_fakeloss );
+#if NET_USE_MMSG
+	Cvar_RegisterVariable( &net_batch );
+#endif
 
 	Q_snprintf( cmd, sizeof( cmd ), "%i", PORT_SERVER );
 	Cvar_FullSet( "hostport", cmd, FCVAR_READ_ONLY );
@@ -2185,6 +2682,12 @@ void NET_Shutdown( void )
 	NET_ClearLagData( true, true );
 
 	NET_Config( false, false );
+#if NET_USE_MMSG
+	NET_FreeBatches();
+#endif
+#if NET_USE_EPOLL
+	NET_ShutdownEvents();
+#endif
 #if XASH_WIN32
 	WSACleanup();
 #endif
@@ -2192,6 +2695,119 @@ void NET_Shutdown( void )
 }
 
 
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+#if NET_USE_MMSG
+static void Test_NetBatch( void )
+{
+	static byte buf[NET_MAX_FRAGMENT];
+	struct sockaddr_storage addr = { 0 }, from;
+	struct sockaddr_in *sin = (struct sockaddr_in *)&addr;
+	socklen_t addrlen = sizeof( *sin );
+	netadr_t to = { 0 };
+	int s, i, ret, wrong = 0;
+
+	s = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if( !NET_IsSocketValid( s ))
+		return; // no network here
+
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+	if( bind( s, (struct sockaddr *)sin, sizeof( *sin )) || getsockname( s, (struct sockaddr *)sin, &addrlen ))
+	{
+		closesocket( s );
+		return;
+	}
+
+	// more than one batch, so queue is sent in the middle too
+	net_sendbatch.active = true;
+	for( i = 0; i < NET_SEND_BATCH + 3; i++ )
+	{
+		memset( buf, i, i * 17 + 1 );
+		if( !NET_QueueSend( s, buf, i * 17 + 1, &addr, to ))
+			wrong++;
+	}
+	NET_FlushSendBatch();
+
+	TASSERT_EQi( wrong, 0 );
+	TASSERT( !net_sendbatch.active );
+	TASSERT_EQi( net_sendbatch.count, 0 );
+
+	// received datagrams are handed out one by one in order
+	for( i = 0; i < NET_SEND_BATCH + 3; i++ )
+	{
+		ret = NET_RecvBatch( &net_recvbatch[0], s, buf, sizeof( buf ), &from );
+
+		if( ret != i * 17 + 1 || buf[ret - 1] != (byte)i )
+			wrong++;
+	}
+
+	TASSERT_EQi( wrong, 0 );
+	TASSERT( NET_IsSocketError( NET_RecvBatch( &net_recvbatch[0], s, buf, sizeof( buf ), &from )));
+	TASSERT_EQi( WSAGetLastError(), WSAEWOULDBLOCK );
+
+	closesocket( s );
+	NET_FreeBatches();
+}
+#endif // NET_USE_MMSG
+
+#if NET_USE_EPOLL
+static void Test_NetEvents( void )
+{
+	struct sockaddr_in sin = { 0 };
+	socklen_t addrlen = sizeof( sin );
+	int s, saved = net.ip_sockets[NS_SERVER];
+	int ret;
+
+	// how long it took depends on the machine load, only check why it returned
+	ret = NET_WaitForEvents( 0.005, true );
+
+	if( ret < 0 )
+		return; // no epoll here
+
+	TASSERT_EQi( ret, 0 );
+
+	s = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if( !NET_IsSocketValid( s ))
+		return;
+
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+	if( bind( s, (struct sockaddr *)&sin, sizeof( sin )) || getsockname( s, (struct sockaddr *)&sin, &addrlen ))
+	{
+		closesocket( s );
+		return;
+	}
+
+	// packet for server must end the wait right away
+	net.ip_sockets[NS_SERVER] = s;
+	sendto( s, "ping", 4, 0, (struct sockaddr *)&sin, sizeof( sin ));
+
+	TASSERT_EQi( NET_WaitForEvents( 5.0, true ), 1 );
+
+	// already seen packet doesn't wake it up again
+	TASSERT_EQi( NET_WaitForEvents( 0.001, true ), 0 );
+
+	net.ip_sockets[NS_SERVER] = saved;
+	closesocket( s );
+	NET_ShutdownEvents();
+}
+#endif // NET_USE_EPOLL
+
+void Test_RunNet( void )
+{
+#if NET_USE_MMSG
+	TRUN( Test_NetBatch( ));
+#endif
+#if NET_USE_EPOLL
+	TRUN( Test_NetEvents( ));
+#endif
+}
+#endif // XASH_ENGINE_TESTS
+
 /*
 =================================================
 
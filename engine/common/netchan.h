@@ -179,19 +179,31 @@ typedef struct
 	int		totalbytes;
 } flow_t;
 
+// compressed message that is queued to many channels, it's never changed
+typedef struct fragblob_s
+{
+	int		refcount;		// one for owner and one for every fragment that uses it
+	int		size;
+	byte		data[1];		// variable sized
+} fragblob_t;
+
 // generic fragment structure
 typedef struct fragbuf_s
 {
 	struct fragbuf_s	*next;				// next buffer in chain
 	int		bufferid;				// id of this buffer
 	sizebuf_t		frag_message;			// message buffer where raw data is stored
-	byte		*frag_message_buf;	// the actual data sits here
+	byte		*frag_message_buf;	// the actual data sits here, NULL if blob is used
+	fragblob_t	*blob;				// shared data frag_message points into
 	qboolean		isfile;				// is this a file buffer?
 	qboolean		isbuffer;				// is this file buffer from memory ( custom decal, etc. ).
 	qboolean		iscompressed;			// is compressed file, we should using filename.ztmp
 	char		filename[MAX_OSPATH];		// name of the file to save out on remote host
 	int		foffset;				// offset in file from which to read data
 	int		size;				// size of data to read at that offset
+	file_t		*file;				// streamed file, open only while it is being sent
+	int		remaining;			// bytes left in file after this piece
+	int		chunksize;			// size of next pieces
 } fragbuf_t;
 
 // Waiting list of fragbuf chains
@@ -293,7 +305,12 @@ void Netchan_CreateFileFragmentsFromBuffer( netchan_t *chan, const char *filenam
 qboolean Netchan_CopyNormalFragments( netchan_t *chan, sizebuf_t *msg, size_t *length );
 qboolean Netchan_CopyFileFragments( netchan_t *chan, sizebuf_t *msg );
 void Netchan_CreateFragments( netchan_t *chan, sizebuf_t *msg );
+fragblob_t *Netchan_CreateFragBlob( sizebuf_t *msg );
+void Netchan_ReleaseFragBlob( fragblob_t **blob );
+void Netchan_CreateBlobFragments( netchan_t *chan, fragblob_t *blob );
 int Netchan_CreateFileFragments( netchan_t *chan, const char *filename );
+void Netchan_QueueCompression( const char *filename );
+void Netchan_UpdateCompression( qboolean wait );
 void Netchan_TransmitBits( netchan_t *chan, int lengthInBits, byte *data );
 void Netchan_OutOfBand( int net_socket, netadr_t adr, int length, byte *data );
 void Netchan_OutOfBandPrint( int net_socket, netadr_t adr, const char *format, ... ) _format( 3 );
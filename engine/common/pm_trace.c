@@ -140,11 +140,24 @@ PM_HullPointContents
 */
 int GAME_EXPORT PM_HullPointContents( hull_t *hull, int num, const vec3_t p )
 {
+	const mpackedhull_t	*packed;
+	const mpackednode_t	*nodes;
 	mplane_t		*plane;
 
 	if( !hull || !hull->planes )	// fantom bmodels?
 		return CONTENTS_NONE;
 
+	packed = Mod_FindPackedHull( hull );
+
+	if( packed && num >= 0 && num < packed->numclipnodes )
+	{
+		nodes = packed->nodes;
+
+		for( num = packed->remap[num]; num >= 0; )
+			num = nodes[num].children[PlaneDiff( p, &nodes[num].plane ) < 0];
+		return num;
+	}
+
 	while( num >= 0 )
 	{
 		plane = &hull->planes[hull->clipnodes[num].planenum];
@@ -153,6 +166,54 @@ int GAME_EXPORT PM_HullPointContents( hull_t *hull, int num, const vec3_t p )
 	return num;
 }
 
+/*
+==================
+PM_HullNode
+
+fetches a node from the packed array if there is one,
+num is an index in that array then
+==================
+*/
+static inline const mplane_t *PM_HullNode( const hull_t *hull, const mpackedhull_t *packed, int num, int *children )
+{
+	if( packed )
+	{
+		const mpackednode_t *node = &packed->nodes[num];
+
+		children[0] = node->children[0];
+		children[1] = node->children[1];
+		return &node->plane;
+	}
+	else
+	{
+		const mclipnode_t *node = &hull->clipnodes[num];
+
+		children[0] = node->children[0];
+		children[1] = node->children[1];
+		return &hull->planes[node->planenum];
+	}
+}
+
+/*
+==================
+PM_HullContents
+
+PM_HullPointContents for the node returned by PM_HullNode
+==================
+*/
+static int PM_HullContents( const hull_t *hull, const mpackedhull_t *packed, int num, const vec3_t p )
+{
+	const mplane_t	*plane;
+	int		children[2];
+
+	while( num >= 0 )
+	{
+		plane = PM_HullNode( hull, packed, num, children );
+		num = children[PlaneDiff( p, plane ) < 0];
+	}
+	return num;
+}
+
 /*
 ==================
 PM_HullForBsp
@@ -211,13 +272,17 @@ hull_t *PM_HullForStudio( physent_t *pe, playermove_t *pmove, int *numhitboxes )
 
 /*
 ==================
-PM_RecursiveHullCheck
+PM_HullCheck
+
+PM_RecursiveHullCheck for the node returned by PM_HullNode
+when bad is set, broken hulls are reported through it instead of Host_Error
 ==================
 */
-qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
+static qboolean PM_HullCheck( hull_t *hull, const mpackedhull_t *packed, int num, float p1f, float p2f, float *p1, float *p2, pmtrace_t *trace, qboolean *bad )
 {
-	mclipnode_t	*node;
-	mplane_t		*plane;
+	const mplane_t	*plane;
+	int		children[2];
+	int		clipnode;
 	float		t1, t2;
 	float		frac, midf;
 	int		side;
@@ -245,25 +310,30 @@ qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec
 		return true;
 	}
 
-	if( num < hull->firstclipnode || num > hull->lastclipnode )
-		Host_Error( "PM_RecursiveHullCheck: bad node number %i\n", num );
+	clipnode = packed ? packed->nodes[num].clipnode : num;
+
+	if( clipnode < hull->firstclipnode || clipnode > hull->lastclipnode )
+	{
+		if( !bad ) Host_Error( "PM_RecursiveHullCheck: bad node number %i\n", clipnode );
+		*bad = true;
+		return false;
+	}
 
 	// find the point distances
-	node = hull->clipnodes + num;
-	plane = hull->planes + node->planenum;
+	plane = PM_HullNode( hull, packed, num, children );
 
 	t1 = PlaneDiff( p1, plane );
 	t2 = PlaneDiff( p2, plane );
 
 	if( t1 >= 0.0f && t2 >= 0.0f )
 	{
-		num = node->children[0];
+		num = children[0];
 		goto loc0;
 	}
 
 	if( t1 < 0.0f && t2 < 0.0f )
 	{
-		num = node->children[1];
+		num = children[1];
 		goto loc0;
 	}
 
@@ -280,14 +350,14 @@ qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec
 	VectorLerp( p1, frac, p2, mid );
 
 	// move up to the node
-	if( !PM_RecursiveHullCheck( hull, node->children[side], p1f, midf, p1, mid, trace ))
+	if( !PM_HullCheck( hull, packed, children[side], p1f, midf, p1, mid, trace, bad ))
 		return false;
 
 	// this recursion can not be optimized because mid would need to be duplicated on a stack
-	if( PM_HullPointContents( hull, node->children[side^1], mid ) != CONTENTS_SOLID )
+	if( PM_HullContents( hull, packed, children[side^1], mid ) != CONTENTS_SOLID )
 	{
 		// go past the node
-		return PM_RecursiveHullCheck( hull, node->children[side^1], midf, p2f, mid, p2, trace );
+		return PM_HullCheck( hull, packed, children[side^1], midf, p2f, mid, p2, trace, bad );
 	}
 
 	// never got out of the solid area
@@ -306,7 +376,7 @@ qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec
 		trace->plane.dist = -plane->dist;
 	}
 
-	while( PM_HullPointContents( hull, hull->firstclipnode, mid ) == CONTENTS_SOLID )
+	while( PM_HullContents( hull, packed, packed ? packed->remap[hull->firstclipnode] : hull->firstclipnode, mid ) == CONTENTS_SOLID )
 	{
 		// shouldn't really happen, but does occasionally
 		frac -= 0.1f;
@@ -315,7 +385,8 @@ qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec
 		{
 			trace->fraction = midf;
 			VectorCopy( mid, trace->endpos );
-			Con_Reportf( S_WARN "trace backed up past 0.0\n" );
+			if( bad ) *bad = true;
+			else Con_Reportf( S_WARN "trace backed up past 0.0\n" );
 			return false;
 		}
 
@@ -329,6 +400,36 @@ qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec
 	return false;
 }
 
+/*
+==================
+PM_RecursiveHullCheckExt
+
+same as PM_RecursiveHullCheck, but never errors or prints when bad is set:
+a broken hull or a trace that backed up sets *bad instead, so threads
+can hand the trace back to the main thread
+==================
+*/
+qboolean PM_RecursiveHullCheckExt( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace, qboolean *bad )
+{
+	const mpackedhull_t *packed = Mod_FindPackedHull( hull );
+
+	if( packed && num >= 0 && num < packed->numclipnodes )
+		return PM_HullCheck( hull, packed, packed->remap[num], p1f, p2f, p1, p2, trace, bad );
+
+	return PM_HullCheck( hull, NULL, num, p1f, p2f, p1, p2, trace, bad );
+}
+
+/*
+==================
+PM_RecursiveHullCheck
+
+==================
+*/
+qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
+{
+	return PM_RecursiveHullCheckExt( hull, num, p1f, p2f, p1, p2, trace, NULL );
+}
+
 pmtrace_t PM_PlayerTraceExt( playermove_t *pmove, vec3_t start, vec3_t end, int flags, int numents, physent_t *ents, int ignore_pe, pfnIgnore pmFilter )
 {
 	physent_t	*pe;
@@ -894,3 +995,364 @@ void PM_StuckTouch( playermove_t *pmove, int hitent, pmtrace_t *tr )
 
 	pmove->touchindex[pmove->numtouch++] = *tr;
 }
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+#define TEST_HULL_NODES	32767
+#define TEST_CHAIN_NODES	192
+#define TEST_TRACES		( 64 * 1024 )
+
+static mclipnode_t	test_clipnodes[TEST_HULL_NODES];
+static mplane_t	test_planes[TEST_HULL_NODES];
+static int	test_planeowner[TEST_HULL_NODES];
+static uint	test_seed;
+
+static float Test_RandomFloat( float min, float max )
+{
+	test_seed = test_seed * 1103515245 + 12345;
+	return min + ( max - min ) * (( test_seed >> 8 ) & 0xffff ) / 65535.0f;
+}
+
+// the recursive version that PM_RecursiveHullCheck was before, as a reference
+static qboolean Test_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
+{
+	mclipnode_t	*node;
+	mplane_t		*plane;
+	float		t1, t2;
+	float		frac, midf;
+	int		side;
+	vec3_t		mid;
+loc0:
+	if( num < 0 )
+	{
+		if( num != CONTENTS_SOLID )
+		{
+			trace->allsolid = false;
+			if( num == CONTENTS_EMPTY )
+				trace->inopen = true;
+			else trace->inwater = true;
+		}
+		else trace->startsolid = true;
+		return true;
+	}
+
+	if( hull->firstclipnode >= hull->lastclipnode )
+	{
+		trace->allsolid = false;
+		trace->inopen = true;
+		return true;
+	}
+
+	if( num < hull->firstclipnode || num > hull->lastclipnode )
+		Host_Error( "PM_RecursiveHullCheck: bad node number %i\n", num );
+
+	node = hull->clipnodes + num;
+	plane = hull->planes + node->planenum;
+
+	t1 = PlaneDiff( p1, plane );
+	t2 = PlaneDiff( p2, plane );
+
+	if( t1 >= 0.0f && t2 >= 0.0f )
+	{
+		num = node->children[0];
+		goto loc0;
+	}
+
+	if( t1 < 0.0f && t2 < 0.0f )
+	{
+		num = node->children[1];
+		goto loc0;
+	}
+
+	side = (t1 < 0.0f);
+
+	if( side ) frac = ( t1 + DIST_EPSILON ) / ( t1 - t2 );
+	else frac = ( t1 - DIST_EPSILON ) / ( t1 - t2 );
+
+	if( frac < 0.0f ) frac = 0.0f;
+	if( frac > 1.0f ) frac = 1.0f;
+
+	midf = p1f + ( p2f - p1f ) * frac;
+	VectorLerp( p1, frac, p2, mid );
+
+	if( !Test_RecursiveHullCheck( hull, node->children[side], p1f, midf, p1, mid, trace ))
+		return false;
+
+	if( PM_HullPointContents( hull, node->children[side^1], mid ) != CONTENTS_SOLID )
+		return Test_RecursiveHullCheck( hull, node->children[side^1], midf, p2f, mid, p2, trace );
+
+	if( trace->allsolid )
+		return false;
+
+	if( !side )
+	{
+		VectorCopy( plane->normal, trace->plane.normal );
+		trace->plane.dist = plane->dist;
+	}
+	else
+	{
+		VectorNegate( plane->normal, trace->plane.normal );
+		trace->plane.dist = -plane->dist;
+	}
+
+	while( PM_HullPointContents( hull, hull->firstclipnode, mid ) == CONTENTS_SOLID )
+	{
+		frac -= 0.1f;
+
+		if( frac < 0.0f )
+		{
+			trace->fraction = midf;
+			VectorCopy( mid, trace->endpos );
+			return false;
+		}
+
+		midf = p1f + ( p2f - p1f ) * frac;
+		VectorLerp( p1, frac, p2, mid );
+	}
+
+	trace->fraction = midf;
+	VectorCopy( mid, trace->endpos );
+
+	return false;
+}
+
+// kd-tree like hull, mostly axial planes splitting the parent's box
+static void Test_BuildHull( hull_t *hull, int numnodes )
+{
+	int	i, j;
+
+	for( i = 0; i < numnodes; i++ )
+	{
+		mplane_t *plane = &test_planes[i];
+
+		memset( plane, 0, sizeof( *plane ));
+
+		if( Test_RandomFloat( 0.0f, 1.0f ) < 0.75f )
+		{
+			plane->type = i % 3;
+			plane->normal[plane->type] = 1.0f;
+		}
+		else
+		{
+			plane->type = 3;
+			VectorSet( plane->normal, Test_RandomFloat( -1.0f, 1.0f ), Test_RandomFloat( -1.0f, 1.0f ), Test_RandomFloat( -1.0f, 1.0f ));
+			VectorNormalize( plane->normal );
+		}
+		plane->dist = Test_RandomFloat( -2048.0f, 2048.0f ) / sqrt( i + 1 );
+
+		test_clipnodes[i].planenum = i;
+
+		for( j = 0; j < 2; j++ )
+		{
+			int child = i * 2 + 1 + j;
+
+			if( child < numnodes )
+				test_clipnodes[i].children[j] = child;
+			else test_clipnodes[i].children[j] = Test_RandomFloat( 0.0f, 1.0f ) < 0.3f ? CONTENTS_SOLID : CONTENTS_EMPTY;
+		}
+	}
+
+	// planes of real maps are in no particular order
+	for( i = 0; i < numnodes; i++ )
+		test_planeowner[i] = i;
+
+	for( i = numnodes - 1; i > 0; i-- )
+	{
+		mplane_t	plane;
+		int	owner;
+
+		j = ( test_seed = test_seed * 1103515245 + 12345 ) % ( i + 1 );
+
+		plane = test_planes[i];
+		test_planes[i] = test_planes[j];
+		test_planes[j] = plane;
+
+		owner = test_planeowner[i];
+		test_planeowner[i] = test_planeowner[j];
+		test_planeowner[j] = owner;
+
+		test_clipnodes[test_planeowner[i]].planenum = i;
+		test_clipnodes[test_planeowner[j]].planenum = j;
+	}
+
+	hull->clipnodes = test_clipnodes;
+	hull->planes = test_planes;
+	hull->firstclipnode = 0;
+	hull->lastclipnode = numnodes - 1;
+}
+
+// long chain of parallel planes, for deep recursion
+static void Test_BuildChainHull( hull_t *hull )
+{
+	int	i;
+
+	for( i = 0; i < TEST_CHAIN_NODES; i++ )
+	{
+		memset( &test_planes[i], 0, sizeof( test_planes[i] ));
+		test_planes[i].normal[0] = 1.0f;
+		test_planes[i].dist = i * 4.0f - TEST_CHAIN_NODES * 2.0f;
+
+		test_clipnodes[i].planenum = i;
+		test_clipnodes[i].children[0] = ( i + 1 < TEST_CHAIN_NODES ) ? i + 1 : CONTENTS_SOLID;
+		test_clipnodes[i].children[1] = ( i & 1 ) ? CONTENTS_WATER : CONTENTS_EMPTY;
+	}
+
+	hull->clipnodes = test_clipnodes;
+	hull->planes = test_planes;
+	hull->firstclipnode = 0;
+	hull->lastclipnode = TEST_CHAIN_NODES - 1;
+}
+
+// coherent groups of segments, like pellets or hull corners
+static void Test_GenerateRays( vec3_t *start, vec3_t *end, int count )
+{
+	vec3_t	origin, dir;
+	int	i;
+
+	for( i = 0; i < count; i++ )
+	{
+		if( i % 4 == 0 )
+		{
+			VectorSet( origin, Test_RandomFloat( -2048.0f, 2048.0f ), Test_RandomFloat( -2048.0f, 2048.0f ), Test_RandomFloat( -512.0f, 512.0f ));
+			VectorSet( dir, Test_RandomFloat( -256.0f, 256.0f ), Test_RandomFloat( -256.0f, 256.0f ), Test_RandomFloat( -64.0f, 64.0f ));
+		}
+
+		VectorSet( start[i], origin[0] + Test_RandomFloat( -4.0f, 4.0f ), origin[1] + Test_RandomFloat( -4.0f, 4.0f ), origin[2] );
+		VectorAdd( start[i], dir, end[i] );
+	}
+}
+
+static double Test_TraceHull( hull_t *hull, vec3_t *start, vec3_t *end, pmtrace_t *traces, int count, int mode )
+{
+	double	time, best = 0.0;
+	int	i, pass;
+
+	// best of a few passes, the first one warms up the caches
+	for( pass = 0; pass < 4; pass++ )
+	{
+		for( i = 0; i < count; i++ )
+			PM_InitPMTrace( &traces[i], end[i] );
+
+		time = Sys_DoubleTime();
+
+		if( mode == 1 )
+		{
+			for( i = 0; i < count; i++ )
+				PM_RecursiveHullCheck( hull, hull->firstclipnode, 0.0f, 1.0f, start[i], end[i], &traces[i] );
+		}
+		else
+		{
+			for( i = 0; i < count; i++ )
+				Test_RecursiveHullCheck( hull, hull->firstclipnode, 0.0f, 1.0f, start[i], end[i], &traces[i] );
+		}
+
+		time = Sys_DoubleTime() - time;
+		if( pass == 0 || time < best )
+			best = time;
+	}
+
+	return best;
+}
+
+static int Test_CompareTraces( hull_t *hull, vec3_t *start, vec3_t *end, int count, const char *bench )
+{
+	pmtrace_t	*ref = Mem_Malloc( host.mempool, sizeof( pmtrace_t ) * count );
+	pmtrace_t	*single = Mem_Malloc( host.mempool, sizeof( pmtrace_t ) * count );
+	double	time[2];
+	int	i, mismatches = 0;
+
+	time[0] = Test_TraceHull( hull, start, end, ref, count, 0 );
+	time[1] = Test_TraceHull( hull, start, end, single, count, 1 );
+
+	if( bench )
+	{
+		Msg( "%s hull, %d traces: reference %.2f ms, engine %.2f ms\n", bench, count,
+			time[0] * 1000.0, time[1] * 1000.0 );
+	}
+
+	// results must be bit-identical
+	for( i = 0; i < count; i++ )
+	{
+		if( memcmp( &ref[i], &single[i], sizeof( pmtrace_t )))
+			mismatches++;
+	}
+
+	Mem_Free( ref );
+	Mem_Free( single );
+
+	return mismatches;
+}
+
+static void Test_RunHullTrace( void )
+{
+	vec3_t		*start = Mem_Malloc( host.mempool, sizeof( vec3_t ) * TEST_TRACES );
+	vec3_t		*end = Mem_Malloc( host.mempool, sizeof( vec3_t ) * TEST_TRACES );
+	poolhandle_t	pool = Mem_AllocPool( "pmtrace test" );
+	model_t		*mod;
+	hull_t		*hull;
+
+	test_seed = 0x1234;
+
+	// packed hulls are only looked up for the models list, the slot is
+	// set up like a brush submodel so its hulls live in a foreign pool
+	mod = Mod_FindName( "*pmtrace_test", false );
+	mod->type = mod_brush;
+	hull = &mod->hulls[0];
+
+	memset( hull, 0, sizeof( *hull ));
+	Test_BuildHull( hull, TEST_HULL_NODES );
+	Test_GenerateRays( start, end, TEST_TRACES );
+	TASSERT( Mod_FindPackedHull( hull ) == NULL );
+	TASSERT_EQi( Test_CompareTraces( hull, start, end, TEST_TRACES, "unpacked" ), 0 );
+
+	// short runs and a single ray
+	TASSERT_EQi( Test_CompareTraces( hull, start, end, 7, NULL ), 0 );
+	TASSERT_EQi( Test_CompareTraces( hull, start, end, 1, NULL ), 0 );
+
+	// the reference still walks the original clipnodes
+	Mod_SetPackedHull( mod, 0, Mod_PackHull( hull, TEST_HULL_NODES, TEST_HULL_NODES, pool ));
+	TASSERT( Mod_FindPackedHull( hull ) != NULL );
+	TASSERT( Mod_FindPackedHull( &mod->hulls[1] ) == NULL );
+	TASSERT_EQi( Test_CompareTraces( hull, start, end, TEST_TRACES, "packed" ), 0 );
+	TASSERT_EQi( Test_CompareTraces( hull, start, end, 7, NULL ), 0 );
+
+	// a copy of the hull isn't in the models list
+	{
+		hull_t copy = *hull;
+		TASSERT( Mod_FindPackedHull( &copy ) == NULL );
+	}
+
+	Mod_DropPackedHulls( pool );
+	TASSERT( Mod_FindPackedHull( hull ) == NULL );
+
+	// deep recursion
+	Test_BuildChainHull( hull );
+	VectorSet( start[0], -TEST_CHAIN_NODES * 4.0f, 0.0f, 0.0f );
+	VectorSet( end[0], TEST_CHAIN_NODES * 4.0f, 0.0f, 0.0f );
+	VectorSet( start[1], TEST_CHAIN_NODES * 4.0f, 1.0f, 0.0f );
+	VectorSet( end[1], -TEST_CHAIN_NODES * 4.0f, 1.0f, 0.0f );
+	TASSERT_EQi( Test_CompareTraces( hull, start, end, 2, NULL ), 0 );
+	Mod_SetPackedHull( mod, 0, Mod_PackHull( hull, TEST_CHAIN_NODES, TEST_CHAIN_NODES, pool ));
+	TASSERT( Mod_FindPackedHull( hull ) != NULL );
+	TASSERT_EQi( Test_CompareTraces( hull, start, end, 2, NULL ), 0 );
+
+	// release the slot, the next lookup must get the same one back
+	Mod_DropPackedHulls( pool );
+	Mod_FreeModel( mod );
+	Mem_FreePool( &pool );
+	TASSERT( !COM_CheckStringEmpty( mod->name ));
+	TASSERT( Mod_FindPackedHull( hull ) == NULL );
+	TASSERT( Mod_FindName( "*pmtrace_test", false ) == mod );
+	mod->type = mod_brush;
+	Mod_FreeModel( mod );
+
+	Mem_Free( start );
+	Mem_Free( end );
+}
+
+void Test_RunPMTrace( void )
+{
+	TRUN( Test_RunHullTrace() );
+}
+#endif /* XASH_ENGINE_TESTS */
@@ -93,15 +93,15 @@ wavdata_t *FS_LoadSound( const char *filename, const byte *buffer, size_t size )
 			Q_snprintf( path, sizeof( path ),
 				format->formatstring, loadname, "", format->ext );
 
-			f = FS_LoadFile( path, &filesize, false );
-			if( f && filesize > 0 )
+			f = FS_MapFile( path, &filesize, false );
+			if( f )
 			{
-				if( format->loadfunc( path, f, filesize ))
+				if( filesize > 0 && format->loadfunc( path, f, filesize ))
 				{
-					Mem_Free(f); // release buffer
+					FS_UnmapFile( f ); // release buffer
 					return SoundPack(); // loaded
 				}
-				else Mem_Free(f); // release buffer
+				else FS_UnmapFile( f ); // release buffer
 			}
 		}
 	}
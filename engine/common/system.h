@@ -72,6 +72,36 @@ void Sys_Quit( void ) NORETURN;
 qboolean Sys_NewInstance( const char *gamedir );
 void *Sys_GetNativeObject( const char *obj );
 
+//
+// workers.c
+//
+#if XASH_POSIX && !XASH_PSVITA && !XASH_NSWITCH && !XASH_EMSCRIPTEN && !XASH_DOS4GW && !defined XASH_NO_ASYNC_NS_RESOLVE
+#define XASH_WORKER_THREADS 1
+#else
+#define XASH_WORKER_THREADS 0
+#endif
+
+typedef void (*pfnWorkerJob)( void *data, int index );
+int Sys_NumWorkerThreads( void );
+void Sys_RunParallel( pfnWorkerJob func, void *data, int count );
+void Sys_ShutdownWorkers( void );
+void Sys_EnterSerial( void );
+void Sys_LeaveSerial( void );
+
+typedef void (*pfnBackgroundJob)( void *data );
+
+typedef struct sys_job_s
+{
+	struct sys_job_s	*next;
+	pfnBackgroundJob	func;
+	void		*data;
+	int		state;	// owned by workers.c
+} sys_job_t;
+
+void Sys_QueueJob( sys_job_t *job, pfnBackgroundJob func, void *data );
+qboolean Sys_JobFinished( sys_job_t *job );
+void Sys_WaitForJob( sys_job_t *job );
+
 //
 // sys_con.c
 //
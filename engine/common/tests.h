@@ -38,19 +38,33 @@ void Test_RunCvar( void );
 void Test_RunCon( void );
 void Test_RunVOX( void );
 void Test_RunIPFilter( void );
+void Test_RunZone( void );
+void Test_RunPMTrace( void );
+void Test_RunWorkers( void );
+void Test_RunDelta( void );
+void Test_RunMsgBits( void );
+void Test_RunNet( void );
+void Test_RunNetchan( void );
 
 #define TEST_LIST_0 \
 	Test_RunLibCommon(); \
 	Test_RunCommon(); \
 	Test_RunCmd(); \
 	Test_RunCvar(); \
+	Test_RunMsgBits(); \
 	Test_RunIPFilter();
 
 #define TEST_LIST_0_CLIENT \
 	Test_RunCon();
 
 #define TEST_LIST_1 \
-	Test_RunImagelib();
+	Test_RunImagelib(); \
+	Test_RunZone(); \
+	Test_RunPMTrace(); \
+	Test_RunWorkers(); \
+	Test_RunDelta(); \
+	Test_RunNet(); \
+	Test_RunNetchan();
 
 #define TEST_LIST_1_CLIENT \
 	Test_RunVOX();
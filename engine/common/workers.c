@@ -0,0 +1,652 @@
+/*
+workers.c - worker threads for parallel engine jobs
+Copyright (C) 2023 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "xash3d_mathlib.h"
+
+#if XASH_WORKER_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/*
+=============================================================================
+
+Sys_RunParallel calls a job for every index in range on worker threads
+and the calling thread, and returns when all of them have finished.
+Indices are handed out in small chunks, so the order in which they run
+is undefined. Jobs must not call back into the engine, except functions
+that are documented as thread safe. Code that can't run concurrently,
+like game DLL callbacks, goes between Sys_EnterSerial and Sys_LeaveSerial.
+
+Builds without threads run everything on the calling thread.
+
+=============================================================================
+*/
+
+#define WORKER_MAX_THREADS	8
+
+#if XASH_WORKER_THREADS
+static struct
+{
+	pthread_mutex_t	lock;
+	pthread_cond_t	queued;	// wakes up workers
+	pthread_cond_t	done;	// wakes up the caller
+	pthread_mutex_t	serial;	// see Sys_EnterSerial
+	pthread_t	threads[WORKER_MAX_THREADS];
+	int		numthreads;	// -1 if threads can't be created
+	qboolean	shutdown;
+	qboolean	running;	// changed only when workers are idle
+
+	// current batch, under the lock
+	pfnWorkerJob	func;
+	void		*data;
+	int		count;
+	int		next;
+	int		chunk;
+	int		numrunning;
+} sys_workers;
+
+/*
+============
+Sys_TakeJobs
+
+lock must be held, returns number of indices to run starting from *first
+============
+*/
+static int Sys_TakeJobs( pfnWorkerJob *func, void **data, int *first )
+{
+	int num;
+
+	if( sys_workers.next >= sys_workers.count )
+		return 0;
+
+	num = Q_min( sys_workers.chunk, sys_workers.count - sys_workers.next );
+	*func = sys_workers.func;
+	*data = sys_workers.data;
+	*first = sys_workers.next;
+	sys_workers.next += num;
+	sys_workers.numrunning++;
+
+	return num;
+}
+
+/*
+============
+Sys_FinishJobs
+
+lock must be held
+============
+*/
+static void Sys_FinishJobs( void )
+{
+	sys_workers.numrunning--;
+
+	if( sys_workers.next >= sys_workers.count && !sys_workers.numrunning )
+		pthread_cond_broadcast( &sys_workers.done );
+}
+
+/*
+============
+Sys_WorkerThread
+
+============
+*/
+static void *Sys_WorkerThread( void *arg )
+{
+	pthread_mutex_lock( &sys_workers.lock );
+
+	while( true )
+	{
+		pfnWorkerJob func;
+		void *data;
+		int i, first, num;
+
+		while( !sys_workers.shutdown && sys_workers.next >= sys_workers.count )
+			pthread_cond_wait( &sys_workers.queued, &sys_workers.lock );
+
+		if( sys_workers.shutdown )
+			break;
+
+		num = Sys_TakeJobs( &func, &data, &first );
+		pthread_mutex_unlock( &sys_workers.lock );
+
+		for( i = first; i < first + num; i++ )
+			func( data, i );
+
+		pthread_mutex_lock( &sys_workers.lock );
+		Sys_FinishJobs();
+	}
+
+	pthread_mutex_unlock( &sys_workers.lock );
+	return NULL;
+}
+
+/*
+============
+Sys_StartWorkers
+
+============
+*/
+static qboolean Sys_StartWorkers( void )
+{
+	int i, numthreads;
+
+	if( sys_workers.numthreads )
+		return sys_workers.numthreads > 0;
+
+	// calling thread runs jobs too
+	numthreads = bound( 0, (int)sysconf( _SC_NPROCESSORS_ONLN ) - 1, WORKER_MAX_THREADS );
+
+	if( !numthreads )
+	{
+		sys_workers.numthreads = -1;
+		return false;
+	}
+
+	pthread_mutex_init( &sys_workers.lock, NULL );
+	pthread_mutex_init( &sys_workers.serial, NULL );
+	pthread_cond_init( &sys_workers.queued, NULL );
+	pthread_cond_init( &sys_workers.done, NULL );
+	sys_workers.shutdown = false;
+
+	for( i = 0; i < numthreads; i++ )
+	{
+		if( pthread_create( &sys_workers.threads[sys_workers.numthreads], NULL, Sys_WorkerThread, NULL ))
+			break;
+
+		sys_workers.numthreads++;
+	}
+
+	if( !sys_workers.numthreads )
+	{
+		Con_Printf( S_WARN "%s: can't create worker threads\n", __func__ );
+		pthread_cond_destroy( &sys_workers.done );
+		pthread_cond_destroy( &sys_workers.queued );
+		pthread_mutex_destroy( &sys_workers.serial );
+		pthread_mutex_destroy( &sys_workers.lock );
+		sys_workers.numthreads = -1; // don't try again
+		return false;
+	}
+
+	Con_Reportf( "%s: %i worker threads\n", __func__, sys_workers.numthreads );
+	return true;
+}
+#endif // XASH_WORKER_THREADS
+
+/*
+============
+Sys_NumWorkerThreads
+
+how many threads run jobs, including the calling one
+============
+*/
+int Sys_NumWorkerThreads( void )
+{
+#if XASH_WORKER_THREADS
+	if( Sys_StartWorkers( ))
+		return sys_workers.numthreads + 1;
+#endif
+	return 1;
+}
+
+/*
+============
+Sys_RunParallel
+
+not reentrant, must be called from the main thread
+============
+*/
+void Sys_RunParallel( pfnWorkerJob func, void *data, int count )
+{
+	int i;
+
+#if XASH_WORKER_THREADS
+	if( count > 1 && Sys_StartWorkers( ))
+	{
+		int first, num;
+
+		sys_workers.running = true;
+		pthread_mutex_lock( &sys_workers.lock );
+
+		sys_workers.func = func;
+		sys_workers.data = data;
+		sys_workers.count = count;
+		sys_workers.next = 0;
+
+		// few chunks per thread keep them busy when jobs take uneven time
+		sys_workers.chunk = Q_max( 1, count / (( sys_workers.numthreads + 1 ) * 4 ));
+
+		pthread_cond_broadcast( &sys_workers.queued );
+
+		while(( num = Sys_TakeJobs( &func, &data, &first )) != 0 )
+		{
+			pthread_mutex_unlock( &sys_workers.lock );
+
+			for( i = first; i < first + num; i++ )
+				func( data, i );
+
+			pthread_mutex_lock( &sys_workers.lock );
+			Sys_FinishJobs();
+		}
+
+		while( sys_workers.numrunning )
+			pthread_cond_wait( &sys_workers.done, &sys_workers.lock );
+
+		sys_workers.count = 0;
+		pthread_mutex_unlock( &sys_workers.lock );
+		sys_workers.running = false;
+		return;
+	}
+#endif
+
+	for( i = 0; i < count; i++ )
+		func( data, i );
+}
+
+/*
+=============================================================================
+
+Sys_QueueJob runs jobs one by one on a background thread, in the order
+they were queued, while the main thread keeps going. Job structs are
+owned by the caller and must stay alive until the job is finished.
+Same rules as above apply: jobs must not touch engine state, including
+memory pools and the filesystem.
+
+Jobs that haven't started when workers are shut down are marked as
+finished without running. Builds without threads run jobs right away.
+
+=============================================================================
+*/
+
+#define JOB_QUEUED		0
+#define JOB_RUNNING		1
+#define JOB_FINISHED	2
+
+#if XASH_WORKER_THREADS
+static struct
+{
+	pthread_mutex_t	lock;
+	pthread_cond_t	queued;	// wakes up the thread
+	pthread_cond_t	finished;	// wakes up waiters
+	pthread_t	thread;
+	int		started;	// -1 if thread can't be created
+	qboolean	shutdown;
+	sys_job_t	*head;
+	sys_job_t	*tail;
+} sys_jobs;
+
+/*
+============
+Sys_JobThread
+
+============
+*/
+static void *Sys_JobThread( void *arg )
+{
+	pthread_mutex_lock( &sys_jobs.lock );
+
+	while( true )
+	{
+		sys_job_t *job;
+
+		while( !sys_jobs.shutdown && !sys_jobs.head )
+			pthread_cond_wait( &sys_jobs.queued, &sys_jobs.lock );
+
+		if( sys_jobs.shutdown )
+			break;
+
+		job = sys_jobs.head;
+		sys_jobs.head = job->next;
+		if( !sys_jobs.head )
+			sys_jobs.tail = NULL;
+
+		job->state = JOB_RUNNING;
+		pthread_mutex_unlock( &sys_jobs.lock );
+
+		job->func( job->data );
+
+		pthread_mutex_lock( &sys_jobs.lock );
+		job->state = JOB_FINISHED;
+		pthread_cond_broadcast( &sys_jobs.finished );
+	}
+
+	pthread_mutex_unlock( &sys_jobs.lock );
+	return NULL;
+}
+
+/*
+============
+Sys_StartJobThread
+
+============
+*/
+static qboolean Sys_StartJobThread( void )
+{
+	if( sys_jobs.started )
+		return sys_jobs.started > 0;
+
+	pthread_mutex_init( &sys_jobs.lock, NULL );
+	pthread_cond_init( &sys_jobs.queued, NULL );
+	pthread_cond_init( &sys_jobs.finished, NULL );
+	sys_jobs.shutdown = false;
+	sys_jobs.head = sys_jobs.tail = NULL;
+
+	if( pthread_create( &sys_jobs.thread, NULL, Sys_JobThread, NULL ))
+	{
+		Con_Printf( S_WARN "%s: can't create background thread\n", __func__ );
+		pthread_cond_destroy( &sys_jobs.finished );
+		pthread_cond_destroy( &sys_jobs.queued );
+		pthread_mutex_destroy( &sys_jobs.lock );
+		sys_jobs.started = -1; // don't try again
+		return false;
+	}
+
+	sys_jobs.started = 1;
+	return true;
+}
+
+/*
+============
+Sys_ShutdownJobThread
+
+lets the running job finish, drops the rest
+============
+*/
+static void Sys_ShutdownJobThread( void )
+{
+	sys_job_t *job;
+
+	if( sys_jobs.started <= 0 )
+	{
+		sys_jobs.started = 0;
+		return;
+	}
+
+	pthread_mutex_lock( &sys_jobs.lock );
+	sys_jobs.shutdown = true;
+	pthread_cond_broadcast( &sys_jobs.queued );
+	pthread_mutex_unlock( &sys_jobs.lock );
+
+	pthread_join( sys_jobs.thread, NULL );
+
+	for( job = sys_jobs.head; job; job = job->next )
+		job->state = JOB_FINISHED;
+	sys_jobs.head = sys_jobs.tail = NULL;
+
+	pthread_cond_destroy( &sys_jobs.finished );
+	pthread_cond_destroy( &sys_jobs.queued );
+	pthread_mutex_destroy( &sys_jobs.lock );
+	sys_jobs.started = 0;
+}
+#endif // XASH_WORKER_THREADS
+
+/*
+============
+Sys_QueueJob
+
+must be called from the main thread
+============
+*/
+void Sys_QueueJob( sys_job_t *job, pfnBackgroundJob func, void *data )
+{
+	job->next = NULL;
+	job->func = func;
+	job->data = data;
+	job->state = JOB_QUEUED;
+
+#if XASH_WORKER_THREADS
+	if( Sys_StartJobThread( ))
+	{
+		pthread_mutex_lock( &sys_jobs.lock );
+
+		if( sys_jobs.tail )
+			sys_jobs.tail->next = job;
+		else sys_jobs.head = job;
+		sys_jobs.tail = job;
+
+		pthread_cond_signal( &sys_jobs.queued );
+		pthread_mutex_unlock( &sys_jobs.lock );
+		return;
+	}
+#endif
+
+	func( data );
+	job->state = JOB_FINISHED;
+}
+
+/*
+============
+Sys_JobFinished
+
+============
+*/
+qboolean Sys_JobFinished( sys_job_t *job )
+{
+#if XASH_WORKER_THREADS
+	if( sys_jobs.started > 0 )
+	{
+		qboolean finished;
+
+		pthread_mutex_lock( &sys_jobs.lock );
+		finished = job->state == JOB_FINISHED;
+		pthread_mutex_unlock( &sys_jobs.lock );
+
+		return finished;
+	}
+#endif
+	return job->state == JOB_FINISHED;
+}
+
+/*
+============
+Sys_WaitForJob
+
+blocks until the job and everything queued before it has finished
+============
+*/
+void Sys_WaitForJob( sys_job_t *job )
+{
+#if XASH_WORKER_THREADS
+	if( sys_jobs.started > 0 )
+	{
+		pthread_mutex_lock( &sys_jobs.lock );
+
+		while( job->state != JOB_FINISHED )
+			pthread_cond_wait( &sys_jobs.finished, &sys_jobs.lock );
+
+		pthread_mutex_unlock( &sys_jobs.lock );
+	}
+#endif
+}
+
+/*
+============
+Sys_ShutdownWorkers
+
+============
+*/
+void Sys_ShutdownWorkers( void )
+{
+#if XASH_WORKER_THREADS
+	int i;
+
+	Sys_ShutdownJobThread();
+
+	if( sys_workers.numthreads <= 0 )
+	{
+		sys_workers.numthreads = 0;
+		return;
+	}
+
+	pthread_mutex_lock( &sys_workers.lock );
+	sys_workers.shutdown = true;
+	pthread_cond_broadcast( &sys_workers.queued );
+	pthread_mutex_unlock( &sys_workers.lock );
+
+	for( i = 0; i < sys_workers.numthreads; i++ )
+		pthread_join( sys_workers.threads[i], NULL );
+
+	pthread_cond_destroy( &sys_workers.done );
+	pthread_cond_destroy( &sys_workers.queued );
+	pthread_mutex_destroy( &sys_workers.serial );
+	pthread_mutex_destroy( &sys_workers.lock );
+	sys_workers.numthreads = 0;
+#endif
+}
+
+/*
+============
+Sys_EnterSerial
+
+makes jobs take turns, does nothing outside of Sys_RunParallel
+============
+*/
+void Sys_EnterSerial( void )
+{
+#if XASH_WORKER_THREADS
+	if( sys_workers.running )
+		pthread_mutex_lock( &sys_workers.serial );
+#endif
+}
+
+/*
+============
+Sys_LeaveSerial
+
+============
+*/
+void Sys_LeaveSerial( void )
+{
+#if XASH_WORKER_THREADS
+	if( sys_workers.running )
+		pthread_mutex_unlock( &sys_workers.serial );
+#endif
+}
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+static void Test_CountJob( void *data, int index )
+{
+	int *counts = data;
+
+	counts[index]++;
+}
+
+#define TEST_NUM_JOBS	10007
+
+static void Test_RunParallel( void )
+{
+	static int counts[TEST_NUM_JOBS];
+	int i, count, wrong = 0;
+
+	for( count = 0; count <= TEST_NUM_JOBS; count += TEST_NUM_JOBS / 3 )
+	{
+		memset( counts, 0, sizeof( counts ));
+		Sys_RunParallel( Test_CountJob, counts, count );
+
+		for( i = 0; i < TEST_NUM_JOBS; i++ )
+		{
+			if( counts[i] != ( i < count ? 1 : 0 ))
+				wrong++;
+		}
+	}
+
+	TASSERT_EQi( wrong, 0 );
+
+	// every batch must be finished before next one starts
+	for( i = 0; i < 1000; i++ )
+	{
+		counts[0] = counts[1] = counts[2] = 0;
+		Sys_RunParallel( Test_CountJob, counts, 3 );
+
+		if( counts[0] != 1 || counts[1] != 1 || counts[2] != 1 )
+			wrong++;
+	}
+
+	TASSERT_EQi( wrong, 0 );
+	TASSERT( Sys_NumWorkerThreads() >= 1 );
+}
+
+static void Test_SerialJob( void *data, int index )
+{
+	int *counter = data;
+	int value;
+
+	// unprotected read-modify-write would lose increments
+	Sys_EnterSerial();
+	value = *counter;
+	*(volatile int *)counter = value + 1;
+	Sys_LeaveSerial();
+}
+
+static void Test_RunSerial( void )
+{
+	int counter = 0;
+
+	Sys_RunParallel( Test_SerialJob, &counter, 100000 );
+	TASSERT_EQi( counter, 100000 );
+}
+
+typedef struct
+{
+	sys_job_t	job;
+	int		*counter;
+	int		order;
+} test_bgjob_t;
+
+static void Test_BackgroundJob( void *data )
+{
+	test_bgjob_t *t = data;
+
+	// only background thread touches the counter
+	t->order = ( *t->counter )++;
+}
+
+#define TEST_NUM_BGJOBS	64
+
+static void Test_RunBackground( void )
+{
+	test_bgjob_t jobs[TEST_NUM_BGJOBS];
+	int i, counter = 0, wrong = 0;
+
+	for( i = 0; i < TEST_NUM_BGJOBS; i++ )
+	{
+		jobs[i].counter = &counter;
+		jobs[i].order = -1;
+		Sys_QueueJob( &jobs[i].job, Test_BackgroundJob, &jobs[i] );
+	}
+
+	Sys_WaitForJob( &jobs[TEST_NUM_BGJOBS - 1].job );
+
+	// jobs run in order, so everything before the last one is done too
+	for( i = 0; i < TEST_NUM_BGJOBS; i++ )
+	{
+		if( !Sys_JobFinished( &jobs[i].job ) || jobs[i].order != i )
+			wrong++;
+	}
+
+	TASSERT_EQi( wrong, 0 );
+	TASSERT_EQi( counter, TEST_NUM_BGJOBS );
+}
+
+void Test_RunWorkers( void )
+{
+	TRUN( Test_RunParallel( ));
+	TRUN( Test_RunSerial( ));
+	TRUN( Test_RunBackground( ));
+}
+#endif // XASH_ENGINE_TESTS
@@ -33,6 +33,12 @@ ENTITY AREA CHECKING
 #define AREA_NODES			32
 #define AREA_DEPTH			4
 
+// adaptive tree, see sv_adaptive_areanodes
+#define AREA_MAX_DEPTH		10
+#define AREA_MAX_NODES		( 2 << AREA_MAX_DEPTH )
+#define AREA_MIN_SIZE		256.0f	// don't split nodes that are smaller on every axis
+#define AREA_LEAF_EDICTS		4	// expected edicts per leaf
+
 #include "lightstyle.h"
 
 extern const char		*et_name[];
@@ -21,6 +21,15 @@ GNU General Public License for more details.
 #define MEMHEADER_SENTINEL1	0xDEADF00DU
 #define MEMHEADER_SENTINEL2	0xDFU
 
+#define MEMSLAB_SIZE		( 32 * 1024 )	// every slab is carved into blocks of a single size class
+#define MEMSLAB_MIN_CLASS	4		// smallest size class is 16 bytes
+#define MEMSLAB_NUM_CLASSES	8		// largest size class is 2048 bytes
+#define MEMSLAB_MAX_SIZE	( 1U << ( MEMSLAB_MIN_CLASS + MEMSLAB_NUM_CLASSES - 1 ))
+
+#define MEMARENA_CHUNK_SIZE	( 256 * 1024 )	// allocations bigger than a quarter of it get their own chunk
+
+#define MEMPROFILE_MAX_SITES	8192		// must be power of two
+
 #ifdef XASH_CUSTOM_SWAP
 #include "platform/swap/swap.h"
 #define Q_malloc SWAP_Malloc
@@ -46,6 +55,24 @@ typedef struct memheader_s
 	// immediately followed by data, which is followed by a MEMHEADER_SENTINEL2 byte
 } memheader_t;
 
+typedef struct memslab_s
+{
+	struct memslab_s	*next;		// next slab belonging to pool
+	size_t		pad;		// keep blocks 16 bytes aligned
+
+	// immediately followed by blocks of the same size class
+} memslab_t;
+
+typedef struct memchunk_s
+{
+	struct memchunk_s	*next;		// next chunk belonging to pool, first one is used for bump allocations
+	size_t		size;		// size of the memory after the chunk header
+	size_t		used;		// bytes already handed out
+	size_t		pad;		// keep blocks 16 bytes aligned on ILP32
+
+	// immediately followed by blocks
+} memchunk_t;
+
 typedef struct mempool_s
 {
 	uint32_t		sentinel1;	// should always be MEMHEADER_SENTINEL1
@@ -53,9 +80,18 @@ typedef struct mempool_s
 	size_t		totalsize;	// total memory allocated in this pool (inside memheaders)
 	size_t		realsize;		// total memory allocated in this pool (actual malloc total)
 	size_t		lastchecksize;	// updated each time the pool is displayed by memlist
+	size_t		numblocks;	// live allocations in this pool
+	size_t		numallocs;	// total allocations made in this pool
+	size_t		numfrees;		// total frees made in this pool
+	size_t		lastallocs;	// numallocs at the moment of last profile snapshot
+	size_t		lastfrees;	// numfrees at the moment of last profile snapshot
 	struct mempool_s	*next;		// linked into global mempool list
 	const char	*filename;	// file name and line where Mem_AllocPool was called
 	int		fileline;
+	uint		flags;		// POOL_* flags
+	struct memslab_s	*slabs;		// slabs owned by this pool, if POOL_SLAB is set
+	struct memheader_s	*freeblocks[MEMSLAB_NUM_CLASSES]; // free slab blocks, linked through next
+	struct memchunk_s	*chunks;		// chunks owned by this pool, if POOL_ARENA is set
 #if XASH_64BIT
 	poolhandle_t idx;
 #endif
@@ -64,23 +100,140 @@ typedef struct mempool_s
 } mempool_t;
 
 static mempool_t *poolchain = NULL; // critical stuff
+static qboolean mem_forceslab = false; // -memslab puts every pool into slab mode
+
+typedef struct memsite_s
+{
+	const char	*filename;	// pointer passed to Mem_Alloc, used for lookups, NULL if record is free
+	int		fileline;
+	char		name[64];		// copy of the filename, pointer may become invalid after library unload
+	size_t		livesize;		// bytes currently allocated from this call site
+	size_t		livecount;	// blocks currently allocated from this call site
+	size_t		numallocs;
+	size_t		numfrees;
+	size_t		lastallocs;	// numallocs at the moment of last snapshot
+	size_t		lastfrees;	// numfrees at the moment of last snapshot
+} memsite_t;
+
+static struct
+{
+	qboolean	active;
+	memsite_t	*sites;		// open addressing hash table, keyed by filename pointer and line
+	int	numsites;
+	size_t	dropped;		// allocations not accounted because table is full
+	double	starttime;
+	double	lasttime;		// time of the last snapshot, for churn rates
+} mem_profile;
 
 #if XASH_64BIT
 // a1ba: due to mempool being passed with the model through reused 32-bit field
 // which makes engine incompatible with 64-bit pointers I changed mempool type
 // from pointer to 32-bit handle, thankfully mempool structure is private
-// But! Mempools are handled through linked list so we can't index them safely
-static poolhandle_t lastidx = 0;
+//
+// Handle is a slot index in the pool table plus generation counter in the upper
+// bits, so lookup is constant time and stale or double freed handles are caught
+#define POOLHANDLE_INDEX_BITS 16
+#define POOLHANDLE_INDEX_MASK (( 1U << POOLHANDLE_INDEX_BITS ) - 1 )
+#define POOLHANDLE_MAX_SLOTS  ( POOLHANDLE_INDEX_MASK - 1 ) // zero index is never used
+#define POOLHANDLE_GEN_MASK   ( 0xFFFFFFFFU >> POOLHANDLE_INDEX_BITS )
+
+typedef struct poolslot_s
+{
+	mempool_t *pool;      // NULL if slot is free
+	uint32_t  generation; // bumped every time slot is released, never zero
+	uint32_t  nextfree;   // next free slot index + 1, valid when pool is NULL
+} poolslot_t;
 
-static mempool_t *Mem_FindPool( poolhandle_t poolptr )
+static poolslot_t *poolslots = NULL;
+static uint32_t   numpoolslots = 0;
+static uint32_t   maxpoolslots = 0;
+static uint32_t   firstfreeslot = 0; // slot index + 1, zero when free list is empty
+
+static poolhandle_t Mem_AllocPoolHandle( mempool_t *pool, const char *filename, int fileline )
 {
-	mempool_t *pool;
+	poolslot_t *slot;
+	uint32_t index;
 
-	for( pool = poolchain; pool; pool = pool->next )
+	if( firstfreeslot )
 	{
-		if( pool->idx == poolptr )
-			return pool;
+		index = firstfreeslot - 1;
+		slot = &poolslots[index];
+		firstfreeslot = slot->nextfree;
 	}
+	else
+	{
+		if( numpoolslots >= POOLHANDLE_MAX_SLOTS )
+			Sys_Error( "Mem_AllocPool: too many pools (allocpool at %s:%i)\n", filename, fileline );
+
+		if( numpoolslots >= maxpoolslots )
+		{
+			uint32_t newmax = maxpoolslots ? maxpoolslots * 2 : 256;
+			poolslot_t *newslots;
+
+			if( newmax > POOLHANDLE_MAX_SLOTS )
+				newmax = POOLHANDLE_MAX_SLOTS;
+
+			newslots = (poolslot_t *)Q_malloc( sizeof( poolslot_t ) * newmax );
+			if( newslots == NULL )
+				Sys_Error( "Mem_AllocPool: out of memory (allocpool at %s:%i)\n", filename, fileline );
+
+			if( poolslots )
+			{
+				memcpy( newslots, poolslots, sizeof( poolslot_t ) * numpoolslots );
+				Q_free( poolslots );
+			}
+
+			poolslots = newslots;
+			maxpoolslots = newmax;
+		}
+
+		index = numpoolslots++;
+		slot = &poolslots[index];
+		slot->generation = 1;
+	}
+
+	slot->pool = pool;
+	slot->nextfree = 0;
+
+	return ( slot->generation << POOLHANDLE_INDEX_BITS ) | ( index + 1 );
+}
+
+static poolslot_t *Mem_GetPoolSlot( poolhandle_t poolptr )
+{
+	uint32_t index = ( poolptr & POOLHANDLE_INDEX_MASK ) - 1;
+	poolslot_t *slot;
+
+	if( index >= numpoolslots )
+		return NULL;
+
+	slot = &poolslots[index];
+	if( !slot->pool || slot->generation != ( poolptr >> POOLHANDLE_INDEX_BITS ))
+		return NULL;
+
+	return slot;
+}
+
+static void Mem_FreePoolHandle( poolhandle_t poolptr )
+{
+	poolslot_t *slot = Mem_GetPoolSlot( poolptr );
+
+	if( !slot )
+		return;
+
+	slot->pool = NULL;
+	slot->generation = ( slot->generation + 1 ) & POOLHANDLE_GEN_MASK;
+	if( !slot->generation )
+		slot->generation = 1;
+	slot->nextfree = firstfreeslot;
+	firstfreeslot = ( slot - poolslots ) + 1;
+}
+
+static mempool_t *Mem_FindPool( poolhandle_t poolptr )
+{
+	poolslot_t *slot = Mem_GetPoolSlot( poolptr );
+
+	if( slot )
+		return slot->pool;
 
 	Sys_Error( "%s: not allocated or double freed pool %d", __FUNCTION__, poolptr );
 
@@ -93,6 +246,235 @@ static mempool_t *Mem_FindPool( poolhandle_t poolptr )
 }
 #endif
 
+static const char *Mem_CheckFilename( const char *filename )
+{
+	static const char	*dummy = "<corrupted>\0";
+	const char	*out = filename;
+	int		i;
+
+	if( !COM_CheckString( out ))
+		return dummy;
+
+	for( i = 0; i < MAX_OSPATH; i++, out++ )
+	{
+		if( *out == '\0' )
+			return filename; // valid name
+	}
+
+	return dummy;
+}
+
+static int Mem_SlabClass( size_t size )
+{
+	int i;
+
+	for( i = 0; i < MEMSLAB_NUM_CLASSES - 1; i++ )
+	{
+		if( size <= ( 1U << ( MEMSLAB_MIN_CLASS + i )))
+			break;
+	}
+
+	return i;
+}
+
+static size_t Mem_SlabBlockSize( int sizeclass )
+{
+	// header, data and sentinel2, rounded up to keep the data aligned
+	size_t size = sizeof( memheader_t ) + ( 1U << ( MEMSLAB_MIN_CLASS + sizeclass )) + 1;
+	return ( size + 15 ) & ~15;
+}
+
+static memheader_t *Mem_AllocSlabBlock( mempool_t *pool, size_t size, const char *filename, int fileline )
+{
+	int sizeclass = Mem_SlabClass( size );
+	memheader_t *mem = pool->freeblocks[sizeclass];
+
+	if( !mem )
+	{
+		size_t blocksize = Mem_SlabBlockSize( sizeclass );
+		size_t numblocks = ( MEMSLAB_SIZE - sizeof( memslab_t )) / blocksize;
+		memslab_t *slab;
+		byte *block;
+		size_t i;
+
+		slab = (memslab_t *)Q_malloc( MEMSLAB_SIZE );
+		if( slab == NULL ) Sys_Error( "Mem_Alloc: out of memory (alloc at %s:%i)\n", filename, fileline );
+
+		slab->next = pool->slabs;
+		pool->slabs = slab;
+		pool->realsize += MEMSLAB_SIZE;
+
+		// link new blocks in address order
+		block = (byte *)slab + sizeof( memslab_t ) + blocksize * ( numblocks - 1 );
+		for( i = 0; i < numblocks; i++, block -= blocksize )
+		{
+			memheader_t *hdr = (memheader_t *)block;
+			hdr->next = mem;
+			mem = hdr;
+		}
+	}
+
+	pool->freeblocks[sizeclass] = mem->next;
+	return mem;
+}
+
+static void Mem_FreeSlabs( mempool_t *pool )
+{
+	while( pool->slabs )
+	{
+		memslab_t *slab = pool->slabs;
+
+		pool->slabs = slab->next;
+		pool->realsize -= MEMSLAB_SIZE;
+		Q_free( slab );
+	}
+
+	memset( pool->freeblocks, 0, sizeof( pool->freeblocks ));
+}
+
+static size_t Mem_ArenaBlockSize( size_t size )
+{
+	return ( sizeof( memheader_t ) + size + 1 + 15 ) & ~15;
+}
+
+/*
+========================
+Mem_ArenaTailChunk
+
+returns the chunk if mem is the last block bumped out of it,
+such block can be resized or given back in place
+========================
+*/
+static memchunk_t *Mem_ArenaTailChunk( mempool_t *pool, memheader_t *mem )
+{
+	memchunk_t *chunk = pool->chunks;
+
+	if( chunk && (byte *)mem + Mem_ArenaBlockSize( mem->size ) == (byte *)chunk + sizeof( memchunk_t ) + chunk->used )
+		return chunk;
+
+	return NULL;
+}
+
+static memheader_t *Mem_AllocArenaBlock( mempool_t *pool, size_t size, const char *filename, int fileline )
+{
+	size_t blocksize = Mem_ArenaBlockSize( size );
+	memchunk_t *chunk = pool->chunks;
+	memheader_t *mem;
+
+	if( !chunk || chunk->size - chunk->used < blocksize )
+	{
+		size_t chunksize = blocksize > MEMARENA_CHUNK_SIZE / 4 ? blocksize : MEMARENA_CHUNK_SIZE;
+
+		chunk = (memchunk_t *)Q_malloc( sizeof( memchunk_t ) + chunksize );
+		if( chunk == NULL ) Sys_Error( "Mem_Alloc: out of memory (alloc at %s:%i)\n", filename, fileline );
+
+		chunk->size = chunksize;
+		chunk->used = 0;
+		pool->realsize += sizeof( memchunk_t ) + chunksize;
+
+		if( pool->chunks && chunksize != MEMARENA_CHUNK_SIZE )
+		{
+			// keep bumping in the current chunk, big block has it's own
+			chunk->next = pool->chunks->next;
+			pool->chunks->next = chunk;
+		}
+		else
+		{
+			chunk->next = pool->chunks;
+			pool->chunks = chunk;
+		}
+	}
+
+	mem = (memheader_t *)((byte *)chunk + sizeof( memchunk_t ) + chunk->used );
+	chunk->used += blocksize;
+
+	return mem;
+}
+
+static void Mem_FreeChunks( mempool_t *pool, qboolean keepfirst )
+{
+	memchunk_t *chunk, *next;
+
+	for( chunk = pool->chunks; chunk; chunk = next )
+	{
+		next = chunk->next;
+
+		// regular sized chunk can be reused by the emptied pool
+		if( keepfirst && chunk->size == MEMARENA_CHUNK_SIZE )
+		{
+			keepfirst = false;
+			chunk->used = 0;
+			chunk->next = NULL;
+			pool->chunks = chunk;
+			continue;
+		}
+
+		pool->realsize -= sizeof( memchunk_t ) + chunk->size;
+		Q_free( chunk );
+	}
+
+	if( keepfirst )
+		pool->chunks = NULL;
+}
+
+static memsite_t *Mem_ProfileFindSite( const char *filename, int fileline, qboolean create )
+{
+	uint hash = (uint)((uintptr_t)filename >> 2 ) * 2654435761U + (uint)fileline * 40503U;
+	uint i, mask = MEMPROFILE_MAX_SITES - 1;
+
+	for( i = 0; i < MEMPROFILE_MAX_SITES; i++ )
+	{
+		memsite_t *site = &mem_profile.sites[( hash + i ) & mask];
+
+		if( site->filename == filename && site->fileline == fileline )
+			return site;
+
+		if( !site->filename )
+		{
+			// keep load factor reasonable, lookup stays short
+			if( !create || mem_profile.numsites >= MEMPROFILE_MAX_SITES / 2 )
+				return NULL;
+
+			site->filename = filename;
+			site->fileline = fileline;
+			Q_strncpy( site->name, Mem_CheckFilename( filename ), sizeof( site->name ));
+			mem_profile.numsites++;
+			return site;
+		}
+	}
+
+	return NULL;
+}
+
+static void Mem_ProfileAlloc( memheader_t *mem, qboolean seed )
+{
+	memsite_t *site = Mem_ProfileFindSite( mem->filename, mem->fileline, true );
+
+	if( !site )
+	{
+		mem_profile.dropped++;
+		return;
+	}
+
+	site->livesize += mem->size;
+	site->livecount++;
+
+	// blocks that existed before profiling was started are not counted as allocations
+	if( !seed ) site->numallocs++;
+}
+
+static void Mem_ProfileFree( memheader_t *mem )
+{
+	memsite_t *site = Mem_ProfileFindSite( mem->filename, mem->fileline, false );
+
+	if( !site || !site->livecount )
+		return;
+
+	site->livesize -= mem->size;
+	site->livecount--;
+	site->numfrees++;
+}
+
 void *_Mem_Alloc( poolhandle_t poolptr, size_t size, qboolean clear, const char *filename, int fileline )
 {
 	memheader_t *mem;
@@ -105,10 +487,23 @@ void *_Mem_Alloc( poolhandle_t poolptr, size_t size, qboolean clear, const char
 
 	pool->totalsize += size;
 
-	// big allocations are not clumped
-	pool->realsize += sizeof( memheader_t ) + size + sizeof( size_t );
-	mem = (memheader_t *)Q_malloc( sizeof( memheader_t ) + size + sizeof( size_t ));
-	if( mem == NULL ) Sys_Error( "Mem_Alloc: out of memory (alloc at %s:%i)\n", filename, fileline );
+	if( FBitSet( pool->flags, POOL_ARENA ))
+	{
+		// arena pools only bump, memory is given back with the whole pool
+		mem = Mem_AllocArenaBlock( pool, size, filename, fileline );
+	}
+	else if( FBitSet( pool->flags, POOL_SLAB ) && size <= MEMSLAB_MAX_SIZE )
+	{
+		// small allocations are carved out of slabs
+		mem = Mem_AllocSlabBlock( pool, size, filename, fileline );
+	}
+	else
+	{
+		// big allocations are not clumped
+		pool->realsize += sizeof( memheader_t ) + size + sizeof( size_t );
+		mem = (memheader_t *)Q_malloc( sizeof( memheader_t ) + size + sizeof( size_t ));
+		if( mem == NULL ) Sys_Error( "Mem_Alloc: out of memory (alloc at %s:%i)\n", filename, fileline );
+	}
 
 	mem->filename = filename;
 	mem->fileline = fileline;
@@ -126,25 +521,12 @@ void *_Mem_Alloc( poolhandle_t poolptr, size_t size, qboolean clear, const char
 	if( clear )
 		memset((void *)((byte *)mem + sizeof( memheader_t )), 0, mem->size );
 
-	return (void *)((byte *)mem + sizeof( memheader_t ));
-}
-
-static const char *Mem_CheckFilename( const char *filename )
-{
-	static const char	*dummy = "<corrupted>\0";
-	const char	*out = filename;
-	int		i;
-
-	if( !COM_CheckString( out ))
-		return dummy;
-
-	for( i = 0; i < MAX_OSPATH; i++, out++ )
-	{
-		if( *out == '\0' )
-			return filename; // valid name
-	}
+	pool->numblocks++;
+	pool->numallocs++;
+	if( mem_profile.active )
+		Mem_ProfileAlloc( mem, false );
 
-	return dummy;
+	return (void *)((byte *)mem + sizeof( memheader_t ));
 }
 
 static void Mem_FreeBlock( memheader_t *mem, const char *filename, int fileline )
@@ -176,6 +558,31 @@ static void Mem_FreeBlock( memheader_t *mem, const char *filename, int fileline
 
 	// memheader has been unlinked, do the actual free now
 	pool->totalsize -= mem->size;
+	pool->numblocks--;
+	pool->numfrees++;
+	if( mem_profile.active )
+		Mem_ProfileFree( mem );
+
+	// arena block memory stays reserved until the pool is emptied, unless it was the last one
+	if( FBitSet( pool->flags, POOL_ARENA ))
+	{
+		memchunk_t *chunk = Mem_ArenaTailChunk( pool, mem );
+
+		if( chunk )
+			chunk->used -= Mem_ArenaBlockSize( mem->size );
+		return;
+	}
+
+	if( FBitSet( pool->flags, POOL_SLAB ) && mem->size <= MEMSLAB_MAX_SIZE )
+	{
+		// return block to the size class free list, slabs are released with the pool
+		int sizeclass = Mem_SlabClass( mem->size );
+
+		mem->next = pool->freeblocks[sizeclass];
+		mem->prev = NULL;
+		pool->freeblocks[sizeclass] = mem;
+		return;
+	}
 
 	pool->realsize -= sizeof( memheader_t ) + mem->size + sizeof( size_t );
 	Q_free( mem );
@@ -198,6 +605,33 @@ void *_Mem_Realloc( poolhandle_t poolptr, void *memptr, size_t size, qboolean cl
 	{
 		memhdr = (memheader_t *)((byte *)memptr - sizeof( memheader_t ));
 		if( size == memhdr->size ) return memptr;
+
+		if( FBitSet( memhdr->pool->flags, POOL_ARENA ) && Mem_FindPool( poolptr ) == memhdr->pool )
+		{
+			mempool_t *pool = memhdr->pool;
+			memchunk_t *chunk = Mem_ArenaTailChunk( pool, memhdr );
+
+			// last block of the chunk grows or shrinks in place, others would leave a hole
+			if( chunk && chunk->used - Mem_ArenaBlockSize( memhdr->size ) + Mem_ArenaBlockSize( size ) <= chunk->size )
+			{
+				if( mem_profile.active )
+					Mem_ProfileFree( memhdr );
+
+				chunk->used += Mem_ArenaBlockSize( size ) - Mem_ArenaBlockSize( memhdr->size );
+				pool->totalsize += size - memhdr->size;
+
+				if( clear && size > memhdr->size )
+					memset((byte *)memptr + memhdr->size, 0, size - memhdr->size );
+
+				memhdr->size = size;
+				*((byte *)memhdr + sizeof( memheader_t ) + memhdr->size ) = MEMHEADER_SENTINEL2;
+
+				if( mem_profile.active )
+					Mem_ProfileAlloc( memhdr, false );
+
+				return memptr;
+			}
+		}
 	}
 
 	nb = _Mem_Alloc( poolptr, size, clear, filename, fileline );
@@ -212,7 +646,7 @@ void *_Mem_Realloc( poolhandle_t poolptr, void *memptr, size_t size, qboolean cl
 	return (void *)nb;
 }
 
-poolhandle_t _Mem_AllocPool( const char *name, const char *filename, int fileline )
+poolhandle_t _Mem_AllocPoolFlags( const char *name, uint flags, const char *filename, int fileline )
 {
 	mempool_t *pool;
 
@@ -229,21 +663,55 @@ poolhandle_t _Mem_AllocPool( const char *name, const char *filename, int filelin
 	pool->sentinel2 = MEMHEADER_SENTINEL1;
 	pool->filename = filename;
 	pool->fileline = fileline;
+	pool->flags = flags;
+	if( mem_forceslab && !FBitSet( flags, POOL_ARENA ))
+		SetBits( pool->flags, POOL_SLAB );
 	pool->chain = NULL;
 	pool->totalsize = 0;
 	pool->realsize = sizeof( mempool_t );
 	Q_strncpy( pool->name, name, sizeof( pool->name ));
 	pool->next = poolchain;
 	poolchain = pool;
-	
+
 #if XASH_64BIT
-	pool->idx = ++lastidx;
+	pool->idx = Mem_AllocPoolHandle( pool, filename, fileline );
 	return pool->idx;
 #else
 	return (poolhandle_t)pool;
 #endif
 }
 
+poolhandle_t _Mem_AllocPool( const char *name, const char *filename, int fileline )
+{
+	return _Mem_AllocPoolFlags( name, 0, filename, fileline );
+}
+
+static void Mem_FreePoolBlocks( mempool_t *pool, qboolean keepchunk, const char *filename, int fileline )
+{
+	if( FBitSet( pool->flags, POOL_ARENA ))
+	{
+		// every block lives in chunks, so there is nothing to walk
+		// unless profiler wants to know about every freed block
+		if( mem_profile.active )
+		{
+			memheader_t *mem;
+
+			for( mem = pool->chain; mem; mem = mem->next )
+				Mem_ProfileFree( mem );
+		}
+
+		pool->chain = NULL;
+		pool->totalsize = 0;
+		pool->numfrees += pool->numblocks;
+		pool->numblocks = 0;
+		Mem_FreeChunks( pool, keepchunk );
+		return;
+	}
+
+	while( pool->chain ) Mem_FreeBlock( pool->chain, filename, fileline );
+	Mem_FreeSlabs( pool );
+}
+
 void _Mem_FreePool( poolhandle_t *poolptr, const char *filename, int fileline )
 {
 	mempool_t	*pool;
@@ -259,7 +727,11 @@ void _Mem_FreePool( poolhandle_t *poolptr, const char *filename, int fileline )
 		*chainaddress = pool->next;
 
 		// free memory owned by the pool
-		while( pool->chain ) Mem_FreeBlock( pool->chain, filename, fileline );
+		Mem_FreePoolBlocks( pool, false, filename, fileline );
+#if XASH_64BIT
+		// release the handle, so stale copies of it will be caught
+		Mem_FreePoolHandle( pool->idx );
+#endif
 		// free the pool itself
 		memset( pool, 0xBF, sizeof( mempool_t ));
 		Q_free( pool );
@@ -276,7 +748,7 @@ void _Mem_EmptyPool( poolhandle_t poolptr, const char *filename, int fileline )
 	if( pool->sentinel2 != MEMHEADER_SENTINEL1 ) Sys_Error( "Mem_EmptyPool: trashed pool sentinel 2 (allocpool at %s:%i, emptypool at %s:%i)\n", pool->filename, pool->fileline, filename, fileline );
 
 	// free memory owned by the pool
-	while( pool->chain ) Mem_FreeBlock( pool->chain, filename, fileline );
+	Mem_FreePoolBlocks( pool, true, filename, fileline );
 }
 
 static qboolean Mem_CheckAlloc( mempool_t *pool, void *data )
@@ -402,6 +874,212 @@ void Mem_PrintList( size_t minallocationsize )
 	}
 }
 
+/*
+========================
+Mem_ProfileStart
+
+starts gathering per call site statistics,
+already allocated blocks are accounted as live
+========================
+*/
+void Mem_ProfileStart( void )
+{
+	mempool_t *pool;
+	memheader_t *mem;
+
+	if( !mem_profile.sites )
+	{
+		mem_profile.sites = (memsite_t *)Q_malloc( sizeof( memsite_t ) * MEMPROFILE_MAX_SITES );
+		if( !mem_profile.sites )
+		{
+			Con_Printf( S_ERROR "%s: out of memory\n", __func__ );
+			return;
+		}
+	}
+
+	memset( mem_profile.sites, 0, sizeof( memsite_t ) * MEMPROFILE_MAX_SITES );
+	mem_profile.numsites = 0;
+	mem_profile.dropped = 0;
+	mem_profile.active = true;
+	mem_profile.starttime = mem_profile.lasttime = Sys_DoubleTime();
+
+	for( pool = poolchain; pool; pool = pool->next )
+	{
+		pool->lastallocs = pool->numallocs;
+		pool->lastfrees = pool->numfrees;
+
+		for( mem = pool->chain; mem; mem = mem->next )
+			Mem_ProfileAlloc( mem, true );
+	}
+}
+
+void Mem_ProfileStop( void )
+{
+	// keep the table, so last results can still be printed or dumped
+	mem_profile.active = false;
+}
+
+qboolean Mem_ProfileActive( void )
+{
+	return mem_profile.active;
+}
+
+static int Mem_ProfileSortBySize( const void *a, const void *b )
+{
+	const memsite_t *sa = *(const memsite_t **)a, *sb = *(const memsite_t **)b;
+
+	if( sa->livesize != sb->livesize )
+		return sa->livesize < sb->livesize ? 1 : -1;
+
+	return Q_strcmp( sa->name, sb->name );
+}
+
+static int Mem_ProfileSortByName( const void *a, const void *b )
+{
+	const memsite_t *sa = *(const memsite_t **)a, *sb = *(const memsite_t **)b;
+	int ret = Q_strcmp( sa->name, sb->name );
+
+	if( ret )
+		return ret;
+
+	return sa->fileline - sb->fileline;
+}
+
+static int Mem_ProfileSortSites( memsite_t **sorted, qboolean byname )
+{
+	int i, count = 0;
+
+	for( i = 0; i < MEMPROFILE_MAX_SITES; i++ )
+	{
+		if( mem_profile.sites[i].filename )
+			sorted[count++] = &mem_profile.sites[i];
+	}
+
+	qsort( sorted, count, sizeof( *sorted ), byname ? Mem_ProfileSortByName : Mem_ProfileSortBySize );
+
+	return count;
+}
+
+/*
+========================
+Mem_ProfilePrint
+
+prints call sites holding the most of memory
+========================
+*/
+void Mem_ProfilePrint( int maxsites )
+{
+	memsite_t **sorted;
+	double elapsed;
+	int i, count;
+
+	if( !mem_profile.sites )
+	{
+		Con_Printf( "memory profiler was never started\n" );
+		return;
+	}
+
+	sorted = (memsite_t **)Q_malloc( sizeof( *sorted ) * MEMPROFILE_MAX_SITES );
+	if( !sorted )
+		return;
+
+	count = Mem_ProfileSortSites( sorted, false );
+	elapsed = Sys_DoubleTime() - mem_profile.starttime;
+
+	Con_Printf( "memory profile, %s, %.1f seconds, %i call sites:\n", mem_profile.active ? "active" : "stopped", elapsed, count );
+	Con_Printf( "  ^3live       blocks     allocs     frees      call site\n" );
+
+	for( i = 0; i < count && i < maxsites; i++ )
+	{
+		Con_Printf( "%10s %10lu %10lu %10lu %s:%i\n", Q_memprint( sorted[i]->livesize ), (unsigned long)sorted[i]->livecount,
+			(unsigned long)sorted[i]->numallocs, (unsigned long)sorted[i]->numfrees, sorted[i]->name, sorted[i]->fileline );
+	}
+
+	if( mem_profile.dropped )
+		Con_Printf( S_WARN "%lu allocations were not accounted, too many call sites\n", (unsigned long)mem_profile.dropped );
+
+	Q_free( sorted );
+}
+
+/*
+========================
+Mem_ProfileDump
+
+writes a snapshot, sorted by call site, so two snapshots can be compared with diff
+churn is counted since the previous snapshot
+========================
+*/
+qboolean Mem_ProfileDump( const char *filename )
+{
+	memsite_t **sorted;
+	mempool_t *pool;
+	double now, elapsed;
+	file_t *f;
+	int i, count;
+
+	if( !mem_profile.sites )
+	{
+		Con_Printf( "memory profiler was never started\n" );
+		return false;
+	}
+
+	f = FS_Open( filename, "w", true );
+	if( !f )
+	{
+		Con_Printf( S_ERROR "couldn't open %s\n", filename );
+		return false;
+	}
+
+	sorted = (memsite_t **)Q_malloc( sizeof( *sorted ) * MEMPROFILE_MAX_SITES );
+	if( !sorted )
+	{
+		FS_Close( f );
+		return false;
+	}
+
+	now = Sys_DoubleTime();
+	elapsed = now - mem_profile.lasttime;
+	if( elapsed <= 0.0 ) elapsed = 1.0;
+
+	FS_Printf( f, "// memory profile snapshot, %.3f seconds since start, %.3f seconds since last snapshot\n", now - mem_profile.starttime, elapsed );
+	FS_Printf( f, "// pool <name> <live bytes> <live blocks> <allocs> <frees> <allocs/s> <frees/s>\n" );
+
+	for( pool = poolchain; pool; pool = pool->next )
+	{
+		FS_Printf( f, "pool \"%s\" %lu %lu %lu %lu %.1f %.1f\n", pool->name, (unsigned long)pool->totalsize, (unsigned long)pool->numblocks,
+			(unsigned long)pool->numallocs, (unsigned long)pool->numfrees,
+			( pool->numallocs - pool->lastallocs ) / elapsed, ( pool->numfrees - pool->lastfrees ) / elapsed );
+
+		pool->lastallocs = pool->numallocs;
+		pool->lastfrees = pool->numfrees;
+	}
+
+	count = Mem_ProfileSortSites( sorted, true );
+
+	FS_Printf( f, "// site <file>:<line> <live bytes> <live blocks> <allocs> <frees> <allocs/s> <frees/s>\n" );
+
+	for( i = 0; i < count; i++ )
+	{
+		memsite_t *site = sorted[i];
+
+		FS_Printf( f, "site %s:%i %lu %lu %lu %lu %.1f %.1f\n", site->name, site->fileline, (unsigned long)site->livesize, (unsigned long)site->livecount,
+			(unsigned long)site->numallocs, (unsigned long)site->numfrees,
+			( site->numallocs - site->lastallocs ) / elapsed, ( site->numfrees - site->lastfrees ) / elapsed );
+
+		site->lastallocs = site->numallocs;
+		site->lastfrees = site->numfrees;
+	}
+
+	if( mem_profile.dropped )
+		FS_Printf( f, "// %lu allocations were not accounted, too many call sites\n", (unsigned long)mem_profile.dropped );
+
+	mem_profile.lasttime = now;
+	Q_free( sorted );
+	FS_Close( f );
+
+	return true;
+}
+
 /*
 ========================
 Memory_Init
@@ -410,4 +1088,287 @@ Memory_Init
 void Memory_Init( void )
 {
 	poolchain = NULL; // init mem chain
+	mem_forceslab = Sys_CheckParm( "-memslab" ) ? true : false;
+#if XASH_64BIT
+	numpoolslots = 0;
+	firstfreeslot = 0;
+#endif
+
+	if( Sys_CheckParm( "-memprofile" ))
+		Mem_ProfileStart();
 }
+
+#if XASH_ENGINE_TESTS
+
+#include "tests.h"
+
+#define TEST_NUM_POOLS  64
+#define TEST_NUM_BLOCKS 32
+#define TEST_NUM_ROUNDS 1024
+
+static void Test_PoolHandles( void )
+{
+	poolhandle_t pools[TEST_NUM_POOLS];
+	poolhandle_t stale;
+	void *p;
+	int i;
+
+	for( i = 0; i < TEST_NUM_POOLS; i++ )
+	{
+		pools[i] = Mem_AllocPool( "test pool" );
+		TASSERT( pools[i] != 0 );
+	}
+
+	for( i = 0; i < TEST_NUM_POOLS; i++ )
+		TASSERT( Mem_FindPool( pools[i] ) != NULL );
+
+	p = Mem_Malloc( pools[TEST_NUM_POOLS - 1], 16 );
+	TASSERT( Mem_IsAllocatedExt( pools[TEST_NUM_POOLS - 1], p ));
+	TASSERT( !Mem_IsAllocatedExt( pools[0], p ));
+
+	stale = pools[0];
+	Mem_FreePool( &pools[0] );
+	TASSERT( pools[0] == 0 );
+
+#if XASH_64BIT
+	// slot gets reused, but the handle must be different
+	TASSERT( Mem_GetPoolSlot( stale ) == NULL );
+	pools[0] = Mem_AllocPool( "test pool" );
+	TASSERT( pools[0] != stale );
+	TASSERT(( pools[0] & POOLHANDLE_INDEX_MASK ) == ( stale & POOLHANDLE_INDEX_MASK ));
+	TASSERT( Mem_GetPoolSlot( stale ) == NULL );
+#else
+	pools[0] = Mem_AllocPool( "test pool" );
+#endif
+
+	for( i = 0; i < TEST_NUM_POOLS; i++ )
+		Mem_FreePool( &pools[i] );
+}
+
+static void Test_SlabPool( void )
+{
+	poolhandle_t pool = Mem_AllocPoolFlags( "test slab pool", POOL_SLAB );
+	mempool_t *p = Mem_FindPool( pool );
+	byte *small, *big, *other;
+	size_t realsize;
+
+	TASSERT( FBitSet( p->flags, POOL_SLAB ));
+
+	small = Mem_Calloc( pool, 24 );
+	TASSERT( p->totalsize == 24 );
+	TASSERT( p->realsize == sizeof( mempool_t ) + MEMSLAB_SIZE );
+	TASSERT((((uintptr_t)small ) & 15 ) == 0 );
+	TASSERT( small[0] == 0 && small[23] == 0 );
+	TASSERT( Mem_IsAllocatedExt( pool, small ));
+
+	// same size class comes out of the same slab
+	other = Mem_Malloc( pool, 30 );
+	TASSERT( p->realsize == sizeof( mempool_t ) + MEMSLAB_SIZE );
+	TASSERT( other == small + Mem_SlabBlockSize( Mem_SlabClass( 24 )));
+
+	// big allocations still go to malloc
+	big = Mem_Malloc( pool, MEMSLAB_MAX_SIZE + 1 );
+	TASSERT( p->totalsize == 24 + 30 + MEMSLAB_MAX_SIZE + 1 );
+
+	Mem_Free( small );
+	Mem_Free( big );
+	TASSERT( p->totalsize == 30 );
+
+	// freed block is reused first, without growing the pool
+	realsize = p->realsize;
+	small = Mem_Malloc( pool, 20 );
+	TASSERT( p->realsize == realsize );
+	TASSERT( Mem_IsAllocatedExt( pool, small ));
+
+	Mem_Check();
+
+	Mem_EmptyPool( pool );
+	TASSERT( p->totalsize == 0 );
+	TASSERT( p->realsize == sizeof( mempool_t ));
+	TASSERT( p->slabs == NULL );
+
+	Mem_FreePool( &pool );
+}
+
+static void Test_ArenaPool( void )
+{
+	poolhandle_t pool = Mem_AllocArenaPool( "test arena pool" );
+	mempool_t *p = Mem_FindPool( pool );
+	byte *a, *b, *big;
+	size_t used;
+	int i;
+
+	a = Mem_Calloc( pool, 100 );
+	b = Mem_Malloc( pool, 10 );
+	TASSERT( p->totalsize == 110 );
+	TASSERT( p->realsize == sizeof( mempool_t ) + sizeof( memchunk_t ) + MEMARENA_CHUNK_SIZE );
+	TASSERT((((uintptr_t)a ) & 15 ) == 0 && (((uintptr_t)b ) & 15 ) == 0 );
+	TASSERT( a[0] == 0 && a[99] == 0 );
+	TASSERT( b > a && b - a < 256 );
+	TASSERT( Mem_IsAllocatedExt( pool, a ));
+
+	// freeing is accounted for, but memory isn't reused
+	Mem_Free( a );
+	TASSERT( p->totalsize == 10 );
+	TASSERT( !Mem_IsAllocatedExt( pool, a ));
+	a = Mem_Malloc( pool, 100 );
+	TASSERT( a > b );
+
+	// last block grows and shrinks in place and gives memory back when freed
+	used = p->chunks->used;
+	b = Mem_Malloc( pool, 10 );
+	b[9] = 0x55;
+	TASSERT( Mem_Realloc( pool, b, 1000 ) == b );
+	TASSERT( b[9] == 0x55 && b[999] == 0 );
+	TASSERT( p->totalsize == 110 + 1000 );
+	TASSERT( Mem_Realloc( pool, b, 20 ) == b );
+	TASSERT( p->totalsize == 110 + 20 );
+	Mem_Check();
+	Mem_Free( b );
+	TASSERT( p->chunks->used == used );
+
+	// blocks in the middle are copied
+	b = Mem_Malloc( pool, 10 );
+	a = Mem_Realloc( pool, a, 120 );
+	TASSERT( a > b );
+
+	// big blocks get their own chunk and don't waste the current one
+	big = Mem_Malloc( pool, MEMARENA_CHUNK_SIZE );
+	TASSERT( p->chunks->next != NULL && p->chunks->size == MEMARENA_CHUNK_SIZE );
+	b = Mem_Malloc( pool, 10 );
+	TASSERT( b > a && b - a < 256 );
+	TASSERT( Mem_IsAllocatedExt( pool, big ));
+
+	for( i = 0; i < 10000; i++ )
+		Mem_Malloc( pool, 64 );
+
+	Mem_Check();
+
+	// one chunk is kept around for the next allocations
+	Mem_EmptyPool( pool );
+	TASSERT( p->totalsize == 0 );
+	TASSERT( p->realsize == sizeof( mempool_t ) + sizeof( memchunk_t ) + MEMARENA_CHUNK_SIZE );
+	TASSERT( p->chain == NULL && p->chunks != NULL && p->chunks->next == NULL && p->chunks->used == 0 );
+
+	Mem_FreePool( &pool );
+}
+
+static void Test_Profile( void )
+{
+	poolhandle_t pool = Mem_AllocPool( "test profile pool" );
+	poolhandle_t arena = Mem_AllocArenaPool( "test profile arena" );
+	qboolean wasactive = Mem_ProfileActive();
+	const char *file = "profiled.c";
+	memsite_t *site;
+	void *a, *b;
+
+	a = _Mem_Alloc( pool, 100, false, file, 1 );
+	Mem_ProfileStart();
+
+	// block that was there before start is live, but not counted as allocation
+	site = Mem_ProfileFindSite( file, 1, false );
+	TASSERT( site != NULL );
+	if( site )
+	{
+		TASSERT( site->livesize == 100 && site->livecount == 1 && site->numallocs == 0 );
+	}
+
+	b = _Mem_Alloc( pool, 50, false, file, 1 );
+	_Mem_Alloc( arena, 20, false, file, 2 );
+	_Mem_Alloc( arena, 30, false, file, 2 );
+	if( site )
+	{
+		TASSERT( site->livesize == 150 && site->livecount == 2 && site->numallocs == 1 );
+	}
+
+	Mem_Free( a );
+	if( site )
+	{
+		TASSERT( site->livesize == 50 && site->livecount == 1 && site->numfrees == 1 );
+	}
+
+	site = Mem_ProfileFindSite( file, 2, false );
+	TASSERT( site != NULL );
+	if( site )
+	{
+		TASSERT( site->livesize == 50 && site->numallocs == 2 );
+		Mem_EmptyPool( arena );
+		TASSERT( site->livesize == 0 && site->livecount == 0 && site->numfrees == 2 );
+	}
+
+	TASSERT( Mem_FindPool( arena )->numblocks == 0 && Mem_FindPool( arena )->numfrees == 2 );
+	TASSERT( Mem_FindPool( pool )->numblocks == 1 && Mem_FindPool( pool )->numallocs == 2 );
+
+	Mem_Free( b );
+	Mem_FreePool( &pool );
+	Mem_FreePool( &arena );
+
+	if( !wasactive )
+		Mem_ProfileStop();
+}
+
+static void Test_PoolBenchmarkFlags( uint flags )
+{
+	poolhandle_t pools[TEST_NUM_POOLS];
+	void *blocks[TEST_NUM_POOLS][TEST_NUM_BLOCKS];
+	double start, end;
+	int i, j, k;
+
+	for( i = 0; i < TEST_NUM_POOLS; i++ )
+		pools[i] = Mem_AllocPoolFlags( "benchmark pool", flags );
+
+	start = Sys_DoubleTime();
+
+	for( k = 0; k < TEST_NUM_ROUNDS; k++ )
+	{
+		for( j = 0; j < TEST_NUM_BLOCKS; j++ )
+		{
+			for( i = 0; i < TEST_NUM_POOLS; i++ )
+				blocks[i][j] = Mem_Malloc( pools[i], 16 + (( i + j + k ) & 63 ));
+		}
+
+		if( FBitSet( flags, POOL_ARENA ))
+		{
+			// arena is released as a whole
+			for( i = 0; i < TEST_NUM_POOLS; i++ )
+				Mem_EmptyPool( pools[i] );
+			continue;
+		}
+
+		for( j = 0; j < TEST_NUM_BLOCKS; j++ )
+		{
+			for( i = 0; i < TEST_NUM_POOLS; i++ )
+				Mem_Free( blocks[i][j] );
+		}
+	}
+
+	end = Sys_DoubleTime();
+
+	for( i = 0; i < TEST_NUM_POOLS; i++ )
+	{
+		TASSERT( Mem_FindPool( pools[i] )->totalsize == 0 );
+		Mem_FreePool( &pools[i] );
+	}
+
+	Msg( "%d allocations across %d %s pools took %.3f ms\n",
+		TEST_NUM_POOLS * TEST_NUM_BLOCKS * TEST_NUM_ROUNDS, TEST_NUM_POOLS,
+		FBitSet( flags, POOL_ARENA ) ? "arena" : FBitSet( flags, POOL_SLAB ) ? "slab" : "regular", ( end - start ) * 1000.0 );
+}
+
+static void Test_PoolBenchmark( void )
+{
+	Test_PoolBenchmarkFlags( 0 );
+	Test_PoolBenchmarkFlags( POOL_SLAB );
+	Test_PoolBenchmarkFlags( POOL_ARENA );
+}
+
+void Test_RunZone( void )
+{
+	TRUN( Test_PoolHandles() );
+	TRUN( Test_SlabPool() );
+	TRUN( Test_ArenaPool() );
+	TRUN( Test_Profile() );
+	TRUN( Test_PoolBenchmark() );
+}
+
+#endif /* XASH_ENGINE_TESTS */
@@ -26,6 +26,7 @@ GNU General Public License for more details.
 #include "entity_state.h"
 #include "protocol.h"
 #include "netchan.h"
+#include "net_encode.h"
 #include "custom.h"
 #include "world.h"
 
@@ -238,6 +239,7 @@ typedef struct sv_client_s
 	float		latency;
 
 	int		ignored_ents;		// if visibility list is full we should know how many entities will be ignored
+	delta_stats_t	delta_stats;		// fields in last snapshot
 	edict_t		*edict;			// EDICT_NUM(clientnum+1)
 	edict_t		*pViewEntity;		// svc_setview member
 	edict_t		*viewentity[MAX_VIEWENTS];	// list of portal cameras in player PVS
@@ -321,6 +323,16 @@ typedef struct
 	vec3_t		finalpos;
 } sv_interp_t;
 
+// client independent parts of signon, see SV_SendSignonBlob
+typedef enum
+{
+	SIGNON_BLOB_NEW = 0,		// delta descriptions, movevars and user messages
+	SIGNON_BLOB_SIGNON,			// sv.signon
+	SIGNON_BLOB_RESOURCES,		// resource list without consistency check
+	SIGNON_BLOB_RESOURCES_CONSISTENCY,	// resource list with files to check
+	SIGNON_BLOB_COUNT
+} sv_signonblob_t;
+
 typedef struct
 {
 	// user messages stuff
@@ -383,6 +395,9 @@ typedef struct
 
 	challenge_t	challenges[MAX_CHALLENGES];	// to prevent invalid IPs from connecting
 
+	fragblob_t	*signon_blobs[SIGNON_BLOB_COUNT];	// built once and shared by all connecting clients
+	uint		signon_keys[SIGNON_BLOB_COUNT];	// CRC of what blob was built from
+
 	sizebuf_t testpacket;         // pregenerataed testpacket, only needs CRC32 patching
 	byte      *testpacket_buf;    // check for NULL if testpacket is available
 	byte      *testpacket_crcpos; // pointer to write pregenerated crc (unaligned!!!)
@@ -463,6 +478,10 @@ extern convar_t		sv_check_errors;
 extern convar_t		sv_reconnect_limit;
 extern convar_t		sv_lighting_modulate;
 extern convar_t		sv_novis;
+extern convar_t		sv_adaptive_areanodes;
+extern convar_t		sv_parallel_physics;
+extern convar_t		sv_parallel_send;
+extern convar_t		sv_pvs_candidates;
 extern convar_t		sv_hostmap;
 extern convar_t		sv_validate_changelevel;
 extern convar_t		sv_maxclients;
@@ -472,6 +491,9 @@ extern convar_t		sv_userinfo_penalty_multiplier;
 extern convar_t		sv_userinfo_penalty_attempts;
 extern convar_t		sv_fullupdate_penalty_time;
 extern convar_t		sv_log_outofband;
+extern convar_t		sv_fps;
+extern convar_t		sv_query_rate;
+extern convar_t		sv_query_burst;
 
 //===========================================================
 //
@@ -552,6 +574,8 @@ void SV_FullClientUpdate( sv_client_t *cl, sizebuf_t *msg );
 void SV_FullUpdateMovevars( sv_client_t *cl, sizebuf_t *msg );
 void SV_GetPlayerStats( sv_client_t *cl, int *ping, int *packet_loss );
 void SV_SendServerdata( sizebuf_t *msg, sv_client_t *cl );
+void SV_SendSignonBlob( sv_client_t *cl, sizebuf_t *msg, sv_signonblob_t type );
+void SV_FreeSignonBlobs( void );
 void SV_ClientThink( sv_client_t *cl, usercmd_t *cmd );
 void SV_ExecuteClientMessage( sv_client_t *cl, sizebuf_t *msg );
 void SV_ConnectionlessPacket( netadr_t from, sizebuf_t *msg );
@@ -584,6 +608,7 @@ int SV_EstimateNeededResources( sv_client_t *cl );
 void SV_ClearResourceList( resource_t *pList );
 void SV_BatchUploadRequest( sv_client_t *cl );
 void SV_SendResources( sv_client_t *cl, sizebuf_t *msg );
+void SV_WriteResources( sizebuf_t *msg, qboolean consistency );
 void SV_ClearResourceLists( sv_client_t *cl );
 void SV_TransferConsistencyInfo( void );
 void SV_RequestMissingResources( void );
@@ -594,6 +619,7 @@ void SV_RequestMissingResources( void );
 void SV_InitFilter( void );
 void SV_ShutdownFilter( void );
 qboolean SV_CheckIP( netadr_t *adr );
+qboolean SV_CheckQueryRate( netadr_t adr );
 qboolean SV_CheckID( const char *id );
 
 //
@@ -604,6 +630,8 @@ int SV_FindBestBaselineForStatic( int index, entity_state_t **baseline, entity_s
 void SV_WriteFrameToClient( sv_client_t *client, sizebuf_t *msg );
 void SV_BuildClientFrame( sv_client_t *client );
 void SV_SkipUpdates( void );
+void SV_SendBench_f( void );
+void SV_DeltaBench_f( void );
 
 //
 // sv_game.c
@@ -685,6 +713,8 @@ void SV_ClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t
 void SV_CustomClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace );
 trace_t SV_TraceHull( edict_t *ent, int hullNum, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end );
 trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e, qboolean monsterclip );
+trace_t SV_MoveClipped( const trace_t *worldtrace, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e, qboolean monsterclip );
+void SV_ClipMoveToWorld( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace, qboolean *bad );
 trace_t SV_MoveNoEnts( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e );
 const char *SV_TraceTexture( edict_t *ent, const vec3_t start, const vec3_t end );
 msurface_t *SV_TraceSurface( edict_t *ent, const vec3_t start, const vec3_t end );
@@ -694,10 +724,35 @@ int SV_TruePointContents( const vec3_t p );
 int SV_PointContents( const vec3_t p );
 void SV_SetLightStyle( int style, const char* s, float f );
 int SV_LightForEntity( edict_t *pEdict );
+void SV_TraceBench_f( void );
 
 //
 // sv_query.c
 //
+typedef enum
+{
+	QUERY_INFO = 0,		// SV_Info
+	QUERY_NETINFO_PLAYERS,
+	QUERY_NETINFO_DETAILS,
+	QUERY_SOURCE_DETAILS,
+	QUERY_SOURCE_RULES,
+	QUERY_SOURCE_PLAYERS,
+	QUERY_COUNT
+} svquery_t;
+
+typedef struct
+{
+	uint		dropped;	// connectionless packets over rate limit
+	uint		cached;	// replies sent from cache
+	uint		built;	// replies built from scratch
+} sv_querystats_t;
+
+extern sv_querystats_t	sv_querystats;
+
 qboolean SV_SourceQuery_HandleConnnectionlessPacket( const char *c, netadr_t from );
+qboolean SV_QueryCacheFind( svquery_t query, const void **data, size_t *size );
+void SV_QueryCacheStore( svquery_t query, const void *data, size_t size );
+void SV_QueryCacheInvalidate( void );
+void SV_QueryStats_f( void );
 
 #endif//SERVER_H
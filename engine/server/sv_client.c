@@ -911,6 +911,13 @@ void SV_Info( netadr_t from, int protocolVersion )
 		int remaining;
 		char temp[sizeof( s )];
 		qboolean have_password = COM_CheckStringEmpty( sv_password.string );
+		const void *cached;
+
+		if( SV_QueryCacheFind( QUERY_INFO, &cached, NULL ))
+		{
+			Netchan_OutOfBandPrint( NS_SERVER, from, "info\n%s", (const char *)cached );
+			return;
+		}
 
 		SV_GetPlayerCount( &count, &bots );
 
@@ -936,6 +943,8 @@ void SV_Info( netadr_t from, int protocolVersion )
 		}
 		Q_strncpy( temp, hostname.string, remaining );
 		Info_SetValueForKey( s, "host", temp, sizeof( s ));
+
+		SV_QueryCacheStore( QUERY_INFO, s, Q_strlen( s ) + 1 );
 	}
 
 	Netchan_OutOfBandPrint( NS_SERVER, from, "info\n%s", s );
@@ -984,8 +993,15 @@ void SV_BuildNetAnswer( netadr_t from )
 	}
 	else if( type == NETAPI_REQUEST_PLAYERS )
 	{
+		const void *cached;
 		size_t len = 0;
 
+		if( SV_QueryCacheFind( QUERY_NETINFO_PLAYERS, &cached, NULL ))
+		{
+			Netchan_OutOfBandPrint( NS_SERVER, from, "netinfo %i %i %s\n", context, type, (const char *)cached );
+			return;
+		}
+
 		string[0] = '\0';
 
 		for( i = 0; i < svs.maxclients; i++ )
@@ -1008,11 +1024,21 @@ void SV_BuildNetAnswer( netadr_t from )
 			}
 		}
 
+		SV_QueryCacheStore( QUERY_NETINFO_PLAYERS, string, len + 1 );
+
 		// send playernames
 		Netchan_OutOfBandPrint( NS_SERVER, from, "netinfo %i %i %s\n", context, type, string );
 	}
 	else if( type == NETAPI_REQUEST_DETAILS )
 	{
+		const void *cached;
+
+		if( SV_QueryCacheFind( QUERY_NETINFO_DETAILS, &cached, NULL ))
+		{
+			Netchan_OutOfBandPrint( NS_SERVER, from, "netinfo %i %i %s\n", context, type, (const char *)cached );
+			return;
+		}
+
 		for( i = 0; i < svs.maxclients; i++ )
 			if( svs.clients[i].state >= cs_connected )
 				count++;
@@ -1023,6 +1049,7 @@ void SV_BuildNetAnswer( netadr_t from )
 		Info_SetValueForKeyf( string, "current", MAX_INFO_STRING, "%i", count );
 		Info_SetValueForKeyf( string, "max", MAX_INFO_STRING, "%i", svs.maxclients );
 		Info_SetValueForKey( string, "map", sv.name, MAX_INFO_STRING );
+		SV_QueryCacheStore( QUERY_NETINFO_DETAILS, string, Q_strlen( string ) + 1 );
 
 		// send serverinfo
 		Netchan_OutOfBandPrint( NS_SERVER, from, "netinfo %i %i %s\n", context, type, string );
@@ -1489,7 +1516,7 @@ void SV_PutClientInServer( sv_client_t *cl )
 		int	viewEnt;
 
 		// NOTE: it's will be fragmented automatically in right ordering
-		MSG_WriteBits( &msg, MSG_GetData( &sv.signon ), MSG_GetNumBitsWritten( &sv.signon ));
+		SV_SendSignonBlob( cl, &msg, SIGNON_BLOB_SIGNON );
 
 		if( cl->pViewEntity )
 			viewEnt = NUM_FOR_EDICT( cl->pViewEntity );
@@ -1573,6 +1600,7 @@ SV_SendServerdata
 
 Sends the first message from the server to a connected client.
 This will be sent on the initial connection and upon each server load.
+Client independent part follows in SIGNON_BLOB_NEW.
 ================
 */
 void SV_SendServerdata( sizebuf_t *msg, sv_client_t *cl )
@@ -1609,16 +1637,17 @@ void SV_SendServerdata( sizebuf_t *msg, sv_client_t *cl )
 		MSG_WriteChar( msg, host.player_mins[i/3][i%3] );
 		MSG_WriteChar( msg, host.player_maxs[i/3][i%3] );
 	}
+}
 
-	// send delta-encoding
-	Delta_WriteDescriptionToClient( msg );
-
-	// now client know delta and can reading encoded messages
-	SV_FullUpdateMovevars( cl, msg );
+/*
+================
+SV_SendLightstyles
 
-	// send the user messages registration
-	for( i = 1; i < MAX_USER_MESSAGES && svgame.msg[i].name[0]; i++ )
-		SV_SendUserReg( msg, &svgame.msg[i] );
+================
+*/
+static void SV_SendLightstyles( sizebuf_t *msg )
+{
+	int	i;
 
 	for( i = 0; i < MAX_LIGHTSTYLES; i++ )
 	{
@@ -1632,6 +1661,189 @@ void SV_SendServerdata( sizebuf_t *msg, sv_client_t *cl )
 	}
 }
 
+/*
+=============================================================================
+
+Parts of signon that are same for every client are built once and
+shared by all channels, so clients that connect after level change
+don't serialize and compress them again. Blob is rebuilt if something
+it was built from is changed during the level.
+
+=============================================================================
+*/
+static const char *sv_signonblob_names[SIGNON_BLOB_COUNT] =
+{
+	"new",
+	"signon",
+	"resources",
+	"resources with consistency",
+};
+
+/*
+================
+SV_WriteSignonBlob
+
+================
+*/
+static void SV_WriteSignonBlob( sizebuf_t *msg, sv_signonblob_t type )
+{
+	int	i;
+
+	switch( type )
+	{
+	case SIGNON_BLOB_NEW:
+		// send delta-encoding
+		Delta_WriteDescriptionToClient( msg );
+
+		// now client know delta and can reading encoded messages
+		SV_FullUpdateMovevars( NULL, msg );
+
+		// send the user messages registration
+		for( i = 1; i < MAX_USER_MESSAGES && svgame.msg[i].name[0]; i++ )
+			SV_SendUserReg( msg, &svgame.msg[i] );
+		break;
+	case SIGNON_BLOB_SIGNON:
+		MSG_WriteBits( msg, MSG_GetData( &sv.signon ), MSG_GetNumBitsWritten( &sv.signon ));
+		break;
+	case SIGNON_BLOB_RESOURCES:
+	case SIGNON_BLOB_RESOURCES_CONSISTENCY:
+		SV_WriteResources( msg, type == SIGNON_BLOB_RESOURCES_CONSISTENCY );
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+================
+SV_SignonBlobKey
+
+checksum of everything blob depends on that can change during level
+================
+*/
+static uint SV_SignonBlobKey( sv_signonblob_t type )
+{
+	uint32_t	crc;
+	int	i, bits;
+
+	CRC32_Init( &crc );
+	CRC32_ProcessBuffer( &crc, &svs.spawncount, sizeof( svs.spawncount ));
+
+	switch( type )
+	{
+	case SIGNON_BLOB_NEW:
+		CRC32_ProcessBuffer( &crc, &svgame.movevars, sizeof( svgame.movevars ));
+
+		// user messages can be registered while game is running
+		for( i = 1; i < MAX_USER_MESSAGES && svgame.msg[i].name[0]; i++ )
+			CRC32_ProcessBuffer( &crc, svgame.msg[i].name, Q_strlen( svgame.msg[i].name ));
+		break;
+	case SIGNON_BLOB_SIGNON:
+		// pfnMakeStatic appends to it while game is running
+		bits = MSG_GetNumBitsWritten( &sv.signon );
+		CRC32_ProcessBuffer( &crc, &bits, sizeof( bits ));
+		CRC32_ProcessBuffer( &crc, MSG_GetData( &sv.signon ), MSG_GetNumBytesWritten( &sv.signon ));
+		break;
+	case SIGNON_BLOB_RESOURCES:
+	case SIGNON_BLOB_RESOURCES_CONSISTENCY:
+		CRC32_ProcessBuffer( &crc, sv_downloadurl.string, Q_strlen( sv_downloadurl.string ));
+		break;
+	default:
+		break;
+	}
+
+	return CRC32_Final( crc );
+}
+
+/*
+================
+SV_GetSignonBlob
+
+returns NULL if blob can't be used
+================
+*/
+static fragblob_t *SV_GetSignonBlob( sv_signonblob_t type )
+{
+	uint	key;
+	sizebuf_t	msg;
+	byte	*buf;
+
+	// sv.signon is still written while loading
+	if( sv.state != ss_active )
+		return NULL;
+
+	key = SV_SignonBlobKey( type );
+
+	if( svs.signon_keys[type] == key && svs.signon_blobs[type] )
+		return svs.signon_blobs[type];
+
+	Netchan_ReleaseFragBlob( &svs.signon_blobs[type] );
+	svs.signon_keys[type] = key;
+
+	buf = Mem_Malloc( host.mempool, MAX_INIT_MSG );
+	MSG_Init( &msg, "SignonBlob", buf, MAX_INIT_MSG );
+
+	SV_WriteSignonBlob( &msg, type );
+
+	// caller will handle overflow when it's written again
+	if( !MSG_CheckOverflow( &msg ))
+	{
+		svs.signon_blobs[type] = Netchan_CreateFragBlob( &msg );
+
+		if( svs.signon_blobs[type] )
+		{
+			Con_Reportf( "%s: %s blob is %i bytes (%i uncompressed)\n", __func__, sv_signonblob_names[type],
+				svs.signon_blobs[type]->size, MSG_GetNumBytesWritten( &msg ));
+		}
+	}
+
+	Mem_Free( buf );
+
+	return svs.signon_blobs[type];
+}
+
+/*
+================
+SV_SendSignonBlob
+
+queues everything written to msg so far and then shared blob,
+or just writes blob contents to msg if it can't be shared
+================
+*/
+void SV_SendSignonBlob( sv_client_t *cl, sizebuf_t *msg, sv_signonblob_t type )
+{
+	fragblob_t	*blob = SV_GetSignonBlob( type );
+
+	if( !blob )
+	{
+		SV_WriteSignonBlob( msg, type );
+		return;
+	}
+
+	if( MSG_GetNumBytesWritten( msg ) > 0 )
+	{
+		Netchan_CreateFragments( &cl->netchan, msg );
+		MSG_Clear( msg );
+	}
+
+	Netchan_CreateBlobFragments( &cl->netchan, blob );
+}
+
+/*
+================
+SV_FreeSignonBlobs
+
+channels keep their references until fragments are sent
+================
+*/
+void SV_FreeSignonBlobs( void )
+{
+	int	i;
+
+	for( i = 0; i < SIGNON_BLOB_COUNT; i++ )
+		Netchan_ReleaseFragBlob( &svs.signon_blobs[i] );
+}
+
 /*
 ============================================================
 
@@ -1683,6 +1895,9 @@ static qboolean SV_New_f( sv_client_t *cl )
 		return true;
 	}
 
+	SV_SendSignonBlob( cl, &msg, SIGNON_BLOB_NEW );
+	SV_SendLightstyles( &msg );
+
 	// server info string
 	MSG_BeginServerCmd( &msg, svc_stufftext );
 	MSG_WriteStringf( &msg, "fullserverinfo \"%s\"\n", SV_Serverinfo( ));
@@ -3137,12 +3352,12 @@ void SV_ConnectionlessPacket( netadr_t from, sizebuf_t *msg )
 
 	if( !Q_strcmp( pcmd, "ping" )) SV_Ping( from );
 	else if( !Q_strcmp( pcmd, "ack" )) SV_Ack( from );
-	else if( !Q_strcmp( pcmd, "info" )) SV_Info( from, Q_atoi( Cmd_Argv( 1 )));
+	else if( !Q_strcmp( pcmd, "info" )) { if( SV_CheckQueryRate( from )) SV_Info( from, Q_atoi( Cmd_Argv( 1 ))); }
 	else if( !Q_strcmp( pcmd, "bandwidth" )) SV_TestBandWidth( from );
 	else if( !Q_strcmp( pcmd, "getchallenge" )) SV_GetChallenge( from );
 	else if( !Q_strcmp( pcmd, "connect" )) SV_ConnectClient( from );
 	else if( !Q_strcmp( pcmd, "rcon" )) SV_RemoteCommand( from, msg );
-	else if( !Q_strcmp( pcmd, "netinfo" )) SV_BuildNetAnswer( from );
+	else if( !Q_strcmp( pcmd, "netinfo" )) { if( SV_CheckQueryRate( from )) SV_BuildNetAnswer( from ); }
 	else if( !Q_strcmp( pcmd, "s" )) SV_AddToMaster( from, msg );
 	else if( !Q_strcmp( pcmd, "i" )) NET_SendPacket( NS_SERVER, 5, "\xFF\xFF\xFF\xFFj", from ); // A2A_PING
 	else if( SV_SourceQuery_HandleConnnectionlessPacket( pcmd, from )) { } // function handles replies
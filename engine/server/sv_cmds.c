@@ -1012,6 +1012,10 @@ void SV_InitOperatorCommands( void )
 	Cmd_AddCommand( "entpatch", SV_EntPatch_f, "write entity patch to allow external editing" );
 	Cmd_AddCommand( "edict_usage", SV_EdictUsage_f, "show info about edicts usage" );
 	Cmd_AddCommand( "entity_info", SV_EntityInfo_f, "show more info about edicts" );
+	Cmd_AddCommand( "sv_tracebench", SV_TraceBench_f, "record SV_Move calls and compare their speed with classic and adaptive areanodes" );
+	Cmd_AddCommand( "sv_sendbench", SV_SendBench_f, "compare serial and parallel snapshot building for bots" );
+	Cmd_AddCommand( "sv_deltabench", SV_DeltaBench_f, "compare compiled and interpreted delta encoders on entities sent to clients" );
+	Cmd_AddCommand( "sv_querystats", SV_QueryStats_f, "prints counters of dropped, cached and built query replies" );
 	Cmd_AddCommand( "shutdownserver", SV_KillServer_f, "shutdown current server" );
 	Cmd_AddCommand( "changelevel", SV_ChangeLevel_f, "change level" );
 	Cmd_AddCommand( "changelevel2", SV_ChangeLevel2_f, "smooth change level" );
@@ -1050,6 +1054,10 @@ void SV_KillOperatorCommands( void )
 	Cmd_RemoveCommand( "entpatch" );
 	Cmd_RemoveCommand( "edict_usage" );
 	Cmd_RemoveCommand( "entity_info" );
+	Cmd_RemoveCommand( "sv_tracebench" );
+	Cmd_RemoveCommand( "sv_sendbench" );
+	Cmd_RemoveCommand( "sv_deltabench" );
+	Cmd_RemoveCommand( "sv_querystats" );
 	Cmd_RemoveCommand( "shutdownserver" );
 	Cmd_RemoveCommand( "changelevel" );
 	Cmd_RemoveCommand( "changelevel2" );
@@ -246,19 +246,17 @@ void SV_TransferConsistencyInfo( void )
 	sv.num_consistency = total;
 }
 
-void SV_SendConsistencyList( sv_client_t *cl, sizebuf_t *msg )
+static void SV_WriteConsistencyList( sizebuf_t *msg, qboolean consistency )
 {
 	int	i, lastcheck;
 	int	delta;
 
-	if( svs.maxclients == 1 || !sv_consistency.value || !sv.num_consistency || FBitSet( cl->flags, FCL_HLTV_PROXY ))
+	if( !consistency )
 	{
-		ClearBits( cl->flags, FCL_FORCE_UNMODIFIED );
 		MSG_WriteOneBit( msg, 0 );
 		return;
 	}
 
-	SetBits( cl->flags, FCL_FORCE_UNMODIFIED );
 	MSG_WriteOneBit( msg, 1 );
 	lastcheck = 0;
 
@@ -554,7 +552,14 @@ void SV_SendResource( resource_t *pResource, sizebuf_t *msg )
 	else MSG_WriteOneBit( msg, 0 );
 }
 
-void SV_SendResources( sv_client_t *cl, sizebuf_t *msg )
+/*
+==================
+SV_WriteResources
+
+same for all clients, so it's sent from signon blob
+==================
+*/
+void SV_WriteResources( sizebuf_t *msg, qboolean consistency )
 {
 	int	i;
 
@@ -576,5 +581,19 @@ void SV_SendResources( sv_client_t *cl, sizebuf_t *msg )
 		SV_SendResource( &sv.resources[i], msg );
 	}
 
-	SV_SendConsistencyList( cl, msg );
+	SV_WriteConsistencyList( msg, consistency );
+}
+
+void SV_SendResources( sv_client_t *cl, sizebuf_t *msg )
+{
+	if( svs.maxclients == 1 || !sv_consistency.value || !sv.num_consistency || FBitSet( cl->flags, FCL_HLTV_PROXY ))
+	{
+		ClearBits( cl->flags, FCL_FORCE_UNMODIFIED );
+		SV_SendSignonBlob( cl, msg, SIGNON_BLOB_RESOURCES );
+	}
+	else
+	{
+		SetBits( cl->flags, FCL_FORCE_UNMODIFIED );
+		SV_SendSignonBlob( cl, msg, SIGNON_BLOB_RESOURCES_CONSISTENCY );
+	}
 }
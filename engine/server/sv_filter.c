@@ -273,40 +273,220 @@ static void SV_ShutdownIDFilter( void )
 
 CLIENT IP FILTER
 
+Filters are kept in binary radix trie, one per address family, so address
+check visits at most one node per address bit no matter how many filters
+there are. Nodes that aren't filters only join two branches and are freed
+as soon as they have less than two children.
+
 =============================================================================
 */
 
 typedef struct ipfilter_s
 {
 	float endTime;
-	struct ipfilter_s *next;
+	struct ipfilter_s *child[2];
 	netadr_t adr;
 	uint prefixlen;
+	qboolean active;	// false if node only joins branches
+	uint seq;	// when filter was added, removeip takes the newest first
+	uint8_t key[16];	// address bytes in network order, masked by prefixlen
 } ipfilter_t;
 
-static ipfilter_t *ipfilter = NULL;
+#define IPFILTER_BIT( key, bit ) ((( key )[( bit ) >> 3] >> ( 7 - (( bit ) & 7 ))) & 1 )
 
-static void SV_CleanExpiredIPFilters( void )
+static ipfilter_t *ipfilter[2];	// IPv4 and IPv6 tries
+static int ipfilter_count;
+static uint ipfilter_seq;
+
+/*
+=================
+SV_IPFilterKey
+
+returns trie index for address, -1 if it can't be filtered
+=================
+*/
+static int SV_IPFilterKey( const netadr_t *adr, uint8_t *key, uint *maxbits )
+{
+	if( adr->type6 == NA_IP6 )
+	{
+		NET_NetadrToIP6Bytes( key, adr );
+		*maxbits = 128;
+		return 1;
+	}
+
+	if( adr->type == NA_IP )
+	{
+		memset( key, 0, 16 );
+		memcpy( key, adr->ip, sizeof( adr->ip ));
+		*maxbits = 32;
+		return 0;
+	}
+
+	return -1;
+}
+
+static void SV_IPFilterMaskKey( uint8_t *key, uint prefixlen )
+{
+	uint i;
+
+	for( i = 0; i < 16; i++ )
+	{
+		if( prefixlen >= ( i + 1 ) * 8 )
+			continue;
+
+		if( prefixlen > i * 8 )
+			key[i] &= (uint8_t)( 0xFF << ( 8 - ( prefixlen - i * 8 )));
+		else key[i] = 0;
+	}
+}
+
+/*
+=================
+SV_IPFilterCommonBits
+
+length of common prefix, up to maxbits, bits before first must be equal
+=================
+*/
+static uint SV_IPFilterCommonBits( const uint8_t *a, const uint8_t *b, uint first, uint maxbits )
+{
+	uint i;
+
+	for( i = first & ~7U; i < maxbits; i += 8 )
+	{
+		uint8_t diff = a[i >> 3] ^ b[i >> 3];
+
+		if( diff )
+		{
+			while( !FBitSet( diff, 0x80 ))
+			{
+				diff <<= 1;
+				i++;
+			}
+
+			return Q_min( i, maxbits );
+		}
+	}
+
+	return maxbits;
+}
+
+static ipfilter_t *SV_AllocIPFilter( const uint8_t *key, uint prefixlen )
+{
+	ipfilter_t *f = Mem_Calloc( host.mempool, sizeof( *f ));
+
+	memcpy( f->key, key, sizeof( f->key ));
+	SV_IPFilterMaskKey( f->key, prefixlen );
+	f->prefixlen = prefixlen;
+
+	return f;
+}
+
+/*
+=================
+SV_AddIPFilter
+
+same subnet added twice is banned until later of two times
+=================
+*/
+static void SV_AddIPFilter( const netadr_t *adr, uint prefixlen, float endTime )
 {
-	ipfilter_t *f, **back;
+	ipfilter_t **link, *f;
+	uint8_t key[16];
+	uint maxbits;
+	int family;
+
+	if(( family = SV_IPFilterKey( adr, key, &maxbits )) < 0 )
+		return;
+
+	prefixlen = Q_min( prefixlen, maxbits );
 
-	back = &ipfilter;
-	while( 1 )
+	for( link = &ipfilter[family]; ; link = &f->child[IPFILTER_BIT( key, f->prefixlen )] )
 	{
-		f = *back;
-		if( !f ) return;
+		uint common;
+
+		if( !( f = *link ))
+		{
+			f = *link = SV_AllocIPFilter( key, prefixlen );
+			break;
+		}
 
-		if( f->endTime && host.realtime > f->endTime )
+		common = SV_IPFilterCommonBits( key, f->key, 0, Q_min( prefixlen, f->prefixlen ));
+
+		if( common == f->prefixlen )
 		{
-			*back = f->next;
-			back = &f->next;
+			if( f->prefixlen == prefixlen )
+				break;
 
-			Mem_Free( f );
+			continue; // go down
+		}
+
+		if( common == prefixlen )
+		{
+			// new subnet includes this node
+			ipfilter_t *parent = SV_AllocIPFilter( key, prefixlen );
+
+			parent->child[IPFILTER_BIT( f->key, prefixlen )] = f;
+			f = *link = parent;
+		}
+		else
+		{
+			// subnets diverge, join them
+			ipfilter_t *branch = SV_AllocIPFilter( key, common );
+			ipfilter_t *leaf = SV_AllocIPFilter( key, prefixlen );
+
+			branch->child[IPFILTER_BIT( f->key, common )] = f;
+			branch->child[IPFILTER_BIT( key, common )] = leaf;
+			*link = branch;
+			f = leaf;
 		}
-		else back = &f->next;
+		break;
+	}
+
+	// adding it again makes it the most recent one, like the filter list did
+	f->seq = ++ipfilter_seq;
+
+	if( !f->active )
+	{
+		f->active = true;
+		f->adr = *adr;
+		f->endTime = endTime;
+		ipfilter_count++;
+	}
+	else if( !endTime || ( f->endTime && endTime > f->endTime ))
+	{
+		f->endTime = endTime;
 	}
 }
 
+static void SV_FreeIPFilters( ipfilter_t *f )
+{
+	if( !f )
+		return;
+
+	SV_FreeIPFilters( f->child[0] );
+	SV_FreeIPFilters( f->child[1] );
+	Mem_Free( f );
+}
+
+/*
+=================
+SV_WalkIPFilters
+
+calls func for every filter in address order
+=================
+*/
+static void SV_WalkIPFilters( ipfilter_t *f, void (*func)( ipfilter_t *f, void *data ), void *data )
+{
+	if( !f )
+		return;
+
+	if( f->active )
+		func( f, data );
+
+	SV_WalkIPFilters( f->child[0], func, data );
+	SV_WalkIPFilters( f->child[1], func, data );
+}
+
 static int SV_FilterToString( char *dest, size_t size, qboolean config, ipfilter_t *f )
 {
 	const char *strformat;
@@ -338,58 +518,254 @@ static qboolean SV_IPFilterIncludesIPFilter( ipfilter_t *a, ipfilter_t *b )
 	return NET_CompareAdrByMask( a->adr, b->adr, b->prefixlen );
 }
 
-static void SV_RemoveIPFilter( ipfilter_t *toremove, qboolean removeAll, qboolean verbose )
+/*
+=================
+SV_NewestIPFilter
+
+sequence number of the most recently added filter
+that contains the address of toremove, 0 if none
+=================
+*/
+static uint SV_NewestIPFilter( const ipfilter_t *f, const ipfilter_t *toremove, uint maxbits )
 {
-	ipfilter_t *f, **back;
+	uint seq = 0;
 
-	back = &ipfilter;
-	while( 1 )
+	for( ; f; f = f->child[IPFILTER_BIT( toremove->key, f->prefixlen )] )
 	{
-		f = *back;
-		if( !f ) return;
+		if( SV_IPFilterCommonBits( toremove->key, f->key, 0, f->prefixlen ) != f->prefixlen )
+			break;
 
-		if( SV_IPFilterIncludesIPFilter( toremove, f ))
-		{
-			if( verbose )
-			{
-				string filterStr;
+		if( f->active && f->seq > seq )
+			seq = f->seq;
 
-				SV_FilterToString( filterStr, sizeof( filterStr ), false, f );
+		if( f->prefixlen >= maxbits )
+			break;
+	}
 
-				Con_Printf( "%s removed.\n", filterStr );
-			}
+	return seq;
+}
+
+/*
+=================
+SV_RemoveIPFilters
+
+removes filters that contain the address of toremove, compared at
+the filter's own prefix length like removeip always did, or expired
+ones if it's NULL, and frees nodes that aren't needed anymore.
+Non-zero seq removes only the filter added with that number
+=================
+*/
+static void SV_RemoveIPFilters( ipfilter_t **link, ipfilter_t *toremove, uint seq, qboolean verbose, int *removed )
+{
+	ipfilter_t *f = *link;
 
-			*back = f->next;
-			back = &f->next;
+	if( !f || ( seq && *removed ))
+		return;
 
-			Mem_Free( f );
+	// such filters are all on the path of toremove address
+	if( toremove && SV_IPFilterCommonBits( toremove->key, f->key, 0, f->prefixlen ) != f->prefixlen )
+		return;
 
-			if( !removeAll )
-				break;
+	if( f->active && ( toremove ? ( !seq || f->seq == seq ) : ( f->endTime && host.realtime > f->endTime )))
+	{
+		if( verbose )
+		{
+			string filterStr;
+
+			SV_FilterToString( filterStr, sizeof( filterStr ), false, f );
+			Con_Printf( "%s removed.\n", filterStr );
 		}
-		else back = &f->next;
+
+		f->active = false;
+		ipfilter_count--;
+		(*removed)++;
+	}
+
+	SV_RemoveIPFilters( &f->child[0], toremove, seq, verbose, removed );
+	SV_RemoveIPFilters( &f->child[1], toremove, seq, verbose, removed );
+
+	if( !f->active && !( f->child[0] && f->child[1] ))
+	{
+		*link = f->child[0] ? f->child[0] : f->child[1];
+		Mem_Free( f );
 	}
 }
 
+static void SV_CleanExpiredIPFilters( void )
+{
+	int removed = 0;
+
+	SV_RemoveIPFilters( &ipfilter[0], NULL, 0, false, &removed );
+	SV_RemoveIPFilters( &ipfilter[1], NULL, 0, false, &removed );
+}
+
+/*
+=================
+SV_RemoveIPFilter
+
+without removeAll only the most recently added
+filter that contains the address is removed
+=================
+*/
+static void SV_RemoveIPFilter( ipfilter_t *toremove, qboolean removeAll, qboolean verbose )
+{
+	int removed = 0;
+	uint maxbits, seq = 0;
+	int family;
 
+	if(( family = SV_IPFilterKey( &toremove->adr, toremove->key, &maxbits )) < 0 )
+		return;
+
+	if( !removeAll && !( seq = SV_NewestIPFilter( ipfilter[family], toremove, maxbits )))
+		return;
+
+	SV_RemoveIPFilters( &ipfilter[family], toremove, seq, verbose, &removed );
+}
+
+/*
+=================
+SV_CheckIP
+
+returns true if address is banned
+=================
+*/
 qboolean SV_CheckIP( netadr_t *adr )
 {
-	// TODO: ip rate limit
-	ipfilter_t *entry = ipfilter;
+	const ipfilter_t *f;
+	uint8_t key[16];
+	uint maxbits, checked = 0;
+	int family;
+
+	if(( family = SV_IPFilterKey( adr, key, &maxbits )) < 0 )
+		return false;
+
+	for( f = ipfilter[family]; f; f = f->child[IPFILTER_BIT( key, f->prefixlen )] )
+	{
+		// parent prefix is already checked
+		if( SV_IPFilterCommonBits( key, f->key, checked, f->prefixlen ) != f->prefixlen )
+			return false;
+
+		checked = f->prefixlen;
+
+		if( f->active && ( !f->endTime || host.realtime <= f->endTime ))
+			return true;
+
+		if( f->prefixlen >= maxbits )
+			break;
+	}
+
+	return false;
+}
+
+/*
+=============================================================================
+
+SERVER QUERY RATE LIMIT
+
+Every address gets a token bucket that refills at sv_query_rate tokens
+per second up to sv_query_burst, each query answered from the query cache
+(info, netinfo and source engine queries) takes one. Challenges, connects,
+rcon and master server traffic have their own checks and aren't limited.
+IPv6 addresses are limited by /64 prefix, as anyone gets whole one.
+Buckets live in small open addressed table, so a flood from many
+addresses can't grow memory usage.
+
+=============================================================================
+*/
+#define QUERYRATE_HASH_SIZE	4096	// must be power of two
+#define QUERYRATE_PROBES	8
+
+typedef struct
+{
+	uint64_t	key;	// 0 if unused
+	float		tokens;
+	double		lasttime;
+} queryrate_t;
+
+static queryrate_t queryrate[QUERYRATE_HASH_SIZE];
+
+static uint64_t SV_QueryRateKey( const netadr_t *adr )
+{
+	uint64_t key;
+
+	if( adr->type6 == NA_IP6 )
+	{
+		uint8_t ip6[16];
+
+		NET_NetadrToIP6Bytes( ip6, adr );
+		memcpy( &key, ip6, sizeof( key ));
+		return key | 1; // never zero, and IPv4 keys are even
+	}
+
+	return (uint64_t)adr->ip4 << 1;
+}
+
+static uint SV_QueryRateHash( uint64_t key )
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+
+	return (uint)key & ( QUERYRATE_HASH_SIZE - 1 );
+}
+
+/*
+=================
+SV_CheckQueryRate
+
+returns false if query from this address must be dropped
+=================
+*/
+qboolean SV_CheckQueryRate( netadr_t adr )
+{
+	float rate = sv_query_rate.value;
+	float burst = Q_max( sv_query_burst.value, 1.0f );
+	queryrate_t *entry = NULL, *oldest = NULL;
+	uint64_t key;
+	uint i, hash;
 
-	for( ; entry; entry = entry->next )
+	if( rate <= 0.0f || NET_IsLocalAddress( adr ))
+		return true;
+
+	key = SV_QueryRateKey( &adr );
+	hash = SV_QueryRateHash( key );
+
+	for( i = 0; i < QUERYRATE_PROBES; i++ )
 	{
-		switch( entry->adr.type6 )
+		queryrate_t *e = &queryrate[( hash + i ) & ( QUERYRATE_HASH_SIZE - 1 )];
+
+		if( e->key == key )
 		{
-		case NA_IP:
-		case NA_IP6:
-			if( NET_CompareAdrByMask( *adr, entry->adr, entry->prefixlen ))
-				return true;
+			entry = e;
 			break;
 		}
+
+		if( !oldest || e->lasttime < oldest->lasttime )
+			oldest = e;
 	}
 
-	return false;
+	if( entry )
+	{
+		entry->tokens = Q_min( entry->tokens + ( host.realtime - entry->lasttime ) * rate, burst );
+	}
+	else
+	{
+		// evict bucket that was idle for longest, it's likely full already
+		entry = oldest;
+		entry->key = key;
+		entry->tokens = burst;
+	}
+
+	entry->lasttime = host.realtime;
+
+	if( entry->tokens < 1.0f )
+	{
+		sv_querystats.dropped++;
+		return false;
+	}
+
+	entry->tokens -= 1.0f;
+	return true;
 }
 
 static void SV_AddIP_PrintUsage( void )
@@ -418,7 +794,7 @@ static void SV_AddIP_f( void )
 {
 	const char *szMinutes = Cmd_Argv( 1 );
 	const char *adr = Cmd_Argv( 2 );
-	ipfilter_t filter, *newfilter;
+	ipfilter_t filter;
 	float minutes;
 	int i;
 
@@ -445,13 +821,8 @@ static void SV_AddIP_f( void )
 		return;
 	}
 
-	newfilter = Mem_Malloc( host.mempool, sizeof( *newfilter ));
-	newfilter->endTime = filter.endTime;
-	newfilter->adr = filter.adr;
-	newfilter->prefixlen = filter.prefixlen;
-	newfilter->next = ipfilter;
-
-	ipfilter = newfilter;
+	SV_CleanExpiredIPFilters();
+	SV_AddIPFilter( &filter.adr, filter.prefixlen, filter.endTime );
 
 	for( i = 0; i < svs.maxclients; i++ )
 	{
@@ -465,10 +836,21 @@ static void SV_AddIP_f( void )
 	}
 }
 
+static void SV_ListIPFilter( ipfilter_t *f, void *data )
+{
+	string filterStr;
+
+	if( data && !SV_IPFilterIncludesIPFilter( data, f ))
+		return;
+
+	SV_FilterToString( filterStr, sizeof( filterStr ), false, f );
+	Con_Printf( "%s\n", filterStr );
+}
+
 static void SV_ListIP_f( void )
 {
 	qboolean haveFilter = false;
-	ipfilter_t filter, *f;
+	ipfilter_t filter;
 
 	if( Cmd_Argc() > 2 )
 	{
@@ -476,7 +858,9 @@ static void SV_ListIP_f( void )
 		return;
 	}
 
-	if( ipfilter == NULL )
+	SV_CleanExpiredIPFilters();
+
+	if( !ipfilter_count )
 	{
 		Con_Printf( "IP filter list is empty\n" );
 		return;
@@ -496,16 +880,8 @@ static void SV_ListIP_f( void )
 
 	Con_Printf( "IP filter list:\n" );
 
-	for( f = ipfilter; f; f = f->next )
-	{
-		string filterStr;
-
-		if( haveFilter && !SV_IPFilterIncludesIPFilter( &filter, f ))
-			continue;
-
-		SV_FilterToString( filterStr, sizeof( filterStr ), false, f );
-		Con_Printf( "%s\n", filterStr );
-	}
+	SV_WalkIPFilters( ipfilter[0], SV_ListIPFilter, haveFilter ? &filter : NULL );
+	SV_WalkIPFilters( ipfilter[1], SV_ListIPFilter, haveFilter ? &filter : NULL );
 }
 
 static void SV_RemoveIP_f( void )
@@ -530,13 +906,26 @@ static void SV_RemoveIP_f( void )
 		return;
 	}
 
+	SV_CleanExpiredIPFilters();
 	SV_RemoveIPFilter( &filter, removeAll, true );
 }
 
+static void SV_WriteIPFilter( ipfilter_t *f, void *data )
+{
+	string filterStr;
+	int size;
+
+	// do not save temporary bans
+	if( f->endTime )
+		return;
+
+	size = SV_FilterToString( filterStr, sizeof( filterStr ), true, f );
+	FS_Write( data, filterStr, size );
+}
+
 static void SV_WriteIP_f( void )
 {
 	file_t *fd = FS_Open( Cvar_VariableString( "listipcfgfile" ), "w", true );
-	ipfilter_t *f;
 
 	if( !fd )
 	{
@@ -544,18 +933,8 @@ static void SV_WriteIP_f( void )
 		return;
 	}
 
-	for( f = ipfilter; f; f = f->next )
-	{
-		string filterStr;
-		int size;
-
-		// do not save temporary bans
-		if( f->endTime )
-			continue;
-
-		size = SV_FilterToString( filterStr, sizeof( filterStr ), true, f );
-		FS_Write( fd, filterStr, size );
-	}
+	SV_WalkIPFilters( ipfilter[0], SV_WriteIPFilter, fd );
+	SV_WalkIPFilters( ipfilter[1], SV_WriteIPFilter, fd );
 
 	FS_Close( fd );
 }
@@ -570,18 +949,13 @@ static void SV_InitIPFilter( void )
 
 static void SV_ShutdownIPFilter( void )
 {
-	ipfilter_t *ipList, *ipNext;
-
 	// should be called manually because banned.cfg is not executed by engine
 	//SV_WriteIP_f();
 
-	for( ipList = ipfilter; ipList; ipList = ipNext )
-	{
-		ipNext = ipList->next;
-		Mem_Free( ipList );
-	}
-
-	ipfilter = NULL;
+	SV_FreeIPFilters( ipfilter[0] );
+	SV_FreeIPFilters( ipfilter[1] );
+	ipfilter[0] = ipfilter[1] = NULL;
+	ipfilter_count = 0;
 }
 
 void SV_InitFilter( void )
@@ -719,10 +1093,291 @@ void Test_IPFilterIncludesIPFilter( void )
 	}
 }
 
+static uint32_t Test_IPFilterRandom( uint32_t *seed )
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+
+	return *seed;
+}
+
+static void Test_IPFilterRandomAdr( uint32_t *seed, netadr_t *adr, qboolean ipv6 )
+{
+	uint8_t ip6[16];
+	int i;
+
+	memset( adr, 0, sizeof( *adr ));
+
+	for( i = 0; i < 16; i++ )
+		ip6[i] = Test_IPFilterRandom( seed );
+
+	if( ipv6 )
+	{
+		// keep to few /16 so prefixes overlap
+		ip6[0] = 0x20;
+		ip6[1] &= 0x03;
+		NET_IP6BytesToNetadr( adr, ip6 );
+		adr->type6 = NA_IP6;
+	}
+	else
+	{
+		adr->type = NA_IP;
+		memcpy( adr->ip, ip6, sizeof( adr->ip ));
+	}
+}
+
+#define TEST_IPFILTER_COUNT	100000
+#define TEST_IPFILTER_LINEAR	200	// checks against linear search, it's slow
+#define TEST_IPFILTER_LOOKUPS	1000000
+
+static qboolean Test_IPFilterLinear( const ipfilter_t *list, int count, const netadr_t *adr )
+{
+	int i;
+
+	for( i = 0; i < count; i++ )
+	{
+		if( list[i].active && NET_CompareAdrByMask( *adr, list[i].adr, list[i].prefixlen ))
+			return true;
+	}
+
+	return false;
+}
+
+static void Test_IPFilterTrie( void )
+{
+	ipfilter_t *saved[2] = { ipfilter[0], ipfilter[1] };
+	int savedcount = ipfilter_count;
+	ipfilter_t *list, toremove;
+	uint32_t seed = 0x9e3779b9;
+	int i, hits, wrong;
+	double start, trie_time, linear_time;
+	netadr_t adr;
+
+	ipfilter[0] = ipfilter[1] = NULL;
+	ipfilter_count = 0;
+
+	// same subnet with different times is one filter
+	NET_StringToFilterAdr( "10.1.0.0/16", &adr, &toremove.prefixlen );
+	SV_AddIPFilter( &adr, 16, host.realtime + 60.0f );
+	SV_AddIPFilter( &adr, 16, 0.0f );
+	SV_AddIPFilter( &adr, 16, host.realtime + 30.0f );
+	TASSERT_EQi( ipfilter_count, 1 );
+	TASSERT( ipfilter[0] && ipfilter[0]->endTime == 0.0f );
+
+	// expired filter doesn't match and is cleaned up
+	NET_StringToFilterAdr( "10.2.3.4", &adr, &toremove.prefixlen );
+	SV_AddIPFilter( &adr, 32, host.realtime - 1.0f );
+	TASSERT_EQi( ipfilter_count, 2 );
+	TASSERT( !SV_CheckIP( &adr ));
+	SV_CleanExpiredIPFilters();
+	TASSERT_EQi( ipfilter_count, 1 );
+	NET_StringToFilterAdr( "10.1.200.3", &adr, &toremove.prefixlen );
+	TASSERT( SV_CheckIP( &adr ));
+
+	// without removeAll only the newest of filters that include address goes
+	NET_StringToFilterAdr( "10.1.2.0/24", &adr, &toremove.prefixlen );
+	SV_AddIPFilter( &adr, 24, 0.0f );
+	NET_StringToFilterAdr( "10.1.2.3", &toremove.adr, &toremove.prefixlen );
+	SV_RemoveIPFilter( &toremove, false, false );
+	TASSERT_EQi( ipfilter_count, 1 );
+	TASSERT( SV_CheckIP( &toremove.adr ));
+	TASSERT( ipfilter[0] && ipfilter[0]->prefixlen == 16 );
+	SV_RemoveIPFilter( &toremove, false, false );
+	TASSERT_EQi( ipfilter_count, 0 );
+	TASSERT( !SV_CheckIP( &toremove.adr ));
+	TASSERT( ipfilter[0] == NULL );
+
+	// same with the wider subnet added last
+	NET_StringToFilterAdr( "10.1.2.0/24", &adr, &toremove.prefixlen );
+	SV_AddIPFilter( &adr, 24, 0.0f );
+	NET_StringToFilterAdr( "10.1.0.0/16", &adr, &toremove.prefixlen );
+	SV_AddIPFilter( &adr, 16, 0.0f );
+	NET_StringToFilterAdr( "10.1.2.3", &toremove.adr, &toremove.prefixlen );
+	SV_RemoveIPFilter( &toremove, false, false );
+	TASSERT_EQi( ipfilter_count, 1 );
+	TASSERT( SV_CheckIP( &toremove.adr ));
+	NET_StringToFilterAdr( "10.1.200.3", &adr, &toremove.prefixlen );
+	TASSERT( !SV_CheckIP( &adr ));
+	SV_RemoveIPFilter( &toremove, false, false );
+	TASSERT_EQi( ipfilter_count, 0 );
+	TASSERT( ipfilter[0] == NULL );
+
+	// subnet removes filters that contain its address, even more specific ones
+	NET_StringToFilterAdr( "10.1.2.0", &adr, &toremove.prefixlen );
+	SV_AddIPFilter( &adr, 32, 0.0f );
+	NET_StringToFilterAdr( "10.1.2.5", &adr, &toremove.prefixlen );
+	SV_AddIPFilter( &adr, 32, 0.0f );
+	NET_StringToFilterAdr( "10.0.0.0/8", &adr, &toremove.prefixlen );
+	SV_AddIPFilter( &adr, 8, 0.0f );
+	NET_StringToFilterAdr( "10.1.2.0/24", &toremove.adr, &toremove.prefixlen );
+	SV_RemoveIPFilter( &toremove, true, false );
+	TASSERT_EQi( ipfilter_count, 1 );
+	TASSERT( !SV_CheckIP( &toremove.adr ));
+	NET_StringToFilterAdr( "10.1.2.5", &toremove.adr, &toremove.prefixlen );
+	TASSERT( SV_CheckIP( &toremove.adr ));
+	SV_RemoveIPFilter( &toremove, true, false );
+	TASSERT_EQi( ipfilter_count, 0 );
+	TASSERT( ipfilter[0] == NULL );
+
+	// random filters, IPv4 /16 to /32 and IPv6 /24 to /128
+	list = Mem_Calloc( host.mempool, sizeof( *list ) * TEST_IPFILTER_COUNT );
+	for( i = 0; i < TEST_IPFILTER_COUNT; i++ )
+	{
+		qboolean ipv6 = i % 5 == 0;
+		uint maxbits;
+
+		Test_IPFilterRandomAdr( &seed, &list[i].adr, ipv6 );
+		list[i].prefixlen = ipv6 ? 24 + Test_IPFilterRandom( &seed ) % 105 : 16 + Test_IPFilterRandom( &seed ) % 17;
+
+		// linear search expects filter address to be masked
+		SV_IPFilterKey( &list[i].adr, list[i].key, &maxbits );
+		SV_IPFilterMaskKey( list[i].key, list[i].prefixlen );
+		if( ipv6 )
+		{
+			NET_IP6BytesToNetadr( &list[i].adr, list[i].key );
+			list[i].adr.type6 = NA_IP6;
+		}
+		else memcpy( list[i].adr.ip, list[i].key, sizeof( list[i].adr.ip ));
+		list[i].active = true;
+
+		SV_AddIPFilter( &list[i].adr, list[i].prefixlen, 0.0f );
+	}
+
+	TASSERT( ipfilter_count > TEST_IPFILTER_COUNT * 9 / 10 );
+
+	// addresses inside of filters must match
+	for( i = wrong = 0; i < TEST_IPFILTER_COUNT; i += 7 )
+	{
+		Test_IPFilterRandomAdr( &seed, &adr, list[i].adr.type6 == NA_IP6 );
+		if( !NET_CompareAdrByMask( adr, list[i].adr, list[i].prefixlen ))
+			continue;
+		if( !SV_CheckIP( &adr ))
+			wrong++;
+	}
+	TASSERT_EQi( wrong, 0 );
+
+	// random addresses must give same answer as linear search
+	start = Sys_DoubleTime();
+	for( i = wrong = hits = 0; i < TEST_IPFILTER_LINEAR; i++ )
+	{
+		Test_IPFilterRandomAdr( &seed, &adr, i & 1 );
+		if( Test_IPFilterLinear( list, TEST_IPFILTER_COUNT, &adr ) != SV_CheckIP( &adr ))
+			wrong++;
+		hits += SV_CheckIP( &adr );
+	}
+	linear_time = ( Sys_DoubleTime() - start ) / TEST_IPFILTER_LINEAR;
+	TASSERT_EQi( wrong, 0 );
+	TASSERT( hits > 0 && hits < TEST_IPFILTER_LINEAR );
+
+	start = Sys_DoubleTime();
+	for( i = hits = 0; i < TEST_IPFILTER_LOOKUPS; i++ )
+	{
+		Test_IPFilterRandomAdr( &seed, &adr, i & 1 );
+		hits += SV_CheckIP( &adr );
+	}
+	trie_time = ( Sys_DoubleTime() - start ) / TEST_IPFILTER_LOOKUPS;
+
+	Con_Printf( "%s: %i filters, trie %.0f ns, linear %.0f ns per lookup, %i%% hits\n", __func__,
+		ipfilter_count, trie_time * 1e9, linear_time * 1e9, (int)( hits * 100LL / TEST_IPFILTER_LOOKUPS ));
+
+	// unban addresses, every filter they are part of is removed
+	for( i = 0; i < TEST_IPFILTER_LINEAR; i++ )
+	{
+		int j;
+
+		Test_IPFilterRandomAdr( &seed, &toremove.adr, i & 1 );
+		toremove.prefixlen = i & 1 ? 128 : 32;
+		SV_RemoveIPFilter( &toremove, true, false );
+
+		if( SV_CheckIP( &toremove.adr ))
+			wrong++;
+
+		for( j = 0; j < TEST_IPFILTER_COUNT; j++ )
+		{
+			if( list[j].active && NET_CompareAdrByMask( toremove.adr, list[j].adr, list[j].prefixlen ))
+				list[j].active = false;
+		}
+	}
+	TASSERT_EQi( wrong, 0 );
+
+	for( i = 0; i < TEST_IPFILTER_LINEAR; i++ )
+	{
+		Test_IPFilterRandomAdr( &seed, &adr, i & 1 );
+		if( Test_IPFilterLinear( list, TEST_IPFILTER_COUNT, &adr ) != SV_CheckIP( &adr ))
+			wrong++;
+	}
+	TASSERT_EQi( wrong, 0 );
+
+	for( i = hits = 0; i < TEST_IPFILTER_COUNT; i++ )
+		hits += list[i].active;
+	TASSERT( ipfilter_count <= hits );
+
+	Mem_Free( list );
+	SV_ShutdownIPFilter();
+	ipfilter[0] = saved[0];
+	ipfilter[1] = saved[1];
+	ipfilter_count = savedcount;
+}
+
+static void Test_QueryRate( void )
+{
+	float oldrate = sv_query_rate.value, oldburst = sv_query_burst.value;
+	double oldtime = host.realtime;
+	netadr_t a, b;
+	int i, passed;
+
+	memset( queryrate, 0, sizeof( queryrate ));
+	sv_query_rate.value = 10.0f;
+	sv_query_burst.value = 30.0f;
+	host.realtime = 1000.0;
+
+	memset( &a, 0, sizeof( a ));
+	a.type = NA_IP;
+	a.ip[0] = 203, a.ip[1] = 0, a.ip[2] = 113, a.ip[3] = 7;
+	b = a;
+	b.ip[3] = 8;
+
+	// burst passes, everything else is dropped
+	for( i = passed = 0; i < 100; i++ )
+		passed += SV_CheckQueryRate( a );
+	TASSERT_EQi( passed, 30 );
+
+	// other address isn't affected
+	TASSERT( SV_CheckQueryRate( b ));
+
+	// half a second refills five tokens
+	host.realtime += 0.5;
+	for( i = passed = 0; i < 100; i++ )
+		passed += SV_CheckQueryRate( a );
+	TASSERT_EQi( passed, 5 );
+
+	// zero rate disables limit
+	sv_query_rate.value = 0.0f;
+	TASSERT( SV_CheckQueryRate( a ));
+
+	// many addresses must not lock out new ones
+	sv_query_rate.value = 10.0f;
+	for( i = passed = 0; i < QUERYRATE_HASH_SIZE * 4; i++ )
+	{
+		b.ip[2] = i >> 8;
+		b.ip[3] = i & 0xff;
+		passed += SV_CheckQueryRate( b );
+	}
+	TASSERT_EQi( passed, QUERYRATE_HASH_SIZE * 4 );
+
+	memset( queryrate, 0, sizeof( queryrate ));
+	sv_query_rate.value = oldrate;
+	sv_query_burst.value = oldburst;
+	host.realtime = oldtime;
+}
+
 void Test_RunIPFilter( void )
 {
 	Test_StringToFilterAdr();
 	Test_IPFilterIncludesIPFilter();
+	TRUN( Test_IPFilterTrie( ));
+	TRUN( Test_QueryRate( ));
 }
 
 #endif // XASH_ENGINE_TESTS
@@ -17,6 +17,7 @@ GNU General Public License for more details.
 #include "server.h"
 #include "const.h"
 #include "net_encode.h"
+#include "crclib.h"
 
 typedef struct
 {
@@ -28,6 +29,159 @@ typedef struct
 int	c_fullsend;	// just a debug counter
 int	c_notsend;
 
+/*
+=============================================================================
+
+PVS CANDIDATES
+
+Once per frame every entity gets a mask of leaf groups it touches.
+Entities that can't be in the client's PVS or PHS are skipped before
+calling pfnAddToFullPack, which saves most of the calls on big maps.
+This assumes the game rejects such entities, like HLSDK does through
+pfnCheckVisibility. Mods that send entities outside of PVS from
+AddToFullPack (radars, spectator and HLTV overviews, forced-visible
+players) lose them, so it's off by default and sv_pvs_candidates 1
+should only be set for games known to cull by PVS.
+
+=============================================================================
+*/
+#define VIS_GROUPS		256
+#define VIS_GROUP_WORDS	( VIS_GROUPS / 32 )
+
+typedef struct
+{
+	uint32_t	bits[VIS_GROUP_WORDS];
+} visgroups_t;
+
+static struct
+{
+	uint		framecount;
+	int		numentities;	// 0 if not built
+	int		shift;		// leaf to group
+	visgroups_t	*groups;	// per entity
+	byte		*always;	// can't be culled by leafs
+	int		maxentities;
+
+	// stats for sv_sendbench
+	uint		numcalls;	// pfnAddToFullPack calls
+	uint		numskipped;
+} sv_candidates;
+
+/*
+=============
+SV_BuildCandidates
+
+=============
+*/
+static void SV_BuildCandidates( void )
+{
+	int	e, i, numgroups;
+
+	if( sv_candidates.numentities == svgame.numEntities && sv_candidates.framecount == host.framecount )
+		return;
+
+	if( sv_candidates.maxentities < svgame.numEntities )
+	{
+		sv_candidates.maxentities = GI->max_edicts;
+		sv_candidates.groups = Mem_Realloc( host.mempool, sv_candidates.groups, sizeof( visgroups_t ) * sv_candidates.maxentities );
+		sv_candidates.always = Mem_Realloc( host.mempool, sv_candidates.always, sv_candidates.maxentities );
+	}
+
+	sv_candidates.framecount = host.framecount;
+	sv_candidates.numentities = svgame.numEntities;
+
+	for( sv_candidates.shift = 0, numgroups = world.visbytes * 8; numgroups > VIS_GROUPS; numgroups >>= 1 )
+		sv_candidates.shift++;
+
+	memset( sv_candidates.groups, 0, sizeof( visgroups_t ) * svgame.numEntities );
+
+	for( e = 1; e < svgame.numEntities; e++ )
+	{
+		edict_t	*ent = EDICT_NUM( e );
+		visgroups_t	*groups = &sv_candidates.groups[e];
+
+		sv_candidates.always[e] = false;
+
+		if( ent->free )
+			continue;
+
+		// beams are upcasted to owner, portals are always recursed,
+		// too big entities are checked by headnode
+		if( FBitSet( ent->v.flags, FL_CUSTOMENTITY ) || FBitSet( ent->v.effects, EF_MERGE_VISIBILITY ) || ent->headnode >= 0 )
+		{
+			sv_candidates.always[e] = true;
+			continue;
+		}
+
+		for( i = 0; i < ent->num_leafs; i++ )
+		{
+			int group = ent->leafnums[i] >> sv_candidates.shift;
+			SetBits( groups->bits[group >> 5], BIT( group & 31 ));
+		}
+	}
+}
+
+/*
+=============
+SV_VisGroups
+
+=============
+*/
+static void SV_VisGroups( const byte *pset, visgroups_t *groups )
+{
+	int	i, j;
+
+	memset( groups, 0, sizeof( *groups ));
+
+	for( i = 0; i < world.visbytes; i++ )
+	{
+		if( !pset[i] )
+			continue;
+
+		for( j = 0; j < 8; j++ )
+		{
+			if( FBitSet( pset[i], BIT( j )))
+			{
+				int group = ( i * 8 + j ) >> sv_candidates.shift;
+				SetBits( groups->bits[group >> 5], BIT( group & 31 ));
+			}
+		}
+	}
+}
+
+/*
+=============
+SV_IsCandidate
+
+can this entity be visible through pset
+=============
+*/
+static qboolean SV_IsCandidate( edict_t *ent, int e, const byte *pset, const visgroups_t *groups )
+{
+	const visgroups_t	*entgroups = &sv_candidates.groups[e];
+	int		i;
+
+	if( !pset || sv_candidates.always[e] )
+		return true;
+
+	for( i = 0; i < VIS_GROUP_WORDS; i++ )
+	{
+		if( entgroups->bits[i] & groups->bits[i] )
+			break;
+	}
+
+	if( i == VIS_GROUP_WORDS )
+		return false;
+
+	for( i = 0; i < ent->num_leafs; i++ )
+	{
+		if( CHECKVISBIT( pset, ent->leafnums[i] ))
+			return true;
+	}
+
+	return false;
+}
+
 /*
 =======================
 SV_EntityNumbers
@@ -64,6 +218,8 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 	sv_client_t	*cl = NULL;
 	qboolean		player;
 	entity_state_t	*state;
+	qboolean		candidates;
+	visgroups_t	pvsgroups, phsgroups;
 	int		e;
 
 	// during an error shutdown message we may need to transmit
@@ -91,6 +247,15 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 	svgame.dllFuncs.pfnSetupVisibility( pViewEnt, pClient, &clientpvs, &clientphs );
 	if( !clientpvs ) fullvis = true;
 
+	candidates = sv_pvs_candidates.value && !fullvis && sv.worldmodel != NULL;
+
+	if( candidates )
+	{
+		SV_BuildCandidates();
+		SV_VisGroups( clientpvs, &pvsgroups );
+		if( clientphs ) SV_VisGroups( clientphs, &phsgroups );
+	}
+
 	// g-cont: of course we can send world but not want to do it :-)
 	for( e = 1; e < svgame.numEntities; e++ )
 	{
@@ -121,7 +286,17 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 			pset = clientphs;
 		else pset = clientpvs;
 
+		if( candidates && !player && ent != pViewEnt )
+		{
+			if( !SV_IsCandidate( ent, e, pset, pset == clientphs ? &phsgroups : &pvsgroups ))
+			{
+				sv_candidates.numskipped++;
+				continue;
+			}
+		}
+
 		state = &ents->entities[ents->num_entities];
+		sv_candidates.numcalls++;
 
 		// add entity to the net packet
 		if( svgame.dllFuncs.pfnAddToFullPack( state, e, ent, pClient, sv.hostflags, player, pset ))
@@ -250,48 +425,58 @@ int SV_FindBestBaselineForStatic( int index, entity_state_t **baseline, entity_s
 	return index - bestfound;
 }
 
+/*
+=============
+SV_DeltaFrame
+
+returns the frame that we are going to delta update from, NULL for full update
+=============
+*/
+static client_frame_t *SV_DeltaFrame( sv_client_t *cl )
+{
+	client_frame_t	*from;
+
+	if( cl->delta_sequence == -1 )
+		return NULL;
+
+	from = &cl->frames[cl->delta_sequence & SV_UPDATE_MASK];
+
+	// the snapshot's entities may still have rolled off the buffer, though
+	if( from->first_entity <= ( svs.next_client_entities - svs.num_client_entities ))
+	{
+		Con_DPrintf( S_WARN "%s: delta request from out of date entities.\n", cl->name );
+		return NULL;
+	}
+
+	return from;
+}
+
 /*
 =============
 SV_EmitPacketEntities
 
 Writes a delta update of an entity_state_t list to the message->
+Doesn't call into the game, except custom delta encoders
 =============
 */
-static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_t *msg )
+static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *from, client_frame_t *to, sizebuf_t *msg )
 {
 	entity_state_t	*oldent, *newent;
 	int		oldindex, newindex;
 	int		i, oldnum, newnum;
 	qboolean		player;
 	int		oldmax;
-	client_frame_t	*from;
 
-	// this is the frame that we are going to delta update from
-	if( cl->delta_sequence != -1 )
+	if( from != NULL )
 	{
-		from = &cl->frames[cl->delta_sequence & SV_UPDATE_MASK];
 		oldmax = from->num_entities;
 
-		// the snapshot's entities may still have rolled off the buffer, though
-		if( from->first_entity <= ( svs.next_client_entities - svs.num_client_entities ))
-		{
-			Con_DPrintf( S_WARN "%s: delta request from out of date entities.\n", cl->name );
-			MSG_BeginServerCmd( msg, svc_packetentities );
-			MSG_WriteUBitLong( msg, to->num_entities - 1, MAX_VISIBLE_PACKET_BITS );
-
-			from = NULL;
-			oldmax = 0;
-		}
-		else
-		{
-			MSG_BeginServerCmd( msg, svc_deltapacketentities );
-			MSG_WriteUBitLong( msg, to->num_entities - 1, MAX_VISIBLE_PACKET_BITS );
-			MSG_WriteByte( msg, cl->delta_sequence );
-		}
+		MSG_BeginServerCmd( msg, svc_deltapacketentities );
+		MSG_WriteUBitLong( msg, to->num_entities - 1, MAX_VISIBLE_PACKET_BITS );
+		MSG_WriteByte( msg, cl->delta_sequence );
 	}
 	else
 	{
-		from = NULL;
 		oldmax = 0;
 
 		MSG_BeginServerCmd( msg, svc_packetentities );
@@ -332,7 +517,7 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 			// delta update from old position
 			// because the force parm is false, this will not result
 			// in any bytes being emited if the entity has not changed at all
-			MSG_WriteDeltaEntity( oldent, newent, msg, false, player, sv.time, 0 );
+			MSG_WriteDeltaEntity( oldent, newent, msg, false, player, sv.time, 0, &cl->delta_stats );
 			oldindex++;
 			newindex++;
 			continue;
@@ -363,7 +548,7 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 			}
 
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity( baseline, newent, msg, true, player, sv.time, offset );
+			MSG_WriteDeltaEntity( baseline, newent, msg, true, player, sv.time, offset, &cl->delta_stats );
 			newindex++;
 			continue;
 		}
@@ -378,7 +563,7 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 				force = true;
 
 			// remove from message
-			MSG_WriteDeltaEntity( oldent, NULL, msg, force, false, sv.time, 0 );
+			MSG_WriteDeltaEntity( oldent, NULL, msg, force, false, sv.time, 0, NULL );
 			oldindex++;
 			continue;
 		}
@@ -558,6 +743,7 @@ void SV_WriteClientdataToMessage( sv_client_t *cl, sizebuf_t *msg )
 	int		i;
 
 	memset( &nullcd, 0, sizeof( nullcd ));
+	memset( &cl->delta_stats, 0, sizeof( cl->delta_stats ));
 	frame = &cl->frames[cl->netchan.outgoing_sequence & SV_UPDATE_MASK];
 	frame->senttime = host.realtime;
 	frame->ping_time = -1.0f;
@@ -608,7 +794,7 @@ void SV_WriteClientdataToMessage( sv_client_t *cl, sizebuf_t *msg )
 	}
 
 	// write clientdata_t
-	MSG_WriteClientData( msg, from_cd, to_cd, sv.time );
+	MSG_WriteClientData( msg, from_cd, to_cd, sv.time, &cl->delta_stats );
 
 	if( FBitSet( cl->flags, FCL_LOCAL_WEAPONS ) && svgame.dllFuncs.pfnGetWeaponData( clent, frame->weapondata ))
 	{
@@ -620,7 +806,7 @@ void SV_WriteClientdataToMessage( sv_client_t *cl, sizebuf_t *msg )
 			else from_wd = &cl->frames[cl->delta_sequence & SV_UPDATE_MASK].weapondata[i];
 			to_wd = &frame->weapondata[i];
 
-			MSG_WriteWeaponData( msg, from_wd, to_wd, sv.time, i );
+			MSG_WriteWeaponData( msg, from_wd, to_wd, sv.time, i, &cl->delta_stats );
 		}
 	}
 
@@ -630,19 +816,19 @@ void SV_WriteClientdataToMessage( sv_client_t *cl, sizebuf_t *msg )
 
 /*
 ==================
-SV_WriteEntitiesToClient
+SV_SetupClientFrame
 
+collects entities visible to the client into its current frame
 ==================
 */
-void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
+static client_frame_t *SV_SetupClientFrame( sv_client_t *cl )
 {
 	client_frame_t	*frame;
 	entity_state_t	*state;
 	static sv_ents_t	frame_ents;
-	int		i, send_pings;
+	int		i;
 
 	frame = &cl->frames[cl->netchan.outgoing_sequence & SV_UPDATE_MASK];
-	send_pings = SV_ShouldUpdatePing( cl );
 
 	memset( frame_ents.sended, 0, sizeof( frame_ents.sended ));
 	ClearBits( sv.hostflags, SVF_MERGE_VISIBILITY );
@@ -689,7 +875,24 @@ void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
 		frame->num_entities++;
 	}
 
-	SV_EmitPacketEntities( cl, frame, msg );
+	return frame;
+}
+
+/*
+==================
+SV_WriteEntitiesToClient
+
+==================
+*/
+void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
+{
+	client_frame_t	*frame;
+	qboolean		send_pings;
+
+	send_pings = SV_ShouldUpdatePing( cl );
+	frame = SV_SetupClientFrame( cl );
+
+	SV_EmitPacketEntities( cl, SV_DeltaFrame( cl ), frame, msg );
 	SV_EmitEvents( cl, frame, msg );
 	if( send_pings ) SV_EmitPings( msg );
 }
@@ -701,6 +904,50 @@ FRAME UPDATES
 
 ===============================================================================
 */
+/*
+=======================
+SV_TransmitDatagram
+
+appends unreliable data and sends snapshot to the client
+=======================
+*/
+static void SV_TransmitDatagram( sv_client_t *cl, sizebuf_t *msg )
+{
+	// copy the accumulated multicast datagram
+	// for this client out to the message
+	if( MSG_CheckOverflow( &cl->datagram ))
+	{
+		Con_Printf( S_WARN "%s overflowed for %s\n", MSG_GetName( &cl->datagram ), cl->name );
+	}
+	else
+	{
+		if( MSG_GetNumBytesWritten( &cl->datagram ) < MSG_GetNumBytesLeft( msg ))
+			MSG_WriteBits( msg, MSG_GetData( &cl->datagram ), MSG_GetNumBitsWritten( &cl->datagram ));
+		else Con_DPrintf( S_WARN "Ignoring unreliable datagram for %s, would overflow on msg\n", cl->name );
+	}
+
+	MSG_Clear( &cl->datagram );
+
+	if( MSG_CheckOverflow( msg ))
+	{
+		// must have room left for the packet header
+		Con_Printf( S_ERROR "%s overflowed for %s\n", MSG_GetName( msg ), cl->name );
+		MSG_Clear( msg );
+	}
+
+	// send the datagram
+	Netchan_TransmitBits( &cl->netchan, MSG_GetNumBitsWritten( msg ), MSG_GetData( msg ));
+
+	if( net_showpackets.value && net_showpackets.value != 2.0f )
+	{
+		Con_Printf( " delta --> %s skipped=%u compared=%u encoded=%u\n"
+			, cl->name
+			, cl->delta_stats.skipped
+			, cl->delta_stats.compared
+			, cl->delta_stats.encoded );
+	}
+}
+
 /*
 =======================
 SV_SendClientDatagram
@@ -721,30 +968,318 @@ void SV_SendClientDatagram( sv_client_t *cl )
 	SV_WriteClientdataToMessage( cl, &msg );
 	SV_WriteEntitiesToClient( cl, &msg );
 
-	// copy the accumulated multicast datagram
-	// for this client out to the message
-	if( MSG_CheckOverflow( &cl->datagram ))
+	SV_TransmitDatagram( cl, &msg );
+}
+
+/*
+===============================================================================
+
+PARALLEL SNAPSHOTS
+
+Everything that calls into the game or touches state shared between
+clients runs on the main thread in client order: clientdata, visibility,
+copying the frame into the packet entities buffer and pings, which are
+written aside. Delta encoding of entities and events for all clients
+then runs on worker threads, custom encoders of the game are called one
+at a time. Datagrams are transmitted in client order afterwards. Output
+is the same as from SV_SendClientDatagram.
+
+===============================================================================
+*/
+#define MAX_PINGS_MSG	256	// 25 bits per client
+
+typedef struct
+{
+	sv_client_t	*cl;
+	client_frame_t	*frame;
+	client_frame_t	*from;
+	qboolean		encoded;
+	sizebuf_t		msg;
+	sizebuf_t		pings;
+	byte		msg_buf[MAX_DATAGRAM];
+	byte		pings_buf[MAX_PINGS_MSG];
+} sv_datagram_t;
+
+static struct
+{
+	sv_datagram_t	*datagrams;
+	int		numdatagrams;
+	int		maxdatagrams;
+} sv_snapshots;
+
+/*
+=======================
+SV_EncodeDatagram
+
+=======================
+*/
+static void SV_EncodeDatagram( sv_datagram_t *dg )
+{
+	SV_EmitPacketEntities( dg->cl, dg->from, dg->frame, &dg->msg );
+	SV_EmitEvents( dg->cl, dg->frame, &dg->msg );
+
+	if( MSG_GetNumBitsWritten( &dg->pings ))
+		MSG_WriteBits( &dg->msg, MSG_GetData( &dg->pings ), MSG_GetNumBitsWritten( &dg->pings ));
+
+	dg->encoded = true;
+}
+
+/*
+=======================
+SV_EncodeDatagramJob
+
+runs on worker threads
+=======================
+*/
+static void SV_EncodeDatagramJob( void *data, int index )
+{
+	sv_datagram_t	*dg = &sv_snapshots.datagrams[index];
+
+	if( !dg->encoded )
+		SV_EncodeDatagram( dg );
+}
+
+/*
+=======================
+SV_QueueClientDatagram
+
+does the serial part of SV_SendClientDatagram, remaining
+is number of clients that may be queued after this one
+=======================
+*/
+static sv_datagram_t *SV_QueueClientDatagram( sv_client_t *cl, int remaining )
+{
+	sv_datagram_t	*dg;
+	qboolean		send_pings;
+	int		first;
+
+	if( sv_snapshots.maxdatagrams < svs.maxclients )
 	{
-		Con_Printf( S_WARN "%s overflowed for %s\n", MSG_GetName( &cl->datagram ), cl->name );
+		sv_snapshots.maxdatagrams = svs.maxclients;
+		sv_snapshots.datagrams = Mem_Realloc( host.mempool, sv_snapshots.datagrams, sv_snapshots.maxdatagrams * sizeof( *sv_snapshots.datagrams ));
+	}
+
+	dg = &sv_snapshots.datagrams[sv_snapshots.numdatagrams++];
+	dg->cl = cl;
+	dg->encoded = false;
+
+	memset( dg->msg_buf, 0, sizeof( dg->msg_buf ));
+	MSG_Init( &dg->msg, "Datagram", dg->msg_buf, sizeof( dg->msg_buf ));
+	memset( dg->pings_buf, 0, sizeof( dg->pings_buf ));
+	MSG_Init( &dg->pings, "Pings", dg->pings_buf, sizeof( dg->pings_buf ));
+
+	// always send servertime at new frame
+	MSG_BeginServerCmd( &dg->msg, svc_time );
+	MSG_WriteFloat( &dg->msg, sv.time );
+
+	SV_WriteClientdataToMessage( cl, &dg->msg );
+
+	send_pings = SV_ShouldUpdatePing( cl );
+	dg->frame = SV_SetupClientFrame( cl );
+	dg->from = SV_DeltaFrame( cl );
+
+	// ping stats are updated while they are written
+	if( send_pings ) SV_EmitPings( &dg->pings );
+
+	// frames of clients queued later may overwrite entities
+	// we delta from, encode them right away in that case
+	first = dg->from ? dg->from->first_entity : dg->frame->first_entity;
+
+	if( first < svs.next_client_entities + remaining * MAX_VISIBLE_PACKET - svs.num_client_entities )
+		SV_EncodeDatagram( dg );
+
+	return dg;
+}
+
+/*
+=======================
+SV_FlushClientDatagrams
+
+encodes queued datagrams, doesn't send them
+=======================
+*/
+static void SV_FlushClientDatagrams( qboolean parallel )
+{
+	int	i;
+
+	if( parallel )
+	{
+		Sys_RunParallel( SV_EncodeDatagramJob, NULL, sv_snapshots.numdatagrams );
+		return;
+	}
+
+	for( i = 0; i < sv_snapshots.numdatagrams; i++ )
+		SV_EncodeDatagramJob( NULL, i );
+}
+
+/*
+=======================
+SV_ParallelSnapshots
+
+=======================
+*/
+static qboolean SV_ParallelSnapshots( void )
+{
+	return sv_parallel_send.value && svs.maxclients > 1 && Sys_NumWorkerThreads() > 1;
+}
+
+/*
+=======================
+SV_SendQueuedDatagrams
+
+=======================
+*/
+static void SV_SendQueuedDatagrams( void )
+{
+	int	i;
+
+	if( !sv_snapshots.numdatagrams )
+		return;
+
+	SV_FlushClientDatagrams( true );
+
+	for( i = 0; i < sv_snapshots.numdatagrams; i++ )
+		SV_TransmitDatagram( sv_snapshots.datagrams[i].cl, &sv_snapshots.datagrams[i].msg );
+
+	sv_snapshots.numdatagrams = 0;
+}
+
+// client state that is consumed by sending a snapshot
+typedef struct
+{
+	event_state_t	events;
+	int		chokecount;
+	int		fixangle;
+	vec3_t		avelocity;
+} sv_benchclient_t;
+
+/*
+=======================
+SV_SaveBenchClient
+
+=======================
+*/
+static void SV_SaveBenchClient( sv_client_t *cl, sv_benchclient_t *save, qboolean restore )
+{
+	if( restore )
+	{
+		cl->events = save->events;
+		cl->chokecount = save->chokecount;
+		cl->edict->v.fixangle = save->fixangle;
+		VectorCopy( save->avelocity, cl->edict->v.avelocity );
 	}
 	else
 	{
-		if( MSG_GetNumBytesWritten( &cl->datagram ) < MSG_GetNumBytesLeft( &msg ))
-			MSG_WriteBits( &msg, MSG_GetData( &cl->datagram ), MSG_GetNumBitsWritten( &cl->datagram ));
-		else Con_DPrintf( S_WARN "Ignoring unreliable datagram for %s, would overflow on msg\n", cl->name );
+		save->events = cl->events;
+		save->chokecount = cl->chokecount;
+		save->fixangle = cl->edict->v.fixangle;
+		VectorCopy( cl->edict->v.avelocity, save->avelocity );
 	}
+}
 
-	MSG_Clear( &cl->datagram );
+/*
+=======================
+SV_BenchSnapshots
 
-	if( MSG_CheckOverflow( &msg ))
+builds snapshots for bots without sending them, returns
+time per frame and checksum of the last frame messages
+=======================
+*/
+static double SV_BenchSnapshots( sv_client_t **bots, sv_benchclient_t *saved, int numbots, int frames, qboolean parallel, uint32_t *crc )
+{
+	double	start = Sys_DoubleTime();
+	int	i, j;
+
+	for( i = 0; i < frames; i++ )
 	{
-		// must have room left for the packet header
-		Con_Printf( S_ERROR "%s overflowed for %s\n", MSG_GetName( &msg ), cl->name );
-		MSG_Clear( &msg );
+		for( j = 0; j < numbots; j++ )
+		{
+			// every frame sends the same state
+			SV_SaveBenchClient( bots[j], &saved[j], true );
+			SV_QueueClientDatagram( bots[j], numbots - j - 1 );
+		}
+
+		SV_FlushClientDatagrams( parallel );
+
+		if( i == frames - 1 )
+		{
+			CRC32_Init( crc );
+
+			for( j = 0; j < numbots; j++ )
+			{
+				sizebuf_t *msg = &sv_snapshots.datagrams[j].msg;
+				CRC32_ProcessBuffer( crc, MSG_GetData( msg ), MSG_GetNumBytesWritten( msg ));
+			}
+
+			*crc = CRC32_Final( *crc );
+		}
+
+		sv_snapshots.numdatagrams = 0;
 	}
 
-	// send the datagram
-	Netchan_TransmitBits( &cl->netchan, MSG_GetNumBitsWritten( &msg ), MSG_GetData( &msg ));
+	return ( Sys_DoubleTime() - start ) / frames;
+}
+
+/*
+=======================
+SV_SendBench_f
+
+compares serial and parallel snapshot building with bots,
+add them with game commands first
+=======================
+*/
+void SV_SendBench_f( void )
+{
+	sv_client_t	*bots[MAX_CLIENTS];
+	sv_benchclient_t	*saved;
+	int		i, n, numbots = 0, frames;
+	uint32_t		crc[2];
+	double		time[2];
+
+	if( sv.state != ss_active )
+	{
+		Con_Printf( "server is not active\n" );
+		return;
+	}
+
+	for( i = 0; i < svs.maxclients; i++ )
+	{
+		if( svs.clients[i].state == cs_spawned && FBitSet( svs.clients[i].flags, FCL_FAKECLIENT ))
+			bots[numbots++] = &svs.clients[i];
+	}
+
+	if( !numbots )
+	{
+		Con_Printf( "no bots on server\n" );
+		return;
+	}
+
+	frames = Cmd_Argc() >= 2 ? bound( 1, Q_atoi( Cmd_Argv( 1 )), 10000 ) : 100;
+	saved = Mem_Malloc( host.mempool, sizeof( *saved ) * numbots );
+
+	for( i = 0; i < numbots; i++ )
+		SV_SaveBenchClient( bots[i], &saved[i], false );
+
+	Con_Printf( "%i frames, %i edicts, %i threads\n", frames, svgame.numEntities, Sys_NumWorkerThreads( ));
+
+	for( n = 1; ; n = Q_min( n * 2, numbots ))
+	{
+		sv_candidates.numcalls = sv_candidates.numskipped = 0;
+		time[0] = SV_BenchSnapshots( bots, saved, n, frames, false, &crc[0] );
+		time[1] = SV_BenchSnapshots( bots, saved, n, frames, true, &crc[1] );
+
+		Con_Printf( "%2i clients: serial %.3f ms, parallel %.3f ms, %u AddToFullPack calls, %u skipped%s\n",
+			n, time[0] * 1000.0, time[1] * 1000.0, sv_candidates.numcalls / ( frames * 2 ), sv_candidates.numskipped / ( frames * 2 ),
+			crc[0] != crc[1] ? ", " S_ERROR "output differs" : "" );
+
+		if( n == numbots )
+			break;
+	}
+
+	for( i = 0; i < numbots; i++ )
+		SV_SaveBenchClient( bots[i], &saved[i], true );
+
+	Mem_Free( saved );
 }
 
 /*
@@ -759,6 +1294,103 @@ void SV_UpdateUserInfo( sv_client_t *cl )
 	cl->next_sendinfotime = host.realtime + 1.0;
 }
 
+/*
+=======================
+SV_DeltaBenchFrame
+
+records entities of last frame sent to the client, paired with
+baselines and with same entities in the frame before
+=======================
+*/
+static int SV_DeltaBenchFrame( sv_client_t *cl, entity_state_t *from, entity_state_t *to )
+{
+	client_frame_t	*frame, *prev;
+	int		i, j = 0, count = 0;
+
+	frame = &cl->frames[( cl->netchan.outgoing_sequence - 1 ) & SV_UPDATE_MASK];
+	prev = &cl->frames[( cl->netchan.outgoing_sequence - 2 ) & SV_UPDATE_MASK];
+
+	if( frame->first_entity <= svs.next_client_entities - svs.num_client_entities )
+		return 0; // rolled off
+
+	if( prev->first_entity <= svs.next_client_entities - svs.num_client_entities )
+		prev = NULL;
+
+	for( i = 0; i < frame->num_entities; i++ )
+	{
+		entity_state_t *state = &svs.packet_entities[( frame->first_entity + i ) % svs.num_client_entities];
+
+		from[count] = svs.baselines[state->number];
+		to[count++] = *state;
+
+		if( !prev )
+			continue;
+
+		// both frames are sorted by number
+		for( ; j < prev->num_entities; j++ )
+		{
+			entity_state_t *old = &svs.packet_entities[( prev->first_entity + j ) % svs.num_client_entities];
+
+			if( old->number > state->number )
+				break;
+
+			if( old->number == state->number )
+			{
+				from[count] = *old;
+				to[count++] = *state;
+				break;
+			}
+		}
+	}
+
+	return count;
+}
+
+/*
+=======================
+SV_DeltaBench_f
+
+compares speed of compiled and interpreted delta encoders
+on entity states sent to clients
+=======================
+*/
+void SV_DeltaBench_f( void )
+{
+	entity_state_t	*from, *to;
+	int		i, count = 0, passes;
+	uint32_t		crc[2];
+	double		time[2];
+
+	if( sv.state != ss_active )
+	{
+		Con_Printf( "server is not active\n" );
+		return;
+	}
+
+	passes = Cmd_Argc() >= 2 ? bound( 1, Q_atoi( Cmd_Argv( 1 )), 10000 ) : 100;
+	from = Mem_Malloc( host.mempool, sizeof( *from ) * svs.maxclients * MAX_VISIBLE_PACKET * 2 );
+	to = Mem_Malloc( host.mempool, sizeof( *to ) * svs.maxclients * MAX_VISIBLE_PACKET * 2 );
+
+	for( i = 0; i < svs.maxclients; i++ )
+	{
+		if( svs.clients[i].state == cs_spawned )
+			count += SV_DeltaBenchFrame( &svs.clients[i], from + count, to + count );
+	}
+
+	if( count )
+	{
+		time[0] = Delta_BenchEntities( from, to, count, svs.maxclients, passes, false, &crc[0] );
+		time[1] = Delta_BenchEntities( from, to, count, svs.maxclients, passes, true, &crc[1] );
+
+		Con_Printf( "%i states: interpreted %.3f ms, compiled %.3f ms%s\n", count, time[0] * 1000.0, time[1] * 1000.0,
+			crc[0] != crc[1] ? ", " S_ERROR "output differs" : "" );
+	}
+	else Con_Printf( "no entities were sent to clients\n" );
+
+	Mem_Free( from );
+	Mem_Free( to );
+}
+
 /*
 =======================
 SV_UpdateToReliableMessages
@@ -843,11 +1475,16 @@ void SV_SendClientMessages( void )
 	int          i;
 	double       updaterate_time;
 	double       time_until_next_message;
+	qboolean     parallel;
 
 	if( sv.state == ss_dead )
 		return;
 
 	SV_UpdateToReliableMessages ();
+	parallel = SV_ParallelSnapshots();
+
+	// all datagrams go out together at the end of frame
+	NET_BeginSendBatch();
 
 	// send a message to each connected client
 	for( i = 0, sv.current_client = svs.clients; i < svs.maxclients; i++, sv.current_client++ )
@@ -882,6 +1519,9 @@ void SV_SendClientMessages( void )
 		// if the reliable message overflowed, drop the client
 		if( MSG_CheckOverflow( &cl->netchan.message ))
 		{
+			// game and other clients must see snapshots sent before
+			SV_SendQueuedDatagrams();
+
 			MSG_Clear( &cl->netchan.message );
 			MSG_Clear( &cl->datagram );
 			SV_BroadcastPrintf( NULL, "%s overflowed\n", cl->name );
@@ -918,11 +1558,17 @@ void SV_SendClientMessages( void )
 
 			// NOTE: we should send frame even if server is not simulated to prevent overflow
 			if( cl->state == cs_spawned )
-				SV_SendClientDatagram( cl );
+			{
+				if( parallel ) SV_QueueClientDatagram( cl, svs.maxclients - i - 1 );
+				else SV_SendClientDatagram( cl );
+			}
 			else Netchan_TransmitBits( &cl->netchan, 0, NULL ); // just update reliable
 		}
 	}
 
+	SV_SendQueuedDatagrams();
+	NET_FlushSendBatch();
+
 	// reset current client
 	sv.current_client = NULL;
 }
@@ -618,7 +618,7 @@ qboolean SV_CreateStaticEntity( sizebuf_t *msg, int index )
 	offset = SV_FindBestBaselineForStatic( index, &baseline, state );
 
 	MSG_BeginServerCmd( msg, svc_spawnstatic );
-	MSG_WriteDeltaEntity( baseline, state, msg, true, DELTA_STATIC, sv.time, offset );
+	MSG_WriteDeltaEntity( baseline, state, msg, true, DELTA_STATIC, sv.time, offset, NULL );
 
 	return true;
 }
@@ -5052,6 +5052,37 @@ static void SV_LoadFromFile( const char *mapname, char *entities )
 	VectorClear( svgame.edicts->v.angles );
 }
 
+/*
+==============
+SV_PrefetchEntityModels
+
+precache lists are filled by the game while entities spawn, so they
+aren't known ahead, but most models are named in the entity lump
+==============
+*/
+static void SV_PrefetchEntityModels( char *entities )
+{
+	char	key[256], value[2048];
+	const char	*ext;
+
+	while(( entities = COM_ParseFile( entities, key, sizeof( key ))) != NULL )
+	{
+		if( key[0] == '{' || key[0] == '}' )
+			continue;
+
+		if(( entities = COM_ParseFile( entities, value, sizeof( value ))) == NULL )
+			break;
+
+		if( Q_stricmp( key, "model" ) || value[0] == '*' )
+			continue;
+
+		ext = COM_FileExtension( value );
+
+		if( !Q_stricmp( ext, "mdl" ) || !Q_stricmp( ext, "spr" ))
+			Mod_PrefetchModel( value );
+	}
+}
+
 /*
 ==============
 SpawnEntities
@@ -5091,8 +5122,14 @@ void SV_SpawnEntities( const char *mapname )
 	svgame.globals->startspot = MAKE_STRING( sv.startspot );
 	svgame.globals->time = sv.time;
 
+	// start reading models while the game spawns entities
+	SV_PrefetchEntityModels( sv.worldmodel->entities );
+
 	// spawn the rest of the entities on the map
 	SV_LoadFromFile( mapname, sv.worldmodel->entities );
+
+	// drop models that game didn't precache
+	FS_CancelPrefetch();
 }
 
 void SV_UnloadProgs( void )
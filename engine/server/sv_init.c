@@ -510,7 +510,7 @@ void SV_CreateBaseline( void )
 		// take current state as baseline
 		base = &svs.baselines[entnum];
 
-		MSG_WriteDeltaEntity( &nullstate, base, &sv.signon, true, delta_type, 1.0f, 0 );
+		MSG_WriteDeltaEntity( &nullstate, base, &sv.signon, true, delta_type, 1.0f, 0, NULL );
 	}
 
 	MSG_WriteUBitLong( &sv.signon, LAST_EDICT, MAX_ENTITY_BITS ); // end of baselines
@@ -519,7 +519,7 @@ void SV_CreateBaseline( void )
 	for( entnum = 0; entnum < sv.num_instanced; entnum++ )
 	{
 		base = &sv.instanced[entnum].baseline;
-		MSG_WriteDeltaEntity( &nullstate, base, &sv.signon, true, DELTA_ENTITY, 1.0f, 0 );
+		MSG_WriteDeltaEntity( &nullstate, base, &sv.signon, true, DELTA_ENTITY, 1.0f, 0, NULL );
 	}
 }
 
@@ -548,6 +548,46 @@ void SV_FreeOldEntities( void )
 	for( ; EDICT_NUM( svgame.numEntities - 1 )->free; svgame.numEntities-- );
 }
 
+/*
+================
+SV_CompressResources
+
+compress downloadable files ahead of time,
+so first client to download them doesn't have to wait
+================
+*/
+static void SV_CompressResources( void )
+{
+	int	i;
+
+	if( svs.maxclients <= 1 || !sv_allow_download.value || !sv_send_resources.value )
+		return;
+
+	for( i = 0; i < sv.num_resources; i++ )
+	{
+		resource_t	*res = &sv.resources[i];
+		const char	*name = res->szFileName;
+
+		if( res->nDownloadSize <= 0 || res->type == t_decal )
+			continue;
+
+		if( res->type == t_sound )
+			name = va( DEFAULT_SOUNDPATH "%s", name );
+
+		if( !COM_IsSafeFileToDownload( name ))
+			continue;
+
+		Netchan_QueueCompression( name );
+
+		// also the model textures
+		if( res->type == t_model && !Q_stricmp( COM_FileExtension( name ), "mdl" ))
+		{
+			if( FS_FileExists( Mod_StudioTexName( name ), false ))
+				Netchan_QueueCompression( Mod_StudioTexName( name ));
+		}
+	}
+}
+
 /*
 ================
 SV_ActivateServer
@@ -606,6 +646,8 @@ void SV_ActivateServer( int runPhysics )
 	// check and count all files that marked by user as unmodified (typically is a player models etc)
 	SV_TransferConsistencyInfo();
 
+	SV_CompressResources();
+
 	// send serverinfo to all connected clients
 	for( i = 0, cl = svs.clients; i < svs.maxclients; i++, cl++ )
 	{
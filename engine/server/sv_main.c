@@ -126,6 +126,12 @@ CVAR_DEFINE_AUTO( sv_enttools_maxfire, "5", FCVAR_ARCHIVE|FCVAR_PROTECTED, "limi
 CVAR_DEFINE( public_server, "public", "0", 0, "change server type from private to public" );
 
 CVAR_DEFINE_AUTO( sv_novis, "0", 0, "force to ignore server visibility" );			// disable server culling entities by vis
+CVAR_DEFINE_AUTO( sv_adaptive_areanodes, "0", 0, "size entity lookup tree by map bounds and entity count, applied on map start" );
+CVAR_DEFINE_AUTO( sv_parallel_physics, "0", 0, "trace moves of toss, bounce and fly entities against the world on worker threads" );
+CVAR_DEFINE_AUTO( sv_parallel_send, "0", 0, "delta encode client snapshots on worker threads" );
+CVAR_DEFINE_AUTO( sv_pvs_candidates, "0", 0, "don't ask game about entities outside of client PVS, only safe for mods that never send such entities (breaks radar, spectator, hltv)" );
+CVAR_DEFINE_AUTO( sv_query_rate, "10", 0, "server queries per second answered for one address, 0 disables limit" );
+CVAR_DEFINE_AUTO( sv_query_burst, "30", 0, "server queries one address can send at once before sv_query_rate applies" );
 CVAR_DEFINE( sv_pausable, "pausable", "1", FCVAR_SERVER, "allow players to pause or not" );
 static CVAR_DEFINE_AUTO( timeout, "125", FCVAR_SERVER, "connection timeout" );				// seconds without any message
 CVAR_DEFINE( sv_lighting_modulate, "r_lighting_modulate", "0.6", FCVAR_ARCHIVE, "lightstyles modulate scale" );
@@ -696,6 +702,9 @@ void Host_ServerFrame( void )
 	// request missing resources for clients
 	SV_RequestMissingResources();
 
+	// write out files compressed for downloads
+	Netchan_UpdateCompression( false );
+
 	// check timeouts
 	SV_CheckTimeouts ();
 
@@ -721,6 +730,9 @@ void Host_SetServerState( int state )
 {
 	Cvar_FullSet( "host_serverstate", va( "%i", state ), FCVAR_READ_ONLY );
 	sv.state = state;
+
+	SV_QueryCacheInvalidate();
+	SV_FreeSignonBlobs();
 }
 
 //============================================================================
@@ -935,6 +947,12 @@ void SV_Init( void )
 	Cvar_RegisterVariable( &sv_consistency );
 	Cvar_RegisterVariable( &sv_downloadurl );
 	Cvar_RegisterVariable( &sv_novis );
+	Cvar_RegisterVariable( &sv_adaptive_areanodes );
+	Cvar_RegisterVariable( &sv_parallel_physics );
+	Cvar_RegisterVariable( &sv_parallel_send );
+	Cvar_RegisterVariable( &sv_pvs_candidates );
+	Cvar_RegisterVariable( &sv_query_rate );
+	Cvar_RegisterVariable( &sv_query_burst );
 	Cvar_RegisterVariable( &sv_hostmap );
 	Cvar_DirectSet( &sv_hostmap, GI->startmap );
 	Cvar_RegisterVariable( &sv_password );
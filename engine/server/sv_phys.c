@@ -154,6 +154,26 @@ void SV_CheckVelocity( edict_t *ent )
 	}
 }
 
+/*
+================
+SV_VelocityInBounds
+
+true if SV_CheckVelocity would leave the entity untouched and silent
+================
+*/
+static qboolean SV_VelocityInBounds( edict_t *ent )
+{
+	int	i;
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( IS_NAN( ent->v.velocity[i] ) || IS_NAN( ent->v.origin[i] ))
+			return false;
+	}
+
+	return DotProduct( ent->v.velocity, ent->v.velocity ) <= sv_maxvelocity.value * sv_maxvelocity.value * 1.73f;
+}
+
 /*
 ================
 SV_UpdateBaseVelocity
@@ -729,11 +749,12 @@ static int SV_FlyMove( edict_t *ent, float time, trace_t *steptrace )
 
 /*
 ============
-SV_AddGravity
+SV_ApplyGravity
 
+SV_AddGravity without bounding velocity
 ============
 */
-static void SV_AddGravity( edict_t *ent )
+static void SV_ApplyGravity( edict_t *ent )
 {
 	float	ent_gravity;
 
@@ -745,6 +766,17 @@ static void SV_AddGravity( edict_t *ent )
 	ent->v.velocity[2] -= ( ent_gravity * sv_gravity.value * sv.frametime );
 	ent->v.velocity[2] += ( ent->v.basevelocity[2] * sv.frametime );
 	ent->v.basevelocity[2] = 0.0f;
+}
+
+/*
+============
+SV_AddGravity
+
+============
+*/
+static void SV_AddGravity( edict_t *ent )
+{
+	SV_ApplyGravity( ent );
 
 	// bound velocity
 	SV_CheckVelocity( ent );
@@ -782,6 +814,61 @@ static qboolean SV_AllowPushRotate( edict_t *ent )
 	return false;
 }
 
+/*
+===============================================================================
+
+PARALLEL TOSS MOVES
+
+===============================================================================
+*/
+#define MIN_TOSS_JOBS	16	// waking up workers doesn't pay off for fewer moves
+
+typedef struct
+{
+	edict_t		*ent;
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	trace_t		trace;	// world part of the move
+	qboolean		bad;	// trace failed on a worker, redo it on the main thread
+} tossjob_t;
+
+static struct
+{
+	tossjob_t		*jobs;
+	int		numjobs;
+	int		maxjobs;
+	int		*entjobs;		// job number for each edict, valid if it points back
+	int		maxentjobs;
+} sv_tossjobs;
+
+/*
+============
+SV_FindTossJob
+
+returns precomputed world trace if the move wasn't changed since
+============
+*/
+static const trace_t *SV_FindTossJob( edict_t *ent, const vec3_t end )
+{
+	int		e = NUM_FOR_EDICT( ent );
+	const tossjob_t	*job;
+
+	if( e >= sv_tossjobs.maxentjobs || sv_tossjobs.entjobs[e] >= sv_tossjobs.numjobs )
+		return NULL;
+
+	job = &sv_tossjobs.jobs[sv_tossjobs.entjobs[e]];
+
+	if( job->bad )
+		return NULL;
+
+	// compare bits, trace must be identical to one from SV_Move
+	if( job->ent != ent || memcmp( job->start, ent->v.origin, sizeof( vec3_t )) || memcmp( job->end, end, sizeof( vec3_t ))
+		|| memcmp( job->mins, ent->v.mins, sizeof( vec3_t )) || memcmp( job->maxs, ent->v.maxs, sizeof( vec3_t )))
+		return NULL;
+
+	return &job->trace;
+}
+
 /*
 ============
 SV_PushEntity
@@ -791,6 +878,7 @@ Does not change the entities velocity at all
 */
 static trace_t SV_PushEntity( edict_t *ent, const vec3_t lpush, const vec3_t apush, int *blocked, float flDamage )
 {
+	const trace_t	*worldtrace;
 	trace_t	trace;
 	qboolean	monsterBlock;
 	qboolean	monsterClip;
@@ -806,7 +894,9 @@ static trace_t SV_PushEntity( edict_t *ent, const vec3_t lpush, const vec3_t apu
 		type = MOVE_NOMONSTERS; // only clip against bmodels
 	else type = MOVE_NORMAL;
 
-	trace = SV_Move( ent->v.origin, ent->v.mins, ent->v.maxs, end, type, ent, monsterClip );
+	if(( worldtrace = SV_FindTossJob( ent, end )) != NULL )
+		trace = SV_MoveClipped( worldtrace, ent->v.origin, ent->v.mins, ent->v.maxs, end, type, ent, monsterClip );
+	else trace = SV_Move( ent->v.origin, ent->v.mins, ent->v.maxs, end, type, ent, monsterClip );
 
 	if( trace.fraction != 0.0f )
 	{
@@ -1427,23 +1517,18 @@ static void SV_CheckWaterTransition( edict_t *ent )
 
 /*
 =============
-SV_Physics_Toss
+SV_TossMove
 
-Toss, bounce, and fly movement.  When onground, do nothing.
+updates velocity and angles of toss, bounce and fly entities
+and returns how far they should move, false if they are at rest.
+predict doesn't bound velocity but fails where it would need to,
+so nothing is fixed up or printed twice for the same move
 =============
 */
-static void SV_Physics_Toss( edict_t *ent )
+static qboolean SV_TossMove( edict_t *ent, vec3_t move, qboolean predict )
 {
-	trace_t	trace;
-	vec3_t	move;
-	float	backoff;
 	edict_t	*ground;
 
-	SV_CheckWater( ent );
-
-	// regular thinking
-	if( !SV_RunThink( ent )) return;
-
 	ground = ent->v.groundentity;
 
 	if( ent->v.velocity[2] > 0 )
@@ -1458,10 +1543,15 @@ static void SV_Physics_Toss( edict_t *ent )
 		VectorClear( ent->v.avelocity );
 
 		if( VectorIsNull( ent->v.basevelocity ))
-			return;	// at rest
+			return false;	// at rest
 	}
 
-	SV_CheckVelocity( ent );
+	if( predict )
+	{
+		if( !SV_VelocityInBounds( ent ))
+			return false;
+	}
+	else SV_CheckVelocity( ent );
 
 	// add gravity
 	switch( ent->v.movetype )
@@ -1471,7 +1561,13 @@ static void SV_Physics_Toss( edict_t *ent )
 	case MOVETYPE_BOUNCEMISSILE:
 		break;
 	default:
-		SV_AddGravity( ent );
+		if( predict )
+		{
+			SV_ApplyGravity( ent );
+			if( !SV_VelocityInBounds( ent ))
+				return false;
+		}
+		else SV_AddGravity( ent );
 		break;
 	}
 
@@ -1492,11 +1588,40 @@ static void SV_Physics_Toss( edict_t *ent )
 	// after the bounce without taking it into account
 	VectorAdd( ent->v.velocity, ent->v.basevelocity, ent->v.velocity );
 
-	SV_CheckVelocity( ent );
+	if( predict )
+	{
+		if( !SV_VelocityInBounds( ent ))
+			return false;
+	}
+	else SV_CheckVelocity( ent );
 	VectorScale( ent->v.velocity, sv.frametime, move );
 
 	VectorSubtract( ent->v.velocity, ent->v.basevelocity, ent->v.velocity );
 
+	return true;
+}
+
+/*
+=============
+SV_Physics_Toss
+
+Toss, bounce, and fly movement.  When onground, do nothing.
+=============
+*/
+static void SV_Physics_Toss( edict_t *ent )
+{
+	trace_t	trace;
+	vec3_t	move;
+	float	backoff;
+
+	SV_CheckWater( ent );
+
+	// regular thinking
+	if( !SV_RunThink( ent )) return;
+
+	if( !SV_TossMove( ent, move, false ))
+		return; // at rest
+
 	trace = SV_PushEntity( ent, move, vec3_origin, NULL, 0.0f );
 	if( ent->free ) return;
 
@@ -1716,12 +1841,8 @@ static void SV_Physics_None( edict_t *ent )
 }
 
 //============================================================================
-static void SV_Physics_Entity( edict_t *ent )
+static void SV_ApplyBaseVelocity( edict_t *ent )
 {
-	// user dll can override movement type (Xash3D extension)
-	if( svgame.physFuncs.SV_PhysicsEntity && svgame.physFuncs.SV_PhysicsEntity( ent ))
-		return; // overrided
-
 	SV_UpdateBaseVelocity( ent );
 
 	if( !FBitSet( ent->v.flags, FL_BASEVELOCITY ) && !VectorIsNull( ent->v.basevelocity ))
@@ -1732,6 +1853,15 @@ static void SV_Physics_Entity( edict_t *ent )
 	}
 
 	ent->v.flags &= ~FL_BASEVELOCITY;
+}
+
+static void SV_Physics_Entity( edict_t *ent )
+{
+	// user dll can override movement type (Xash3D extension)
+	if( svgame.physFuncs.SV_PhysicsEntity && svgame.physFuncs.SV_PhysicsEntity( ent ))
+		return; // overrided
+
+	SV_ApplyBaseVelocity( ent );
 
 	if( svgame.globals->force_retouch != 0.0f )
 	{
@@ -1778,6 +1908,125 @@ static void SV_Physics_Entity( edict_t *ent )
 		SV_FreeEdict( ent );
 }
 
+/*
+================
+SV_TossJob
+
+runs on worker threads, must not Host_Error or print
+================
+*/
+static void SV_TossJob( void *data, int index )
+{
+	tossjob_t	*job = &sv_tossjobs.jobs[index];
+
+	job->bad = false;
+	SV_ClipMoveToWorld( job->start, job->mins, job->maxs, job->end, &job->trace, &job->bad );
+}
+
+/*
+================
+SV_AddTossJob
+
+predicts the first move of toss entity in this frame
+================
+*/
+static void SV_AddTossJob( edict_t *ent )
+{
+	tossjob_t	*job;
+	edict_t	temp;
+	vec3_t	move;
+
+	// entities that think may change anything
+	if( FBitSet( ent->v.flags, FL_KILLME ) || ( ent->v.nextthink > 0.0f && ent->v.nextthink <= sv.time + sv.frametime ))
+		return;
+
+	// same steps as SV_Physics_Entity does, but on a copy. Velocity is only
+	// validated here and by the real move after the merge, a move that
+	// would need fixing is left to the main thread
+	temp = *ent;
+	SV_ApplyBaseVelocity( &temp );
+
+	if( !SV_TossMove( &temp, move, true ))
+		return;
+
+	if( sv_tossjobs.numjobs == sv_tossjobs.maxjobs )
+	{
+		sv_tossjobs.maxjobs = Q_max( 256, sv_tossjobs.maxjobs * 2 );
+		sv_tossjobs.jobs = Mem_Realloc( host.mempool, sv_tossjobs.jobs, sv_tossjobs.maxjobs * sizeof( *sv_tossjobs.jobs ));
+	}
+
+	job = &sv_tossjobs.jobs[sv_tossjobs.numjobs];
+	job->ent = ent;
+	VectorCopy( temp.v.origin, job->start );
+	VectorAdd( temp.v.origin, move, job->end );
+	VectorCopy( temp.v.mins, job->mins );
+	VectorCopy( temp.v.maxs, job->maxs );
+
+	sv_tossjobs.entjobs[NUM_FOR_EDICT( ent )] = sv_tossjobs.numjobs++;
+}
+
+/*
+================
+SV_RunTossJobs
+
+Traces moves of toss, bounce and fly entities against the world on worker
+threads before entities are processed. The world doesn't change during
+the frame, so SV_PushEntity takes the result instead of tracing again when
+the move turns out to be the same. Clipping against other entities,
+touches and impacts still run in edict order, so the game sees the same
+sequence of callbacks as without sv_parallel_physics. Workers never report
+errors themselves, a failed trace is flagged and SV_Move redoes it, with
+the usual warnings, on the main thread.
+================
+*/
+static void SV_RunTossJobs( void )
+{
+	edict_t	*ent;
+	int	i;
+
+	sv_tossjobs.numjobs = 0;
+
+	if( !sv_parallel_physics.value || Sys_NumWorkerThreads() < 2 )
+		return;
+
+	// game may override physics and hull selection, don't call it from threads
+	if( svgame.physFuncs.SV_PhysicsEntity != NULL || svgame.physFuncs.SV_HullForBsp != NULL )
+		return;
+
+	if( sv_tossjobs.maxentjobs < svgame.numEntities )
+	{
+		sv_tossjobs.maxentjobs = GI->max_edicts;
+		sv_tossjobs.entjobs = Mem_Realloc( host.mempool, sv_tossjobs.entjobs, sv_tossjobs.maxentjobs * sizeof( *sv_tossjobs.entjobs ));
+	}
+
+	for( i = svs.maxclients + 1; i < svgame.numEntities; i++ )
+	{
+		ent = EDICT_NUM( i );
+
+		if( !SV_IsValidEdict( ent ))
+			continue;
+
+		switch( ent->v.movetype )
+		{
+		case MOVETYPE_FLY:
+		case MOVETYPE_TOSS:
+		case MOVETYPE_BOUNCE:
+		case MOVETYPE_FLYMISSILE:
+		case MOVETYPE_BOUNCEMISSILE:
+			SV_AddTossJob( ent );
+			break;
+		}
+	}
+
+	if( sv_tossjobs.numjobs < MIN_TOSS_JOBS )
+	{
+		sv_tossjobs.numjobs = 0;
+		return;
+	}
+
+	Sys_RunParallel( SV_TossJob, NULL, sv_tossjobs.numjobs );
+}
+
 static void SV_RunLightStyles( void )
 {
 	int		i, ofs;
@@ -1816,6 +2065,8 @@ void SV_Physics( void )
 	// let the progs know that a new frame has started
 	svgame.dllFuncs.pfnStartFrame();
 
+	SV_RunTossJobs();
+
 	// treat each object in turn
 	for( i = 0; i < svgame.numEntities; i++ )
 	{
@@ -1830,6 +2081,8 @@ void SV_Physics( void )
 		SV_Physics_Entity( ent );
 	}
 
+	sv_tossjobs.numjobs = 0;
+
 	if( svgame.globals->force_retouch != 0.0f )
 		svgame.globals->force_retouch--;
 
@@ -27,6 +27,124 @@ GNU General Public License for more details.
 
 #define SOURCE_QUERY_CONNECTIONLESS -1
 
+sv_querystats_t	sv_querystats;
+
+/*
+=============================================================================
+
+Replies to connectionless queries are kept until the end of frame,
+so floods of queries don't build same reply again and again.
+
+=============================================================================
+*/
+static struct
+{
+	int		framecount;	// host.framecount when built, -1 if invalid
+	size_t		size;	// may be 0, an empty reply is still cached
+	size_t		maxsize;
+	byte		*data;
+} sv_querycache[QUERY_COUNT];
+
+/*
+==================
+SV_QueryCacheFind
+
+returns true if reply was built in this frame,
+data is NULL for an empty reply
+==================
+*/
+qboolean SV_QueryCacheFind( svquery_t query, const void **data, size_t *size )
+{
+	if( sv_querycache[query].framecount != host.framecount )
+		return false;
+
+	sv_querystats.cached++;
+
+	*data = sv_querycache[query].size ? sv_querycache[query].data : NULL;
+
+	if( size )
+		*size = sv_querycache[query].size;
+
+	return true;
+}
+
+/*
+==================
+SV_QueryCacheStore
+
+==================
+*/
+void SV_QueryCacheStore( svquery_t query, const void *data, size_t size )
+{
+	sv_querystats.built++;
+
+	if( size > sv_querycache[query].maxsize )
+	{
+		sv_querycache[query].data = Mem_Realloc( host.mempool, sv_querycache[query].data, size );
+		sv_querycache[query].maxsize = size;
+	}
+
+	if( size )
+		memcpy( sv_querycache[query].data, data, size );
+
+	sv_querycache[query].size = size;
+	sv_querycache[query].framecount = host.framecount;
+}
+
+/*
+==================
+SV_QueryCacheInvalidate
+
+==================
+*/
+void SV_QueryCacheInvalidate( void )
+{
+	int i;
+
+	for( i = 0; i < QUERY_COUNT; i++ )
+		sv_querycache[i].framecount = -1;
+}
+
+/*
+==================
+SV_QueryStats_f
+
+==================
+*/
+void SV_QueryStats_f( void )
+{
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		memset( &sv_querystats, 0, sizeof( sv_querystats ));
+		return;
+	}
+
+	Con_Printf( "queries dropped by rate limit: %u\n", sv_querystats.dropped );
+	Con_Printf( "replies sent from cache: %u\n", sv_querystats.cached );
+	Con_Printf( "replies built: %u\n", sv_querystats.built );
+}
+
+/*
+==================
+SV_SourceQuery_SendCached
+
+==================
+*/
+static qboolean SV_SourceQuery_SendCached( svquery_t query, netadr_t from )
+{
+	const void *data;
+	size_t size;
+
+	if( !SV_QueryCacheFind( query, &data, &size ))
+		return false;
+
+	// empty reply means nothing should be sent
+	if( size )
+		NET_SendPacket( NS_SERVER, size, data, from );
+
+	return true;
+}
+
 /*
 ==================
 SV_SourceQuery_Details
@@ -39,6 +157,9 @@ static void SV_SourceQuery_Details( netadr_t from )
 	int i, bot_count, client_count;
 	int is_private = 0;
 
+	if( SV_SourceQuery_SendCached( QUERY_SOURCE_DETAILS, from ))
+		return;
+
 	SV_GetPlayerCount( &client_count, &bot_count );
 	client_count += bot_count; // bots are counted as players in this reply
 	if( COM_CheckStringEmpty( sv_password.string ) && Q_stricmp( sv_password.string, "none" ))
@@ -72,6 +193,7 @@ static void SV_SourceQuery_Details( netadr_t from )
 	MSG_WriteByte( &buf, GI->secure );
 	MSG_WriteString( &buf, XASH_VERSION );
 
+	SV_QueryCacheStore( QUERY_SOURCE_DETAILS, MSG_GetData( &buf ), MSG_GetNumBytesWritten( &buf ));
 	NET_SendPacket( NS_SERVER, MSG_GetNumBytesWritten( &buf ), MSG_GetData( &buf ), from );
 }
 
@@ -87,13 +209,19 @@ static void SV_SourceQuery_Rules( netadr_t from )
 	cvar_t *cvar;
 	int cvar_count = 0;
 
+	if( SV_SourceQuery_SendCached( QUERY_SOURCE_RULES, from ))
+		return;
+
 	for( cvar = Cvar_GetList( ); cvar; cvar = cvar->next )
 	{
 		if( FBitSet( cvar->flags, FCVAR_SERVER ))
 			cvar_count++;
 	}
 	if( cvar_count <= 0 )
+	{
+		SV_QueryCacheStore( QUERY_SOURCE_RULES, NULL, 0 );
 		return;
+	}
 
 	MSG_Init( &buf, "TSourceEngineQueryRules", answer, sizeof( answer ));
 
@@ -113,6 +241,8 @@ static void SV_SourceQuery_Rules( netadr_t from )
 		else
 			MSG_WriteString( &buf, cvar->string );
 	}
+
+	SV_QueryCacheStore( QUERY_SOURCE_RULES, MSG_GetData( &buf ), MSG_GetNumBytesWritten( &buf ));
 	NET_SendPacket( NS_SERVER, MSG_GetNumBytesWritten( &buf ), MSG_GetData( &buf ), from );
 }
 
@@ -127,11 +257,17 @@ static void SV_SourceQuery_Players( netadr_t from )
 	char answer[1024 * 8];
 	int i, client_count, bot_count;
 
+	if( SV_SourceQuery_SendCached( QUERY_SOURCE_PLAYERS, from ))
+		return;
+
 	SV_GetPlayerCount( &client_count, &bot_count );
 	client_count += bot_count; // bots are counted as players in this reply
 
 	if( client_count <= 0 )
+	{
+		SV_QueryCacheStore( QUERY_SOURCE_PLAYERS, NULL, 0 );
 		return;
+	}
 
 	MSG_Init( &buf, "TSourceEngineQueryPlayers", answer, sizeof( answer ));
 
@@ -153,6 +289,8 @@ static void SV_SourceQuery_Players( netadr_t from )
 			MSG_WriteFloat( &buf, -1.0f );
 		else MSG_WriteFloat( &buf, host.realtime - cl->connecttime );
 	}
+
+	SV_QueryCacheStore( QUERY_SOURCE_PLAYERS, MSG_GetData( &buf ), MSG_GetNumBytesWritten( &buf ));
 	NET_SendPacket( NS_SERVER, MSG_GetNumBytesWritten( &buf ), MSG_GetData( &buf ), from );
 }
 
@@ -168,15 +306,18 @@ qboolean SV_SourceQuery_HandleConnnectionlessPacket( const char *c, netadr_t fro
 	switch( request )
 	{
 	case SOURCE_QUERY_INFO:
-		SV_SourceQuery_Details( from );
+		if( SV_CheckQueryRate( from ))
+			SV_SourceQuery_Details( from );
 		return true;
 
 	case SOURCE_QUERY_RULES:
-		SV_SourceQuery_Rules( from );
+		if( SV_CheckQueryRate( from ))
+			SV_SourceQuery_Rules( from );
 		return true;
 
 	case SOURCE_QUERY_PLAYERS:
-		SV_SourceQuery_Players( from );
+		if( SV_CheckQueryRate( from ))
+			SV_SourceQuery_Players( from );
 		return true;
 
 	default:
@@ -366,8 +366,10 @@ ENTITY AREA CHECKING
 ===============================================================================
 */
 static int	iTouchLinkSemaphore = 0;	// prevent recursion when SV_TouchLinks is active
-areanode_t	sv_areanodes[AREA_NODES];
+areanode_t	sv_areanodes[AREA_MAX_NODES];
 static int	sv_numareanodes;
+static int	sv_areadepth;		// depth of the tree for current map
+static qboolean	sv_areaadaptive;
 
 /*
 ===============
@@ -389,15 +391,18 @@ static areanode_t *SV_CreateAreaNode( int depth, vec3_t mins, vec3_t maxs )
 	ClearLink( &anode->solid_edicts );
 	ClearLink( &anode->portal_edicts );
 
-	if( depth == AREA_DEPTH )
+	VectorSubtract( maxs, mins, size );
+
+	if( depth == sv_areadepth || ( sv_areaadaptive && VectorMax( size ) < AREA_MIN_SIZE * 2.0f ))
 	{
 		anode->axis = -1;
 		anode->children[0] = anode->children[1] = NULL;
 		return anode;
 	}
 
-	VectorSubtract( maxs, mins, size );
-	if( size[0] > size[1] )
+	if( sv_areaadaptive && size[2] > size[0] && size[2] > size[1] )
+		anode->axis = 2; // tall maps are split vertically too
+	else if( size[0] > size[1] )
 		anode->axis = 0;
 	else anode->axis = 1;
 
@@ -414,6 +419,50 @@ static areanode_t *SV_CreateAreaNode( int depth, vec3_t mins, vec3_t maxs )
 	return anode;
 }
 
+/*
+===============
+SV_AreaDepthForWorld
+
+picks depth for the adaptive tree, so leafs
+aren't crowded and aren't smaller than needed
+===============
+*/
+static int SV_AreaDepthForWorld( void )
+{
+	const char	*pfile = sv.worldmodel->entities;
+	int		numedicts = svs.maxclients;
+	int		depth = AREA_DEPTH;
+
+	// count entities in the map, spawned in runtime ones are usually as many
+	while( pfile && ( pfile = Q_strchr( pfile, '{' )) != NULL )
+	{
+		numedicts++;
+		pfile++;
+	}
+	numedicts *= 2;
+
+	while( depth < AREA_MAX_DEPTH && ( 1 << depth ) * AREA_LEAF_EDICTS < numedicts )
+		depth++;
+
+	return depth;
+}
+
+/*
+===============
+SV_CreateAreaNodes
+
+===============
+*/
+static void SV_CreateAreaNodes( qboolean adaptive )
+{
+	memset( sv_areanodes, 0, sizeof( areanode_t ) * sv_numareanodes );
+	sv_numareanodes = 0;
+	sv_areaadaptive = adaptive;
+	sv_areadepth = adaptive ? SV_AreaDepthForWorld() : AREA_DEPTH;
+
+	SV_CreateAreaNode( 0, sv.worldmodel->mins, sv.worldmodel->maxs );
+}
+
 /*
 ===============
 SV_ClearWorld
@@ -433,11 +482,9 @@ void SV_ClearWorld( void )
 		sv.lightstyles[i].time = 0.0f;
 	}
 
-	memset( sv_areanodes, 0, sizeof( sv_areanodes ));
 	iTouchLinkSemaphore = 0;
-	sv_numareanodes = 0;
 
-	SV_CreateAreaNode( 0, sv.worldmodel->mins, sv.worldmodel->maxs );
+	SV_CreateAreaNodes( sv_adaptive_areanodes.value != 0.0f );
 }
 
 /*
@@ -783,9 +830,10 @@ SV_ClipMoveToEntity
 
 Handles selection or creation of a clipping hull, and offseting (and
 eventually rotation) of the end points
+bad is passed down to PM_RecursiveHullCheckExt
 ==================
 */
-void SV_ClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace )
+static void SV_ClipMoveToEntityExt( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace, qboolean *bad )
 {
 	hull_t	*hull;
 	model_t	*model;
@@ -860,7 +908,7 @@ void SV_ClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t
 
 	if( hullcount == 1 )
 	{
-		PM_RecursiveHullCheck( hull, hull->firstclipnode, 0.0f, 1.0f, start_l, end_l, (pmtrace_t *)trace );
+		PM_RecursiveHullCheckExt( hull, hull->firstclipnode, 0.0f, 1.0f, start_l, end_l, (pmtrace_t *)trace, bad );
 	}
 	else
 	{
@@ -870,7 +918,7 @@ void SV_ClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t
 		{
 			PM_InitTrace( &trace_hitbox, end );
 
-			PM_RecursiveHullCheck( &hull[i], hull[i].firstclipnode, 0.0f, 1.0f, start_l, end_l, (pmtrace_t *)&trace_hitbox );
+			PM_RecursiveHullCheckExt( &hull[i], hull[i].firstclipnode, 0.0f, 1.0f, start_l, end_l, (pmtrace_t *)&trace_hitbox, bad );
 
 			if( i == 0 || trace_hitbox.allsolid || trace_hitbox.startsolid || trace_hitbox.fraction < trace->fraction )
 			{
@@ -909,6 +957,17 @@ void SV_ClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t
 		trace->ent = ent;
 }
 
+/*
+==================
+SV_ClipMoveToEntity
+
+==================
+*/
+void SV_ClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace )
+{
+	SV_ClipMoveToEntityExt( ent, start, mins, maxs, end, trace, NULL );
+}
+
 /*
 ==================
 SV_PortalCSG
@@ -1258,19 +1317,122 @@ static void SV_ClipToWorldBrush( areanode_t *node, moveclip_t *clip )
 		SV_ClipToWorldBrush( node->children[1], clip );
 }
 
+/*
+===============================================================================
+
+TRACE BENCHMARK
+
+===============================================================================
+*/
+#define MAX_RECORDED_MOVES	65536
+
+typedef struct
+{
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	int		type;
+	int		passent;		// -1 if none
+	qboolean		monsterclip;
+} recmove_t;
+
+static struct
+{
+	recmove_t		*moves;
+	int		nummoves;
+	int		maxmoves;
+	qboolean		recording;
+} sv_tracebench;
+
+/*
+==================
+SV_RecordMove
+
+==================
+*/
+static void SV_RecordMove( const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int type, edict_t *e, qboolean monsterclip )
+{
+	recmove_t	*move = &sv_tracebench.moves[sv_tracebench.nummoves++];
+
+	VectorCopy( start, move->start );
+	VectorCopy( end, move->end );
+	VectorCopy( mins, move->mins );
+	VectorCopy( maxs, move->maxs );
+	move->type = type;
+	move->passent = e ? NUM_FOR_EDICT( e ) : -1;
+	move->monsterclip = monsterclip;
+
+	if( sv_tracebench.nummoves == sv_tracebench.maxmoves )
+	{
+		sv_tracebench.recording = false;
+		Con_Printf( "recorded %i moves\n", sv_tracebench.nummoves );
+	}
+}
+
+/*
+==================
+SV_ClipMoveToWorld
+
+first part of SV_Move, depends only on its arguments and the world model,
+so it's safe to call from worker threads if the game doesn't override
+hull selection. Threads must pass bad: instead of Host_Error or warnings
+it's set and the trace has to be redone on the main thread
+==================
+*/
+void SV_ClipMoveToWorld( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace, qboolean *bad )
+{
+	edict_t	*world = EDICT_NUM( 0 );
+	model_t	*model;
+
+	if( bad )
+	{
+		// anything but a plain bsp world may error or use the shared box hull
+		model = SV_ModelHandle( world->v.modelindex );
+
+		if( !model || model->type != mod_brush || world->v.solid != SOLID_BSP
+			|| ( world->v.movetype != MOVETYPE_PUSH && world->v.movetype != MOVETYPE_PUSHSTEP ))
+		{
+			PM_InitTrace( trace, end );
+			*bad = true;
+			return;
+		}
+	}
+
+	SV_ClipMoveToEntityExt( world, start, mins, maxs, end, trace, bad );
+}
+
 /*
 ==================
 SV_Move
 ==================
 */
 trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e, qboolean monsterclip )
+{
+	trace_t	worldtrace;
+
+	SV_ClipMoveToWorld( start, mins, maxs, end, &worldtrace, NULL );
+
+	return SV_MoveClipped( &worldtrace, start, mins, maxs, end, type, e, monsterclip );
+}
+
+/*
+==================
+SV_MoveClipped
+
+finishes SV_Move with a world trace computed by SV_ClipMoveToWorld
+for the same arguments
+==================
+*/
+trace_t SV_MoveClipped( const trace_t *worldtrace, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e, qboolean monsterclip )
 {
 	moveclip_t	clip;
 	vec3_t		trace_endpos;
 	float		trace_fraction;
 
+	if( sv_tracebench.recording )
+		SV_RecordMove( start, mins, maxs, end, type, e, monsterclip );
+
 	memset( &clip, 0, sizeof( moveclip_t ));
-	SV_ClipMoveToEntity( EDICT_NUM( 0 ), start, mins, maxs, end, &clip.trace );
+	clip.trace = *worldtrace;
 
 	if( clip.trace.fraction != 0.0f )
 	{
@@ -1393,6 +1555,149 @@ msurface_t *GAME_EXPORT SV_TraceSurface( edict_t *ent, const vec3_t start, const
 	return PM_RecursiveSurfCheck( bmodel, &bmodel->nodes[hull->firstclipnode], start_l, end_l );
 }
 
+/*
+==================
+SV_RelinkWorld
+
+rebuilds areanodes and links edicts there again
+==================
+*/
+static void SV_RelinkWorld( qboolean adaptive )
+{
+	edict_t	*ent;
+	int	i;
+
+	for( i = 1; i < svgame.numEntities; i++ )
+	{
+		ent = EDICT_NUM( i );
+
+		// remember who was linked, lists are going to be cleared
+		ent->area.next = ent->area.prev;
+		ent->area.prev = NULL;
+	}
+
+	SV_CreateAreaNodes( adaptive );
+
+	for( i = 1; i < svgame.numEntities; i++ )
+	{
+		ent = EDICT_NUM( i );
+
+		if( !ent->area.next )
+			continue;
+
+		ent->area.next = NULL;
+		SV_LinkEdict( ent, false );
+	}
+}
+
+/*
+==================
+SV_ReplayMoves
+
+returns time spent in SV_Move
+==================
+*/
+static double SV_ReplayMoves( trace_t *results, int passes )
+{
+	double	start = Sys_DoubleTime();
+	int	i, j;
+
+	for( j = 0; j < passes; j++ )
+	{
+		for( i = 0; i < sv_tracebench.nummoves; i++ )
+		{
+			recmove_t	*move = &sv_tracebench.moves[i];
+			edict_t	*e = NULL;
+
+			if( move->passent >= 0 && move->passent < svgame.numEntities )
+				e = EDICT_NUM( move->passent );
+
+			results[i] = SV_Move( move->start, move->mins, move->maxs, move->end, move->type, e, move->monsterclip );
+		}
+	}
+
+	return Sys_DoubleTime() - start;
+}
+
+/*
+==================
+SV_TraceBench_f
+
+record SV_Move calls and replay them with both areanode trees
+==================
+*/
+void SV_TraceBench_f( void )
+{
+	qboolean	wasadaptive = sv_areaadaptive;
+	trace_t	*classic, *adaptive;
+	double	time[2];
+	int	i, passes, mismatches = 0;
+
+	if( sv.state != ss_active )
+	{
+		Con_Printf( "server is not active\n" );
+		return;
+	}
+
+	if( Cmd_Argc() >= 2 && !Q_stricmp( Cmd_Argv( 1 ), "record" ))
+	{
+		sv_tracebench.maxmoves = Cmd_Argc() >= 3 ? Q_atoi( Cmd_Argv( 2 )) : 16384;
+		sv_tracebench.maxmoves = bound( 1, sv_tracebench.maxmoves, MAX_RECORDED_MOVES );
+
+		if( sv_tracebench.moves )
+			Mem_Free( sv_tracebench.moves );
+
+		sv_tracebench.moves = Mem_Malloc( host.mempool, sizeof( recmove_t ) * sv_tracebench.maxmoves );
+		sv_tracebench.nummoves = 0;
+		sv_tracebench.recording = true;
+		Con_Printf( "recording next %i moves\n", sv_tracebench.maxmoves );
+		return;
+	}
+
+	if( Cmd_Argc() < 2 || Q_stricmp( Cmd_Argv( 1 ), "play" ))
+	{
+		Con_Printf( S_USAGE "sv_tracebench <record [count]|play [passes]>\n" );
+		return;
+	}
+
+	if( sv_tracebench.recording || !sv_tracebench.nummoves )
+	{
+		Con_Printf( "nothing recorded yet, %i moves so far\n", sv_tracebench.nummoves );
+		return;
+	}
+
+	passes = Cmd_Argc() >= 3 ? bound( 1, Q_atoi( Cmd_Argv( 2 )), 100 ) : 10;
+	classic = Mem_Malloc( host.mempool, sizeof( trace_t ) * sv_tracebench.nummoves );
+	adaptive = Mem_Malloc( host.mempool, sizeof( trace_t ) * sv_tracebench.nummoves );
+
+	SV_RelinkWorld( false );
+	time[0] = SV_ReplayMoves( classic, passes );
+
+	SV_RelinkWorld( true );
+	time[1] = SV_ReplayMoves( adaptive, passes );
+
+	for( i = 0; i < sv_tracebench.nummoves; i++ )
+	{
+		if( classic[i].fraction != adaptive[i].fraction || classic[i].ent != adaptive[i].ent
+			|| classic[i].allsolid != adaptive[i].allsolid || classic[i].startsolid != adaptive[i].startsolid )
+			mismatches++;
+	}
+
+	Con_Printf( "%i moves x %i passes, %i edicts\n", sv_tracebench.nummoves, passes, svgame.numEntities );
+	Con_Printf( "classic tree:  %.2f ms, %.0f moves/s\n", time[0] * 1000.0, sv_tracebench.nummoves * passes / time[0] );
+	Con_Printf( "adaptive tree: %.2f ms, %.0f moves/s, %i nodes, depth %i\n", time[1] * 1000.0,
+		sv_tracebench.nummoves * passes / time[1], sv_numareanodes, sv_areadepth );
+
+	if( mismatches )
+		Con_Printf( S_WARN "%i moves have different results\n", mismatches );
+
+	Mem_Free( classic );
+	Mem_Free( adaptive );
+
+	// restore tree selected for this map
+	SV_RelinkWorld( wasadaptive );
+}
+
 /*
 ==================
 SV_TraceTexture
@@ -31,6 +31,9 @@ GNU General Public License for more details.
 #include <dirent.h>
 #include <errno.h>
 #endif
+#if XASH_POSIX
+#include <unistd.h>
+#endif
 #include <stdio.h>
 #include <stdarg.h>
 #include "port.h"
@@ -42,9 +45,49 @@ GNU General Public License for more details.
 #include "xash3d_mathlib.h"
 #include "common/com_strings.h"
 #include "common/protocol.h"
+#if XASH_FS_MMAP
+#include <sys/mman.h>
+#endif
 
 #define FILE_COPY_SIZE		(1024 * 1024)
 
+#define FINDCACHE_HASH_SIZE	4096	// must be power of two
+#define FINDCACHE_MAX_ENTRIES	65536	// cache is flushed when it grows over this
+
+// FS_FindFile lookup cache
+// archives never change after mount, so for every looked up name we remember
+// which archive has it first in search order (or that none has it)
+// directories may change at any moment, so they are always probed
+typedef struct findcache_s
+{
+	struct findcache_s *next;
+	searchpath_t *search; // first archive that has this file, NULL if none
+	int        index;
+	qboolean   gamedironly;
+	char       *fixedname;
+	char       name[1];   // lowercased, variable sized
+} findcache_t;
+
+// FS_MapFile views
+typedef struct fs_mapping_s
+{
+	struct fs_mapping_s *next;
+	byte   *data;  // pointer returned to the caller
+	void   *base;  // page aligned mmap address, NULL if data was loaded into memory
+	size_t length; // mmap length
+} fs_mapping_t;
+
+static fs_mapping_t *fs_mappings;
+
+static struct
+{
+	findcache_t *hash[FINDCACHE_HASH_SIZE];
+	int numentries;
+	uint hits;
+	uint misses;
+	uint flushes;
+} fs_findcache;
+
 fs_globals_t FI;
 qboolean      fs_ext_path = false;	// attempt to read\write from ./ or ../ pathes
 poolhandle_t  fs_mempool;
@@ -296,6 +339,40 @@ void FS_CreatePath( char *path )
 	}
 }
 
+/*
+================
+FS_FindCacheFlush
+
+must be called each time search path changes
+================
+*/
+static void FS_FindCacheFlush( void )
+{
+	int i;
+
+	if( !fs_findcache.numentries )
+		return;
+
+	for( i = 0; i < FINDCACHE_HASH_SIZE; i++ )
+	{
+		while( fs_findcache.hash[i] )
+		{
+			findcache_t *entry = fs_findcache.hash[i];
+
+			fs_findcache.hash[i] = entry->next;
+			Mem_Free( entry );
+		}
+	}
+
+	fs_findcache.numentries = 0;
+	fs_findcache.flushes++;
+}
+
+static inline qboolean FS_IsDirectorySearchPath( const searchpath_t *search )
+{
+	return search->type == SEARCHPATH_PLAIN || search->type == SEARCHPATH_PK3DIR;
+}
+
 searchpath_t *FS_AddArchive_Fullpath( const fs_archive_t *archive, const char *file, int flags )
 {
 	searchpath_t *search;
@@ -311,6 +388,9 @@ searchpath_t *FS_AddArchive_Fullpath( const fs_archive_t *archive, const char *f
 	if( !search )
 		return NULL;
 
+	FS_FindCacheFlush();
+	FS_CancelPrefetch();
+
 	search->next = fs_searchpaths;
 	fs_searchpaths = search;
 
@@ -421,6 +501,9 @@ void FS_ClearSearchPath( void )
 
 	prev = &fs_searchpaths;
 
+	FS_FindCacheFlush();
+	FS_CancelPrefetch();
+
 	while( true )
 	{
 		cur = *prev;
@@ -1189,6 +1272,9 @@ void FS_Rescan( void )
 	if( Q_stricmp( GI->basedir, GI->falldir ) && Q_stricmp( GI->gamefolder, GI->falldir ))
 		FS_AddGameHierarchy( GI->falldir, 0 );
 	FS_AddGameHierarchy( GI->gamefolder, FS_GAMEDIR_PATH );
+
+	// remember parsed archives for the next run
+	FS_SaveIndex();
 }
 
 /*
@@ -1514,6 +1600,8 @@ void FS_ShutdownStdio( void )
 			Mem_Free( FI.games[i] );
 	}
 
+	FS_ShutdownPrefetch(); // stop workers before archives are closed
+	FS_ShutdownIndex();
 	FS_ClearSearchPath(); // release all wad files too
 	Mem_FreePool( &fs_mempool );
 }
@@ -1528,6 +1616,7 @@ debug info
 void FS_Path_f( void )
 {
 	searchpath_t	*s;
+	uint		total = fs_findcache.hits + fs_findcache.misses;
 
 	Con_Printf( "Current search path:\n" );
 
@@ -1547,6 +1636,14 @@ void FS_Path_f( void )
 
 		Con_Printf( "\n" );
 	}
+
+	Con_Printf( "Lookup cache: %i entries, %u hits, %u misses (%.1f%% hit rate), %u flushes\n",
+		fs_findcache.numentries, fs_findcache.hits, fs_findcache.misses,
+		total ? fs_findcache.hits * 100.0 / total : 0.0, fs_findcache.flushes );
+
+	FS_PrintCacheInfo_ZIP();
+	FS_PrintPrefetchInfo();
+	FS_PrintIndexInfo();
 }
 
 /*
@@ -1653,8 +1750,34 @@ file_t *FS_SysOpen( const char *filepath, const char *mode )
 	if( opt & O_APPEND )  file->position = file->real_length;
 	else lseek( file->handle, 0, SEEK_SET );
 
+#ifdef POSIX_FADV_SEQUENTIAL
+	// plain files are mostly parsed from start to end
+	if( mod == O_RDONLY )
+		posix_fadvise( file->handle, 0, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+
 	return file;
 }
+
+/*
+====================
+FS_SysReadAt
+
+Read from the given offset without moving the descriptor offset,
+so descriptors shared between file_t's don't depend on each other
+====================
+*/
+fs_offset_t FS_SysReadAt( int handle, void *buffer, size_t count, fs_offset_t offset )
+{
+#if XASH_POSIX
+	return pread( handle, buffer, count, offset );
+#else
+	if( lseek( handle, offset, SEEK_SET ) == -1 )
+		return -1;
+
+	return read( handle, buffer, count );
+#endif
+}
 /*
 static int FS_DuplicateHandle( const char *filename, int handle, fs_offset_t pos )
 {
@@ -1696,6 +1819,12 @@ file_t *FS_OpenHandle( const char *syspath, int handle, fs_offset_t offset, fs_o
 	file->position = 0;
 	file->ungetc = EOF;
 
+#ifdef POSIX_FADV_WILLNEED
+	// start reading the beginning of the packed file in background
+	if( file->handle >= 0 )
+		posix_fadvise( file->handle, offset, Q_min( len, FILE_READAHEAD_SIZE ), POSIX_FADV_WILLNEED );
+#endif
+
 	return file;
 }
 
@@ -1816,22 +1945,127 @@ and the file index in the package if relevant
 */
 searchpath_t *FS_FindFile( const char *name, int *index, char *fixedname, size_t len, qboolean gamedironly )
 {
-	searchpath_t	*search;
+	searchpath_t	*search, *found = NULL, *archive = NULL;
+	char		lowername[MAX_SYSPATH], archivename[MAX_SYSPATH];
+	int		found_ind = -1, archive_ind = -1;
+	findcache_t	*entry;
+	uint		hash;
 
-	// search through the path, one element at a time
-	for( search = fs_searchpaths; search; search = search->next )
+	Q_strnlwr( name, lowername, sizeof( lowername ));
+	hash = COM_HashKey( lowername, FINDCACHE_HASH_SIZE );
+
+	for( entry = fs_findcache.hash[hash]; entry; entry = entry->next )
 	{
-		int pack_ind;
+		if( entry->gamedironly == gamedironly && !Q_strcmp( entry->name, lowername ))
+			break;
+	}
 
-		if( gamedironly & !FBitSet( search->flags, FS_GAMEDIRONLY_SEARCH_FLAGS ))
-			continue;
+	if( entry )
+	{
+		fs_findcache.hits++;
 
-		pack_ind = search->pfnFindFile( search, name, fixedname, len );
-		if( pack_ind >= 0 )
+		// only directories before the cached archive can override it
+		for( search = fs_searchpaths; search && search != entry->search; search = search->next )
 		{
+			int pack_ind;
+
+			if( !FS_IsDirectorySearchPath( search ))
+				continue;
+
+			if( gamedironly & !FBitSet( search->flags, FS_GAMEDIRONLY_SEARCH_FLAGS ))
+				continue;
+
+			pack_ind = search->pfnFindFile( search, name, fixedname, len );
+			if( pack_ind >= 0 )
+			{
+				if( index )
+					*index = pack_ind;
+				return search;
+			}
+		}
+
+		if( entry->search )
+		{
+			if( fixedname )
+				Q_strncpy( fixedname, entry->fixedname, len );
 			if( index )
-				*index = pack_ind;
-			return search;
+				*index = entry->index;
+			return entry->search;
+		}
+	}
+	else
+	{
+		size_t namelen, fixedlen;
+
+		fs_findcache.misses++;
+
+		// search through the path, one element at a time
+		// keep going until first archive is found to fill the cache
+		for( search = fs_searchpaths; search; search = search->next )
+		{
+			qboolean isdir = FS_IsDirectorySearchPath( search );
+			int pack_ind;
+
+			if( found && isdir )
+				continue;
+
+			if( gamedironly & !FBitSet( search->flags, FS_GAMEDIRONLY_SEARCH_FLAGS ))
+				continue;
+
+			if( isdir )
+			{
+				pack_ind = search->pfnFindFile( search, name, fixedname, len );
+				if( pack_ind >= 0 )
+				{
+					found = search;
+					found_ind = pack_ind;
+				}
+				continue;
+			}
+
+			pack_ind = search->pfnFindFile( search, name, archivename, sizeof( archivename ));
+			if( pack_ind >= 0 )
+			{
+				archive = search;
+				archive_ind = pack_ind;
+				break;
+			}
+		}
+
+		if( fs_findcache.numentries >= FINDCACHE_MAX_ENTRIES )
+			FS_FindCacheFlush();
+
+		namelen = Q_strlen( lowername ) + 1;
+		fixedlen = archive ? Q_strlen( archivename ) + 1 : 0;
+
+		entry = Mem_Malloc( fs_mempool, sizeof( *entry ) + namelen + fixedlen );
+		entry->search = archive;
+		entry->index = archive_ind;
+		entry->gamedironly = gamedironly;
+		memcpy( entry->name, lowername, namelen );
+		entry->fixedname = NULL;
+		if( archive )
+		{
+			entry->fixedname = entry->name + namelen;
+			memcpy( entry->fixedname, archivename, fixedlen );
+		}
+		entry->next = fs_findcache.hash[hash];
+		fs_findcache.hash[hash] = entry;
+		fs_findcache.numentries++;
+
+		if( !found && archive )
+		{
+			found = archive;
+			found_ind = archive_ind;
+			if( fixedname )
+				Q_strncpy( fixedname, archivename, len );
+		}
+
+		if( found )
+		{
+			if( index )
+				*index = found_ind;
+			return found;
 		}
 	}
 
@@ -1981,6 +2215,9 @@ int FS_Close( file_t *file )
 
 	FS_BackupFileName( file, NULL, 0 );
 
+	if( file->ztk )
+		FS_CloseInflate_ZIP( file );
+
 	if( file->handle >= 0 )
 		if( close( file->handle ))
 			return EOF;
@@ -2028,9 +2265,8 @@ fs_offset_t FS_Write( file_t *file, const void *data, size_t datasize )
 
 	if( !file ) return 0;
 
-	// if necessary, seek to the exact file position we're supposed to be
-	if( file->buff_ind != file->buff_len )
-		lseek( file->handle, file->buff_ind - file->buff_len, SEEK_CUR );
+	// reads and seeks don't move the descriptor offset, go to the logical position
+	lseek( file->handle, file->offset + FS_Tell( file ), SEEK_SET );
 
 	// purge cached data
 	FS_Purge( file );
@@ -2047,6 +2283,21 @@ fs_offset_t FS_Write( file_t *file, const void *data, size_t datasize )
 	return result;
 }
 
+/*
+====================
+FS_ReadRaw
+
+Read file data at the current position, decompressing it if needed
+====================
+*/
+static fs_offset_t FS_ReadRaw( file_t *file, void *buffer, size_t count )
+{
+	if( file->ztk )
+		return FS_Inflate_ZIP( file, buffer, count );
+
+	return FS_SysReadAt( file->handle, buffer, count, file->offset + file->position );
+}
+
 /*
 ====================
 FS_Read
@@ -2077,12 +2328,14 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 	if( file->buff_ind < file->buff_len )
 	{
 		count = file->buff_len - file->buff_ind;
+		if( count > buffersize )
+			count = buffersize;
 
-		done += ( buffersize > count ) ? (fs_offset_t)count : (fs_offset_t)buffersize;
-		memcpy( buffer, &file->buff[file->buff_ind], done );
-		file->buff_ind += done;
+		memcpy( (byte *)buffer + done, &file->buff[file->buff_ind], count );
+		file->buff_ind += count;
+		done += count;
 
-		buffersize -= done;
+		buffersize -= count;
 		if( buffersize == 0 )
 			return done;
 	}
@@ -2098,8 +2351,7 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 	{
 		if( count > buffersize )
 			count = buffersize;
-		lseek( file->handle, file->offset + file->position, SEEK_SET );
-		nb = read( file->handle, (byte *)buffer + done, count );
+		nb = FS_ReadRaw( file, (byte *)buffer + done, count );
 
 		if( nb > 0 )
 		{
@@ -2113,8 +2365,7 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 	{
 		if( count > sizeof( file->buff ))
 			count = sizeof( file->buff );
-		lseek( file->handle, file->offset + file->position, SEEK_SET );
-		nb = read( file->handle, file->buff, count );
+		nb = FS_ReadRaw( file, file->buff, count );
 
 		if( nb > 0 )
 		{
@@ -2190,7 +2441,7 @@ int FS_VPrintf( file_t *file, const char *format, va_list ap )
 		buff_size *= 2;
 	}
 
-	len = write( file->handle, tempbuff, len );
+	len = FS_Write( file, tempbuff, len );
 	Mem_Free( tempbuff );
 
 	return len;
@@ -2299,12 +2550,10 @@ int FS_Seek( file_t *file, fs_offset_t offset, int whence )
 		return 0;
 	}
 
-	FS_EnsureOpenFile( file );
 	// Purge cached data
 	FS_Purge( file );
 
-	if( lseek( file->handle, file->offset + offset, SEEK_SET ) == -1 )
-		return -1;
+	// reads are positional and writes seek by themselves, so just move the position
 	file->position = offset;
 
 	return 0;
@@ -2361,6 +2610,7 @@ Always appends a 0 byte.
 byte *FS_LoadFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly )
 {
 	searchpath_t *search;
+	byte *buf;
 	file_t *file;
 	char netpath[MAX_SYSPATH];
 	int pack_ind;
@@ -2375,6 +2625,10 @@ byte *FS_LoadFile( const char *path, fs_offset_t *filesizeptr, qboolean gamediro
 	if( !fs_searchpaths || FS_CheckNastyPath( path ))
 		return NULL;
 
+	// already read in background
+	if(( buf = FS_TakePrefetched( path, filesizeptr, gamedironly )) != NULL )
+		return buf;
+
 	search = FS_FindFile( path, &pack_ind, netpath, sizeof( netpath ), gamedironly );
 
 	if( !search )
@@ -2389,7 +2643,6 @@ byte *FS_LoadFile( const char *path, fs_offset_t *filesizeptr, qboolean gamediro
 	if( file )
 	{
 		fs_offset_t	filesize = file->real_length;
-		byte *buf;
 
 		buf = (byte *)Mem_Malloc( fs_mempool, filesize + 1 );
 		buf[filesize] = '\0';
@@ -2405,6 +2658,159 @@ byte *FS_LoadFile( const char *path, fs_offset_t *filesizeptr, qboolean gamediro
 	return NULL;
 }
 
+#if XASH_FS_MMAP
+static byte *FS_MapRange( int handle, fs_offset_t offset, fs_offset_t size, fs_mapping_t *mapping )
+{
+	static long pagesize;
+	fs_offset_t aligned;
+	struct stat buf;
+	void *base;
+
+	if( handle < 0 || size <= 0 )
+		return NULL;
+
+	// pages past the end fault on access, truncated archive must fail the old way
+	if( fstat( handle, &buf ) < 0 || offset < 0 || offset + size > buf.st_size )
+		return NULL;
+
+	if( !pagesize )
+		pagesize = sysconf( _SC_PAGESIZE );
+
+	aligned = offset & ~((fs_offset_t)pagesize - 1 );
+
+	// private writable mapping, so loaders that patch their input get a copy of the page
+	base = mmap( NULL, size + ( offset - aligned ), PROT_READ|PROT_WRITE, MAP_PRIVATE, handle, aligned );
+	if( base == MAP_FAILED )
+		return NULL;
+
+#ifdef MADV_WILLNEED
+	madvise( base, size + ( offset - aligned ), MADV_WILLNEED );
+#endif
+
+	mapping->base = base;
+	mapping->length = size + ( offset - aligned );
+
+	return (byte *)base + ( offset - aligned );
+}
+#endif // XASH_FS_MMAP
+
+/*
+============
+FS_MapFile
+
+Returns a read-only view of the file, without copying it when
+file data is stored uncompressed on disk. The buffer is NOT null terminated.
+Falls back to FS_LoadFile on compressed files and platforms without mmap.
+============
+*/
+byte *FS_MapFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly )
+{
+	fs_mapping_t *mapping;
+	byte *data = NULL;
+	fs_offset_t filesize = 0;
+
+	if( filesizeptr )
+		*filesizeptr = 0;
+
+	mapping = (fs_mapping_t *)Mem_Calloc( fs_mempool, sizeof( *mapping ));
+
+#if XASH_FS_MMAP
+	{
+		searchpath_t *search;
+		char netpath[MAX_SYSPATH];
+		const char *name = path;
+		int pack_ind;
+
+		// some mappers used leading '/' or '\' in path to models or sounds
+		if( name[0] == '/' || name[0] == '\\' )
+			name++;
+
+		if( name[0] == '/' || name[0] == '\\' )
+			name++;
+
+		// staged buffer is already in memory, let FS_LoadFile take it
+		if( fs_searchpaths && !FS_CheckNastyPath( name )
+			&& !( data = FS_TakePrefetched( name, &filesize, gamedironly ))
+			&& ( search = FS_FindFile( name, &pack_ind, netpath, sizeof( netpath ), gamedironly )))
+		{
+			int handle;
+			fs_offset_t offset;
+
+			if( search->pfnFileRange )
+			{
+				if( search->pfnFileRange( search, pack_ind, &handle, &offset, &filesize ))
+					data = FS_MapRange( handle, offset, filesize, mapping );
+			}
+			else if( !search->pfnLoadFile )
+			{
+				file_t *file = search->pfnOpenFile( search, netpath, "rb", pack_ind );
+
+				if( file )
+				{
+					filesize = file->real_length;
+					data = FS_MapRange( file->handle, file->offset, filesize, mapping );
+					FS_Close( file ); // mapping stays valid
+				}
+			}
+		}
+	}
+#endif // XASH_FS_MMAP
+
+	if( !data )
+	{
+		data = FS_LoadFile( path, &filesize, gamedironly );
+		if( !data )
+		{
+			Mem_Free( mapping );
+			return NULL;
+		}
+		mapping->base = NULL;
+	}
+
+	mapping->data = data;
+	mapping->next = fs_mappings;
+	fs_mappings = mapping;
+
+	if( filesizeptr )
+		*filesizeptr = filesize;
+
+	return data;
+}
+
+/*
+============
+FS_UnmapFile
+
+============
+*/
+void FS_UnmapFile( byte *data )
+{
+	fs_mapping_t *mapping, **prev;
+
+	if( !data )
+		return;
+
+	for( prev = &fs_mappings; ( mapping = *prev ) != NULL; prev = &mapping->next )
+	{
+		if( mapping->data != data )
+			continue;
+
+		*prev = mapping->next;
+
+#if XASH_FS_MMAP
+		if( mapping->base )
+			munmap( mapping->base, mapping->length );
+		else
+#endif
+			Mem_Free( mapping->data );
+
+		Mem_Free( mapping );
+		return;
+	}
+
+	Con_Printf( S_ERROR "%s: %p wasn't mapped\n", __func__, data );
+}
+
 qboolean CRC32_File( dword *crcvalue, const char *filename )
 {
 	char	buffer[1024];
@@ -2828,6 +3234,7 @@ void FS_InitMemory( void )
 {
 	fs_mempool = Mem_AllocPool( "FileSystem Pool" );
 	fs_searchpaths = NULL;
+	memset( &fs_findcache, 0, sizeof( fs_findcache ));
 }
 
 fs_interface_t g_engfuncs =
@@ -2951,6 +3358,14 @@ fs_api_t g_api =
 	(void *)FS_MountArchive_Fullpath,
 
 	FS_GetFullDiskPath,
+
+	FS_MapFile,
+	FS_UnmapFile,
+
+	FS_Prefetch,
+	FS_CancelPrefetch,
+
+	FS_SetIndexCache,
 };
 
 int EXPORT GetFSAPI( int version, fs_api_t *api, fs_globals_t **globals, fs_interface_t *engfuncs )
@@ -31,8 +31,8 @@ extern "C"
 {
 #endif // __cplusplus
 
-#define FS_API_VERSION 2 // not stable yet!
-#define FS_API_CREATEINTERFACE_TAG   "XashFileSystem002" // follow FS_API_VERSION!!!
+#define FS_API_VERSION 3 // not stable yet!
+#define FS_API_CREATEINTERFACE_TAG   "XashFileSystem003" // follow FS_API_VERSION!!!
 #define FILESYSTEM_INTERFACE_VERSION "VFileSystem009" // never change this!
 
 // search path flags
@@ -192,6 +192,20 @@ typedef struct fs_api_t
 	void *(*MountArchive_Fullpath)( const char *path, int flags );
 
 	qboolean (*GetFullDiskPath)( char *buffer, size_t size, const char *name, qboolean gamedironly );
+
+	// zero-copy file view, must be released with UnmapFile
+	// unlike LoadFile, the buffer isn't null terminated, writes to it are private
+	byte *(*MapFile)( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly );
+	void (*UnmapFile)( byte *data );
+
+	// read files in background, LoadFile and MapFile pick up the result
+	// CancelPrefetch drops everything that wasn't loaded
+	void (*Prefetch)( const char *path, qboolean gamedironly );
+	void (*CancelPrefetch)( void );
+
+	// persistent cache of parsed archive directories, set before InitStdio
+	// NULL saves and disables it
+	void (*SetIndexCache)( const char *path );
 } fs_api_t;
 
 typedef struct fs_interface_t
@@ -31,8 +31,29 @@ typedef struct dir_s dir_t;
 typedef struct zip_s zip_t;
 typedef struct pack_s pack_t;
 typedef struct wfile_s wfile_t;
+typedef struct ztoolkit_s ztoolkit_t;
 
-#define FILE_BUFF_SIZE		(2048)
+// file_t read buffer, reads bigger than half of it go directly to the caller buffer
+#ifndef FILE_BUFF_SIZE
+#define FILE_BUFF_SIZE		(16384)
+#endif
+
+// amount of data kernel is asked to read ahead when file is opened
+#define FILE_READAHEAD_SIZE	(256 * 1024)
+
+// zero-copy FS_MapFile views, archives and files are mapped with mmap
+#if XASH_POSIX && !XASH_PSVITA && !XASH_NSWITCH && !defined XASH_REDUCE_FD
+#define XASH_FS_MMAP 1
+#else
+#define XASH_FS_MMAP 0
+#endif
+
+// background prefetch workers, read files with pread from shared descriptors
+#if XASH_POSIX && !XASH_PSVITA && !XASH_NSWITCH && !XASH_EMSCRIPTEN && !XASH_DOS4GW && !defined XASH_REDUCE_FD
+#define XASH_FS_PREFETCH 1
+#else
+#define XASH_FS_PREFETCH 0
+#endif
 
 struct file_s
 {
@@ -42,6 +63,7 @@ struct file_s
 	fs_offset_t		position;			// current position in the file
 	fs_offset_t		offset;			// offset into the package (0 if external file)
 	time_t		filetime;			// pak, wad or real filetime
+	ztoolkit_t	*ztk;			// inflate stream for deflated zip entries
 						// contents buffer
 	fs_offset_t		buff_ind, buff_len;		// buffer current index and length
 	byte		buff[FILE_BUFF_SIZE];	// intermediate buffer
@@ -92,6 +114,8 @@ typedef struct searchpath_s
 	int     (*pfnFindFile)( struct searchpath_s *search, const char *path, char *fixedname, size_t len );
 	void    (*pfnSearch)( struct searchpath_s *search, stringlist_t *list, const char *pattern, int caseinsensitive );
 	byte   *(*pfnLoadFile)( struct searchpath_s *search, const char *path, int pack_ind, fs_offset_t *filesize );
+	// location of uncompressed file data in archive, used to map it directly
+	qboolean (*pfnFileRange)( struct searchpath_s *search, int pack_ind, int *handle, fs_offset_t *offset, fs_offset_t *size );
 } searchpath_t;
 
 typedef searchpath_t *(*FS_ADDARCHIVE_FULLPATH)( const char *path, int flags );
@@ -171,6 +195,8 @@ qboolean FS_FileCopy( file_t *pOutput, file_t *pInput, int fileSize );
 byte *FS_LoadFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly );
 byte *FS_LoadDirectFile( const char *path, fs_offset_t *filesizeptr );
 qboolean FS_WriteFile( const char *filename, const void *data, fs_offset_t len );
+byte *FS_MapFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly );
+void FS_UnmapFile( byte *data );
 
 // file hashing
 qboolean CRC32_File( dword *crcvalue, const char *filename );
@@ -200,6 +226,7 @@ file_t  *FS_OpenReadFile( const char *filename, const char *mode, qboolean gamed
 int           FS_SysFileTime( const char *filename );
 file_t       *FS_OpenHandle( const char *syspath, int handle, fs_offset_t offset, fs_offset_t len );
 file_t       *FS_SysOpen( const char *filepath, const char *mode );
+fs_offset_t   FS_SysReadAt( int handle, void *buffer, size_t count, fs_offset_t offset );
 searchpath_t *FS_FindFile( const char *name, int *index, char *fixedname, size_t len, qboolean gamedironly );
 qboolean FS_FullPathToRelativePath( char *dst, const char *src, size_t size );
 
@@ -217,6 +244,30 @@ searchpath_t *FS_AddWad_Fullpath( const char *wadfile, int flags );
 // zip.c
 //
 searchpath_t *FS_AddZip_Fullpath( const char *zipfile, int flags );
+fs_offset_t FS_Inflate_ZIP( file_t *file, void *buffer, size_t size );
+void FS_CloseInflate_ZIP( file_t *file );
+void FS_PrintCacheInfo_ZIP( void );
+qboolean FS_DeflatedRange_ZIP( searchpath_t *search, int pack_ind, int *handle, fs_offset_t *offset, fs_offset_t *disksize, fs_offset_t *size );
+qboolean FS_InflateBuffer_ZIP( const byte *in, fs_offset_t inlen, byte *out, fs_offset_t outlen );
+
+//
+// index.c
+//
+void FS_SetIndexCache( const char *path );
+const byte *FS_FindIndex( const char *path, int type, size_t *payloadsize );
+void FS_StoreIndex( const char *path, int type, const void *payload, size_t payloadsize );
+void FS_SaveIndex( void );
+void FS_ShutdownIndex( void );
+void FS_PrintIndexInfo( void );
+
+//
+// prefetch.c
+//
+void FS_Prefetch( const char *path, qboolean gamedironly );
+void FS_CancelPrefetch( void );
+byte *FS_TakePrefetched( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly );
+void FS_PrintPrefetchInfo( void );
+void FS_ShutdownPrefetch( void );
 
 //
 // dir.c
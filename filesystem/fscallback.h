@@ -65,6 +65,11 @@ extern fs_globals_t *FI;
 #define FS_LoadFile (*g_fsapi.LoadFile)
 #define FS_LoadDirectFile (*g_fsapi.LoadDirectFile)
 #define FS_WriteFile (*g_fsapi.WriteFile)
+#define FS_MapFile (*g_fsapi.MapFile)
+#define FS_UnmapFile (*g_fsapi.UnmapFile)
+#define FS_Prefetch (*g_fsapi.Prefetch)
+#define FS_CancelPrefetch (*g_fsapi.CancelPrefetch)
+#define FS_SetIndexCache (*g_fsapi.SetIndexCache)
 
 // file hashing
 #define CRC32_File (*g_fsapi.CRC32_File)
@@ -0,0 +1,469 @@
+/*
+index.c - persistent cache of parsed archive directories
+Copyright (C) 2023 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "build.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include STDINT_H
+#include "port.h"
+#include "filesystem_internal.h"
+#include "crtlib.h"
+#include "crclib.h"
+#include "common/com_strings.h"
+
+/*
+=============================================================================
+
+Archive loaders store their parsed, already sorted file tables here,
+keyed by archive path, type, size and modification time. The index is
+saved to disk, so cold mounts of unchanged archives skip parsing.
+It isn't portable between builds or machines, header carries a build
+signature and index made by another build is thrown away.
+
+=============================================================================
+*/
+
+#define IDINDEXHEADER	(('I'<<24)+('S'<<16)+('F'<<8)+'X')	// little-endian "XFSI"
+#define INDEX_VERSION	2
+#define INDEX_HASH_SIZE	256
+#define INDEX_MAX_SIZE	(256 * 1024 * 1024)	// sanity check
+
+typedef struct
+{
+	int		ident;
+	int		version;
+	int		offsetsize;	// sizeof( fs_offset_t )
+	uint		signature;	// see FS_IndexSignature
+	int		numrecords;
+} dindexheader_t;
+
+typedef struct
+{
+	int		type;		// SEARCHPATH_*
+	int		pathlen;	// including terminator
+	int64_t		size;
+	int64_t		mtime;		// nanoseconds where available
+	int		payloadsize;
+} dindexrecord_t;
+
+typedef struct fsindex_s
+{
+	struct fsindex_s *next;
+	int		type;
+	qboolean	used;		// asked for in this session
+	int64_t		size;
+	int64_t		mtime;
+	size_t		payloadsize;
+	byte		*payload;
+	char		path[1];	// variable sized
+} fsindex_t;
+
+static struct
+{
+	char		path[MAX_SYSPATH];	// empty if disabled
+	qboolean	loaded;
+	qboolean	dirty;
+	fsindex_t	*hash[INDEX_HASH_SIZE];
+	int		numrecords;
+	uint		hits;
+	uint		misses;
+} fs_index;
+
+/*
+============
+FS_StatArchive
+
+============
+*/
+static qboolean FS_StatArchive( const char *path, int64_t *size, int64_t *mtime )
+{
+#if XASH_WIN32
+	struct _stat buf;
+	if( _stat( path, &buf ) < 0 )
+#else
+	struct stat buf;
+	if( stat( path, &buf ) < 0 )
+#endif
+		return false;
+
+	*size = buf.st_size;
+	*mtime = (int64_t)buf.st_mtime * 1000000000;
+
+	// whole seconds miss an archive rewritten right after it was indexed
+#if XASH_APPLE
+	*mtime += buf.st_mtimespec.tv_nsec;
+#elif XASH_POSIX
+	*mtime += buf.st_mtim.tv_nsec;
+#endif
+
+	return true;
+}
+
+/*
+============
+FS_IndexSignature
+
+payloads are raw loader structs, so anything
+that can change their layout must be here
+============
+*/
+static uint FS_IndexSignature( void )
+{
+	static uint32_t signature;
+
+	if( !signature )
+	{
+		char buf[256];
+		int len;
+
+		len = Q_snprintf( buf, sizeof( buf ), "%s %i %s %s %s %i", XASH_VERSION, Q_buildnum(),
+			Q_buildcommit(), Q_buildos(), Q_buildarch(), (int)sizeof( void * ));
+
+		CRC32_Init( &signature );
+		CRC32_ProcessBuffer( &signature, buf, len );
+		signature = CRC32_Final( signature );
+	}
+
+	return signature;
+}
+
+/*
+============
+FS_FindIndexRecord
+
+============
+*/
+static fsindex_t *FS_FindIndexRecord( const char *path, int type )
+{
+	fsindex_t *rec;
+
+	for( rec = fs_index.hash[COM_HashKey( path, INDEX_HASH_SIZE )]; rec; rec = rec->next )
+	{
+		if( rec->type == type && !Q_strcmp( rec->path, path ))
+			return rec;
+	}
+
+	return NULL;
+}
+
+/*
+============
+FS_AddIndexRecord
+
+replaces existing record
+============
+*/
+static fsindex_t *FS_AddIndexRecord( const char *path, int type, int64_t size, int64_t mtime, const void *payload, size_t payloadsize )
+{
+	size_t pathlen = Q_strlen( path ) + 1;
+	fsindex_t *rec, **prev;
+	uint hash = COM_HashKey( path, INDEX_HASH_SIZE );
+
+	for( prev = &fs_index.hash[hash]; *prev; prev = &( *prev )->next )
+	{
+		rec = *prev;
+
+		if( rec->type == type && !Q_strcmp( rec->path, path ))
+		{
+			*prev = rec->next;
+			Mem_Free( rec->payload );
+			Mem_Free( rec );
+			fs_index.numrecords--;
+			break;
+		}
+	}
+
+	rec = (fsindex_t *)Mem_Calloc( fs_mempool, sizeof( *rec ) + pathlen );
+	Q_strncpy( rec->path, path, pathlen );
+	rec->type = type;
+	rec->size = size;
+	rec->mtime = mtime;
+	rec->payloadsize = payloadsize;
+	rec->payload = Mem_Malloc( fs_mempool, payloadsize );
+	memcpy( rec->payload, payload, payloadsize );
+
+	rec->next = fs_index.hash[hash];
+	fs_index.hash[hash] = rec;
+	fs_index.numrecords++;
+
+	return rec;
+}
+
+/*
+============
+FS_FreeIndex
+
+============
+*/
+static void FS_FreeIndex( void )
+{
+	int i;
+
+	for( i = 0; i < INDEX_HASH_SIZE; i++ )
+	{
+		while( fs_index.hash[i] )
+		{
+			fsindex_t *rec = fs_index.hash[i];
+
+			fs_index.hash[i] = rec->next;
+			Mem_Free( rec->payload );
+			Mem_Free( rec );
+		}
+	}
+
+	fs_index.numrecords = 0;
+	fs_index.loaded = false;
+	fs_index.dirty = false;
+}
+
+/*
+============
+FS_LoadIndex
+
+============
+*/
+static void FS_LoadIndex( void )
+{
+	dindexheader_t header;
+	fs_offset_t filesize, ofs;
+	file_t *f;
+	byte *buf;
+	int i;
+
+	fs_index.loaded = true;
+
+	if( !( f = FS_SysOpen( fs_index.path, "rb" )))
+		return; // not created yet
+
+	filesize = FS_FileLength( f );
+	if( filesize < sizeof( header ) || filesize > INDEX_MAX_SIZE )
+	{
+		FS_Close( f );
+		return;
+	}
+
+	buf = Mem_Malloc( fs_mempool, filesize );
+	if( FS_Read( f, buf, filesize ) != filesize )
+	{
+		Mem_Free( buf );
+		FS_Close( f );
+		return;
+	}
+	FS_Close( f );
+
+	memcpy( &header, buf, sizeof( header ));
+
+	if( header.ident != IDINDEXHEADER || header.version != INDEX_VERSION || header.offsetsize != sizeof( fs_offset_t )
+		|| header.signature != FS_IndexSignature( ))
+	{
+		Con_Reportf( "%s: %s is outdated, rebuilding\n", __func__, fs_index.path );
+		Mem_Free( buf );
+		return;
+	}
+
+	for( i = 0, ofs = sizeof( header ); i < header.numrecords; i++ )
+	{
+		dindexrecord_t drec;
+		const char *path;
+
+		if( ofs + (fs_offset_t)sizeof( drec ) > filesize )
+			break;
+
+		memcpy( &drec, buf + ofs, sizeof( drec ));
+		ofs += sizeof( drec );
+
+		if( drec.pathlen <= 1 || drec.payloadsize < 0 || ofs + drec.pathlen + drec.payloadsize > filesize )
+			break;
+
+		path = (const char *)buf + ofs;
+		if( path[drec.pathlen - 1] != '\0' )
+			break;
+
+		FS_AddIndexRecord( path, drec.type, drec.size, drec.mtime, buf + ofs + drec.pathlen, drec.payloadsize );
+		ofs += drec.pathlen + drec.payloadsize;
+	}
+
+	if( i != header.numrecords )
+	{
+		Con_Reportf( S_ERROR "%s: %s is corrupted, rebuilding\n", __func__, fs_index.path );
+		FS_FreeIndex();
+		fs_index.loaded = true;
+	}
+
+	Mem_Free( buf );
+}
+
+/*
+============
+FS_SaveIndex
+
+writes records used in this session and ones that are still valid
+============
+*/
+void FS_SaveIndex( void )
+{
+	dindexheader_t header;
+	file_t *f;
+	int i;
+
+	if( !fs_index.path[0] || !fs_index.dirty )
+		return;
+
+	fs_index.dirty = false;
+
+	if( !( f = FS_SysOpen( fs_index.path, "wb" )))
+	{
+		Con_Reportf( S_ERROR "%s: can't write %s\n", __func__, fs_index.path );
+		return;
+	}
+
+	header.ident = IDINDEXHEADER;
+	header.version = INDEX_VERSION;
+	header.offsetsize = sizeof( fs_offset_t );
+	header.signature = FS_IndexSignature();
+	header.numrecords = 0;
+	FS_Write( f, &header, sizeof( header ));
+
+	for( i = 0; i < INDEX_HASH_SIZE; i++ )
+	{
+		fsindex_t *rec;
+
+		for( rec = fs_index.hash[i]; rec; rec = rec->next )
+		{
+			dindexrecord_t drec;
+			int64_t size, mtime;
+
+			// drop archives that were removed or changed
+			if( !rec->used && ( !FS_StatArchive( rec->path, &size, &mtime ) || size != rec->size || mtime != rec->mtime ))
+				continue;
+
+			drec.type = rec->type;
+			drec.pathlen = Q_strlen( rec->path ) + 1;
+			drec.size = rec->size;
+			drec.mtime = rec->mtime;
+			drec.payloadsize = rec->payloadsize;
+
+			FS_Write( f, &drec, sizeof( drec ));
+			FS_Write( f, rec->path, drec.pathlen );
+			FS_Write( f, rec->payload, rec->payloadsize );
+			header.numrecords++;
+		}
+	}
+
+	FS_Seek( f, 0, SEEK_SET );
+	FS_Write( f, &header, sizeof( header ));
+	FS_Close( f );
+}
+
+/*
+============
+FS_FindIndex
+
+returns stored file table if archive wasn't changed since
+============
+*/
+const byte *FS_FindIndex( const char *path, int type, size_t *payloadsize )
+{
+	int64_t size, mtime;
+	fsindex_t *rec;
+
+	if( !fs_index.path[0] )
+		return NULL;
+
+	if( !fs_index.loaded )
+		FS_LoadIndex();
+
+	rec = FS_FindIndexRecord( path, type );
+
+	if( !rec || !FS_StatArchive( path, &size, &mtime ) || size != rec->size || mtime != rec->mtime )
+	{
+		fs_index.misses++;
+		return NULL;
+	}
+
+	fs_index.hits++;
+	rec->used = true;
+	*payloadsize = rec->payloadsize;
+
+	return rec->payload;
+}
+
+/*
+============
+FS_StoreIndex
+
+============
+*/
+void FS_StoreIndex( const char *path, int type, const void *payload, size_t payloadsize )
+{
+	int64_t size, mtime;
+	fsindex_t *rec;
+
+	if( !fs_index.path[0] )
+		return;
+
+	if( !fs_index.loaded )
+		FS_LoadIndex();
+
+	if( !FS_StatArchive( path, &size, &mtime ))
+		return;
+
+	rec = FS_AddIndexRecord( path, type, size, mtime, payload, payloadsize );
+	rec->used = true;
+	fs_index.dirty = true;
+}
+
+/*
+============
+FS_SetIndexCache
+
+enables persistent archive index stored in file at path, NULL disables it
+============
+*/
+void FS_SetIndexCache( const char *path )
+{
+	FS_ShutdownIndex();
+
+	if( COM_CheckString( path ))
+		Q_strncpy( fs_index.path, path, sizeof( fs_index.path ));
+}
+
+/*
+============
+FS_ShutdownIndex
+
+============
+*/
+void FS_ShutdownIndex( void )
+{
+	FS_SaveIndex();
+	FS_FreeIndex();
+	fs_index.path[0] = '\0';
+}
+
+/*
+============
+FS_PrintIndexInfo
+
+============
+*/
+void FS_PrintIndexInfo( void )
+{
+	if( !fs_index.path[0] )
+		return;
+
+	Con_Printf( "Archive index: %s, %i records, %u hits, %u misses\n",
+		fs_index.path, fs_index.numrecords, fs_index.hits, fs_index.misses );
+}
@@ -88,38 +88,24 @@ static int FS_SortPak( const void *_a, const void *_b )
 
 /*
 =================
-FS_LoadPackPAK
-
-Takes an explicit (not game tree related) path to a pak file.
+FS_ReadPackDirectory
 
-Loads the header and directory, adding the files at the beginning
-of the list so they override previous pack files.
+Loads the header and sorted directory of opened pak file
 =================
 */
-static pack_t *FS_LoadPackPAK( const char *packfile, int *error )
+static pack_t *FS_ReadPackDirectory( const char *packfile, int packhandle, int *error )
 {
 	dpackheader_t header;
-	int         packhandle;
 	int         numpackfiles;
 	pack_t      *pack;
 	fs_size_t     c;
 
-	packhandle = open( packfile, O_RDONLY|O_BINARY );
-
-	if( packhandle < 0 )
-	{
-		Con_Reportf( "%s couldn't open: %s\n", packfile, strerror( errno ));
-		if( error ) *error = PAK_LOAD_COULDNT_OPEN;
-		return NULL;
-	}
-
 	c = read( packhandle, (void *)&header, sizeof( header ));
 
 	if( c != sizeof( header ) || header.ident != IDPACKV1HEADER )
 	{
 		Con_Reportf( "%s is not a packfile. Ignored.\n", packfile );
 		if( error ) *error = PAK_LOAD_BAD_HEADER;
-		close( packhandle );
 		return NULL;
 	}
 
@@ -127,7 +113,6 @@ static pack_t *FS_LoadPackPAK( const char *packfile, int *error )
 	{
 		Con_Reportf( S_ERROR "%s has an invalid directory size. Ignored.\n", packfile );
 		if( error ) *error = PAK_LOAD_BAD_FOLDERS;
-		close( packhandle );
 		return NULL;
 	}
 
@@ -137,7 +122,6 @@ static pack_t *FS_LoadPackPAK( const char *packfile, int *error )
 	{
 		Con_Reportf( S_ERROR "%s has too many files ( %i ). Ignored.\n", packfile, numpackfiles );
 		if( error ) *error = PAK_LOAD_TOO_MANY_FILES;
-		close( packhandle );
 		return NULL;
 	}
 
@@ -145,7 +129,6 @@ static pack_t *FS_LoadPackPAK( const char *packfile, int *error )
 	{
 		Con_Reportf( "%s has no files. Ignored.\n", packfile );
 		if( error ) *error = PAK_LOAD_NO_FILES;
-		close( packhandle );
 		return NULL;
 	}
 
@@ -157,18 +140,70 @@ static pack_t *FS_LoadPackPAK( const char *packfile, int *error )
 		Con_Reportf( "%s is an incomplete PAK, not loading\n", packfile );
 		if( error )
 			*error = PAK_LOAD_CORRUPTED;
-		close( packhandle );
 		Mem_Free( pack );
 		return NULL;
 	}
 
 	// TODO: validate directory?
 
-	pack->filetime = FS_SysFileTime( packfile );
-	pack->handle = packhandle;
 	pack->numfiles = numpackfiles;
 	qsort( pack->files, pack->numfiles, sizeof( pack->files[0] ), FS_SortPak );
 
+	return pack;
+}
+
+/*
+=================
+FS_LoadPackPAK
+
+Takes an explicit (not game tree related) path to a pak file.
+
+Loads the header and directory, adding the files at the beginning
+of the list so they override previous pack files.
+=================
+*/
+static pack_t *FS_LoadPackPAK( const char *packfile, int *error )
+{
+	int         packhandle;
+	pack_t      *pack;
+	const byte  *index;
+	size_t      indexsize;
+
+	packhandle = open( packfile, O_RDONLY|O_BINARY );
+
+	if( packhandle < 0 )
+	{
+		Con_Reportf( "%s couldn't open: %s\n", packfile, strerror( errno ));
+		if( error ) *error = PAK_LOAD_COULDNT_OPEN;
+		return NULL;
+	}
+
+	// unchanged pak, take sorted directory from the index
+	if(( index = FS_FindIndex( packfile, SEARCHPATH_PAK, &indexsize )) != NULL
+		&& indexsize > 0 && !( indexsize % sizeof( dpackfile_t )))
+	{
+		int numpackfiles = indexsize / sizeof( dpackfile_t );
+
+		pack = (pack_t *)Mem_Calloc( fs_mempool, sizeof( pack_t ) + sizeof( dpackfile_t ) * ( numpackfiles - 1 ));
+		memcpy( pack->files, index, indexsize );
+		pack->numfiles = numpackfiles;
+	}
+	else
+	{
+		pack = FS_ReadPackDirectory( packfile, packhandle, error );
+
+		if( !pack )
+		{
+			close( packhandle );
+			return NULL;
+		}
+
+		FS_StoreIndex( packfile, SEARCHPATH_PAK, pack->files, sizeof( dpackfile_t ) * pack->numfiles );
+	}
+
+	pack->filetime = FS_SysFileTime( packfile );
+	pack->handle = packhandle;
+
 #ifdef XASH_REDUCE_FD
 	// will reopen when needed
 	close( pack->handle );
@@ -197,6 +232,23 @@ static file_t *FS_OpenFile_PAK( searchpath_t *search, const char *filename, cons
 	return FS_OpenHandle( search->filename, search->pack->handle, pfile->filepos, pfile->filelen );
 }
 
+/*
+===========
+FS_FileRange_PAK
+
+===========
+*/
+static qboolean FS_FileRange_PAK( searchpath_t *search, int pack_ind, int *handle, fs_offset_t *offset, fs_offset_t *size )
+{
+	dpackfile_t	*pfile = &search->pack->files[pack_ind];
+
+	*handle = search->pack->handle;
+	*offset = pfile->filepos;
+	*size = pfile->filelen;
+
+	return true;
+}
+
 /*
 ===========
 FS_FindFile_PAK
@@ -357,6 +409,7 @@ searchpath_t *FS_AddPak_Fullpath( const char *pakfile, int flags )
 	search->pfnFileTime = FS_FileTime_PAK;
 	search->pfnFindFile = FS_FindFile_PAK;
 	search->pfnSearch = FS_Search_PAK;
+	search->pfnFileRange = FS_FileRange_PAK;
 
 	Con_Reportf( "Adding pakfile: %s (%i files)\n", pakfile, pak->numfiles );
 
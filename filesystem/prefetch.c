@@ -0,0 +1,541 @@
+/*
+prefetch.c - background file reading for precache lists
+Copyright (C) 2023 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "build.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#if XASH_POSIX
+#include <unistd.h>
+#endif
+#include "port.h"
+#include "filesystem_internal.h"
+#include "crtlib.h"
+#include "crclib.h"
+#include "xash3d_mathlib.h"
+#include "common/com_strings.h"
+#if XASH_FS_PREFETCH
+#include <pthread.h>
+#endif
+
+/*
+=============================================================================
+
+Files queued with FS_Prefetch are read, and decompressed if needed, by
+worker threads into a staging area. FS_LoadFile and FS_MapFile take the
+staged buffer instead of touching the disk, so loaders stay synchronous.
+
+Lookups and allocation of the destination buffer happen on the main
+thread when the file is queued, workers only use pread on descriptors of
+already opened archives and plain malloc for inflate input, because
+searchpaths and memory pools aren't thread safe. Loose files are opened
+and closed by the worker around its read, so a long precache list
+doesn't keep a descriptor per queued file.
+
+=============================================================================
+*/
+
+#define PREFETCH_HASH_SIZE	1024
+#define PREFETCH_MAX_THREADS	4
+#define PREFETCH_MAX_STAGED	(128 * 1024 * 1024)	// queued data budget, both compressed and decompressed
+
+enum
+{
+	PREFETCH_QUEUED = 0,
+	PREFETCH_RUNNING,
+	PREFETCH_DONE,
+};
+
+typedef struct prefetch_s
+{
+	struct prefetch_s *next;	// hash chain
+	struct prefetch_s *nextqueued;	// worker queue
+	int		state;
+	int		handle;	// archive descriptor, owned by searchpath
+	const char	*syspath;	// loose file opened by worker, or NULL
+	qboolean	deflated;
+	qboolean	gamedironly;
+	fs_offset_t	offset;
+	fs_offset_t	disksize;
+	fs_offset_t	size;
+	byte		*data;		// from filesystem pool, filled by worker
+	qboolean	ok;		// data is valid
+	char		name[1];	// lowercased, variable sized
+} prefetch_t;
+
+#if XASH_FS_PREFETCH
+static struct
+{
+	pthread_mutex_t	lock;
+	pthread_cond_t	queued;	// wakes up workers
+	pthread_cond_t	done;	// wakes up main thread
+	pthread_t	threads[PREFETCH_MAX_THREADS];
+	int		numthreads;
+	qboolean	shutdown;
+
+	// hash is touched only by main thread, queue and job states are under the lock
+	prefetch_t	*hash[PREFETCH_HASH_SIZE];
+	prefetch_t	*queue, **queuetail;
+	int		numjobs;
+	int		numrunning;
+	fs_offset_t	staged;
+
+	uint		hits;
+	uint		waits;
+	uint		wasted;
+} fs_prefetch;
+
+/*
+============
+FS_PrefetchRead
+
+runs on worker threads, or on main thread if nobody has started the job yet
+============
+*/
+static qboolean FS_PrefetchRead( const prefetch_t *job )
+{
+	fs_offset_t done = 0;
+	qboolean ok = true;
+	int handle = job->handle;
+	byte *raw;
+
+	if( job->syspath && ( handle = open( job->syspath, O_RDONLY|O_BINARY )) < 0 )
+		return false;
+
+	// plain data goes right where the caller will take it
+	if( !job->deflated )
+		raw = job->data;
+	else if( !( raw = malloc( job->disksize )))
+		return false;
+
+	while( done < job->disksize )
+	{
+		ssize_t nb = pread( handle, raw + done, job->disksize - done, job->offset + done );
+
+		if( nb <= 0 )
+		{
+			ok = false;
+			break;
+		}
+
+		done += nb;
+	}
+
+	if( job->syspath )
+		close( handle );
+
+	if( job->deflated )
+	{
+		if( ok )
+			ok = FS_InflateBuffer_ZIP( raw, job->disksize, job->data, job->size );
+		free( raw );
+	}
+
+	if( ok )
+		job->data[job->size] = '\0';
+
+	return ok;
+}
+
+/*
+============
+FS_PrefetchThread
+
+============
+*/
+static void *FS_PrefetchThread( void *arg )
+{
+	pthread_mutex_lock( &fs_prefetch.lock );
+
+	while( true )
+	{
+		prefetch_t *job;
+		qboolean ok;
+
+		while( !fs_prefetch.shutdown && !fs_prefetch.queue )
+			pthread_cond_wait( &fs_prefetch.queued, &fs_prefetch.lock );
+
+		if( fs_prefetch.shutdown )
+			break;
+
+		job = fs_prefetch.queue;
+		fs_prefetch.queue = job->nextqueued;
+		if( !fs_prefetch.queue )
+			fs_prefetch.queuetail = &fs_prefetch.queue;
+
+		job->state = PREFETCH_RUNNING;
+		fs_prefetch.numrunning++;
+		pthread_mutex_unlock( &fs_prefetch.lock );
+
+		ok = FS_PrefetchRead( job );
+
+		pthread_mutex_lock( &fs_prefetch.lock );
+		job->ok = ok;
+		job->state = PREFETCH_DONE;
+		fs_prefetch.numrunning--;
+		pthread_cond_broadcast( &fs_prefetch.done );
+	}
+
+	pthread_mutex_unlock( &fs_prefetch.lock );
+	return NULL;
+}
+
+/*
+============
+FS_StartPrefetchThreads
+
+============
+*/
+static qboolean FS_StartPrefetchThreads( void )
+{
+	int i, numthreads;
+
+	if( fs_prefetch.numthreads )
+		return fs_prefetch.numthreads > 0;
+
+	// leave one core to the main thread, which parses what we read
+	numthreads = bound( 1, (int)sysconf( _SC_NPROCESSORS_ONLN ) - 1, PREFETCH_MAX_THREADS );
+
+	pthread_mutex_init( &fs_prefetch.lock, NULL );
+	pthread_cond_init( &fs_prefetch.queued, NULL );
+	pthread_cond_init( &fs_prefetch.done, NULL );
+	fs_prefetch.queuetail = &fs_prefetch.queue;
+	fs_prefetch.shutdown = false;
+
+	for( i = 0; i < numthreads; i++ )
+	{
+		if( pthread_create( &fs_prefetch.threads[fs_prefetch.numthreads], NULL, FS_PrefetchThread, NULL ))
+			break;
+
+		fs_prefetch.numthreads++;
+	}
+
+	if( !fs_prefetch.numthreads )
+	{
+		Con_Printf( S_WARN "%s: can't create worker threads, prefetch disabled\n", __func__ );
+		pthread_cond_destroy( &fs_prefetch.done );
+		pthread_cond_destroy( &fs_prefetch.queued );
+		pthread_mutex_destroy( &fs_prefetch.lock );
+		fs_prefetch.numthreads = -1; // don't try again
+		return false;
+	}
+
+	Con_Reportf( "%s: %i prefetch threads\n", __func__, fs_prefetch.numthreads );
+	return true;
+}
+
+/*
+============
+FS_FreePrefetch
+
+job must be finished or removed from the queue
+============
+*/
+static void FS_FreePrefetch( prefetch_t *job )
+{
+	prefetch_t **prev = &fs_prefetch.hash[COM_HashKey( job->name, PREFETCH_HASH_SIZE )];
+
+	for( ; *prev; prev = &( *prev )->next )
+	{
+		if( *prev == job )
+		{
+			*prev = job->next;
+			break;
+		}
+	}
+
+	if( job->data )
+		Mem_Free( job->data );
+
+	fs_prefetch.staged -= job->disksize + ( job->deflated ? job->size : 0 );
+	fs_prefetch.numjobs--;
+	Mem_Free( job );
+}
+
+/*
+============
+FS_FindPrefetch
+
+============
+*/
+static prefetch_t *FS_FindPrefetch( const char *lowername, qboolean gamedironly )
+{
+	prefetch_t *job;
+
+	for( job = fs_prefetch.hash[COM_HashKey( lowername, PREFETCH_HASH_SIZE )]; job; job = job->next )
+	{
+		if( job->gamedironly == gamedironly && !Q_strcmp( job->name, lowername ))
+			return job;
+	}
+
+	return NULL;
+}
+#endif // XASH_FS_PREFETCH
+
+/*
+============
+FS_Prefetch
+
+queue file to be read in background, does nothing
+if file is missing or stored in unsupported way
+============
+*/
+void FS_Prefetch( const char *path, qboolean gamedironly )
+{
+#if XASH_FS_PREFETCH
+	char lowername[MAX_SYSPATH], netpath[MAX_SYSPATH];
+	fs_offset_t offset, disksize, size;
+	char syspath[MAX_SYSPATH] = "";
+	qboolean deflated = false;
+	searchpath_t *search;
+	prefetch_t *job;
+	int pack_ind, handle;
+	size_t len;
+	uint hash;
+
+	if( !COM_CheckString( path ))
+		return;
+
+	// same as in FS_LoadFile
+	if( path[0] == '/' || path[0] == '\\' )
+		path++;
+
+	if( path[0] == '/' || path[0] == '\\' )
+		path++;
+
+	Q_strnlwr( path, lowername, sizeof( lowername ));
+
+	if( FS_FindPrefetch( lowername, gamedironly ))
+		return;
+
+	search = FS_FindFile( path, &pack_ind, netpath, sizeof( netpath ), gamedironly );
+	if( !search )
+		return;
+
+	if( search->pfnFileRange && search->pfnFileRange( search, pack_ind, &handle, &offset, &size ))
+	{
+		disksize = size;
+	}
+	else if( search->type == SEARCHPATH_ZIP && FS_DeflatedRange_ZIP( search, pack_ind, &handle, &offset, &disksize, &size ))
+	{
+		deflated = true;
+	}
+	else if( search->type == SEARCHPATH_PLAIN || search->type == SEARCHPATH_PK3DIR )
+	{
+		struct stat buf;
+
+		// same path as FS_OpenFile_DIR, worker will open it
+		Q_snprintf( syspath, sizeof( syspath ), "%s%s", search->filename, netpath );
+
+		if( stat( syspath, &buf ) < 0 )
+			return;
+
+		handle = -1;
+		offset = 0;
+		disksize = size = buf.st_size;
+	}
+	else return;
+
+	if( size <= 0 || ( handle < 0 && !syspath[0] ) || fs_prefetch.staged + disksize + ( deflated ? size : 0 ) > PREFETCH_MAX_STAGED
+		|| !FS_StartPrefetchThreads( ))
+		return;
+
+	len = Q_strlen( lowername ) + 1;
+	job = (prefetch_t *)Mem_Calloc( fs_mempool, sizeof( *job ) + len + ( handle < 0 ? Q_strlen( syspath ) + 1 : 0 ));
+	Q_strncpy( job->name, lowername, len );
+	job->gamedironly = gamedironly;
+	job->handle = handle;
+
+	if( handle < 0 )
+	{
+		// stored right after the name
+		Q_strncpy( job->name + len, syspath, Q_strlen( syspath ) + 1 );
+		job->syspath = job->name + len;
+	}
+
+	job->deflated = deflated;
+	job->offset = offset;
+	job->disksize = disksize;
+	job->size = size;
+	job->data = (byte *)Mem_Malloc( fs_mempool, size + 1 );
+
+	hash = COM_HashKey( lowername, PREFETCH_HASH_SIZE );
+	job->next = fs_prefetch.hash[hash];
+	fs_prefetch.hash[hash] = job;
+	fs_prefetch.staged += disksize + ( deflated ? size : 0 );
+	fs_prefetch.numjobs++;
+
+	pthread_mutex_lock( &fs_prefetch.lock );
+	job->state = PREFETCH_QUEUED;
+	*fs_prefetch.queuetail = job;
+	fs_prefetch.queuetail = &job->nextqueued;
+	pthread_cond_signal( &fs_prefetch.queued );
+	pthread_mutex_unlock( &fs_prefetch.lock );
+#endif // XASH_FS_PREFETCH
+}
+
+/*
+============
+FS_TakePrefetched
+
+returns staged file contents allocated from filesystem pool,
+waits for the worker if file is being read right now
+============
+*/
+byte *FS_TakePrefetched( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly )
+{
+#if XASH_FS_PREFETCH
+	char lowername[MAX_SYSPATH];
+	prefetch_t *job;
+	byte *buf = NULL;
+
+	if( !fs_prefetch.numjobs )
+		return NULL;
+
+	Q_strnlwr( path, lowername, sizeof( lowername ));
+
+	if( !( job = FS_FindPrefetch( lowername, gamedironly )))
+		return NULL;
+
+	pthread_mutex_lock( &fs_prefetch.lock );
+
+	if( job->state == PREFETCH_QUEUED )
+	{
+		prefetch_t **prev;
+
+		// nobody has started it yet, don't wait for the queue
+		for( prev = &fs_prefetch.queue; *prev != job; prev = &( *prev )->nextqueued );
+
+		*prev = job->nextqueued;
+		if( fs_prefetch.queuetail == &job->nextqueued )
+			fs_prefetch.queuetail = prev;
+
+		pthread_mutex_unlock( &fs_prefetch.lock );
+
+		job->ok = FS_PrefetchRead( job );
+	}
+	else
+	{
+		if( job->state == PREFETCH_RUNNING )
+			fs_prefetch.waits++;
+
+		while( job->state != PREFETCH_DONE )
+			pthread_cond_wait( &fs_prefetch.done, &fs_prefetch.lock );
+
+		pthread_mutex_unlock( &fs_prefetch.lock );
+	}
+
+	if( job->ok )
+	{
+		buf = job->data;
+		job->data = NULL; // caller owns it now
+
+		if( filesizeptr )
+			*filesizeptr = job->size;
+
+		fs_prefetch.hits++;
+	}
+
+	FS_FreePrefetch( job );
+
+	return buf;
+#else
+	return NULL;
+#endif // XASH_FS_PREFETCH
+}
+
+/*
+============
+FS_CancelPrefetch
+
+drop everything that wasn't taken, must be called when search path changes
+============
+*/
+void FS_CancelPrefetch( void )
+{
+#if XASH_FS_PREFETCH
+	int i;
+
+	if( !fs_prefetch.numjobs )
+		return;
+
+	pthread_mutex_lock( &fs_prefetch.lock );
+
+	fs_prefetch.queue = NULL;
+	fs_prefetch.queuetail = &fs_prefetch.queue;
+
+	while( fs_prefetch.numrunning )
+		pthread_cond_wait( &fs_prefetch.done, &fs_prefetch.lock );
+
+	pthread_mutex_unlock( &fs_prefetch.lock );
+
+	for( i = 0; i < PREFETCH_HASH_SIZE; i++ )
+	{
+		while( fs_prefetch.hash[i] )
+		{
+			fs_prefetch.wasted++;
+			FS_FreePrefetch( fs_prefetch.hash[i] );
+		}
+	}
+#endif // XASH_FS_PREFETCH
+}
+
+/*
+============
+FS_PrintPrefetchInfo
+
+============
+*/
+void FS_PrintPrefetchInfo( void )
+{
+#if XASH_FS_PREFETCH
+	Con_Printf( "Prefetch: %i threads, %i queued, %s staged, %u hits (%u waited), %u wasted\n",
+		fs_prefetch.numthreads, fs_prefetch.numjobs, Q_memprint( fs_prefetch.staged ),
+		fs_prefetch.hits, fs_prefetch.waits, fs_prefetch.wasted );
+#endif // XASH_FS_PREFETCH
+}
+
+/*
+============
+FS_ShutdownPrefetch
+
+============
+*/
+void FS_ShutdownPrefetch( void )
+{
+#if XASH_FS_PREFETCH
+	int i;
+
+	FS_CancelPrefetch();
+
+	if( fs_prefetch.numthreads <= 0 )
+		return;
+
+	pthread_mutex_lock( &fs_prefetch.lock );
+	fs_prefetch.shutdown = true;
+	pthread_cond_broadcast( &fs_prefetch.queued );
+	pthread_mutex_unlock( &fs_prefetch.lock );
+
+	for( i = 0; i < fs_prefetch.numthreads; i++ )
+		pthread_join( fs_prefetch.threads[i], NULL );
+
+	pthread_cond_destroy( &fs_prefetch.done );
+	pthread_cond_destroy( &fs_prefetch.queued );
+	pthread_mutex_destroy( &fs_prefetch.lock );
+
+	memset( &fs_prefetch, 0, sizeof( fs_prefetch ));
+#endif // XASH_FS_PREFETCH
+}
@@ -0,0 +1,207 @@
+#include "port.h"
+#include "build.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesystem.h"
+#if XASH_POSIX
+#include <dlfcn.h>
+#include <sys/stat.h>
+#define LoadLibrary( x ) dlopen( x, RTLD_NOW )
+#define GetProcAddress( x, y ) dlsym( x, y )
+#define FreeLibrary( x ) dlclose( x )
+#define MakeDir( x ) mkdir( x, 0777 )
+#elif XASH_WIN32
+#include <windows.h>
+#include <direct.h>
+#define MakeDir( x ) _mkdir( x )
+#endif
+
+#define TEST_DIR "findcache_test/"
+
+void *g_hModule;
+FSAPI g_pfnGetFSAPI;
+fs_api_t g_fs;
+fs_globals_t *g_nullglobals;
+
+static qboolean LoadFilesystem( void )
+{
+	g_hModule = LoadLibrary( "filesystem_stdio." OS_LIB_EXT );
+	if( !g_hModule )
+		return false;
+
+	g_pfnGetFSAPI = (void*)GetProcAddress( g_hModule, GET_FS_API );
+	if( !g_pfnGetFSAPI )
+		return false;
+
+	if( !g_pfnGetFSAPI( FS_API_VERSION, &g_fs, &g_nullglobals, NULL ))
+		return false;
+
+	return true;
+}
+
+static qboolean WritePak( const char *path, const char *name, const char *data )
+{
+	struct
+	{
+		int ident;
+		int dirofs;
+		int dirlen;
+	} hdr;
+	struct
+	{
+		char name[56];
+		int filepos;
+		int filelen;
+	} entry;
+	int len = strlen( data );
+	FILE *f;
+
+	if( !( f = fopen( path, "wb" )))
+		return false;
+
+	memcpy( &hdr.ident, "PACK", 4 );
+	hdr.dirofs = sizeof( hdr ) + len;
+	hdr.dirlen = sizeof( entry );
+
+	memset( &entry, 0, sizeof( entry ));
+	strncpy( entry.name, name, sizeof( entry.name ) - 1 );
+	entry.filepos = sizeof( hdr );
+	entry.filelen = len;
+
+	fwrite( &hdr, sizeof( hdr ), 1, f );
+	fwrite( data, len, 1, f );
+	fwrite( &entry, sizeof( entry ), 1, f );
+	fclose( f );
+
+	return true;
+}
+
+static qboolean WriteRawFile( const char *path, const char *data )
+{
+	FILE *f;
+
+	if( !( f = fopen( path, "wb" )))
+		return false;
+
+	fwrite( data, strlen( data ), 1, f );
+	fclose( f );
+
+	return true;
+}
+
+static qboolean CheckFileContents( const char *path, const char *expected )
+{
+	fs_offset_t len;
+	byte *data;
+	qboolean ret;
+
+	data = g_fs.LoadFile( path, &len, false );
+	if( !data )
+	{
+		printf( "LoadFile %s fail\n", path );
+		return false;
+	}
+
+	ret = len == strlen( expected ) && !memcmp( data, expected, len );
+	if( !ret )
+		printf( "LoadFile %s contents fail, expected %s\n", path, expected );
+
+	free( data );
+
+	if( !ret )
+		return false;
+
+	// mapped view must match the loaded copy
+	data = g_fs.MapFile( path, &len, false );
+	if( !data )
+	{
+		printf( "MapFile %s fail\n", path );
+		return false;
+	}
+
+	ret = len == strlen( expected ) && !memcmp( data, expected, len );
+	if( !ret )
+		printf( "MapFile %s contents fail, expected %s\n", path, expected );
+
+	g_fs.UnmapFile( data );
+	return ret;
+}
+
+static qboolean TestFindCache( void )
+{
+	int i;
+
+	MakeDir( TEST_DIR );
+	if( !WritePak( TEST_DIR "pak0.pak", "sound/a.wav", "pak" ))
+		return false;
+
+	g_fs.AddGameDirectory( TEST_DIR, FS_GAMEDIR_PATH );
+
+	// first lookup fills the cache, next ones must be answered the same
+	for( i = 0; i < 2; i++ )
+	{
+		if( !CheckFileContents( "sound/a.wav", "pak" ))
+			return false;
+
+		if( !CheckFileContents( "SOUND/A.WAV", "pak" ))
+			return false;
+
+		if( g_fs.FileExists( "sound/missing.wav", false ))
+		{
+			printf( "FileExists missing fail\n" );
+			return false;
+		}
+	}
+
+	// directories always have the priority over archives, even if archive is cached
+	MakeDir( TEST_DIR "sound" );
+	if( !WriteRawFile( TEST_DIR "sound/a.wav", "dir" ))
+		return false;
+
+	if( !CheckFileContents( "sound/a.wav", "dir" ))
+		return false;
+
+	remove( TEST_DIR "sound/a.wav" );
+
+	if( !CheckFileContents( "sound/a.wav", "pak" ))
+		return false;
+
+	// cached negative lookup must not hide new files
+	if( !WriteRawFile( TEST_DIR "sound/missing.wav", "dir" ))
+		return false;
+
+	if( !g_fs.FileExists( "sound/missing.wav", false ))
+	{
+		printf( "FileExists new file fail\n" );
+		return false;
+	}
+
+	// remount drops the cache
+	g_fs.ClearSearchPath();
+	if( g_fs.FileExists( "sound/a.wav", false ))
+	{
+		printf( "FileExists after clear fail\n" );
+		return false;
+	}
+
+	remove( TEST_DIR "sound/missing.wav" );
+	remove( TEST_DIR "sound" );
+	remove( TEST_DIR "pak0.pak" );
+	remove( TEST_DIR );
+
+	return true;
+}
+
+int main( void )
+{
+	if( !LoadFilesystem() )
+		return EXIT_FAILURE;
+
+	if( !TestFindCache())
+		return EXIT_FAILURE;
+
+	printf( "success\n" );
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,262 @@
+#include "port.h"
+#include "build.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesystem.h"
+#if XASH_POSIX
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <time.h>
+#define LoadLibrary( x ) dlopen( x, RTLD_NOW )
+#define GetProcAddress( x, y ) dlsym( x, y )
+#define FreeLibrary( x ) dlclose( x )
+#define MakeDir( x ) mkdir( x, 0777 )
+#elif XASH_WIN32
+#include <windows.h>
+#include <direct.h>
+#define MakeDir( x ) _mkdir( x )
+#endif
+
+#define TEST_DIR "indexcache_test/"
+#define TEST_INDEX "indexcache_test.bin"
+#define NUM_ARCHIVES 32
+#define NUM_FILES 1024
+
+void *g_hModule;
+FSAPI g_pfnGetFSAPI;
+fs_api_t g_fs;
+fs_globals_t *g_nullglobals;
+
+static qboolean LoadFilesystem( void )
+{
+	g_hModule = LoadLibrary( "filesystem_stdio." OS_LIB_EXT );
+	if( !g_hModule )
+		return false;
+
+	g_pfnGetFSAPI = (void*)GetProcAddress( g_hModule, GET_FS_API );
+	if( !g_pfnGetFSAPI )
+		return false;
+
+	if( !g_pfnGetFSAPI( FS_API_VERSION, &g_fs, &g_nullglobals, NULL ))
+		return false;
+
+	return true;
+}
+
+static double Sys_Seconds( void )
+{
+#if XASH_POSIX
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static byte *PutShort( byte *p, int v )
+{
+	p[0] = v & 0xff;
+	p[1] = ( v >> 8 ) & 0xff;
+	return p + 2;
+}
+
+static byte *PutLong( byte *p, int v )
+{
+	p = PutShort( p, v & 0xffff );
+	return PutShort( p, ( v >> 16 ) & 0xffff );
+}
+
+// writes a zip with NUM_FILES stored entries, each one contains its own name and tag
+static qboolean WriteZip( const char *path, int archive, const char *tag )
+{
+	byte *buf = malloc( NUM_FILES * 256 + 64 ), *p = buf, *cdf;
+	int offsets[NUM_FILES];
+	char name[64], data[64];
+	int i, len, namelen;
+	FILE *f;
+
+	for( i = 0; i < NUM_FILES; i++ )
+	{
+		namelen = snprintf( name, sizeof( name ), "data/%02d/%04d.txt", archive, i );
+		len = snprintf( data, sizeof( data ), "%s %s", name, tag );
+
+		offsets[i] = p - buf;
+		p = PutLong( p, 0x04034b50 );
+		p = PutShort( p, 10 );
+		p = PutShort( p, 0 );
+		p = PutShort( p, 0 ); // stored
+		p = PutLong( p, 0 );
+		p = PutLong( p, 0 ); // crc32, not checked
+		p = PutLong( p, len );
+		p = PutLong( p, len );
+		p = PutShort( p, namelen );
+		p = PutShort( p, 0 );
+		memcpy( p, name, namelen );
+		p += namelen;
+		memcpy( p, data, len );
+		p += len;
+	}
+
+	cdf = p;
+	for( i = 0; i < NUM_FILES; i++ )
+	{
+		namelen = snprintf( name, sizeof( name ), "data/%02d/%04d.txt", archive, i );
+		len = snprintf( data, sizeof( data ), "%s %s", name, tag );
+
+		p = PutLong( p, 0x02014b50 );
+		p = PutShort( p, 10 );
+		p = PutShort( p, 10 );
+		p = PutShort( p, 0 );
+		p = PutShort( p, 0 );
+		p = PutLong( p, 0 );
+		p = PutLong( p, 0 );
+		p = PutLong( p, len );
+		p = PutLong( p, len );
+		p = PutShort( p, namelen );
+		p = PutShort( p, 0 );
+		p = PutShort( p, 0 );
+		p = PutShort( p, 0 );
+		p = PutShort( p, 0 );
+		p = PutLong( p, 0 );
+		p = PutLong( p, offsets[i] );
+		memcpy( p, name, namelen );
+		p += namelen;
+	}
+
+	len = p - cdf;
+	p = PutLong( p, 0x06054b50 );
+	p = PutShort( p, 0 );
+	p = PutShort( p, 0 );
+	p = PutShort( p, NUM_FILES );
+	p = PutShort( p, NUM_FILES );
+	p = PutLong( p, len );
+	p = PutLong( p, cdf - buf );
+	p = PutShort( p, 0 );
+
+	if( !( f = fopen( path, "wb" )))
+	{
+		free( buf );
+		return false;
+	}
+
+	fwrite( buf, p - buf, 1, f );
+	fclose( f );
+	free( buf );
+
+	return true;
+}
+
+static qboolean CheckFile( int archive, int file, const char *tag )
+{
+	char name[64], expected[64];
+	fs_offset_t len;
+	qboolean ret;
+	byte *data;
+
+	snprintf( name, sizeof( name ), "data/%02d/%04d.txt", archive, file );
+	snprintf( expected, sizeof( expected ), "%s %s", name, tag );
+
+	data = g_fs.LoadFile( name, &len, false );
+	if( !data )
+	{
+		printf( "LoadFile %s fail\n", name );
+		return false;
+	}
+
+	ret = len == strlen( expected ) && !memcmp( data, expected, len );
+	if( !ret )
+		printf( "LoadFile %s contents fail, expected %s\n", name, expected );
+
+	free( data );
+	return ret;
+}
+
+static double MountArchives( const char *index )
+{
+	double start;
+
+	g_fs.SetIndexCache( index );
+
+	start = Sys_Seconds();
+	g_fs.AddGameDirectory( TEST_DIR, FS_GAMEDIR_PATH );
+
+	return Sys_Seconds() - start;
+}
+
+static qboolean TestIndexCache( void )
+{
+	double nocache, cold, warm;
+	char path[64];
+	int i;
+
+	MakeDir( TEST_DIR );
+	remove( TEST_INDEX );
+
+	for( i = 0; i < NUM_ARCHIVES; i++ )
+	{
+		snprintf( path, sizeof( path ), TEST_DIR "pak%02d.pk3", i );
+		if( !WriteZip( path, i, "v1" ))
+			return false;
+	}
+
+	nocache = MountArchives( NULL );
+	g_fs.ClearSearchPath();
+
+	// first mount builds the index, second one uses it
+	cold = MountArchives( TEST_INDEX );
+	g_fs.ClearSearchPath();
+	g_fs.SetIndexCache( NULL );
+
+	warm = MountArchives( TEST_INDEX );
+
+	printf( "mounting %d archives with %d files: %.2f ms without index, %.2f ms building index, %.2f ms with index\n",
+		NUM_ARCHIVES, NUM_FILES, nocache * 1000.0, cold * 1000.0, warm * 1000.0 );
+
+	for( i = 0; i < NUM_ARCHIVES; i++ )
+	{
+		if( !CheckFile( i, 0, "v1" ) || !CheckFile( i, NUM_FILES / 2, "v1" ) || !CheckFile( i, NUM_FILES - 1, "v1" ))
+			return false;
+	}
+
+	g_fs.ClearSearchPath();
+	g_fs.SetIndexCache( NULL );
+
+	// changed archive must be parsed again, size differs
+	if( !WriteZip( TEST_DIR "pak05.pk3", 5, "version2" ))
+		return false;
+
+	MountArchives( TEST_INDEX );
+
+	if( !CheckFile( 5, 7, "version2" ) || !CheckFile( 6, 7, "v1" ))
+		return false;
+
+	g_fs.ClearSearchPath();
+	g_fs.SetIndexCache( NULL );
+
+	for( i = 0; i < NUM_ARCHIVES; i++ )
+	{
+		snprintf( path, sizeof( path ), TEST_DIR "pak%02d.pk3", i );
+		remove( path );
+	}
+
+	remove( TEST_DIR );
+	remove( TEST_INDEX );
+
+	return true;
+}
+
+int main( void )
+{
+	if( !LoadFilesystem() )
+		return EXIT_FAILURE;
+
+	if( !TestIndexCache())
+		return EXIT_FAILURE;
+
+	printf( "success\n" );
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,291 @@
+#include "port.h"
+#include "build.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesystem.h"
+#if XASH_POSIX
+#include <dlfcn.h>
+#include <sys/stat.h>
+#define LoadLibrary( x ) dlopen( x, RTLD_NOW )
+#define GetProcAddress( x, y ) dlsym( x, y )
+#define FreeLibrary( x ) dlclose( x )
+#define MakeDir( x ) mkdir( x, 0777 )
+#elif XASH_WIN32
+#include <windows.h>
+#include <direct.h>
+#define MakeDir( x ) _mkdir( x )
+#endif
+
+#define TEST_DIR "prefetch_test/"
+#define TEST_SIZE 100000
+
+void *g_hModule;
+FSAPI g_pfnGetFSAPI;
+fs_api_t g_fs;
+fs_globals_t *g_nullglobals;
+
+static qboolean LoadFilesystem( void )
+{
+	g_hModule = LoadLibrary( "filesystem_stdio." OS_LIB_EXT );
+	if( !g_hModule )
+		return false;
+
+	g_pfnGetFSAPI = (void*)GetProcAddress( g_hModule, GET_FS_API );
+	if( !g_pfnGetFSAPI )
+		return false;
+
+	if( !g_pfnGetFSAPI( FS_API_VERSION, &g_fs, &g_nullglobals, NULL ))
+		return false;
+
+	return true;
+}
+
+static byte *PutShort( byte *p, int v )
+{
+	p[0] = v & 0xff;
+	p[1] = ( v >> 8 ) & 0xff;
+	return p + 2;
+}
+
+static byte *PutLong( byte *p, int v )
+{
+	p = PutShort( p, v & 0xffff );
+	return PutShort( p, ( v >> 16 ) & 0xffff );
+}
+
+// writes a zip with a single deflated entry, made of stored deflate blocks
+static qboolean WriteZip( const char *path, const char *name, const byte *data, int len )
+{
+	byte *buf = malloc( len + len / 4096 * 5 + 512 ), *p = buf, *cdf;
+	int namelen = strlen( name ), complen, ofs;
+	FILE *f;
+
+	p = PutLong( p, 0x04034b50 );
+	p = PutShort( p, 20 ); // version
+	p = PutShort( p, 0 ); // flags
+	p = PutShort( p, 8 ); // deflated
+	p = PutLong( p, 0 ); // date
+	p = PutLong( p, 0 ); // crc32, not checked
+	p = PutLong( p, 0 ); // compressed size, patched below
+	p = PutLong( p, len );
+	p = PutShort( p, namelen );
+	p = PutShort( p, 0 );
+	memcpy( p, name, namelen );
+	p += namelen;
+
+	for( ofs = 0, complen = 0; ofs < len; ofs += 4096 )
+	{
+		int blocklen = len - ofs > 4096 ? 4096 : len - ofs;
+
+		*p++ = ofs + blocklen >= len; // BFINAL, BTYPE 00
+		p = PutShort( p, blocklen );
+		p = PutShort( p, ~blocklen );
+		memcpy( p, data + ofs, blocklen );
+		p += blocklen;
+		complen += blocklen + 5;
+	}
+	PutLong( buf + 18, complen );
+
+	cdf = p;
+	p = PutLong( p, 0x02014b50 );
+	p = PutShort( p, 20 );
+	p = PutShort( p, 20 );
+	p = PutShort( p, 0 );
+	p = PutShort( p, 8 );
+	p = PutLong( p, 0 ); // time and date
+	p = PutLong( p, 0 );
+	p = PutLong( p, complen );
+	p = PutLong( p, len );
+	p = PutShort( p, namelen );
+	p = PutShort( p, 0 );
+	p = PutShort( p, 0 );
+	p = PutShort( p, 0 );
+	p = PutShort( p, 0 );
+	p = PutLong( p, 0 );
+	p = PutLong( p, 0 ); // local header offset
+	memcpy( p, name, namelen );
+	p += namelen;
+
+	ofs = p - cdf;
+	p = PutLong( p, 0x06054b50 );
+	p = PutShort( p, 0 );
+	p = PutShort( p, 0 );
+	p = PutShort( p, 1 );
+	p = PutShort( p, 1 );
+	p = PutLong( p, ofs );
+	p = PutLong( p, cdf - buf );
+	p = PutShort( p, 0 );
+
+	if( !( f = fopen( path, "wb" )))
+	{
+		free( buf );
+		return false;
+	}
+
+	fwrite( buf, p - buf, 1, f );
+	fclose( f );
+	free( buf );
+
+	return true;
+}
+
+static qboolean WritePak( const char *path, const char *name, const char *data )
+{
+	struct
+	{
+		int ident;
+		int dirofs;
+		int dirlen;
+	} hdr;
+	struct
+	{
+		char name[56];
+		int filepos;
+		int filelen;
+	} entry;
+	int len = strlen( data );
+	FILE *f;
+
+	if( !( f = fopen( path, "wb" )))
+		return false;
+
+	memcpy( &hdr.ident, "PACK", 4 );
+	hdr.dirofs = sizeof( hdr ) + len;
+	hdr.dirlen = sizeof( entry );
+
+	memset( &entry, 0, sizeof( entry ));
+	strncpy( entry.name, name, sizeof( entry.name ) - 1 );
+	entry.filepos = sizeof( hdr );
+	entry.filelen = len;
+
+	fwrite( &hdr, sizeof( hdr ), 1, f );
+	fwrite( data, len, 1, f );
+	fwrite( &entry, sizeof( entry ), 1, f );
+	fclose( f );
+
+	return true;
+}
+
+static qboolean WriteRawFile( const char *path, const char *data )
+{
+	FILE *f;
+
+	if( !( f = fopen( path, "wb" )))
+		return false;
+
+	fwrite( data, strlen( data ), 1, f );
+	fclose( f );
+
+	return true;
+}
+
+static qboolean CheckContents( const char *path, const byte *expected, int len, qboolean map )
+{
+	fs_offset_t size;
+	byte *data;
+	qboolean ret;
+
+	data = map ? g_fs.MapFile( path, &size, false ) : g_fs.LoadFile( path, &size, false );
+	if( !data )
+	{
+		printf( "%s %s fail\n", map ? "MapFile" : "LoadFile", path );
+		return false;
+	}
+
+	ret = size == len && !memcmp( data, expected, len );
+	if( !ret )
+		printf( "%s %s contents fail\n", map ? "MapFile" : "LoadFile", path );
+
+	if( map )
+		g_fs.UnmapFile( data );
+	else free( data );
+
+	return ret;
+}
+
+static qboolean TestPrefetch( void )
+{
+	static byte data[TEST_SIZE];
+	int i;
+
+	for( i = 0; i < TEST_SIZE; i++ )
+		data[i] = ( i * 13 + ( i >> 9 )) & 0xff;
+
+	MakeDir( TEST_DIR );
+	MakeDir( TEST_DIR "gfx" );
+	if( !WritePak( TEST_DIR "pak0.pak", "models/a.mdl", "stored" ))
+		return false;
+
+	if( !WriteZip( TEST_DIR "pak0.pk3", "sound/b.wav", data, TEST_SIZE ))
+		return false;
+
+	if( !WriteRawFile( TEST_DIR "gfx/c.txt", "plain" ))
+		return false;
+
+	g_fs.AddGameDirectory( TEST_DIR, FS_GAMEDIR_PATH );
+
+	// every kind of storage, in different case and twice
+	for( i = 0; i < 2; i++ )
+	{
+		g_fs.Prefetch( "models/a.mdl", false );
+		g_fs.Prefetch( "SOUND/B.WAV", false );
+		g_fs.Prefetch( "/gfx/c.txt", false );
+		g_fs.Prefetch( "gfx/missing.txt", false );
+
+		if( !CheckContents( "models/a.mdl", (const byte *)"stored", 6, i ))
+			return false;
+
+		if( !CheckContents( "sound/b.wav", data, TEST_SIZE, i ))
+			return false;
+
+		if( !CheckContents( "gfx/c.txt", (const byte *)"plain", 5, !i ))
+			return false;
+
+		if( g_fs.LoadFile( "gfx/missing.txt", NULL, false ))
+		{
+			printf( "LoadFile missing fail\n" );
+			return false;
+		}
+	}
+
+	// staged data must not outlive the file on disk
+	g_fs.Prefetch( "gfx/c.txt", false );
+	g_fs.CancelPrefetch();
+	if( !WriteRawFile( TEST_DIR "gfx/c.txt", "changed" ))
+		return false;
+
+	if( !CheckContents( "gfx/c.txt", (const byte *)"changed", 7, false ))
+		return false;
+
+	// remount drops whatever was queued
+	g_fs.Prefetch( "sound/b.wav", false );
+	g_fs.ClearSearchPath();
+
+	if( g_fs.LoadFile( "sound/b.wav", NULL, false ))
+	{
+		printf( "LoadFile after clear fail\n" );
+		return false;
+	}
+
+	remove( TEST_DIR "gfx/c.txt" );
+	remove( TEST_DIR "gfx" );
+	remove( TEST_DIR "pak0.pak" );
+	remove( TEST_DIR "pak0.pk3" );
+	remove( TEST_DIR );
+
+	return true;
+}
+
+int main( void )
+{
+	if( !LoadFilesystem() )
+		return EXIT_FAILURE;
+
+	if( !TestPrefetch())
+		return EXIT_FAILURE;
+
+	printf( "success\n" );
+
+	return EXIT_SUCCESS;
+}
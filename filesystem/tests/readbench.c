@@ -0,0 +1,299 @@
+#include "port.h"
+#include "build.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesystem.h"
+#if XASH_POSIX
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <time.h>
+#define LoadLibrary( x ) dlopen( x, RTLD_NOW )
+#define GetProcAddress( x, y ) dlsym( x, y )
+#define FreeLibrary( x ) dlclose( x )
+#define MakeDir( x ) mkdir( x, 0777 )
+#elif XASH_WIN32
+#include <windows.h>
+#include <direct.h>
+#define MakeDir( x ) _mkdir( x )
+#endif
+
+#define TEST_DIR "readbench_test/"
+#define FILE_SIZE ( 8 * 1024 * 1024 + 123 ) // not a multiple of any read size
+#define PACK_OFFSET 12 // packed file starts right after the header
+
+void *g_hModule;
+FSAPI g_pfnGetFSAPI;
+fs_api_t g_fs;
+fs_globals_t *g_nullglobals;
+
+static qboolean LoadFilesystem( void )
+{
+	g_hModule = LoadLibrary( "filesystem_stdio." OS_LIB_EXT );
+	if( !g_hModule )
+		return false;
+
+	g_pfnGetFSAPI = (void*)GetProcAddress( g_hModule, GET_FS_API );
+	if( !g_pfnGetFSAPI )
+		return false;
+
+	if( !g_pfnGetFSAPI( FS_API_VERSION, &g_fs, &g_nullglobals, NULL ))
+		return false;
+
+	return true;
+}
+
+static double Sys_Seconds( void )
+{
+#if XASH_POSIX
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static byte Pattern( fs_offset_t i )
+{
+	// lines of varying length, so FS_Gets has something to do
+	if( i % 97 == 96 )
+		return '\n';
+
+	return (( i * 2654435761u >> 13 ) & 0x5f ) | 0x20;
+}
+
+static byte *PutLong( byte *p, int v )
+{
+	p[0] = v & 0xff;
+	p[1] = ( v >> 8 ) & 0xff;
+	p[2] = ( v >> 16 ) & 0xff;
+	p[3] = ( v >> 24 ) & 0xff;
+	return p + 4;
+}
+
+static qboolean WriteFiles( void )
+{
+	byte *data = malloc( FILE_SIZE ), header[12], entry[64], *p;
+	qboolean ret = false;
+	FILE *f;
+	int i;
+
+	for( i = 0; i < FILE_SIZE; i++ )
+		data[i] = Pattern( i );
+
+	if(( f = fopen( TEST_DIR "plain.bin", "wb" )))
+	{
+		ret = fwrite( data, FILE_SIZE, 1, f ) == 1;
+		fclose( f );
+	}
+
+	if( ret && ( f = fopen( TEST_DIR "pak0.pak", "wb" )))
+	{
+		memcpy( header, "PACK", 4 );
+		p = PutLong( header + 4, PACK_OFFSET + FILE_SIZE );
+		PutLong( p, sizeof( entry ));
+
+		memset( entry, 0, sizeof( entry ));
+		strcpy( (char *)entry, "packed.bin" );
+		p = PutLong( entry + 56, PACK_OFFSET );
+		PutLong( p, FILE_SIZE );
+
+		ret = fwrite( header, sizeof( header ), 1, f ) == 1
+			&& fwrite( data, FILE_SIZE, 1, f ) == 1
+			&& fwrite( entry, sizeof( entry ), 1, f ) == 1;
+		fclose( f );
+	}
+
+	free( data );
+	return ret;
+}
+
+static qboolean CheckData( const byte *buf, fs_offset_t pos, fs_offset_t len )
+{
+	fs_offset_t i;
+
+	for( i = 0; i < len; i++ )
+	{
+		if( buf[i] != Pattern( pos + i ))
+		{
+			printf( "data mismatch at %lld\n", (long long)( pos + i ));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void Report( const char *name, const char *test, double time )
+{
+	printf( "%s %-12s %8.1f MB/s\n", name, test, FILE_SIZE / ( 1024.0 * 1024.0 ) / time );
+}
+
+static qboolean BenchGetc( const char *name )
+{
+	file_t *f = g_fs.Open( name, "rb", false );
+	fs_offset_t pos = 0;
+	double start;
+	int c;
+
+	if( !f )
+		return false;
+
+	start = Sys_Seconds();
+	while(( c = g_fs.Getc( f )) != EOF )
+	{
+		if( c != Pattern( pos ))
+		{
+			printf( "Getc mismatch at %lld\n", (long long)pos );
+			g_fs.Close( f );
+			return false;
+		}
+		pos++;
+	}
+	Report( name, "Getc", Sys_Seconds() - start );
+
+	g_fs.Close( f );
+	return pos == FILE_SIZE;
+}
+
+static qboolean BenchGets( const char *name )
+{
+	file_t *f = g_fs.Open( name, "rb", false );
+	fs_offset_t pos = 0;
+	char line[128];
+	double start;
+	int len;
+
+	if( !f )
+		return false;
+
+	start = Sys_Seconds();
+	while( !g_fs.Eof( f ))
+	{
+		// FS_Gets drops the newline
+		g_fs.Gets( f, line, sizeof( line ));
+		len = strlen( line );
+		if( !CheckData( (byte *)line, pos, len ))
+		{
+			g_fs.Close( f );
+			return false;
+		}
+		pos += len + ( pos + len < FILE_SIZE );
+	}
+	Report( name, "Gets", Sys_Seconds() - start );
+
+	g_fs.Close( f );
+	return pos == FILE_SIZE;
+}
+
+static qboolean BenchRead( const char *name, size_t chunk )
+{
+	file_t *f = g_fs.Open( name, "rb", false );
+	byte *buf = malloc( chunk );
+	fs_offset_t pos = 0, len;
+	char test[32];
+	double start;
+
+	if( !f )
+		return false;
+
+	start = Sys_Seconds();
+	while(( len = g_fs.Read( f, buf, chunk )) > 0 )
+	{
+		if( !CheckData( buf, pos, len ))
+			break;
+		pos += len;
+	}
+	snprintf( test, sizeof( test ), "Read %zuK", chunk / 1024 );
+	Report( name, test, Sys_Seconds() - start );
+
+	free( buf );
+	g_fs.Close( f );
+	return pos == FILE_SIZE;
+}
+
+// two handles on the same archive must not disturb each other
+static qboolean TestInterleaved( const char *name )
+{
+	file_t *a = g_fs.Open( name, "rb", false );
+	file_t *b = g_fs.Open( name, "rb", false );
+	fs_offset_t posa = 0, posb = FILE_SIZE / 2;
+	byte bufa[1000], bufb[700]; // a stays behind b
+	qboolean ret = false;
+	fs_offset_t len;
+	int c;
+
+	if( !a || !b )
+		goto cleanup;
+
+	if( g_fs.Seek( b, posb, SEEK_SET ) != 0 )
+		goto cleanup;
+
+	while( posb < FILE_SIZE )
+	{
+		if(( len = g_fs.Read( a, bufa, sizeof( bufa ))) <= 0 || !CheckData( bufa, posa, len ))
+			goto cleanup;
+		posa += len;
+
+		if(( len = g_fs.Read( b, bufb, sizeof( bufb ))) <= 0 || !CheckData( bufb, posb, len ))
+			goto cleanup;
+		posb += len;
+
+		// mix in buffered character reads and ungetc
+		c = g_fs.Getc( a );
+		g_fs.UnGetc( a, c );
+		if( c != Pattern( posa ))
+			goto cleanup;
+	}
+
+	// seek back into the already buffered area
+	if( g_fs.Seek( b, -16, SEEK_CUR ) != 0 || g_fs.Read( b, bufb, 16 ) != 16 || !CheckData( bufb, FILE_SIZE - 16, 16 ))
+		goto cleanup;
+
+	ret = true;
+
+cleanup:
+	if( !ret )
+		printf( "interleaved reads of %s fail\n", name );
+	if( a ) g_fs.Close( a );
+	if( b ) g_fs.Close( b );
+	return ret;
+}
+
+static qboolean TestFile( const char *name )
+{
+	return BenchGetc( name ) && BenchGets( name ) && BenchRead( name, 4096 )
+		&& BenchRead( name, 65536 ) && TestInterleaved( name );
+}
+
+int main( void )
+{
+	qboolean ret;
+
+	if( !LoadFilesystem() )
+		return EXIT_FAILURE;
+
+	MakeDir( TEST_DIR );
+
+	if( !WriteFiles( ))
+		return EXIT_FAILURE;
+
+	g_fs.AddGameDirectory( TEST_DIR, FS_GAMEDIR_PATH );
+
+	ret = TestFile( "plain.bin" ) && TestFile( "packed.bin" );
+
+	g_fs.ClearSearchPath();
+
+	remove( TEST_DIR "plain.bin" );
+	remove( TEST_DIR "pak0.pak" );
+	remove( TEST_DIR );
+
+	if( !ret )
+		return EXIT_FAILURE;
+
+	printf( "success\n" );
+
+	return EXIT_SUCCESS;
+}
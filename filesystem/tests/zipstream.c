@@ -0,0 +1,245 @@
+#include "port.h"
+#include "build.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesystem.h"
+#if XASH_POSIX
+#include <dlfcn.h>
+#include <sys/stat.h>
+#define LoadLibrary( x ) dlopen( x, RTLD_NOW )
+#define GetProcAddress( x, y ) dlsym( x, y )
+#define FreeLibrary( x ) dlclose( x )
+#define MakeDir( x ) mkdir( x, 0777 )
+#elif XASH_WIN32
+#include <windows.h>
+#include <direct.h>
+#define MakeDir( x ) _mkdir( x )
+#endif
+
+#define TEST_DIR "zipstream_test/"
+#define TEST_SIZE 100000
+
+void *g_hModule;
+FSAPI g_pfnGetFSAPI;
+fs_api_t g_fs;
+fs_globals_t *g_nullglobals;
+
+static qboolean LoadFilesystem( void )
+{
+	g_hModule = LoadLibrary( "filesystem_stdio." OS_LIB_EXT );
+	if( !g_hModule )
+		return false;
+
+	g_pfnGetFSAPI = (void*)GetProcAddress( g_hModule, GET_FS_API );
+	if( !g_pfnGetFSAPI )
+		return false;
+
+	if( !g_pfnGetFSAPI( FS_API_VERSION, &g_fs, &g_nullglobals, NULL ))
+		return false;
+
+	return true;
+}
+
+static byte *PutShort( byte *p, int v )
+{
+	p[0] = v & 0xff;
+	p[1] = ( v >> 8 ) & 0xff;
+	return p + 2;
+}
+
+static byte *PutLong( byte *p, int v )
+{
+	p = PutShort( p, v & 0xffff );
+	return PutShort( p, ( v >> 16 ) & 0xffff );
+}
+
+// writes a zip with a single deflated entry, made of stored deflate blocks
+static qboolean WriteZip( const char *path, const char *name, const byte *data, int len )
+{
+	byte *buf = malloc( len + len / 4096 * 5 + 512 ), *p = buf, *cdf;
+	int namelen = strlen( name ), complen, ofs;
+	FILE *f;
+
+	p = PutLong( p, 0x04034b50 );
+	p = PutShort( p, 20 ); // version
+	p = PutShort( p, 0 ); // flags
+	p = PutShort( p, 8 ); // deflated
+	p = PutLong( p, 0 ); // date
+	p = PutLong( p, 0 ); // crc32, not checked
+	p = PutLong( p, 0 ); // compressed size, patched below
+	p = PutLong( p, len );
+	p = PutShort( p, namelen );
+	p = PutShort( p, 0 );
+	memcpy( p, name, namelen );
+	p += namelen;
+
+	for( ofs = 0, complen = 0; ofs < len; ofs += 4096 )
+	{
+		int blocklen = len - ofs > 4096 ? 4096 : len - ofs;
+
+		*p++ = ofs + blocklen >= len; // BFINAL, BTYPE 00
+		p = PutShort( p, blocklen );
+		p = PutShort( p, ~blocklen );
+		memcpy( p, data + ofs, blocklen );
+		p += blocklen;
+		complen += blocklen + 5;
+	}
+	PutLong( buf + 18, complen );
+
+	cdf = p;
+	p = PutLong( p, 0x02014b50 );
+	p = PutShort( p, 20 );
+	p = PutShort( p, 20 );
+	p = PutShort( p, 0 );
+	p = PutShort( p, 8 );
+	p = PutLong( p, 0 ); // time and date
+	p = PutLong( p, 0 );
+	p = PutLong( p, complen );
+	p = PutLong( p, len );
+	p = PutShort( p, namelen );
+	p = PutShort( p, 0 );
+	p = PutShort( p, 0 );
+	p = PutShort( p, 0 );
+	p = PutShort( p, 0 );
+	p = PutLong( p, 0 );
+	p = PutLong( p, 0 ); // local header offset
+	memcpy( p, name, namelen );
+	p += namelen;
+
+	ofs = p - cdf;
+	p = PutLong( p, 0x06054b50 );
+	p = PutShort( p, 0 );
+	p = PutShort( p, 0 );
+	p = PutShort( p, 1 );
+	p = PutShort( p, 1 );
+	p = PutLong( p, ofs );
+	p = PutLong( p, cdf - buf );
+	p = PutShort( p, 0 );
+
+	if( !( f = fopen( path, "wb" )))
+	{
+		free( buf );
+		return false;
+	}
+
+	fwrite( buf, p - buf, 1, f );
+	fclose( f );
+	free( buf );
+
+	return true;
+}
+
+static qboolean CheckRead( file_t *f, const byte *expected, int pos, int len )
+{
+	byte buf[TEST_SIZE];
+
+	if( g_fs.Seek( f, pos, SEEK_SET ) != 0 )
+	{
+		printf( "Seek %d fail\n", pos );
+		return false;
+	}
+
+	if( g_fs.Read( f, buf, len ) != len || memcmp( buf, expected + pos, len ))
+	{
+		printf( "Read %d at %d fail\n", len, pos );
+		return false;
+	}
+
+	return true;
+}
+
+static qboolean TestZipStream( void )
+{
+	static byte data[TEST_SIZE];
+	fs_offset_t len;
+	byte *buf;
+	file_t *f;
+	int i;
+
+	for( i = 0; i < TEST_SIZE; i++ )
+		data[i] = ( i * 7 + ( i >> 8 )) & 0xff;
+
+	MakeDir( TEST_DIR );
+	if( !WriteZip( TEST_DIR "pak0.pk3", "maps/data.bin", data, TEST_SIZE ))
+		return false;
+
+	g_fs.AddGameDirectory( TEST_DIR, FS_GAMEDIR_PATH );
+
+	// second load comes from the decompressed entries cache
+	for( i = 0; i < 2; i++ )
+	{
+		buf = g_fs.LoadFile( "maps/data.bin", &len, false );
+		if( !buf || len != TEST_SIZE || memcmp( buf, data, TEST_SIZE ))
+		{
+			printf( "LoadFile fail\n" );
+			return false;
+		}
+		free( buf );
+	}
+
+	f = g_fs.Open( "maps/data.bin", "rb", false );
+	if( !f )
+	{
+		printf( "Open deflated file fail\n" );
+		return false;
+	}
+
+	if( g_fs.FileLength( f ) != TEST_SIZE )
+	{
+		printf( "FileLength fail\n" );
+		return false;
+	}
+
+	// sequential reads, small ones go through the file buffer
+	for( i = 0; i < TEST_SIZE; i += 1000 )
+	{
+		byte chunk[1000];
+
+		if( g_fs.Read( f, chunk, i % 2000 ? 100 : 1000 ) != ( i % 2000 ? 100 : 1000 ))
+		{
+			printf( "Read at %d fail\n", i );
+			return false;
+		}
+
+		if( memcmp( chunk, data + i, i % 2000 ? 100 : 1000 ))
+		{
+			printf( "Read contents at %d fail\n", i );
+			return false;
+		}
+
+		g_fs.Seek( f, i + 1000, SEEK_SET );
+	}
+
+	// forward, backward and whole file seeks
+	if( !CheckRead( f, data, 70000, 100 ) || !CheckRead( f, data, 10, 5000 )
+		|| !CheckRead( f, data, 0, TEST_SIZE ) || !CheckRead( f, data, TEST_SIZE - 1, 1 ))
+		return false;
+
+	if( !g_fs.Eof( f ))
+	{
+		printf( "Eof fail\n" );
+		return false;
+	}
+
+	g_fs.Close( f );
+	g_fs.ClearSearchPath();
+
+	remove( TEST_DIR "pak0.pk3" );
+	remove( TEST_DIR );
+
+	return true;
+}
+
+int main( void )
+{
+	if( !LoadFilesystem() )
+		return EXIT_FAILURE;
+
+	if( !TestZipStream())
+		return EXIT_FAILURE;
+
+	printf( "success\n" );
+
+	return EXIT_SUCCESS;
+}
@@ -630,6 +630,29 @@ static byte *W_ReadLump( searchpath_t *search, const char *path, int pack_ind, f
 	return buf;
 }
 
+/*
+===========
+W_LumpRange
+
+W_ReadLump returns lump data as is, so it can be mapped directly,
+unless wad itself is deflated inside a zip or lump is compressed
+===========
+*/
+static qboolean W_LumpRange( searchpath_t *search, int pack_ind, int *handle, fs_offset_t *offset, fs_offset_t *size )
+{
+	const wfile_t *wad = search->wad;
+	const dlumpinfo_t *lump = &wad->lumps[pack_ind];
+
+	if( wad->handle->ztk || lump->disksize != lump->size )
+		return false;
+
+	*handle = wad->handle->handle;
+	*offset = wad->handle->offset + lump->filepos;
+	*size = lump->disksize;
+
+	return true;
+}
+
 /*
 ====================
 FS_AddWad_Fullpath
@@ -663,6 +686,7 @@ searchpath_t *FS_AddWad_Fullpath( const char *wadfile, int flags )
 	search->pfnFindFile = FS_FindFile_WAD;
 	search->pfnSearch = FS_Search_WAD;
 	search->pfnLoadFile = W_ReadLump;
+	search->pfnFileRange = W_LumpRange;
 
 	Con_Reportf( "Adding wadfile: %s (%i files)\n", wadfile, wad->numlumps );
 	return search;
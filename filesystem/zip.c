@@ -26,6 +26,7 @@ GNU General Public License for more details.
 #include "port.h"
 #include "filesystem_internal.h"
 #include "crtlib.h"
+#include "xash3d_mathlib.h"
 #include "common/com_strings.h"
 #include "miniz.h"
 
@@ -40,6 +41,10 @@ GNU General Public License for more details.
 
 #define ZIP_ZIP64 0xffffffff
 
+#define ZIP_INFLATE_BUFF_SIZE	(16384)		// compressed input buffer for inflate streams
+#define ZIP_CACHE_SIZE		(16 * 1024 * 1024)	// decompressed entries cache budget
+#define ZIP_CACHE_MAX_ENTRY	(ZIP_CACHE_SIZE / 4)	// bigger entries aren't cached
+
 #pragma pack( push, 1 )
 typedef struct zip_header_s
 {
@@ -129,6 +134,35 @@ struct zip_s
 	zipfile_t	*files;
 };
 
+struct ztoolkit_s
+{
+	z_stream	zstream;
+	fs_offset_t	offset;		// compressed data offset in the archive
+	fs_offset_t	comp_length;	// compressed data size
+	fs_offset_t	in_position;	// compressed bytes already fed to inflate
+	fs_offset_t	out_position;	// current position in the decompressed stream
+	byte		input[ZIP_INFLATE_BUFF_SIZE];
+};
+
+// recently decompressed entries, most recently used first
+typedef struct zipcache_s
+{
+	struct zipcache_s *prev, *next;
+	const zip_t	*zip;
+	int		index;
+	fs_offset_t	size;
+	byte		*data;
+} zipcache_t;
+
+static struct
+{
+	zipcache_t	*head, *tail;
+	int		numentries;
+	size_t		totalsize;
+	uint		hits;
+	uint		misses;
+} zip_cache;
+
 #ifdef XASH_REDUCE_FD
 static void FS_EnsureOpenZip( zip_t *zip )
 {
@@ -148,6 +182,269 @@ static void FS_EnsureOpenZip( zip_t *zip )
 static void FS_EnsureOpenZip( zip_t *zip ) {}
 #endif
 
+/*
+============
+Zip_InitStream
+
+============
+*/
+static qboolean Zip_InitStream( ztoolkit_t *ztk, const zipfile_t *file )
+{
+	memset( ztk, 0, offsetof( ztoolkit_t, input ));
+	ztk->offset = file->offset;
+	ztk->comp_length = file->compressed_size;
+
+	if( inflateInit2( &ztk->zstream, -MAX_WBITS ) != Z_OK )
+	{
+		Con_Printf( S_ERROR "%s: inflateInit2 failed\n", __func__ );
+		return false;
+	}
+
+	return true;
+}
+
+/*
+============
+Zip_Inflate
+
+decompress next "size" bytes of the stream, reading compressed data by chunks
+============
+*/
+static fs_offset_t Zip_Inflate( ztoolkit_t *ztk, int handle, byte *buffer, size_t size )
+{
+	fs_offset_t done;
+	int zlib_result;
+
+	ztk->zstream.next_out = buffer;
+	ztk->zstream.avail_out = size;
+
+	while( ztk->zstream.avail_out > 0 )
+	{
+		if( ztk->zstream.avail_in == 0 && ztk->in_position < ztk->comp_length )
+		{
+			fs_offset_t count = Q_min( ztk->comp_length - ztk->in_position, (fs_offset_t)sizeof( ztk->input ));
+			fs_offset_t nb;
+
+			nb = FS_SysReadAt( handle, ztk->input, count, ztk->offset + ztk->in_position );
+			if( nb <= 0 )
+				break;
+
+			ztk->in_position += nb;
+			ztk->zstream.next_in = ztk->input;
+			ztk->zstream.avail_in = nb;
+		}
+
+		zlib_result = inflate( &ztk->zstream, Z_SYNC_FLUSH );
+
+		if( zlib_result == Z_STREAM_END )
+			break;
+
+		if( zlib_result != Z_OK )
+		{
+			// Z_BUF_ERROR means truncated input, any other code is corrupted data
+			Con_Reportf( S_ERROR "%s: error while file decompressing. Zlib return code %d.\n", __func__, zlib_result );
+			break;
+		}
+	}
+
+	done = size - ztk->zstream.avail_out;
+	ztk->out_position += done;
+
+	return done;
+}
+
+/*
+============
+FS_Inflate_ZIP
+
+read decompressed data of a deflated entry at the current file position
+============
+*/
+fs_offset_t FS_Inflate_ZIP( file_t *file, void *buffer, size_t size )
+{
+	ztoolkit_t *ztk = file->ztk;
+	byte temp[FILE_BUFF_SIZE];
+
+	// deflate streams can't be rewinded, start over
+	if( file->position < ztk->out_position )
+	{
+		inflateReset( &ztk->zstream );
+		ztk->zstream.avail_in = 0;
+		ztk->in_position = 0;
+		ztk->out_position = 0;
+	}
+
+	// skip data up to the seek position
+	while( ztk->out_position < file->position )
+	{
+		fs_offset_t count = Q_min( file->position - ztk->out_position, (fs_offset_t)sizeof( temp ));
+
+		if( Zip_Inflate( ztk, file->handle, temp, count ) != count )
+			return 0;
+	}
+
+	return Zip_Inflate( ztk, file->handle, buffer, size );
+}
+
+/*
+============
+FS_CloseInflate_ZIP
+
+============
+*/
+void FS_CloseInflate_ZIP( file_t *file )
+{
+	inflateEnd( &file->ztk->zstream );
+	Mem_Free( file->ztk );
+	file->ztk = NULL;
+}
+
+/*
+============
+Zip_CacheUnlink
+
+============
+*/
+static void Zip_CacheUnlink( zipcache_t *entry )
+{
+	if( entry->prev ) entry->prev->next = entry->next;
+	else zip_cache.head = entry->next;
+
+	if( entry->next ) entry->next->prev = entry->prev;
+	else zip_cache.tail = entry->prev;
+
+	entry->prev = entry->next = NULL;
+}
+
+/*
+============
+Zip_CacheRemove
+
+============
+*/
+static void Zip_CacheRemove( zipcache_t *entry )
+{
+	Zip_CacheUnlink( entry );
+
+	zip_cache.totalsize -= entry->size;
+	zip_cache.numentries--;
+
+	Mem_Free( entry->data );
+	Mem_Free( entry );
+}
+
+/*
+============
+Zip_CacheLookup
+
+returns a copy of cached entry, caller must free it
+============
+*/
+static byte *Zip_CacheLookup( const zip_t *zip, int index, fs_offset_t *sizeptr )
+{
+	zipcache_t *entry;
+	byte *data;
+
+	for( entry = zip_cache.head; entry; entry = entry->next )
+	{
+		if( entry->zip == zip && entry->index == index )
+			break;
+	}
+
+	if( !entry )
+	{
+		zip_cache.misses++;
+		return NULL;
+	}
+
+	zip_cache.hits++;
+
+	// move to the front
+	if( entry != zip_cache.head )
+	{
+		Zip_CacheUnlink( entry );
+		entry->next = zip_cache.head;
+		zip_cache.head->prev = entry;
+		zip_cache.head = entry;
+	}
+
+	data = Mem_Malloc( fs_mempool, entry->size + 1 );
+	memcpy( data, entry->data, entry->size + 1 );
+
+	if( sizeptr ) *sizeptr = entry->size;
+
+	return data;
+}
+
+/*
+============
+Zip_CacheStore
+
+============
+*/
+static void Zip_CacheStore( const zip_t *zip, int index, const byte *data, fs_offset_t size )
+{
+	zipcache_t *entry;
+
+	if( size > ZIP_CACHE_MAX_ENTRY )
+		return;
+
+	// drop least recently used entries
+	while( zip_cache.tail && zip_cache.totalsize + size > ZIP_CACHE_SIZE )
+		Zip_CacheRemove( zip_cache.tail );
+
+	entry = (zipcache_t *)Mem_Calloc( fs_mempool, sizeof( *entry ));
+	entry->zip = zip;
+	entry->index = index;
+	entry->size = size;
+	entry->data = Mem_Malloc( fs_mempool, size + 1 );
+	memcpy( entry->data, data, size + 1 );
+
+	entry->next = zip_cache.head;
+	if( zip_cache.head )
+		zip_cache.head->prev = entry;
+	else zip_cache.tail = entry;
+	zip_cache.head = entry;
+
+	zip_cache.totalsize += size;
+	zip_cache.numentries++;
+}
+
+/*
+============
+Zip_CacheFlush
+
+drop cached entries of the archive, or everything if zip is NULL
+============
+*/
+static void Zip_CacheFlush( const zip_t *zip )
+{
+	zipcache_t *entry, *next;
+
+	for( entry = zip_cache.head; entry; entry = next )
+	{
+		next = entry->next;
+
+		if( !zip || entry->zip == zip )
+			Zip_CacheRemove( entry );
+	}
+}
+
+/*
+============
+FS_PrintCacheInfo_ZIP
+
+============
+*/
+void FS_PrintCacheInfo_ZIP( void )
+{
+	uint total = zip_cache.hits + zip_cache.misses;
+
+	Con_Printf( "Zip cache: %i entries, %s used, %u hits, %u misses (%.1f%% hit rate)\n",
+		zip_cache.numentries, Q_memprint( zip_cache.totalsize ), zip_cache.hits, zip_cache.misses,
+		total ? zip_cache.hits * 100.0 / total : 0.0 );
+}
+
 /*
 ============
 FS_CloseZIP
@@ -155,6 +452,8 @@ FS_CloseZIP
 */
 static void FS_CloseZIP( zip_t *zip )
 {
+	Zip_CacheFlush( zip );
+
 	if( zip->files )
 		Mem_Free( zip->files );
 
@@ -186,6 +485,115 @@ static int FS_SortZip( const void *a, const void *b )
 	return Q_stricmp( ( ( zipfile_t* )a )->name, ( ( zipfile_t* )b )->name );
 }
 
+// file table entry in archive index, followed by the name
+typedef struct zipindex_s
+{
+	fs_offset_t	offset;
+	fs_offset_t	size;
+	fs_offset_t	compressed_size;
+	uint16_t	flags;
+	uint16_t	namelen;
+} zipindex_t;
+
+/*
+============
+FS_LoadZipIndex
+
+take sorted file table from the archive index
+============
+*/
+static qboolean FS_LoadZipIndex( zip_t *zip, const char *zipfile )
+{
+	const byte *index, *p, *end;
+	size_t indexsize;
+	int i, numfiles;
+
+	if( !( index = FS_FindIndex( zipfile, SEARCHPATH_ZIP, &indexsize )) || indexsize < sizeof( numfiles ))
+		return false;
+
+	memcpy( &numfiles, index, sizeof( numfiles ));
+	if( numfiles <= 0 )
+		return false;
+
+	p = index + sizeof( numfiles );
+	end = index + indexsize;
+	zip->files = (zipfile_t *)Mem_Calloc( fs_mempool, sizeof( *zip->files ) * numfiles );
+
+	for( i = 0; i < numfiles; i++ )
+	{
+		zipindex_t entry;
+
+		if( p + sizeof( entry ) > end )
+			break;
+
+		memcpy( &entry, p, sizeof( entry ));
+		p += sizeof( entry );
+
+		if( entry.namelen >= MAX_SYSPATH || p + entry.namelen > end )
+			break;
+
+		memcpy( zip->files[i].name, p, entry.namelen );
+		zip->files[i].name[entry.namelen] = '\0';
+		zip->files[i].offset = entry.offset;
+		zip->files[i].size = entry.size;
+		zip->files[i].compressed_size = entry.compressed_size;
+		zip->files[i].flags = entry.flags;
+		p += entry.namelen;
+	}
+
+	if( i != numfiles )
+	{
+		Mem_Free( zip->files );
+		zip->files = NULL;
+		return false;
+	}
+
+	zip->numfiles = numfiles;
+	zip->filetime = FS_SysFileTime( zipfile );
+
+	return true;
+}
+
+/*
+============
+FS_StoreZipIndex
+
+============
+*/
+static void FS_StoreZipIndex( const zip_t *zip, const char *zipfile )
+{
+	size_t indexsize = sizeof( zip->numfiles );
+	byte *index, *p;
+	int i;
+
+	for( i = 0; i < zip->numfiles; i++ )
+		indexsize += sizeof( zipindex_t ) + Q_strlen( zip->files[i].name );
+
+	p = index = Mem_Malloc( fs_mempool, indexsize );
+	memcpy( p, &zip->numfiles, sizeof( zip->numfiles ));
+	p += sizeof( zip->numfiles );
+
+	for( i = 0; i < zip->numfiles; i++ )
+	{
+		zipindex_t entry;
+
+		memset( &entry, 0, sizeof( entry ));
+		entry.offset = zip->files[i].offset;
+		entry.size = zip->files[i].size;
+		entry.compressed_size = zip->files[i].compressed_size;
+		entry.flags = zip->files[i].flags;
+		entry.namelen = Q_strlen( zip->files[i].name );
+
+		memcpy( p, &entry, sizeof( entry ));
+		p += sizeof( entry );
+		memcpy( p, zip->files[i].name, entry.namelen );
+		p += entry.namelen;
+	}
+
+	FS_StoreIndex( zipfile, SEARCHPATH_ZIP, index, indexsize );
+	Mem_Free( index );
+}
+
 /*
 ============
 FS_LoadZip
@@ -216,6 +624,19 @@ static zip_t *FS_LoadZip( const char *zipfile, int *error )
 		return NULL;
 	}
 
+	// unchanged archive, skip directory parsing
+	if( FS_LoadZipIndex( zip, zipfile ))
+	{
+#ifdef XASH_REDUCE_FD
+		close( zip->handle );
+		zip->handle = -1;
+#endif
+		if( error )
+			*error = ZIP_LOAD_OK;
+
+		return zip;
+	}
+
 	length = lseek( zip->handle, 0, SEEK_END );
 
 	if( length > UINT_MAX )
@@ -380,6 +801,8 @@ static zip_t *FS_LoadZip( const char *zipfile, int *error )
 
 	qsort( zip->files, zip->numfiles, sizeof( *zip->files ), FS_SortZip );
 
+	FS_StoreZipIndex( zip, zipfile );
+
 #ifdef XASH_REDUCE_FD
 	// will reopen when needed
 	close(zip->handle);
@@ -402,16 +825,105 @@ Open a packed file using its package file descriptor
 static file_t *FS_OpenFile_ZIP( searchpath_t *search, const char *filename, const char *mode, int pack_ind )
 {
 	zipfile_t	*pfile;
+	file_t	*file;
+
 	pfile = &search->zip->files[pack_ind];
 
-	// compressed files handled in Zip_LoadFile
-	if( pfile->flags != ZIP_COMPRESSION_NO_COMPRESSION )
+	if( pfile->flags != ZIP_COMPRESSION_NO_COMPRESSION && pfile->flags != ZIP_COMPRESSION_DEFLATED )
 	{
-		Con_Printf( S_ERROR "%s: can't open compressed file %s\n", __FUNCTION__, pfile->name );
+		Con_Printf( S_ERROR "%s: %s compressed with unknown algorithm\n", __FUNCTION__, pfile->name );
 		return NULL;
 	}
 
-	return FS_OpenHandle( search->filename, search->zip->handle, pfile->offset, pfile->size );
+	file = FS_OpenHandle( search->filename, search->zip->handle, pfile->offset, pfile->size );
+
+	// deflated files are decompressed on the fly in FS_Read
+	if( file && pfile->flags == ZIP_COMPRESSION_DEFLATED )
+	{
+		file->ztk = (ztoolkit_t *)Mem_Malloc( fs_mempool, sizeof( *file->ztk ));
+
+		if( !Zip_InitStream( file->ztk, pfile ))
+		{
+			Mem_Free( file->ztk );
+			file->ztk = NULL;
+			FS_Close( file );
+			return NULL;
+		}
+	}
+
+	return file;
+}
+
+/*
+===========
+FS_FileRange_ZIP
+
+only stored files can be mapped directly
+===========
+*/
+static qboolean FS_FileRange_ZIP( searchpath_t *search, int pack_ind, int *handle, fs_offset_t *offset, fs_offset_t *size )
+{
+	zipfile_t	*pfile = &search->zip->files[pack_ind];
+
+	if( pfile->flags != ZIP_COMPRESSION_NO_COMPRESSION )
+		return false;
+
+	*handle = search->zip->handle;
+	*offset = pfile->offset;
+	*size = pfile->size;
+
+	return true;
+}
+
+/*
+===========
+FS_DeflatedRange_ZIP
+
+location of compressed data of deflated file
+===========
+*/
+qboolean FS_DeflatedRange_ZIP( searchpath_t *search, int pack_ind, int *handle, fs_offset_t *offset, fs_offset_t *disksize, fs_offset_t *size )
+{
+	zipfile_t	*pfile = &search->zip->files[pack_ind];
+
+	if( pfile->flags != ZIP_COMPRESSION_DEFLATED )
+		return false;
+
+	*handle = search->zip->handle;
+	*offset = pfile->offset;
+	*disksize = pfile->compressed_size;
+	*size = pfile->size;
+
+	return true;
+}
+
+/*
+===========
+FS_InflateBuffer_ZIP
+
+decompress whole deflated file at once, doesn't touch
+filesystem state, so it's safe to call from any thread
+===========
+*/
+qboolean FS_InflateBuffer_ZIP( const byte *in, fs_offset_t inlen, byte *out, fs_offset_t outlen )
+{
+	z_stream	zstream;
+	int		zlib_result;
+
+	memset( &zstream, 0, sizeof( zstream ));
+
+	if( inflateInit2( &zstream, -MAX_WBITS ) != Z_OK )
+		return false;
+
+	zstream.next_in = (Bytef *)in;
+	zstream.avail_in = inlen;
+	zstream.next_out = out;
+	zstream.avail_out = outlen;
+
+	zlib_result = inflate( &zstream, Z_FINISH );
+	inflateEnd( &zstream );
+
+	return ( zlib_result == Z_STREAM_END || zlib_result == Z_OK ) && zstream.avail_out == 0;
 }
 
 /*
@@ -424,10 +936,8 @@ static byte *FS_LoadZIPFile( searchpath_t *search, const char *path, int pack_in
 {
 	zipfile_t *file;
 	int		index;
-	byte		*compressed_buffer = NULL, *decompressed_buffer = NULL;
-	int		zlib_result = 0;
+	byte		*decompressed_buffer = NULL;
 	dword		test_crc, final_crc;
-	z_stream	decompress_stream;
 	size_t      c;
 
 	if( sizeptr ) *sizeptr = 0;
@@ -436,9 +946,6 @@ static byte *FS_LoadZIPFile( searchpath_t *search, const char *path, int pack_in
 
 	FS_EnsureOpenZip( search->zip );
 
-	if( lseek( search->zip->handle, file->offset, SEEK_SET ) == -1 )
-		return NULL;
-
 	/*if( read( search->zip->handle, &header, sizeof( header ) ) < 0 )
 		return NULL;
 
@@ -453,10 +960,11 @@ static byte *FS_LoadZIPFile( searchpath_t *search, const char *path, int pack_in
 		decompressed_buffer = Mem_Malloc( fs_mempool, file->size + 1 );
 		decompressed_buffer[file->size] = '\0';
 
-		c = read( search->zip->handle, decompressed_buffer, file->size );
+		c = FS_SysReadAt( search->zip->handle, decompressed_buffer, file->size, file->offset );
 		if( c != file->size )
 		{
 			Con_Reportf( S_ERROR "Zip_LoadFile: %s size doesn't match\n", file->name );
+			Mem_Free( decompressed_buffer );
 			return NULL;
 		}
 
@@ -480,68 +988,57 @@ static byte *FS_LoadZIPFile( searchpath_t *search, const char *path, int pack_in
 	}
 	else if( file->flags == ZIP_COMPRESSION_DEFLATED )
 	{
-		compressed_buffer = Mem_Malloc( fs_mempool, file->compressed_size + 1 );
-		decompressed_buffer = Mem_Malloc( fs_mempool, file->size + 1 );
-		decompressed_buffer[file->size] = '\0';
+		ztoolkit_t *ztk;
+
+		// same assets are loaded again on every changelevel
+		decompressed_buffer = Zip_CacheLookup( search->zip, pack_ind, sizeptr );
+		if( decompressed_buffer )
+		{
+			FS_EnsureOpenZip( NULL );
+			return decompressed_buffer;
+		}
 
-		c = read( search->zip->handle, compressed_buffer, file->compressed_size );
-		if( c != file->compressed_size )
+		// decompress directly into the output buffer, reading compressed data by chunks
+		ztk = (ztoolkit_t *)Mem_Malloc( fs_mempool, sizeof( *ztk ));
+		if( !Zip_InitStream( ztk, file ))
 		{
-			Con_Reportf( S_ERROR "Zip_LoadFile: %s compressed size doesn't match\n", file->name );
+			Mem_Free( ztk );
 			return NULL;
 		}
 
-		memset( &decompress_stream, 0, sizeof( decompress_stream ) );
+		decompressed_buffer = Mem_Malloc( fs_mempool, file->size + 1 );
+		decompressed_buffer[file->size] = '\0';
 
-		decompress_stream.total_in = decompress_stream.avail_in = file->compressed_size;
-		decompress_stream.next_in = (Bytef *)compressed_buffer;
-		decompress_stream.total_out = decompress_stream.avail_out = file->size;
-		decompress_stream.next_out = (Bytef *)decompressed_buffer;
+		c = Zip_Inflate( ztk, search->zip->handle, decompressed_buffer, file->size );
 
-		decompress_stream.zalloc = Z_NULL;
-		decompress_stream.zfree = Z_NULL;
-		decompress_stream.opaque = Z_NULL;
+		inflateEnd( &ztk->zstream );
+		Mem_Free( ztk );
 
-		if( inflateInit2( &decompress_stream, -MAX_WBITS ) != Z_OK )
+		if( c != file->size )
 		{
-			Con_Printf( S_ERROR "Zip_LoadFile: inflateInit2 failed\n" );
-			Mem_Free( compressed_buffer );
+			Con_Reportf( S_ERROR "Zip_LoadFile: %s : error while file decompressing.\n", file->name );
 			Mem_Free( decompressed_buffer );
 			return NULL;
 		}
-
-		zlib_result = inflate( &decompress_stream, Z_NO_FLUSH );
-		inflateEnd( &decompress_stream );
-
-		if( zlib_result == Z_OK || zlib_result == Z_STREAM_END )
-		{
-			Mem_Free( compressed_buffer ); // finaly free compressed buffer
 #if 0
-			CRC32_Init( &test_crc );
-			CRC32_ProcessBuffer( &test_crc, decompressed_buffer, file->size );
-
-			final_crc = CRC32_Final( test_crc );
+		CRC32_Init( &test_crc );
+		CRC32_ProcessBuffer( &test_crc, decompressed_buffer, file->size );
 
-			if( final_crc != file->crc32 )
-			{
-				Con_Reportf( S_ERROR "Zip_LoadFile: %s file crc32 mismatch\n", file->name );
-				Mem_Free( decompressed_buffer );
-				return NULL;
-			}
-#endif
-			if( sizeptr ) *sizeptr = file->size;
+		final_crc = CRC32_Final( test_crc );
 
-			FS_EnsureOpenZip( NULL );
-			return decompressed_buffer;
-		}
-		else
+		if( final_crc != file->crc32 )
 		{
-			Con_Reportf( S_ERROR "Zip_LoadFile: %s : error while file decompressing. Zlib return code %d.\n", file->name, zlib_result );
-			Mem_Free( compressed_buffer );
+			Con_Reportf( S_ERROR "Zip_LoadFile: %s file crc32 mismatch\n", file->name );
 			Mem_Free( decompressed_buffer );
 			return NULL;
 		}
+#endif
+		Zip_CacheStore( search->zip, pack_ind, decompressed_buffer, file->size );
 
+		if( sizeptr ) *sizeptr = file->size;
+
+		FS_EnsureOpenZip( NULL );
+		return decompressed_buffer;
 	}
 	else
 	{
@@ -692,6 +1189,7 @@ searchpath_t *FS_AddZip_Fullpath( const char *zipfile, int flags )
 	search->pfnFindFile = FS_FindFile_ZIP;
 	search->pfnSearch = FS_Search_ZIP;
 	search->pfnLoadFile = FS_LoadZIPFile;
+	search->pfnFileRange = FS_FileRange_ZIP;
 
 	Con_Reportf( "Adding zipfile: %s (%i files)\n", zipfile, zip->numfiles );
 	return search;
@@ -3710,7 +3710,6 @@ static void R_StudioLoadTexture( model_t *mod, studiohdr_t *phdr, mstudiotexture
 		byte	*pixels;
 
 		i = mod->numtextures;
-		mod->textures = (texture_t **)Mem_Realloc( mod->mempool, mod->textures, ( i + 1 ) * sizeof( texture_t* ));
 		size = ptexture->width * ptexture->height + 768;
 		tx = Mem_Calloc( mod->mempool, sizeof( *tx ) + size );
 		mod->textures[i] = tx;
@@ -3788,7 +3787,7 @@ void Mod_StudioLoadTextures( model_t *mod, void *data )
 {
 	studiohdr_t	*phdr = (studiohdr_t *)data;
 	mstudiotexture_t	*ptexture;
-	int		i;
+	int		i, count;
 
 	if( !phdr )
 		return;
@@ -3796,6 +3795,15 @@ void Mod_StudioLoadTextures( model_t *mod, void *data )
 	ptexture = (mstudiotexture_t *)(((byte *)phdr) + phdr->textureindex);
 	if( phdr->textureindex > 0 && phdr->numtextures <= MAXSTUDIOSKINS )
 	{
+		for( i = count = 0; i < phdr->numtextures; i++ )
+		{
+			if( !Q_strnicmp( ptexture[i].name, "DM_Base", 7 ) || !Q_strnicmp( ptexture[i].name, "remap", 5 ))
+				count++;
+		}
+
+		// size the remap list once, arena pools keep every reallocated copy
+		if( count ) mod->textures = (texture_t **)Mem_Realloc( mod->mempool, mod->textures, ( mod->numtextures + count ) * sizeof( texture_t* ));
+
 		for( i = 0; i < phdr->numtextures; i++ )
 			R_StudioLoadTexture( mod, phdr, &ptexture[i] );
 	}